@@ -2,21 +2,61 @@
 #define SRC_AV_SYSTEM_H
 
 #include "chip8.h"
+#include "key_injector.h"
+#include "simd_kernels.h"
 #include <array>
+#include <bit>
 #include <concepts>
+#include <cstdint>
 #include <ostream>
 
 namespace chip8 {
 
+// A finished picture handed from the emulation thread to the frontend: one
+// uint64_t per row with x = 0 in bit 63, whichever framebuffer layout the
+// machine uses.
+struct Frame {
+  std::array<uint64_t, 32> rows = {};
+  // Emulated frames run before this one was captured.
+  uint64_t number = 0u;
+};
+
+// The extended core's picture (see ExtendedChip8): its two 128x64
+// bitplanes, each row k_wide_row_words words with x = 0 in bit 63 of the
+// first.
+struct PlaneFrame {
+  std::array<std::array<uint64_t, 64 * k_wide_row_words>, 2> planes = {};
+  uint64_t number = 0u;
+};
+
+// Copies the rows chip8.dirty_rows_ marks into `frame` and returns the ones
+// whose pixels changed: 0 when the frame's draws cancelled out, e.g. a
+// sprite XORed twice to flicker.
+inline uint32_t update_frame(const Chip8State &chip8, Frame &frame) {
+  uint32_t changed = 0u;
+  for (uint32_t dirty = chip8.dirty_rows_; dirty != 0u; dirty &= dirty - 1u) {
+    const int y = std::countr_zero(dirty);
+    const uint64_t row = chip8.display_row(y);
+    if (row != frame.rows[y]) {
+      frame.rows[y] = row;
+      changed |= 1u << y;
+    }
+  }
+  return changed;
+}
+
+// A frontend owns the window and input device. It runs on its own thread:
+// poll_events() pushes timestamped key transitions for the emulation thread
+// (see KeyInjector) and
+// present() shows a frame it published.
 template <typename T>
-concept AVSystem = requires(T t, const Chip8 &chip8, int width, int height) {
+concept AVSystem = requires(T t, const Frame &frame, KeyQueue &keys,
+                            int width, int height) {
   { T(width, height) };
 
-  {
-    t.poll_events(std::declval<bool &>(), std::declval<Chip8 &>())
-  } -> std::same_as<void>;
+  { t.poll_events(std::declval<bool &>(), keys) } -> std::same_as<void>;
 
-  { t.draw(chip8) } -> std::same_as<void>;
+  { t.present(frame) } -> std::same_as<void>;
 };
 
 } // namespace chip8
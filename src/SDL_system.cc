@@ -1,24 +1,92 @@
 #include "SDL_system.h"
 #include "app_error.h"
-
-#include <arm_neon.h>
+#include "simd_kernels.h"
+#include "tone_generator.h"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_audio.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include <string>
 
 namespace chip8 {
 
 namespace {
-constexpr int k_samples_per_second = 44100;
-constexpr int k_tone_hz = 440;
-constexpr int k_tone_volume = 3000;
-constexpr int k_square_wave_period = k_samples_per_second / k_tone_hz;
-constexpr int k_half_square_wave_period = k_square_wave_period / 2;
+// Samples synthesised per SDL_PutAudioStreamData() call in the callback;
+// the scratch buffer lives on the audio thread's stack.
+constexpr int k_audio_chunk_samples = 1024;
+
+constexpr const char *k_window_title = "CHIP-8 Emulator";
+
+constexpr uint32_t k_pixel_on = 0xFFFFFFFF;
+constexpr uint32_t k_pixel_off = 0xFF000000;
+// Indexed by plane 0's bit plus twice plane 1's.
+constexpr std::array<uint32_t, 4> k_plane_palette = {k_pixel_off, k_pixel_on,
+                                                     0xFFAAAAAA, 0xFF555555};
+
+// The usual 1234/QWER/ASDF/ZXCV layout for the 4x4 hex keypad.
+uint8_t keypad_index(SDL_Keycode key) {
+  switch (key) {
+  case SDLK_X:
+    return 0x0u;
+  case SDLK_1:
+    return 0x1u;
+  case SDLK_2:
+    return 0x2u;
+  case SDLK_3:
+    return 0x3u;
+  case SDLK_Q:
+    return 0x4u;
+  case SDLK_W:
+    return 0x5u;
+  case SDLK_E:
+    return 0x6u;
+  case SDLK_A:
+    return 0x7u;
+  case SDLK_S:
+    return 0x8u;
+  case SDLK_D:
+    return 0x9u;
+  case SDLK_Z:
+    return 0xAu;
+  case SDLK_C:
+    return 0xBu;
+  case SDLK_4:
+    return 0xCu;
+  case SDLK_R:
+    return 0xDu;
+  case SDLK_F:
+    return 0xEu;
+  case SDLK_V:
+    return 0xFu;
+  default:
+    return k_unmapped_key;
+  }
+}
+
+// Runs on SDL's audio thread whenever the device needs `additional_amount`
+// more bytes; tops the stream up with exactly that much tone.
+void SDLCALL feed_audio(void *userdata, SDL_AudioStream *stream,
+                        int additional_amount, int total_amount) {
+  auto *tone = static_cast<ToneGenerator *>(userdata);
+  std::array<int16_t, k_audio_chunk_samples> chunk;
+  int samples = additional_amount / static_cast<int>(sizeof(int16_t));
+  while (samples > 0) {
+    const int count = std::min(samples, k_audio_chunk_samples);
+    tone->generate(std::span(chunk.data(), count));
+    SDL_PutAudioStreamData(stream, chunk.data(),
+                           count * static_cast<int>(sizeof(int16_t)));
+    samples -= count;
+  }
+}
 
 void handle_quit_signals(int sig) {
   SDL_Event event;
@@ -30,165 +98,211 @@ void handle_quit_signals(int sig) {
 
 SDLSystem::SDLSystem(int width, int height, SDL_Window *window,
                      SDL_Renderer *renderer, SDL_Texture *texture,
-                     SDL_AudioStream *stream)
-    : width_(width), height_(height), pixels_(width * height),
-      on_(vdupq_n_u32(0xFFFFFFFF)), off_(vdupq_n_u32(0xFF000000)),
-      ones_(vdupq_n_u32(1)), window_(window, SDL_DestroyWindow),
+                     SDL_AudioStream *stream,
+                     std::unique_ptr<ToneGenerator> tone,
+                     TextureMode texture_mode)
+    : width_(width), height_(height),
+      window_(window, SDL_DestroyWindow),
       renderer_(renderer, SDL_DestroyRenderer),
-      texture_(texture, SDL_DestroyTexture),
-      stream_(stream, SDL_DestroyAudioStream) {}
+      texture_(texture, SDL_DestroyTexture), texture_mode_(texture_mode),
+      tone_(std::move(tone)), stream_(stream, SDL_DestroyAudioStream) {}
 
 SDLSystem::~SDLSystem() {
   std::cout << "Destructor is invoked" << std::endl;
   SDL_Quit();
 }
 
-void SDLSystem::poll_events(bool &quit, Chip8 &chip8) {
+void SDLSystem::poll_events(bool &quit, KeyQueue &keys) {
+  // SDL stamps events on SDL_GetTicksNS(); map them onto steady_clock.
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const Uint64 now_ns = SDL_GetTicksNS();
   SDL_Event event;
-  std::array<uint8_t, 16u> &keys = chip8.keypad_;
   while (SDL_PollEvent(&event)) {
     if (event.type == SDL_EVENT_QUIT) {
       quit = true;
-    } else if (event.type == SDL_EVENT_KEY_DOWN ||
-               event.type == SDL_EVENT_KEY_UP) {
-      if (event.type == SDL_EVENT_KEY_DOWN)
-        chip8.waiting_for_key_press_ = false;
-      if (event.type == SDL_EVENT_KEY_UP)
-        chip8.waiting_for_key_release_ = false;
-      const uint8_t v = (event.type == SDL_EVENT_KEY_DOWN) ? 1u : 0u;
-      switch (event.key.key) {
-      case SDLK_X:
-        keys[0u] = v;
-        break;
-      case SDLK_1:
-        keys[1u] = v;
-        break;
-      case SDLK_2:
-        keys[2u] = v;
-        break;
-      case SDLK_3:
-        keys[3u] = v;
-        break;
-      case SDLK_Q:
-        keys[4u] = v;
-        break;
-      case SDLK_W:
-        keys[5u] = v;
-        break;
-      case SDLK_E:
-        keys[6u] = v;
-        break;
-      case SDLK_A:
-        keys[7u] = v;
-        break;
-      case SDLK_S:
-        keys[8u] = v;
-        break;
-      case SDLK_D:
-        keys[9u] = v;
-        break;
-      case SDLK_Z:
-        keys[0xAu] = v;
-        break;
-      case SDLK_C:
-        keys[0xBu] = v;
-        break;
-      case SDLK_4:
-        keys[0xCu] = v;
-        break;
-      case SDLK_R:
-        keys[0xDu] = v;
-        break;
-      case SDLK_F:
-        keys[0xEu] = v;
-        break;
-      case SDLK_V:
-        keys[0xFu] = v;
-        break;
-      default:
-        break;
+    } else if (event.type == SDL_EVENT_WINDOW_EXPOSED) {
+      full_redraw_ = true;
+    } else if ((event.type == SDL_EVENT_KEY_DOWN ||
+                event.type == SDL_EVENT_KEY_UP) &&
+               !event.key.repeat) {
+      const bool pressed = event.type == SDL_EVENT_KEY_DOWN;
+      if (event.key.key == SDLK_BACKSPACE) {
+        rewind_held_ = pressed;
+        continue;
       }
+      if (event.key.key == SDLK_TAB) {
+        turbo_held_ = pressed;
+        continue;
+      }
+      // 256 pending transitions means the emulation thread has stopped
+      // draining; dropping more cannot make that worse.
+      const Uint64 age_ns =
+          now_ns - std::min(event.key.timestamp, now_ns);
+      keys.try_push({keypad_index(event.key.key), pressed,
+                     now - std::chrono::nanoseconds(age_ns)});
     }
   }
 }
 
-void SDLSystem::publish_audio_stream(const Chip8 &chip8,
-                                     uint32_t &running_sample_index) {
-  const int samples_to_generate = k_samples_per_second / 60;
-  std::vector<Sint16> audio_buffer(samples_to_generate);
+void SDLSystem::publish_audio_state(const Chip8State &chip8, bool muted) {
+  publish_audio_state(chip8.should_beep_, muted);
+}
+
+void SDLSystem::publish_audio_state(bool should_beep, bool muted) {
+  if (tone_ != nullptr) {
+    tone_->set_beeping(should_beep && !muted);
+  }
+}
+
+void SDLSystem::show_speed(std::optional<double> cycles_per_second,
+                           double real_time) {
+  if (window_ == nullptr) {
+    return;
+  }
+  if (!cycles_per_second) {
+    SDL_SetWindowTitle(window_.get(), k_window_title);
+    return;
+  }
+  char title[96];
+  std::snprintf(title, sizeof(title), "%s - turbo %.2f MHz (x%.0f)",
+                k_window_title, *cycles_per_second / 1e6,
+                *cycles_per_second / real_time);
+  SDL_SetWindowTitle(window_.get(), title);
+}
+
+AudioStats SDLSystem::audio_stats() const {
+  return tone_ != nullptr ? tone_->stats() : AudioStats{};
+}
 
-  for (int i = 0; i < samples_to_generate; ++i) {
-    if (chip8.should_beep_) {
-      audio_buffer[i] = ((running_sample_index / k_half_square_wave_period) % 2)
-                            ? k_tone_volume
-                            : -k_tone_volume;
+int SDLSystem::buffered_audio_samples() const {
+  if (stream_ == nullptr) {
+    return 0;
+  }
+  int queued = SDL_GetAudioStreamQueued(stream_.get()) /
+               static_cast<int>(sizeof(int16_t));
+  SDL_AudioSpec spec;
+  int device_frames = 0;
+  if (!SDL_GetAudioDeviceFormat(SDL_GetAudioStreamDevice(stream_.get()),
+                                &spec, &device_frames)) {
+    device_frames = 0;
+  }
+  return std::max(queued, 0) + device_frames;
+}
+
+void SDLSystem::present(const Frame &frame) {
+  uint32_t changed = full_redraw_ ? k_all_rows : 0u;
+  for (int y = 0; y < height_; y++) {
+    if (frame.rows[y] != presented_rows_[y]) {
+      changed |= 1u << y;
+    }
+  }
+  if (changed == 0u) {
+    return;
+  }
+  // Convert and upload each run of consecutive changed rows on its own.
+  while (changed != 0u) {
+    const int first = std::countr_zero(changed);
+    const int count = std::countr_one(changed >> first);
+    const SDL_Rect rect = {0, first, width_, count};
+    void *locked = nullptr;
+    int pitch = 0;
+    if (texture_mode_ == TextureMode::Streaming &&
+        SDL_LockTexture(texture_.get(), &rect, &locked, &pitch)) {
+      // Locked memory is write-only and every pixel of the rect is written.
+      expand_rows_argb_pitched(pixel_kernels(), frame.rows.data() + first,
+                               count, locked, pitch, k_pixel_on, k_pixel_off);
+      SDL_UnlockTexture(texture_.get());
     } else {
-      audio_buffer[i] = 0;
+      uint32_t *pixels = screen_.data() + first * width_;
+      pixel_kernels().expand_rows_argb(frame.rows.data() + first, count,
+                                       pixels, k_pixel_on, k_pixel_off);
+      SDL_UpdateTexture(texture_.get(), &rect, pixels,
+                        width_ * sizeof(uint32_t));
     }
-    running_sample_index++;
+    changed &= count == 32 ? 0u : ~(((1u << count) - 1u) << first);
   }
-  SDL_PutAudioStreamData(stream_.get(), audio_buffer.data(),
-                         audio_buffer.size() * sizeof(Sint16));
+  presented_rows_ = frame.rows;
+  full_redraw_ = false;
+
+  SDL_RenderClear(renderer_.get());
+  SDL_RenderTexture(renderer_.get(), texture_.get(), NULL, NULL);
+  SDL_RenderPresent(renderer_.get());
 }
 
-void SDLSystem::draw(const Chip8 &chip8) {
-#if defined(USE_VECTOR_DRAW)
-  int step_size = 16;
-  for (int i = 0; i < pixels_; i += step_size) {
-    uint8x16_t input = vld1q_u8(chip8.display_.data() + i);
-    uint16x8_t low = vmovl_u8(vget_low_u8(input));
-    uint16x8_t high = vmovl_u8(vget_high_u8(input));
-    uint32x4_t p1 = vmovl_u16(vget_low_u16(low));
-    uint32x4_t p2 = vmovl_u16(vget_high_u16(low));
-    uint32x4_t p3 = vmovl_u16(vget_low_u16(high));
-    uint32x4_t p4 = vmovl_u16(vget_high_u16(high));
-    uint32x4_t mask1 = vceqq_u32(p1, ones_);
-    uint32x4_t mask2 = vceqq_u32(p2, ones_);
-    uint32x4_t mask3 = vceqq_u32(p3, ones_);
-    uint32x4_t mask4 = vceqq_u32(p4, ones_);
-    uint32x4_t result1 = vbslq_u32(mask1, on_, off_);
-    uint32x4_t result2 = vbslq_u32(mask2, on_, off_);
-    uint32x4_t result3 = vbslq_u32(mask3, on_, off_);
-    uint32x4_t result4 = vbslq_u32(mask4, on_, off_);
-    vst1q_u32(screen_.data() + i, result1);
-    vst1q_u32(screen_.data() + i + 4, result2);
-    vst1q_u32(screen_.data() + i + 8, result3);
-    vst1q_u32(screen_.data() + i + 12, result4);
+void SDLSystem::present(const PlaneFrame &frame) {
+  uint64_t changed = full_redraw_ ? ~uint64_t{0} : 0u;
+  for (int y = 0; y < height_; y++) {
+    for (size_t p = 0; p < frame.planes.size(); p++) {
+      const auto row = frame.planes[p].begin() + y * k_wide_row_words;
+      if (!std::equal(row, row + k_wide_row_words,
+                      presented_planes_[p].begin() + y * k_wide_row_words)) {
+        changed |= uint64_t{1} << y;
+      }
+    }
+  }
+  if (changed == 0u) {
+    return;
   }
-#else
-  for (int i = 0; i < pixels_; ++i) {
-    screen_[i] = (chip8.display_[i] == 1) ? 0xFFFFFFFF : 0xFF000000;
+  while (changed != 0u) {
+    const int first = std::countr_zero(changed);
+    const int count = std::countr_one(changed >> first);
+    const SDL_Rect rect = {0, first, width_, count};
+    const uint64_t *plane0 = frame.planes[0].data() + first * k_wide_row_words;
+    const uint64_t *plane1 = frame.planes[1].data() + first * k_wide_row_words;
+    void *locked = nullptr;
+    int pitch = 0;
+    if (texture_mode_ == TextureMode::Streaming &&
+        SDL_LockTexture(texture_.get(), &rect, &locked, &pitch)) {
+      composite_planes_argb_pitched(pixel_kernels(), plane0, plane1, count,
+                                    locked, pitch, k_plane_palette);
+      SDL_UnlockTexture(texture_.get());
+    } else {
+      plane_screen_.resize(static_cast<size_t>(width_) * height_);
+      uint32_t *pixels = plane_screen_.data() + first * width_;
+      pixel_kernels().composite_planes_argb(plane0, plane1, count, pixels,
+                                            k_plane_palette);
+      SDL_UpdateTexture(texture_.get(), &rect, pixels,
+                        width_ * sizeof(uint32_t));
+    }
+    changed &= count == 64 ? 0u : ~(((uint64_t{1} << count) - 1u) << first);
   }
-#endif
+  presented_planes_ = frame.planes;
+  full_redraw_ = false;
 
-  SDL_UpdateTexture(texture_.get(), NULL, screen_.data(),
-                    width_ * sizeof(uint32_t));
   SDL_RenderClear(renderer_.get());
   SDL_RenderTexture(renderer_.get(), texture_.get(), NULL, NULL);
   SDL_RenderPresent(renderer_.get());
 }
 
 common::StatusOr<SDLSystem> create_sdl_system(int width, int height,
-                                              int scale) {
+                                              int scale,
+                                              TextureMode texture_mode) {
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
   SDL_Window *window =
-      SDL_CreateWindow("CHIP-8 Emulator", width * scale, height * scale, 0);
+      SDL_CreateWindow(k_window_title, width * scale, height * scale, 0);
   SDL_Renderer *renderer = SDL_CreateRenderer(window, nullptr);
-  SDL_Texture *texture =
-      SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-                        SDL_TEXTUREACCESS_STATIC, width, height);
-  static SDL_AudioSpec *src_spec = new SDL_AudioSpec();
-  src_spec->freq = k_samples_per_second;
-  src_spec->format = SDL_AUDIO_S16;
-  src_spec->channels = 1;
-  SDL_AudioStream *audio_stream = SDL_OpenAudioDeviceStream(
-      SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, src_spec, nullptr, nullptr);
+  SDL_Texture *texture = SDL_CreateTexture(
+      renderer, SDL_PIXELFORMAT_ARGB8888,
+      texture_mode == TextureMode::Streaming ? SDL_TEXTUREACCESS_STREAMING
+                                             : SDL_TEXTUREACCESS_STATIC,
+      width, height);
+  SDL_AudioSpec src_spec;
+  src_spec.freq = k_samples_per_second;
+  src_spec.format = SDL_AUDIO_S16;
+  src_spec.channels = 1;
+  // Heap-allocated so the callback's pointer survives moving the SDLSystem.
+  auto tone = std::make_unique<ToneGenerator>();
+  SDL_AudioStream *audio_stream =
+      SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &src_spec,
+                                feed_audio, tone.get());
   SDL_AudioDeviceID dev = SDL_GetAudioStreamDevice(audio_stream);
   SDL_ResumeAudioDevice(dev);
   signal(SIGINT, handle_quit_signals);
   signal(SIGTERM, handle_quit_signals);
   return common::StatusOr<SDLSystem>(std::in_place, width, height, window,
-                                     renderer, texture, audio_stream);
+                                     renderer, texture, audio_stream,
+                                     std::move(tone), texture_mode);
 }
 
 } // namespace chip8
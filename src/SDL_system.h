@@ -4,49 +4,96 @@
 #include "AV_system.h"
 #include "app_error.h"
 #include "chip8.h"
-
-#include <arm_neon.h>
+#include "tone_generator.h"
 
 #include <SDL3/SDL.h>
 #include <array>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace chip8 {
 
+// How frames reach the GPU. `Static` converts into a staging array that
+// SDL_UpdateTexture then copies into the texture; `Streaming` locks the
+// texture and converts straight into its memory, saving that copy.
+enum class TextureMode : uint8_t { Static, Streaming };
+
 class SDLSystem {
 public:
   SDLSystem(int width, int height, SDL_Window *window = nullptr,
             SDL_Renderer *renderer = nullptr, SDL_Texture *texture = nullptr,
-            SDL_AudioStream *stream = nullptr);
+            SDL_AudioStream *stream = nullptr,
+            std::unique_ptr<ToneGenerator> tone = nullptr,
+            TextureMode texture_mode = TextureMode::Static);
   SDLSystem(const SDLSystem &rhs) = delete;
   SDLSystem(SDLSystem &&rhs) = default;
 
   ~SDLSystem();
-  void poll_events(bool &quit, Chip8 &chip8);
-  void draw(const Chip8 &chip8);
-  void publish_audio_stream(const Chip8 &chip8, uint32_t &running_sample_index);
+  // Pushes key transitions onto `keys` for the emulation thread, stamped
+  // with the time SDL received them rather than the time of the poll.
+  void poll_events(bool &quit, KeyQueue &keys);
+  // Converts and uploads only the rows that differ from the last presented
+  // frame, and skips presenting entirely when none do.
+  void present(const Frame &frame);
+  // Composites the two bitplanes of the rows that differ from the last
+  // presented PlaneFrame and uploads them. Needs a 128x64 texture.
+  void present(const PlaneFrame &frame);
+  // True after the window was exposed and must be drawn even without a new
+  // frame.
+  bool needs_full_redraw() const { return full_redraw_; }
+  // Called from the emulation thread once per frame: turns the tone the
+  // audio callback synthesises on or off. `muted` silences it regardless,
+  // e.g. in turbo, where beeps would be too short to hear as anything but
+  // clicks.
+  void publish_audio_state(const Chip8State &chip8, bool muted = false);
+  // The same for a core that is not a Chip8State, e.g. ExtendedChip8.
+  void publish_audio_state(bool should_beep, bool muted = false);
+  AudioStats audio_stats() const;
+  // Samples queued in the stream plus the device's own buffer: how long
+  // after the emulator starts a beep it is heard, in samples.
+  int buffered_audio_samples() const;
+  // True while Backspace (rewind) is held down.
+  bool rewind_held() const { return rewind_held_; }
+  // True while Tab (turbo) is held down.
+  bool turbo_held() const { return turbo_held_; }
+  // Shows the emulated clock rate, and its ratio to `real_time` (the rate
+  // without turbo), in the window title, or restores the plain title for
+  // std::nullopt.
+  void show_speed(std::optional<double> cycles_per_second, double real_time);
 
 private:
   const int width_;
   const int height_;
-  const int pixels_;
-
-  const uint32x4_t on_;
-  const uint32x4_t off_;
-  const uint32x4_t ones_;
 
   std::unique_ptr<SDL_Window, decltype(&SDL_DestroyWindow)> window_;
   std::unique_ptr<SDL_Renderer, decltype(&SDL_DestroyRenderer)> renderer_;
   std::unique_ptr<SDL_Texture, decltype(&SDL_DestroyTexture)> texture_;
+  const TextureMode texture_mode_;
+  // Staging for TextureMode::Static.
   std::array<uint32_t, 64 * 32> screen_;
+  std::array<uint64_t, 32> presented_rows_ = {};
+  // The same for present(const PlaneFrame &); plane_screen_ is its staging
+  // for TextureMode::Static, allocated on first use.
+  std::array<std::array<uint64_t, 64 * k_wide_row_words>, 2>
+      presented_planes_ = {};
+  std::vector<uint32_t> plane_screen_;
+  bool full_redraw_ = true;
 
+  // Declared before stream_ so the stream, and with it the callback, goes
+  // first.
+  std::unique_ptr<ToneGenerator> tone_;
   std::unique_ptr<SDL_AudioStream, decltype(&SDL_DestroyAudioStream)> stream_;
+  bool rewind_held_ = false;
+  bool turbo_held_ = false;
 };
 
 // Statically assert that SDLSystem satisfies the AVSystem concept.
 static_assert(AVSystem<SDLSystem>);
 
-common::StatusOr<SDLSystem> create_sdl_system(int width, int height, int scale);
+common::StatusOr<SDLSystem>
+create_sdl_system(int width, int height, int scale,
+                  TextureMode texture_mode = TextureMode::Streaming);
 
 } // namespace chip8
 
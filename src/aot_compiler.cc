@@ -0,0 +1,254 @@
+#include "aot_compiler.h"
+#include "chip8.h"
+#include "instruction.h"
+#include "quirks.h"
+#include "rom_analysis.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace chip8 {
+namespace {
+
+// The BasicChip8 instantiations generated code can target.
+struct MachineType {
+  std::string_view quirks;
+  std::string_view type;
+  bool display_wait = false;
+};
+
+template <typename Quirks>
+constexpr MachineType machine_type(std::string_view type) {
+  return {Quirks::k_name, type, Quirks::k_display_wait};
+}
+
+constexpr std::array<MachineType, 3> k_machine_types = {
+    machine_type<CosmacVipQuirks>("CosmacVipQuirks"),
+    machine_type<Chip48Quirks>("Chip48Quirks"),
+    machine_type<SuperChipQuirks>("SuperChipQuirks"),
+};
+
+// A run of instructions compiled into one function, covering [start, end).
+struct Block {
+  uint16_t start = 0u;
+  uint16_t end = 0u;
+};
+
+bool is_identifier(std::string_view name) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  });
+}
+
+std::string hex(uint32_t value, int digits) {
+  std::ostringstream out;
+  out << "0x" << std::uppercase << std::hex << std::setw(digits)
+      << std::setfill('0') << value;
+  return out.str();
+}
+
+// "SRC_AOT_IBM_LOGO_H" for "src/aot_ibm_logo.h".
+std::string include_guard(std::string_view path) {
+  std::string guard;
+  for (char c : path) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    guard += std::isalnum(u) ? static_cast<char>(std::toupper(u)) : '_';
+  }
+  return guard;
+}
+
+uint16_t opcode_at(std::span<const std::byte> program, uint32_t address) {
+  const size_t offset = address - k_rom_origin;
+  return static_cast<uint16_t>(std::to_integer<uint16_t>(program[offset])
+                                   << 8u |
+                               std::to_integer<uint16_t>(program[offset + 1u]));
+}
+
+// Whether AotProgram::run() has to look at the machine after `op` before
+// anything else runs: for a stall, or for code a store may have rewritten.
+bool yields(Op op, bool display_wait) {
+  switch (op) {
+  case Op::LdVxK:
+  case Op::LdBVx:
+  case Op::LdIVx:
+    return true;
+  case Op::Cls:
+  case Op::Drw:
+    return display_wait;
+  default:
+    return false;
+  }
+}
+
+std::vector<Block> split_blocks(std::span<const std::byte> program,
+                                const ControlFlowGraph &cfg,
+                                bool display_wait) {
+  std::vector<Block> blocks;
+  for (const BasicBlock &basic : cfg.blocks) {
+    uint16_t start = basic.start;
+    for (uint32_t address = basic.start; address + 2u < basic.end;
+         address += 2u) {
+      const uint16_t opcode = opcode_at(program, address);
+      if (yields(decode(opcode >> 8u, opcode & 0xFFu).op, display_wait)) {
+        blocks.push_back({start, static_cast<uint16_t>(address + 2u)});
+        start = static_cast<uint16_t>(address + 2u);
+      }
+    }
+    // compile_rom_to_cpp() only takes programs that fit in memory_.
+    blocks.push_back({start, static_cast<uint16_t>(basic.end)});
+  }
+  return blocks;
+}
+
+void emit_block(std::ostringstream &out, std::span<const std::byte> program,
+                const Block &block) {
+  out << "\n// " << hex(block.start, 3) << "-" << hex(block.end - 1u, 3)
+      << ":";
+  for (uint32_t address = block.start; address < block.end; address += 2u) {
+    out << ' ' << std::uppercase << std::hex << std::setw(4)
+        << std::setfill('0') << opcode_at(program, address) << std::dec;
+  }
+  // One instruction always fits the budget.
+  const bool single = block.end - block.start == 2u;
+  out << "\nint block_" << std::hex << block.start << std::dec
+      << "(Machine &chip8, int" << (single ? "" : " budget") << ") {\n"
+      << "  if (!aot::unchanged<" << block.end - block.start << ">(chip8, "
+      << hex(block.start, 3) << ", k_rom.data() + "
+      << hex(block.start - k_rom_origin, 3) << ")) {\n"
+      << "    return 0;\n"
+      << "  }\n"
+      << "  int ran = 0;\n"
+      << "  switch (chip8.program_counter_) {\n";
+  for (uint32_t address = block.start; address < block.end; address += 2u) {
+    const uint16_t opcode = opcode_at(program, address);
+    const Instruction in = decode(opcode >> 8u, opcode & 0xFFu);
+    const std::string_view op = op_enumerator(in.op);
+    const bool last = address + 2u == block.end;
+    out << "  case " << hex(address, 3) << ":\n";
+    if (last) {
+      out << "    chip8.program_counter_ = " << hex(address + 2u, 3) << ";\n";
+    }
+    out << "    if (!aot::step<Machine, Op::" << op << ">(\n"
+        << "            chip8, " << hex(address, 3) << ", {Op::" << op << ", "
+        << hex(in.x, 1) << ", " << hex(in.y, 1) << ", " << hex(in.n, 1)
+        << ", " << hex(in.kk, 2) << ", " << hex(in.nnn, 3) << "})) {\n"
+        << "      return ran + 1;\n"
+        << "    }\n";
+    if (last) {
+      out << "    return ran + 1;\n";
+    } else {
+      out << "    if (++ran == budget) {\n"
+          << "      chip8.program_counter_ = " << hex(address + 2u, 3)
+          << ";\n"
+          << "      return ran;\n"
+          << "    }\n"
+          << "    [[fallthrough]];\n";
+    }
+  }
+  out << "  }\n"
+      << "  return 0;\n"
+      << "}\n";
+}
+
+} // namespace
+
+common::StatusOr<AotTranslation>
+compile_rom_to_cpp(std::span<const std::byte> program,
+                   const AotOptions &options) {
+  if (!is_identifier(options.name)) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "AOT program name '" + options.name + "' is not a C++ identifier"});
+  }
+  const MachineType *machine = nullptr;
+  for (const MachineType &candidate : k_machine_types) {
+    if (candidate.quirks == options.quirks) {
+      machine = &candidate;
+    }
+  }
+  if (machine == nullptr) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Unknown quirk profile '" + options.quirks +
+            "' (expected vip, chip48 or schip)"});
+  }
+  constexpr size_t k_max_program = sizeof(Chip8State::memory_) - k_rom_origin;
+  if (program.size() > k_max_program) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "ROM of " + std::to_string(program.size()) +
+            " bytes does not fit in memory"});
+  }
+
+  const std::vector<Block> blocks =
+      split_blocks(program, recover_cfg(program, k_rom_origin, RomProfile::Vip),
+                   machine->display_wait);
+  const std::string machine_name =
+      "BasicChip8<" + std::string(machine->type) + ", " +
+      (options.checked ? "Checked" : "Unchecked") + ">";
+  const std::string banner = "// Generated by chip8_aot from " +
+                             options.rom_name + ". Do not edit.\n";
+  AotTranslation translation;
+  translation.blocks = blocks.size();
+
+  const std::string guard = include_guard(options.header_include);
+  std::ostringstream header;
+  header << banner << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+         << "#include \"src/aot_program.h\"\n"
+         << "#include \"src/chip8.h\"\n\n"
+         << "namespace chip8::aot {\n\n"
+         << "extern const AotProgram<" << machine_name << "> " << options.name
+         << ";\n\n"
+         << "} // namespace chip8::aot\n\n"
+         << "#endif\n";
+  translation.header = header.str();
+
+  std::ostringstream source;
+  source << banner << "#include \"" << options.header_include << "\"\n"
+         << "#include \"src/aot_program.h\"\n"
+         << "#include \"src/chip8.h\"\n"
+         << "#include \"src/instruction.h\"\n"
+         << "#include <array>\n"
+         << "#include <cstdint>\n\n"
+         << "namespace chip8::aot {\n"
+         << "namespace {\n\n"
+         << "using Machine = " << machine_name << ";\n\n"
+         << "constexpr std::array<uint8_t, " << program.size()
+         << "> k_rom = {";
+  for (size_t i = 0; i < program.size(); i++) {
+    source << (i % 12u == 0u ? "\n    " : " ")
+           << hex(std::to_integer<uint8_t>(program[i]), 2) << ",";
+  }
+  source << "\n};\n";
+  for (const Block &block : blocks) {
+    emit_block(source, program, block);
+    translation.instructions += (block.end - block.start) / 2u;
+  }
+  source << "\nconstexpr std::array<AotBlock<Machine>, " << blocks.size()
+         << "> k_blocks = {{";
+  for (const Block &block : blocks) {
+    source << "\n    {" << hex(block.start, 3) << ", " << hex(block.end, 3)
+           << ", &block_" << std::hex << block.start << std::dec << "},";
+  }
+  source << "\n}};\n\n"
+         << "} // namespace\n\n"
+         << "constexpr AotProgram<Machine> " << options.name << "(\""
+         << options.name << "\", k_rom, k_blocks);\n\n"
+         << "namespace {\n\n"
+         << "const bool k_registered = register_aot_program(" << options.name
+         << ");\n\n"
+         << "} // namespace\n"
+         << "} // namespace chip8::aot\n";
+  translation.source = source.str();
+  return translation;
+}
+
+} // namespace chip8
@@ -0,0 +1,45 @@
+#ifndef SRC_AOT_COMPILER_H
+#define SRC_AOT_COMPILER_H
+
+#include "app_error.h"
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace chip8 {
+
+struct AotOptions {
+  // C++ identifier of the generated chip8::aot::<name> AotProgram.
+  std::string name;
+  // Quirk profile the program runs under, by quirks.h k_name: "vip",
+  // "chip48" or "schip".
+  std::string quirks = "vip";
+  // Compile for the Checked core rather than the Unchecked one.
+  bool checked = true;
+  // What the generated source #includes for the generated header, e.g.
+  // "src/aot_ibm_logo.h". Also gives the header its include guard.
+  std::string header_include;
+  // Where the ROM came from, for the generated files' header comment.
+  std::string rom_name;
+};
+
+struct AotTranslation {
+  std::string header;
+  std::string source;
+  size_t blocks = 0u;
+  size_t instructions = 0u;
+};
+
+// Translates the ROM image `program` (as loaded at k_rom_origin) into C++
+// defining an AotProgram (see aot_program.h) with one function per basic
+// block recover_cfg() finds. Blocks are cut further after Fx0A, after
+// Fx33/Fx55, whose stores may rewrite the code that follows, and with the
+// display_wait quirk after Dxyn and 00E0, so AotProgram::run() sees every
+// stall and every rewrite before it runs on.
+common::StatusOr<AotTranslation>
+compile_rom_to_cpp(std::span<const std::byte> program,
+                   const AotOptions &options);
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,112 @@
+#include "src/aot_compiler.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+namespace {
+
+AotOptions options(const std::string &quirks = "vip") {
+  return {.name = "test_program",
+          .quirks = quirks,
+          .header_include = "src/test_program.h",
+          .rom_name = "test.ch8"};
+}
+
+bool contains(const std::string &text, const std::string &part) {
+  return text.find(part) != std::string::npos;
+}
+
+} // namespace
+
+TEST(AotCompilerTest, EmitsOneFunctionPerBlock) {
+  std::vector<std::byte> rom = program_bytes({
+      0x6005, // 200: LD V0, 5
+      0x2208, // 202: CALL 208
+      0x1204, // 204: JP 204
+      0xFFFF, // 206: never reached
+      0x7101, // 208: ADD V1, 1
+      0x00EE, // 20A: RET
+  });
+  common::StatusOr<AotTranslation> translation =
+      compile_rom_to_cpp(rom, options());
+  ASSERT_TRUE(translation.has_value()) << translation.error();
+  EXPECT_EQ(translation->blocks, 3u);
+  EXPECT_EQ(translation->instructions, 5u);
+  for (const char *block : {"block_200", "block_204", "block_208"}) {
+    EXPECT_TRUE(contains(translation->source,
+                         "int " + std::string(block) + "(Machine &chip8"))
+        << block;
+    EXPECT_TRUE(contains(translation->source, "&" + std::string(block)))
+        << block;
+  }
+  EXPECT_FALSE(contains(translation->source, "block_206"));
+  EXPECT_TRUE(contains(translation->source, "Op::Call"));
+  EXPECT_TRUE(contains(translation->source,
+                       "register_aot_program(test_program)"));
+  EXPECT_TRUE(contains(translation->header, "#ifndef SRC_TEST_PROGRAM_H"));
+  EXPECT_TRUE(contains(translation->header,
+                       "extern const AotProgram<BasicChip8<CosmacVipQuirks, "
+                       "Checked>> test_program;"));
+}
+
+TEST(AotCompilerTest, LeavesComputedJumpTargetsToTheInterpreter) {
+  std::vector<std::byte> rom = program_bytes({
+      0xB204, // 200: JP V0, 204
+      0x0000, // 202
+      0x6001, // 204: only reached through V0
+      0x1204, // 206: JP 204
+  });
+  common::StatusOr<AotTranslation> translation =
+      compile_rom_to_cpp(rom, options());
+  ASSERT_TRUE(translation.has_value()) << translation.error();
+  EXPECT_EQ(translation->blocks, 1u);
+  EXPECT_FALSE(contains(translation->source, "block_204"));
+}
+
+TEST(AotCompilerTest, EndsBlocksWhereTheMachineMayStallOrBeRewritten) {
+  std::vector<std::byte> rom = program_bytes({
+      0xF00A, // 200: LD V0, K
+      0xF055, // 202: LD [I], V0
+      0xD015, // 204: DRW V0, V1, 5
+      0x7001, // 206: ADD V0, 1
+      0x1200, // 208: JP 200
+  });
+  common::StatusOr<AotTranslation> vip = compile_rom_to_cpp(rom, options());
+  ASSERT_TRUE(vip.has_value()) << vip.error();
+  // Fx0A, Fx55 and, waiting for the display, Dxyn.
+  EXPECT_EQ(vip->blocks, 4u);
+  common::StatusOr<AotTranslation> chip48 =
+      compile_rom_to_cpp(rom, options("chip48"));
+  ASSERT_TRUE(chip48.has_value()) << chip48.error();
+  EXPECT_EQ(chip48->blocks, 3u);
+  EXPECT_TRUE(contains(chip48->source, "BasicChip8<Chip48Quirks, Checked>"));
+}
+
+TEST(AotCompilerTest, TargetsTheUncheckedCore) {
+  AotOptions unchecked = options("schip");
+  unchecked.checked = false;
+  common::StatusOr<AotTranslation> translation =
+      compile_rom_to_cpp(program_bytes({0x1200}), unchecked);
+  ASSERT_TRUE(translation.has_value()) << translation.error();
+  EXPECT_TRUE(contains(translation->header,
+                       "AotProgram<BasicChip8<SuperChipQuirks, Unchecked>>"));
+}
+
+TEST(AotCompilerTest, RejectsWhatItCannotCompile) {
+  AotOptions bad_name = options();
+  bad_name.name = "3-corax+";
+  EXPECT_EQ(compile_rom_to_cpp(program_bytes({0x1200}), bad_name).error().code,
+            common::ErrorCode::InvalidArgument);
+  EXPECT_EQ(compile_rom_to_cpp(program_bytes({0x1200}), options("xochip"))
+                .error()
+                .code,
+            common::ErrorCode::InvalidArgument);
+  std::vector<std::byte> too_large(0x1000 - 0x200 + 1);
+  EXPECT_EQ(compile_rom_to_cpp(too_large, options()).error().code,
+            common::ErrorCode::InvalidArgument);
+}
+
+} // namespace chip8
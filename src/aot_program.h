@@ -0,0 +1,191 @@
+#ifndef SRC_AOT_PROGRAM_H
+#define SRC_AOT_PROGRAM_H
+
+#include "app_error.h"
+#include "chip8.h"
+#include "headless.h"
+#include "instruction.h"
+#include "opcode_handlers.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace chip8 {
+
+// One basic block chip8_aot compiled, covering [start, end). `run` starts at
+// the machine's program_counter_, which may be any instruction in the block,
+// runs at most `budget` (>= 1) instructions and returns how many ran, the
+// last one having faulted if the block stopped early for it. It returns 0
+// without touching the machine if memory_ no longer holds the bytes the
+// block was compiled from.
+template <typename Machine> struct AotBlock {
+  uint16_t start = 0u;
+  uint16_t end = 0u;
+  int (*run)(Machine &chip8, int budget) = nullptr;
+};
+
+// A ROM compiled ahead of time by chip8_aot (see chip8_aot.bzl) for one
+// BasicChip8 instantiation: each statically reachable basic block is a
+// native function built on the interpreter's own opcode handlers.
+template <typename Machine> class AotProgram {
+public:
+  static constexpr size_t k_address_space =
+      std::tuple_size_v<decltype(Chip8State::memory_)>;
+
+  constexpr AotProgram(std::string_view name, std::span<const uint8_t> rom,
+                       std::span<const AotBlock<Machine>> blocks)
+      : name_(name), rom_(rom), blocks_(blocks) {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+      for (uint32_t address = blocks_[i].start; address < blocks_[i].end;
+           address += 2u) {
+        if (block_at_[address] == 0u) {
+          block_at_[address] = static_cast<uint16_t>(i + 1u);
+        }
+      }
+    }
+  }
+
+  std::string_view name() const { return name_; }
+  // The image the blocks were compiled from, as load_program() takes it.
+  std::span<const std::byte> rom() const { return std::as_bytes(rom_); }
+  size_t num_blocks() const { return blocks_.size(); }
+
+  // Same as chip8.run_cycles(cycles). Runs the compiled block holding the
+  // program counter where there is one, and chip8.execute_cycle() where
+  // there is not: Bnnn targets and other code only found at run time,
+  // blocks whose bytes were overwritten (self-modifying code, or a machine
+  // holding some other ROM) and anything outside the image. Stops at the
+  // first fault, as execute_cycle() does.
+  common::Status run(Machine &chip8, int cycles) const {
+    using Quirks = typename Machine::quirks;
+    while (cycles > 0 && !chip8.faulted_ &&
+           !handlers::stalled<Quirks>(chip8)) {
+      const uint16_t pc = chip8.program_counter_;
+      const uint16_t block = pc < k_address_space ? block_at_[pc] : 0u;
+      const int ran =
+          block != 0u ? blocks_[block - 1u].run(chip8, cycles) : 0;
+      if (ran == 0) {
+        chip8.execute_cycle();
+        cycles--;
+        continue;
+      }
+      chip8.instructions_executed_ += ran;
+      cycles -= ran;
+    }
+    return chip8.fault_status();
+  }
+
+private:
+  std::string_view name_;
+  std::span<const uint8_t> rom_;
+  std::span<const AotBlock<Machine>> blocks_;
+  // 1-based index into blocks_ of the block holding each instruction.
+  std::array<uint16_t, k_address_space> block_at_ = {};
+};
+
+// Every AotProgram<Machine> linked into the binary. Generated sources
+// register theirs during static initialisation (chip8_aot_library is
+// alwayslink), so nothing has to name them.
+template <typename Machine>
+std::vector<const AotProgram<Machine> *> &aot_programs() {
+  static std::vector<const AotProgram<Machine> *> programs;
+  return programs;
+}
+
+template <typename Machine>
+bool register_aot_program(const AotProgram<Machine> &program) {
+  aot_programs<Machine>().push_back(&program);
+  return true;
+}
+
+// The linked program compiled from exactly `rom`, or nullptr.
+template <typename Machine>
+const AotProgram<Machine> *find_aot_program(std::span<const std::byte> rom) {
+  for (const AotProgram<Machine> *program : aot_programs<Machine>()) {
+    if (std::ranges::equal(program->rom(), rom)) {
+      return program;
+    }
+  }
+  return nullptr;
+}
+
+// run_headless_frame() running the cycles through `program`.
+template <typename Machine>
+common::Status run_headless_frame(Machine &chip8,
+                                  const AotProgram<Machine> &program,
+                                  int cycles_per_frame =
+                                      k_default_cycles_per_frame) {
+  common::Status status = program.run(chip8, cycles_per_frame);
+  if (!status)
+    return status;
+  chip8.decrement_timers();
+  chip8.redraw_ = false;
+  return {};
+}
+
+// What generated blocks are made of.
+namespace aot {
+
+// True if memory_ holds the `Size` bytes at `code` from `address` on.
+template <size_t Size>
+inline bool unchanged(const Chip8State &chip8, uint16_t address,
+                      const uint8_t *code) {
+  return std::memcmp(&chip8.memory_[address], code, Size) == 0;
+}
+
+// Whether the handler for `op` can raise a fault under `Checking`.
+template <Op op, typename Checking> constexpr bool can_fault() {
+  switch (op) {
+  case Op::Ret:
+  case Op::Call:
+  case Op::InvalidRegisterOp:
+  case Op::InvalidKeyOp:
+  case Op::InvalidFOp:
+    return true;
+  case Op::Drw:
+  case Op::Skp:
+  case Op::Sknp:
+  case Op::LdBVx:
+  case Op::LdIVx:
+  case Op::LdVxI:
+    return Checking::k_checked;
+  default:
+    return false;
+  }
+}
+
+// Runs the instruction at `address` through the interpreter's handler for
+// `op`, which the constant table index lets the compiler inline. Returns
+// false if it faulted, leaving the machine as execute_cycle() would.
+template <typename Machine, Op op>
+inline bool step(Machine &chip8, uint16_t address,
+                 const Instruction &instruction) {
+  using Quirks = typename Machine::quirks;
+  using Checking = typename Machine::checking;
+  using Display = typename Machine::display;
+  constexpr handlers::Handler handler =
+      handlers::k_handlers<Quirks, Checking, Display>[static_cast<size_t>(op)];
+  handler(chip8, instruction);
+  if constexpr (can_fault<op, Checking>()) {
+    if (chip8.faulted_) [[unlikely]] {
+      chip8.program_counter_ = address + 2u;
+      if constexpr (Checking::k_checked) {
+        handlers::capture_fault(chip8, address);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace aot
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,74 @@
+#include "src/aot_program.h"
+#include "src/aot_ibm_logo.h"
+#include "src/chip8.h"
+#include "src/headless.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <vector>
+
+// Runs Timendus' IBM logo ROM, compiled by the aot_ibm_logo target, against
+// the interpreter.
+namespace chip8 {
+
+class AotProgramTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    for (Chip8 *machine : {&interpreted, &compiled}) {
+      ASSERT_TRUE(machine->load_program(aot::aot_ibm_logo.rom()));
+    }
+  }
+
+  void run_and_compare(int frames, int cycles_per_frame) {
+    for (int frame = 0; frame < frames; frame++) {
+      ASSERT_TRUE(run_headless_frame(interpreted, cycles_per_frame));
+      ASSERT_TRUE(
+          run_headless_frame(compiled, aot::aot_ibm_logo, cycles_per_frame));
+      ASSERT_EQ(interpreted.registers_, compiled.registers_);
+      ASSERT_EQ(interpreted.index_register_, compiled.index_register_);
+      ASSERT_EQ(interpreted.program_counter_, compiled.program_counter_);
+      ASSERT_EQ(interpreted.instructions_executed_,
+                compiled.instructions_executed_);
+      ASSERT_EQ(hash_display(interpreted), hash_display(compiled));
+    }
+  }
+
+  Chip8 interpreted;
+  Chip8 compiled;
+};
+
+TEST_F(AotProgramTest, MatchesTheInterpreterWhateverTheBudget) {
+  for (int cycles_per_frame : {1, 3, 10, 1000}) {
+    SCOPED_TRACE(cycles_per_frame);
+    interpreted = Chip8();
+    compiled = Chip8();
+    SetUp();
+    run_and_compare(60, cycles_per_frame);
+  }
+}
+
+TEST_F(AotProgramTest, InterpretsRewrittenCode) {
+  // A22A -> A239: the first sprite drawn becomes the second one.
+  for (Chip8 *machine : {&interpreted, &compiled}) {
+    machine->write_memory(0x203, std::byte{0x39});
+  }
+  run_and_compare(60, k_default_cycles_per_frame);
+  Chip8 pristine;
+  ASSERT_TRUE(pristine.load_program(aot::aot_ibm_logo.rom()));
+  for (int frame = 0; frame < 60; frame++) {
+    ASSERT_TRUE(run_headless_frame(pristine));
+  }
+  EXPECT_NE(hash_display(compiled), hash_display(pristine));
+}
+
+TEST_F(AotProgramTest, IsFoundByItsRom) {
+  EXPECT_EQ(find_aot_program<Chip8>(aot::aot_ibm_logo.rom()),
+            &aot::aot_ibm_logo);
+  std::vector<std::byte> other(aot::aot_ibm_logo.rom().begin(),
+                               aot::aot_ibm_logo.rom().end());
+  other.back() ^= std::byte{1};
+  EXPECT_EQ(find_aot_program<Chip8>(other), nullptr);
+  using Unchecked = BasicChip8<CosmacVipQuirks, Unchecked>;
+  EXPECT_EQ(find_aot_program<Unchecked>(aot::aot_ibm_logo.rom()), nullptr);
+}
+
+} // namespace chip8
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "app_error.h"
+#include "chip8.h"
+#include "headless.h"
+#include "recompiler.h"
+#include "rom_image.h"
+#include "rom_index.h"
+#include "work_stealing_pool.h"
+
+namespace {
+
+constexpr int k_default_instances = 1024;
+constexpr int k_default_frames = 600;
+
+struct Options {
+  int instances = k_default_instances;
+  int frames = k_default_frames;
+  int cycles_per_frame = chip8::k_default_cycles_per_frame;
+  unsigned threads = std::thread::hardware_concurrency();
+  bool jit = false;
+  chip8::DisplayMode display_mode = chip8::DisplayMode::Bytes;
+  // Where directory arguments' scan is cached between runs; empty to
+  // rescan from scratch every time.
+  std::filesystem::path index;
+  std::vector<std::filesystem::path> roms;
+};
+
+// Parses `--name=<int>` into `value`, returning false if `arg` is not that
+// flag.
+template <typename T>
+bool parse_int_flag(std::string_view arg, std::string_view name, T &value) {
+  if (!arg.starts_with(name) || arg.size() <= name.size() ||
+      arg[name.size()] != '=') {
+    return false;
+  }
+  std::string_view number = arg.substr(name.size() + 1);
+  auto [ptr, ec] =
+      std::from_chars(number.data(), number.data() + number.size(), value);
+  return ec == std::errc() && ptr == number.data() + number.size();
+}
+
+common::StatusOr<Options> parse_options(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (parse_int_flag(arg, "--instances", options.instances) ||
+        parse_int_flag(arg, "--frames", options.frames) ||
+        parse_int_flag(arg, "--cycles_per_frame", options.cycles_per_frame) ||
+        parse_int_flag(arg, "--threads", options.threads)) {
+      continue;
+    }
+    if (arg == "--jit") {
+      options.jit = true;
+      continue;
+    }
+    if (arg == "--packed") {
+      options.display_mode = chip8::DisplayMode::Packed;
+      continue;
+    }
+    if (arg.starts_with("--index=")) {
+      options.index = arg.substr(std::string_view("--index=").size());
+      continue;
+    }
+    if (arg.starts_with("--")) {
+      return std::unexpected(common::AppError{
+          common::ErrorCode::InvalidArgument,
+          "Unknown or malformed flag: " + std::string(arg)});
+    }
+    options.roms.emplace_back(arg);
+  }
+  if (options.roms.empty()) {
+    return std::unexpected(common::AppError{common::ErrorCode::InvalidArgument,
+                                            "No ROM passed into batch runner"});
+  }
+  if (options.instances <= 0 || options.frames <= 0 ||
+      options.cycles_per_frame <= 0) {
+    return std::unexpected(
+        common::AppError{common::ErrorCode::InvalidArgument,
+                         "instances, frames and cycles_per_frame must be > 0"});
+  }
+  if (options.jit && options.display_mode == chip8::DisplayMode::Packed) {
+    return std::unexpected(
+        common::AppError{common::ErrorCode::InvalidArgument,
+                         "--jit runs Chip8, which has no packed display"});
+  }
+  return options;
+}
+
+// Replaces each directory in `roms` with the ROMs under it that need
+// nothing beyond CHIP-8, using (and refreshing) the index at `index_path`.
+common::Status expand_directories(std::vector<std::filesystem::path> &roms,
+                                  const std::filesystem::path &index_path) {
+  chip8::RomIndex index;
+  if (!index_path.empty()) {
+    common::StatusOr<chip8::RomIndex> read = chip8::read_rom_index(index_path);
+    if (read) {
+      index = std::move(*read);
+    } else if (read.error().code != common::ErrorCode::NotFound) {
+      return std::unexpected(read.error());
+    }
+  }
+  std::vector<std::filesystem::path> expanded;
+  bool scanned = false;
+  for (const std::filesystem::path &rom : roms) {
+    if (!std::filesystem::is_directory(rom)) {
+      expanded.push_back(rom);
+      continue;
+    }
+    common::StatusOr<chip8::ScanStats> stats = chip8::scan_roms(index, rom);
+    if (!stats) {
+      return std::unexpected(stats.error());
+    }
+    scanned = true;
+    size_t skipped = 0u;
+    const std::string prefix = (rom / "").string();
+    for (const chip8::RomRecord &record : index.records) {
+      if (!record.path.starts_with(prefix)) {
+        continue;
+      }
+      if (record.analysis.profile == chip8::RomProfile::Vip) {
+        expanded.emplace_back(record.path);
+      } else {
+        skipped++;
+      }
+    }
+    std::cout << rom.string() << ": " << stats->unchanged << " cached, "
+              << stats->analysed << " analysed, " << stats->removed
+              << " removed, " << stats->rejected << " rejected; skipping "
+              << skipped << " SUPER-CHIP/XO-CHIP ROMs" << std::endl;
+  }
+  if (scanned && !index_path.empty()) {
+    common::Status status = chip8::write_rom_index(index, index_path);
+    if (!status) {
+      return status;
+    }
+  }
+  roms = std::move(expanded);
+  return {};
+}
+
+// Runs options.instances machines of type Machine over `images` and prints
+// the throughput; returns the process exit code.
+template <typename Machine>
+int run_batch(const Options &options,
+              const std::vector<chip8::RomImage> &images) {
+  // Instances are assigned to ROMs round-robin so a corpus is spread evenly
+  // over the batch.
+  std::vector<Machine> machines;
+  machines.reserve(options.instances);
+  for (int i = 0; i < options.instances; i++) {
+    machines.emplace_back();
+  }
+  for (size_t i = 0; i < machines.size(); i++) {
+    const size_t rom = i % images.size();
+    common::Status load_status =
+        machines[i].load_program(images[rom].bytes());
+    if (!load_status) {
+      std::cerr << "Error when loading rom " << options.roms[rom] << ": "
+                << load_status.error() << std::endl;
+      return -1;
+    }
+  }
+
+  // Each machine gets its own recompiler since compiled blocks are derived
+  // from that machine's memory.
+  std::vector<chip8::Recompiler> recompilers(options.jit ? machines.size()
+                                                         : 0u);
+  std::vector<int> frames_run(machines.size(), 0);
+  std::atomic<size_t> failures = 0;
+  common::WorkStealingPool pool(options.threads);
+
+  auto start = std::chrono::steady_clock::now();
+  pool.run(machines.size(), [&](size_t i) {
+    for (int frame = 0; frame < options.frames; frame++) {
+      common::Status status;
+      // parse_options() only allows --jit with Chip8.
+      if constexpr (std::is_same_v<Machine, chip8::Chip8>) {
+        status = options.jit
+                     ? chip8::run_headless_frame(machines[i], recompilers[i],
+                                                 options.cycles_per_frame)
+                     : chip8::run_headless_frame(machines[i],
+                                                 options.cycles_per_frame);
+      } else {
+        status =
+            chip8::run_headless_frame(machines[i], options.cycles_per_frame);
+      }
+      if (!status) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      frames_run[i]++;
+    }
+  });
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Where native code could not be used every cycle was interpreted.
+  std::string recompiler_state = options.jit ? "on" : "off";
+  for (const chip8::Recompiler &recompiler : recompilers) {
+    common::Status native = recompiler.native_status();
+    if (!native) {
+      recompiler_state = "off (" + native.error().message + ")";
+      break;
+    }
+  }
+
+  uint64_t instructions = 0u;
+  uint64_t frames = 0u;
+  for (size_t i = 0; i < machines.size(); i++) {
+    instructions += machines[i].instructions_executed_;
+    frames += frames_run[i];
+  }
+  double seconds = std::max(elapsed.count(), 1e-9);
+
+  std::cout << "instances:        " << machines.size() << "\n"
+            << "worker threads:   " << pool.num_workers() << "\n"
+            << "recompiler:       " << recompiler_state << "\n"
+            << "display:          "
+            << (Machine::display::k_display_mode == chip8::DisplayMode::Packed
+                    ? "packed"
+                    : "bytes")
+            << "\n"
+            << "failed instances: " << failures.load() << "\n"
+            << "wall time (s):    " << elapsed.count() << "\n"
+            << "instructions:     " << instructions << "\n"
+            << "frames:           " << frames << "\n"
+            << "instructions/sec: " << instructions / seconds << "\n"
+            << "frames/sec:       " << frames / seconds << std::endl;
+  return failures.load() == 0 ? 0 : -1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  common::StatusOr<Options> options = parse_options(argc, argv);
+  if (!options) {
+    std::cerr << "Usage: batch_runner [--instances=N] [--frames=N] "
+                 "[--cycles_per_frame=N] [--threads=N] [--jit] [--packed] "
+                 "[--index=FILE] <rom or directory>..."
+              << std::endl;
+    std::cerr << options.error() << std::endl;
+    return -1;
+  }
+  common::Status expand_status =
+      expand_directories(options->roms, options->index);
+  if (!expand_status) {
+    std::cerr << expand_status.error() << std::endl;
+    return -1;
+  }
+  if (options->roms.empty()) {
+    std::cerr << "No CHIP-8 ROMs to run" << std::endl;
+    return -1;
+  }
+
+  // Each distinct ROM is mapped and validated once, then copied into every
+  // instance running it.
+  std::vector<chip8::RomImage> images;
+  images.reserve(options->roms.size());
+  for (const std::filesystem::path &rom : options->roms) {
+    common::StatusOr<chip8::RomImage> image = chip8::RomImage::open(rom);
+    if (!image) {
+      std::cerr << "Error when loading rom " << rom << ": " << image.error()
+                << std::endl;
+      return -1;
+    }
+    images.push_back(std::move(*image));
+  }
+
+  return options->display_mode == chip8::DisplayMode::Packed
+             ? run_batch<chip8::PackedChip8>(*options, images)
+             : run_batch<chip8::Chip8>(*options, images);
+}
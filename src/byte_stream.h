@@ -0,0 +1,106 @@
+#ifndef SRC_BYTE_STREAM_H
+#define SRC_BYTE_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace common {
+
+// Little-endian integers, LEB128 varints and raw strings for the on-disk
+// formats (recordings, the ROM index, XOR deltas). Appends to `out`.
+class ByteWriter {
+public:
+  explicit ByteWriter(std::vector<std::byte> &out) : out_(out) {}
+
+  template <typename T> void integer(T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      out_.push_back(static_cast<std::byte>(value >> (8u * i)));
+    }
+  }
+  void varint(uint32_t value) {
+    while (value >= 0x80u) {
+      out_.push_back(static_cast<std::byte>((value & 0x7Fu) | 0x80u));
+      value >>= 7u;
+    }
+    out_.push_back(static_cast<std::byte>(value));
+  }
+  void bytes(std::string_view value) {
+    for (char c : value) {
+      out_.push_back(static_cast<std::byte>(c));
+    }
+  }
+
+private:
+  std::vector<std::byte> &out_;
+};
+
+// Reads what ByteWriter wrote from `bytes`, latching the first overrun so
+// callers check once.
+class ByteReader {
+public:
+  explicit ByteReader(std::span<const std::byte> bytes) : bytes_(bytes) {}
+
+  template <typename T> T integer() {
+    if (!take(sizeof(T))) {
+      return T{};
+    }
+    const std::byte *data = bytes_.data() + offset_ - sizeof(T);
+    T value = 0u;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      value |= static_cast<T>(std::to_integer<T>(data[i]) << (8u * i));
+    }
+    return value;
+  }
+  uint32_t varint() {
+    uint32_t value = 0u;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t byte = integer<uint8_t>();
+      value |= static_cast<uint32_t>(byte & 0x7Fu) << shift;
+      if ((byte & 0x80u) == 0u) {
+        return value;
+      }
+    }
+    overrun_ = true;
+    return 0u;
+  }
+  // The next `length` bytes, or an empty span on overrun.
+  std::span<const std::byte> bytes(size_t length) {
+    if (!take(length)) {
+      return {};
+    }
+    return bytes_.subspan(offset_ - length, length);
+  }
+  std::string string(size_t length) {
+    if (!take(length)) {
+      return {};
+    }
+    return std::string(
+        reinterpret_cast<const char *>(bytes_.data() + offset_ - length),
+        length);
+  }
+
+  bool ok() const { return !overrun_; }
+  bool at_end() const { return offset_ == bytes_.size(); }
+
+private:
+  bool take(size_t length) {
+    if (overrun_ || bytes_.size() - offset_ < length) {
+      overrun_ = true;
+      return false;
+    }
+    offset_ += length;
+    return true;
+  }
+
+  std::span<const std::byte> bytes_;
+  size_t offset_ = 0u;
+  bool overrun_ = false;
+};
+
+} // namespace common
+
+#endif
@@ -0,0 +1,202 @@
+#include "capture.h"
+#include "byte_stream.h"
+#include "xor_delta.h"
+
+#include <bit>
+#include <cstring>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+constexpr std::array<char, 4> k_rle_magic = {'C', '8', 'V', 'R'};
+constexpr int k_width = 64;
+constexpr int k_height = 32;
+constexpr int k_frames_per_second = 60;
+constexpr size_t k_frame_bytes = k_height * sizeof(uint64_t);
+// A literal ends once this many unchanged bytes follow it.
+constexpr size_t k_min_unchanged_run = 4u;
+// Studio-range luma, what players expect from a Y4M without an XCOLORRANGE.
+constexpr char k_luma_on = static_cast<char>(235);
+constexpr char k_luma_off = static_cast<char>(16);
+
+// Rows as 256 bytes, x = 0 in the top bit of each row's first byte.
+std::array<std::byte, k_frame_bytes>
+frame_bytes(const std::array<uint64_t, 32> &rows) {
+  std::array<std::byte, k_frame_bytes> bytes;
+  for (int y = 0; y < k_height; y++) {
+    uint64_t row = rows[y];
+    if constexpr (std::endian::native == std::endian::little) {
+      row = std::byteswap(row);
+    }
+    std::memcpy(bytes.data() + y * sizeof(uint64_t), &row, sizeof(row));
+  }
+  return bytes;
+}
+
+common::AppError corrupt(const std::string &what) {
+  return common::AppError{common::ErrorCode::InvalidArgument,
+                          "Corrupt capture: " + what};
+}
+
+} // namespace
+
+void encode_rle_frame(const std::array<uint64_t, 32> &rows,
+                      const std::array<uint64_t, 32> &previous,
+                      std::vector<std::byte> &out) {
+  const std::array<std::byte, k_frame_bytes> current = frame_bytes(rows);
+  const std::array<std::byte, k_frame_bytes> base = frame_bytes(previous);
+  common::encode_xor_delta(current, base, k_min_unchanged_run, out);
+}
+
+common::StatusOr<std::vector<std::array<uint64_t, 32>>>
+decode_rle_capture(std::span<const std::byte> bytes) {
+  constexpr size_t k_header_size = k_rle_magic.size() + 4u;
+  if (bytes.size() < k_header_size ||
+      std::memcmp(bytes.data(), k_rle_magic.data(), k_rle_magic.size()) !=
+          0) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument, "Not a CHIP-8 RLE capture"});
+  }
+  if (static_cast<uint8_t>(bytes[4]) != k_rle_capture_version) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Unsupported capture version " +
+            std::to_string(static_cast<uint8_t>(bytes[4]))});
+  }
+  std::vector<std::array<uint64_t, 32>> frames;
+  std::array<std::byte, k_frame_bytes> pixels = {};
+  common::ByteReader reader(bytes.subspan(k_header_size));
+  while (!reader.at_end()) {
+    std::span<const std::byte> delta = reader.bytes(reader.varint());
+    if (!reader.ok()) {
+      return std::unexpected(corrupt("truncated frame"));
+    }
+    if (!common::apply_xor_delta(delta, pixels)) {
+      return std::unexpected(corrupt("bad token"));
+    }
+    std::array<uint64_t, 32> &rows = frames.emplace_back();
+    for (int y = 0; y < k_height; y++) {
+      uint64_t row;
+      std::memcpy(&row, pixels.data() + y * sizeof(uint64_t), sizeof(row));
+      if constexpr (std::endian::native == std::endian::little) {
+        row = std::byteswap(row);
+      }
+      rows[y] = row;
+    }
+  }
+  return frames;
+}
+
+common::StatusOr<std::unique_ptr<FrameCapture>>
+FrameCapture::open(const std::filesystem::path &path, CaptureFormat format) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError,
+        "Unable to open capture output " + path.string()});
+  }
+  if (format == CaptureFormat::Y4m) {
+    file << "YUV4MPEG2 W" << k_width << " H" << k_height << " F"
+         << k_frames_per_second << ":1 Ip A1:1 Cmono\n";
+  } else {
+    file.write(k_rle_magic.data(), k_rle_magic.size());
+    const char header[] = {static_cast<char>(k_rle_capture_version),
+                           static_cast<char>(k_width),
+                           static_cast<char>(k_height),
+                           static_cast<char>(k_frames_per_second)};
+    file.write(header, sizeof(header));
+  }
+  return std::unique_ptr<FrameCapture>(
+      new FrameCapture(std::move(file), format));
+}
+
+FrameCapture::FrameCapture(std::ofstream file, CaptureFormat format)
+    : file_(std::move(file)), format_(format),
+      writer_([this] { write_loop(); }) {}
+
+FrameCapture::~FrameCapture() { finish(); }
+
+bool FrameCapture::push(const Frame &frame) {
+  if (!queue_.try_push(frame)) {
+    dropped_++;
+    return false;
+  }
+  signal_.fetch_add(1u, std::memory_order_release);
+  signal_.notify_one();
+  return true;
+}
+
+void FrameCapture::push_waiting(const Frame &frame) {
+  while (!queue_.try_push(frame)) {
+    std::this_thread::yield();
+  }
+  signal_.fetch_add(1u, std::memory_order_release);
+  signal_.notify_one();
+}
+
+common::Status FrameCapture::finish() {
+  if (!finished_) {
+    finished_ = true;
+    stopping_.store(true, std::memory_order_release);
+    signal_.fetch_add(1u, std::memory_order_release);
+    signal_.notify_one();
+    writer_.join();
+    file_.close();
+  }
+  if (file_.fail()) {
+    return std::unexpected(common::AppError{common::ErrorCode::IOError,
+                                            "Unable to write the capture"});
+  }
+  if (dropped_ != 0u) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError,
+        "Capture writer fell behind; dropped " + std::to_string(dropped_) +
+            " frames"});
+  }
+  return {};
+}
+
+void FrameCapture::write_loop() {
+  while (true) {
+    const uint64_t seen = signal_.load(std::memory_order_acquire);
+    const bool stopping = stopping_.load(std::memory_order_acquire);
+    const Frame *frame;
+    while ((frame = queue_.front()) != nullptr) {
+      write_frame(*frame);
+      queue_.pop();
+    }
+    if (stopping) {
+      return;
+    }
+    signal_.wait(seen, std::memory_order_acquire);
+  }
+}
+
+void FrameCapture::write_frame(const Frame &frame) {
+  if (format_ == CaptureFormat::Y4m) {
+    static constexpr char k_frame_header[] = "FRAME\n";
+    std::array<char, k_width * k_height> luma;
+    for (int y = 0; y < k_height; y++) {
+      for (int x = 0; x < k_width; x++) {
+        luma[y * k_width + x] =
+            (frame.rows[y] >> (63 - x)) & 0x1u ? k_luma_on : k_luma_off;
+      }
+    }
+    file_.write(k_frame_header, sizeof(k_frame_header) - 1u);
+    file_.write(luma.data(), luma.size());
+  } else {
+    encode_rle_frame(frame.rows, previous_, scratch_);
+    length_.clear();
+    common::ByteWriter length(length_);
+    length.varint(static_cast<uint32_t>(scratch_.size()));
+    file_.write(reinterpret_cast<const char *>(length_.data()),
+                static_cast<std::streamsize>(length_.size()));
+    file_.write(reinterpret_cast<const char *>(scratch_.data()),
+                static_cast<std::streamsize>(scratch_.size()));
+    previous_ = frame.rows;
+  }
+  written_.fetch_add(1u, std::memory_order_relaxed);
+}
+
+} // namespace chip8
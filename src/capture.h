@@ -0,0 +1,131 @@
+#ifndef SRC_CAPTURE_H
+#define SRC_CAPTURE_H
+
+#include "AV_system.h"
+#include "app_error.h"
+#include "spsc_queue.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace chip8 {
+
+// What a FrameCapture writes.
+//
+// `Y4m` is uncompressed YUV4MPEG2 (64x32, 60 fps, luma only), which ffmpeg
+// and most players read directly.
+//
+// `Rle` is smaller and also lossless:
+//   "C8VR", u8 version, u8 width, u8 height, u8 frames per second, then per
+//   frame varint(length) and `length` bytes of tokens. The frame's 256
+//   bytes of 1-bit pixels (row-major, x = 0 in each row's first byte's top
+//   bit) are XORed with the previous frame's and stored as tokens of
+//   varint(unchanged bytes), varint(literal length), literal bytes.
+//   A frame identical to the previous one takes 1 byte.
+enum class CaptureFormat : uint8_t { Y4m, Rle };
+
+constexpr uint8_t k_rle_capture_version = 1u;
+
+// Y4m for a ".y4m" path, Rle otherwise.
+inline CaptureFormat capture_format_for(const std::filesystem::path &path) {
+  return path.extension() == ".y4m" ? CaptureFormat::Y4m : CaptureFormat::Rle;
+}
+
+// Encodes `rows` as one Rle frame against `previous` into `out`.
+void encode_rle_frame(const std::array<uint64_t, 32> &rows,
+                      const std::array<uint64_t, 32> &previous,
+                      std::vector<std::byte> &out);
+// Every frame in an Rle capture, for checking and converting captures.
+common::StatusOr<std::vector<std::array<uint64_t, 32>>>
+decode_rle_capture(std::span<const std::byte> bytes);
+
+// Records emulator output to a file without slowing the emulator: push()
+// copies a frame into a bounded lock-free queue and returns, and a writer
+// thread encodes and writes frames as they arrive. Push one frame per
+// 60 Hz tick so the video runs at 60 fps.
+class FrameCapture {
+public:
+  // Frames queued before push() starts dropping them, about 4 s at 60 Hz.
+  static constexpr size_t k_queue_frames = 256u;
+
+  // Opens `path` and starts the writer thread.
+  static common::StatusOr<std::unique_ptr<FrameCapture>>
+  open(const std::filesystem::path &path, CaptureFormat format);
+
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+  ~FrameCapture();
+
+  // Emulation thread. Never blocks; returns false, dropping the frame, if
+  // the writer has fallen k_queue_frames behind.
+  bool push(const Frame &frame);
+  // For headless runs, which outpace any writer: waits for room instead of
+  // dropping, so the capture has every frame.
+  void push_waiting(const Frame &frame);
+
+  // Writes every queued frame, stops the writer and closes the file.
+  // Reports the first write error, or frames that were dropped.
+  common::Status finish();
+
+  uint64_t frames_written() const {
+    return written_.load(std::memory_order_relaxed);
+  }
+  uint64_t frames_dropped() const { return dropped_; }
+
+private:
+  FrameCapture(std::ofstream file, CaptureFormat format);
+
+  void write_loop();
+  void write_frame(const Frame &frame);
+
+  std::ofstream file_;
+  const CaptureFormat format_;
+  common::SpscQueue<Frame, k_queue_frames> queue_;
+  // Bumped on every push and on stop so the writer can wait on it.
+  std::atomic<uint64_t> signal_ = 0u;
+  std::atomic<bool> stopping_ = false;
+  std::atomic<uint64_t> written_ = 0u;
+  uint64_t dropped_ = 0u;
+  bool finished_ = false;
+
+  // Writer thread state.
+  std::array<uint64_t, 32> previous_ = {};
+  std::vector<std::byte> scratch_;
+  // scratch_.size() as the varint written ahead of it.
+  std::vector<std::byte> length_;
+  std::jthread writer_;
+};
+
+// An AVSystem with no window or input: present() hands every frame to the
+// attached capture, waiting for the writer when it falls behind, so
+// headless runs (replays, QA bots) can record video through the same
+// interface as the SDL frontend.
+class CaptureSystem {
+public:
+  CaptureSystem(int width, int height) {}
+
+  void attach(FrameCapture *capture) { capture_ = capture; }
+
+  void poll_events(bool &quit, KeyQueue &keys) {}
+  void present(const Frame &frame) {
+    if (capture_ != nullptr) {
+      capture_->push_waiting(frame);
+    }
+  }
+
+private:
+  FrameCapture *capture_ = nullptr;
+};
+
+static_assert(AVSystem<CaptureSystem>);
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,146 @@
+#include "src/capture.h"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+
+class CaptureTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = std::filesystem::path(::testing::TempDir()) /
+            ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  // A small sprite moving one pixel right per frame, held still every
+  // fourth frame.
+  static std::vector<Frame> moving_sprite(int count) {
+    std::vector<Frame> frames(count);
+    for (int i = 0; i < count; i++) {
+      int x = i - i / 4;
+      for (int y = 10; y < 15; y++) {
+        frames[i].rows[y] = 0xF000000000000000ull >> (x % 60);
+      }
+      frames[i].number = i;
+    }
+    return frames;
+  }
+
+  std::vector<char> read_file() const {
+    std::ifstream file(path_, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
+  }
+
+  std::filesystem::path path_;
+};
+
+TEST_F(CaptureTest, RleRoundTripsLosslessly) {
+  std::vector<Frame> frames = moving_sprite(200);
+  {
+    auto capture = FrameCapture::open(path_, CaptureFormat::Rle);
+    ASSERT_TRUE(capture.has_value());
+    for (const Frame &frame : frames) {
+      ASSERT_TRUE((*capture)->push(frame));
+    }
+    EXPECT_TRUE((*capture)->finish());
+    EXPECT_EQ((*capture)->frames_written(), frames.size());
+  }
+  std::vector<char> bytes = read_file();
+  auto decoded = decode_rle_capture(std::as_bytes(std::span(bytes)));
+  ASSERT_TRUE(decoded.has_value()) << decoded.error();
+  ASSERT_EQ(decoded->size(), frames.size());
+  for (size_t i = 0; i < frames.size(); i++) {
+    ASSERT_EQ((*decoded)[i], frames[i].rows) << "frame " << i;
+  }
+  // 256 bytes of raw pixels per frame; the sprite's deltas need far less.
+  EXPECT_LT(bytes.size(), frames.size() * 32u);
+}
+
+TEST_F(CaptureTest, UnchangedFrameHasNoTokens) {
+  std::array<uint64_t, 32> rows = {};
+  rows[3] = 0x0123456789ABCDEFull;
+  std::vector<std::byte> encoded;
+  encode_rle_frame(rows, rows, encoded);
+  EXPECT_TRUE(encoded.empty());
+  encode_rle_frame(rows, {}, encoded);
+  EXPECT_FALSE(encoded.empty());
+}
+
+TEST_F(CaptureTest, Y4mHasOneLumaPlanePerFrame) {
+  std::vector<Frame> frames = moving_sprite(3);
+  {
+    auto capture = FrameCapture::open(path_, CaptureFormat::Y4m);
+    ASSERT_TRUE(capture.has_value());
+    CaptureSystem system(64, 32);
+    system.attach(capture->get());
+    for (const Frame &frame : frames) {
+      system.present(frame);
+    }
+    EXPECT_TRUE((*capture)->finish());
+  }
+  std::vector<char> bytes = read_file();
+  const std::string header = "YUV4MPEG2 W64 H32 F60:1 Ip A1:1 Cmono\n";
+  ASSERT_EQ(std::string(bytes.begin(), bytes.begin() + header.size()), header);
+  const size_t frame_size = 6u + 64u * 32u;
+  ASSERT_EQ(bytes.size(), header.size() + frames.size() * frame_size);
+  const char *last = bytes.data() + header.size() + 2 * frame_size;
+  EXPECT_EQ(std::string(last, 6), "FRAME\n");
+  // Frame 2 has its sprite at x = 2..5 on row 10.
+  EXPECT_EQ(static_cast<uint8_t>(last[6 + 10 * 64 + 1]), 16u);
+  EXPECT_EQ(static_cast<uint8_t>(last[6 + 10 * 64 + 2]), 235u);
+  EXPECT_EQ(static_cast<uint8_t>(last[6 + 10 * 64 + 5]), 235u);
+  EXPECT_EQ(static_cast<uint8_t>(last[6 + 10 * 64 + 6]), 16u);
+}
+
+TEST_F(CaptureTest, HeadlessSystemWaitsInsteadOfDropping) {
+  // Far more frames than the queue holds, pushed as fast as possible.
+  std::vector<Frame> frames = moving_sprite(4 * FrameCapture::k_queue_frames);
+  auto capture = FrameCapture::open(path_, CaptureFormat::Rle);
+  ASSERT_TRUE(capture.has_value());
+  CaptureSystem system(64, 32);
+  system.attach(capture->get());
+  for (const Frame &frame : frames) {
+    system.present(frame);
+  }
+  EXPECT_TRUE((*capture)->finish());
+  EXPECT_EQ((*capture)->frames_written(), frames.size());
+  EXPECT_EQ((*capture)->frames_dropped(), 0u);
+}
+
+TEST_F(CaptureTest, RejectsCorruptCaptures) {
+  const std::byte not_capture[] = {std::byte{'C'}, std::byte{'8'},
+                                   std::byte{'S'}, std::byte{'S'},
+                                   std::byte{1},   std::byte{64},
+                                   std::byte{32},  std::byte{60}};
+  EXPECT_FALSE(decode_rle_capture(not_capture).has_value());
+  const std::byte truncated[] = {std::byte{'C'}, std::byte{'8'},
+                                 std::byte{'V'}, std::byte{'R'},
+                                 std::byte{1},   std::byte{64},
+                                 std::byte{32},  std::byte{60},
+                                 std::byte{5},   std::byte{0}};
+  EXPECT_FALSE(decode_rle_capture(truncated).has_value());
+  // One 12-byte frame whose token skips 2^64 - 1 bytes and then XORs one:
+  // the two lengths sum to 0 modulo 2^64.
+  const std::byte wrapping[] = {
+      std::byte{'C'},  std::byte{'8'},  std::byte{'V'},  std::byte{'R'},
+      std::byte{1},    std::byte{64},   std::byte{32},   std::byte{60},
+      std::byte{12},   std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+      std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+      std::byte{0xFF}, std::byte{0xFF}, std::byte{0x01}, std::byte{1},
+      std::byte{0xAA}};
+  EXPECT_FALSE(decode_rle_capture(wrapping).has_value());
+  // The same with a skip of 2^32 - 1, which does fit a varint.
+  const std::byte overlong_skip[] = {
+      std::byte{'C'},  std::byte{'8'},  std::byte{'V'},  std::byte{'R'},
+      std::byte{1},    std::byte{64},   std::byte{32},   std::byte{60},
+      std::byte{7},    std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+      std::byte{0xFF}, std::byte{0x0F}, std::byte{1},    std::byte{0xAA}};
+  EXPECT_FALSE(decode_rle_capture(overlong_skip).has_value());
+}
+
+} // namespace chip8
@@ -0,0 +1,68 @@
+#ifndef SRC_CHECKING_H
+#define SRC_CHECKING_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace chip8 {
+
+// What went wrong when a core faulted.
+enum class FaultKind : uint8_t {
+  None,
+  InvalidOpcode,
+  StackOverflow,
+  StackUnderflow,
+  MemoryOutOfBounds,
+  KeyOutOfRange,
+};
+
+constexpr std::string_view fault_name(FaultKind kind) {
+  switch (kind) {
+  case FaultKind::None:
+    return "no fault";
+  case FaultKind::InvalidOpcode:
+    return "invalid opcode";
+  case FaultKind::StackOverflow:
+    return "stack overflow";
+  case FaultKind::StackUnderflow:
+    return "stack underflow";
+  case FaultKind::MemoryOutOfBounds:
+    return "memory access out of bounds";
+  case FaultKind::KeyOutOfRange:
+    return "key index out of range";
+  }
+  return "unknown fault";
+}
+
+// The first fault a machine hit. Only Checked cores fill in the detail; an
+// Unchecked core records just the kind.
+struct Fault {
+  FaultKind kind = FaultKind::None;
+  bool detailed = false;
+  uint16_t program_counter = 0u;
+  uint16_t opcode = 0u;
+  uint16_t index_register = 0u;
+  uint8_t stack_pointer = 0u;
+  std::array<uint8_t, 16> registers = {};
+};
+
+// Execution policies for BasicChip8. Handlers never return a status; they
+// raise a sticky fault on the machine instead.
+//
+// Checked validates every memory, stack and keypad access, stops at the
+// first fault and reports the PC, opcode and registers it happened at.
+struct Checked {
+  static constexpr bool k_checked = true;
+};
+
+// Unchecked skips the memory and keypad tests (addresses wrap to 12 bits and
+// key indices to 4, as on the VIP) and only looks at the fault flag once per
+// run_cycles() call. Stack over/underflow and invalid opcodes still set it.
+struct Unchecked {
+  static constexpr bool k_checked = false;
+};
+
+} // namespace chip8
+
+#endif
@@ -1,19 +1,30 @@
 #include "chip8.h"
 #include "app_error.h"
+#include "opcode_handlers.h"
+#include "profiler.h"
+#include "rom_image.h"
+#include "simd_kernels.h"
+#include "vip_timing.h"
 
-#include <arm_neon.h>
-
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <expected>
 #include <filesystem>
-#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <random>
+#include <sstream>
+#include <string>
 
 namespace chip8 {
 namespace {
 
+using handlers::capture_fault;
+using handlers::fetch;
+using handlers::k_handlers;
+using handlers::stalled;
+
 constexpr size_t k_program_start = 0x200;
-constexpr size_t k_font_address = 0x50;
 
 constexpr size_t k_font_space = 80;
 constexpr std::array<uint16_t, k_font_space> k_fontset = {
@@ -43,387 +54,403 @@ void print_instructions(uint8_t b1, uint8_t b2, uint16_t program_counter) {
             << std::endl;
 }
 
-common::Status zero(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  if (b1 == 0x00u) {
-    if (b2 == 0xE0u) {
-      em.display_ = {};
-      em.redraw_ = true;
-    } else if (b2 == 0xEEu) {
-      if (em.stack_pointer_ - 1 < 0) {
-        return std::unexpected(
-            common::AppError{common::ErrorCode::InternalError,
-                             "Unable to decrement stack_pointer further"});
-      }
-      em.stack_pointer_ -= 1;
-      em.program_counter_ = em.stack_[em.stack_pointer_];
-    }
-  }
-  return {};
-}
+constexpr uint32_t k_rng_modulus = 2147483647u; // 2^31 - 1
+constexpr uint32_t k_rng_multiplier = 48271u;
 
-common::Status jp(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  em.program_counter_ = ((b1 & 0x0Fu) << 8u) | b2;
-  return {};
+} // namespace
+
+void load_font(std::span<std::byte> memory) {
+  for (size_t i = 0; i < k_font_space; i++) {
+    memory[k_font_address + i] = static_cast<std::byte>(k_fontset[i]);
+  }
 }
 
-common::Status ldi(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  em.index_register_ = ((b1 & 0x0Fu) << 8u) | b2;
-  return {};
+uint32_t random_state_for(uint64_t seed) {
+  // MINSTD state must be non-zero and below the modulus.
+  return static_cast<uint32_t>(seed % (k_rng_modulus - 1u)) + 1u;
 }
 
-common::Status ldv(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  em.registers_[Vx] = b2;
-  return {};
+uint8_t next_random_byte(uint32_t &state) {
+  // The top 8 of the 31 state bits are the least correlated.
+  state = static_cast<uint32_t>(uint64_t{state} * k_rng_multiplier %
+                                k_rng_modulus);
+  return static_cast<uint8_t>(state >> 23u);
 }
 
-common::Status addv(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  em.registers_[Vx] += b2;
-  return {};
+Chip8State::Chip8State(DisplayMode display_mode)
+    : program_counter_(k_program_start), display_mode_(display_mode) {
+  seed_random(std::chrono::system_clock::now().time_since_epoch().count());
+  load_font(memory_);
 }
 
-common::Status scalar_draw(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t Vy = (b2 & 0xF0u) >> 4u;
-  uint8_t height = (b2 & 0xFu);
-  int x_coord = em.registers_[Vx] % 64;
-  int y_coord = em.registers_[Vy] % 32;
-  em.registers_[0xFu] = 0u;
-  for (uint8_t i = 0u; i < height; i++) {
-    int y = (y_coord + i);
-    if (y >= 32)
-      break;
-    uint8_t sprite_byte =
-        static_cast<uint8_t>(em.memory_[em.index_register_ + i]);
-    for (uint8_t j = 0u; j < 8u; j++) {
-      if ((sprite_byte & (0x80u >> j))) {
-        int x = (x_coord + j);
-        if (x >= 64)
-          break;
-        uint16_t pix = (y * 64) + x;
-        if (em.display_[pix] == 1u) {
-          em.registers_[0xFu] = 1u;
-        }
-        em.display_[pix] ^= 1u;
-      }
-    }
+common::Status Chip8State::load_rom(const std::filesystem::path &path) {
+  common::StatusOr<RomImage> image =
+      RomImage::open(path, memory_.size() - program_counter_);
+  if (!image) {
+    return std::unexpected(image.error());
   }
-  return {};
+  return load_program(image->bytes());
 }
 
-common::Status vector_draw(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t Vy = (b2 & 0xF0u) >> 4u;
-  uint8_t height = (b2 & 0xFu);
-  int x_coord = em.registers_[Vx] % 64;
-  // Scalar draw to prevent any overflow for simd
-  if (x_coord + 8 >= 64) {
-    return scalar_draw(em, b1, b2);
-  }
-  int y_coord = em.registers_[Vy] % 32;
-  em.registers_[0xFu] = 0u;
-  for (uint8_t i = 0u; i < height; i++) {
-    int y = (y_coord + i);
-    if (y >= 32)
-      break;
-    uint8_t sprite_byte =
-        static_cast<uint8_t>(em.memory_[em.index_register_ + i]);
-    int start_pixel = y * 64 + x_coord;
-    uint8x8_t display_pixels = vld1_u8(&em.display_[start_pixel]);
-    uint8x8_t sprite_mask = vld1_u8(em.sprite_table_[sprite_byte].data());
-    uint8_t max_val_in_display = vmaxv_u8(display_pixels);
-    if (max_val_in_display == 1u) {
-      em.registers_[0xFu] = 1u;
-    }
-    uint8x8_t result = veor_u8(display_pixels, sprite_mask);
-    vst1_u8(&em.display_[start_pixel], result);
+common::Status Chip8State::load_program(std::span<const std::byte> program) {
+  if (program.size() > memory_.size() - program_counter_) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "ROM of " + std::to_string(program.size()) +
+            " bytes does not fit in memory"});
   }
+  std::copy(program.begin(), program.end(),
+            memory_.begin() + program_counter_);
+  decoded_base_ = program_counter_;
+  decoded_.assign(program.size(), Instruction{});
   return {};
 }
 
-common::Status draw(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  em.redraw_ = true;
-#if defined(USE_VECTOR_DRAW)
-  return vector_draw(em, b1, b2);
-#else
-  return scalar_draw(em, b1, b2);
-#endif
+void Chip8State::seed_random(uint64_t seed) {
+  rng_state_ = random_state_for(seed);
 }
 
-common::Status call(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  if (em.stack_pointer_ > 15) {
-    return std::unexpected(
-        common::AppError{common::ErrorCode::InternalError, "stack overflow"});
+void KeypadState::set_key(uint8_t key, bool pressed) {
+  if (pressed) {
+    waiting_for_key_press_ = false;
+  } else {
+    waiting_for_key_release_ = false;
+  }
+  if (key < k_num_keys) {
+    keypad_[key] = pressed ? 1u : 0u;
   }
-  uint16_t address = ((b1 & 0x0Fu) << 8u) | b2;
-  em.stack_[em.stack_pointer_] = em.program_counter_;
-  em.stack_pointer_ += 1;
-  em.program_counter_ = address;
-  return {};
 }
 
-common::Status skip_instr_equal(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  if (em.registers_[Vx] == b2) {
-    em.program_counter_ += 2;
+void Chip8State::decrement_timers() {
+  if (delay_timer_ > 0) {
+    --delay_timer_;
+  }
+  if (sound_timer_ > 0) {
+    should_beep_ = true;
+    --sound_timer_;
+  }
+  if (sound_timer_ == 0) {
+    should_beep_ = false;
   }
-  return {};
 }
 
-common::Status skip_instr_not_equal(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  if (em.registers_[Vx] != b2) {
-    em.program_counter_ += 2;
-  }
-  return {};
+void Chip8State::write_memory(uint16_t address, std::byte value) {
+  memory_[address] = value;
+  invalidate_decoded(address, 1);
 }
 
-common::Status skip_reg_equal(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t Vy = (b2 & 0xF0u) >> 4u;
-  if (em.registers_[Vx] == em.registers_[Vy]) {
-    em.program_counter_ += 2;
+void Chip8State::invalidate_decoded(uint16_t address, size_t length) {
+  // An instruction starting one byte earlier also read `address`.
+  size_t begin = std::max<size_t>(address > 0u ? address - 1u : 0u,
+                                  decoded_base_);
+  size_t end = std::min<size_t>(address + length,
+                                decoded_base_ + decoded_.size());
+  for (size_t i = begin; i < end; i++) {
+    decoded_[i - decoded_base_].op = Op::Undecoded;
   }
-  return {};
 }
 
-common::Status skip_reg_not_equal(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t Vy = (b2 & 0xF0u) >> 4u;
-  if (em.registers_[Vx] != em.registers_[Vy]) {
-    em.program_counter_ += 2;
+// A Chip8State is always the base of the layout display_mode_ names, so
+// these downcasts reach the framebuffer without a virtual call.
+
+uint8_t Chip8State::pixel(int x, int y) const {
+  if (display_mode_ == DisplayMode::Packed) {
+    const auto &packed = static_cast<const PackedDisplay &>(*this);
+    return (packed.packed_display_[y] >> (63 - x)) & 0x1u;
   }
-  return {};
+  return static_cast<const ByteDisplay &>(*this).display_[y * 64 + x];
 }
 
-common::Status register_ops(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t Vy = (b2 & 0xF0u) >> 4u;
-  uint8_t op = (b2 & 0x0Fu);
-  switch (op) {
-  case 0x0u:
-    em.registers_[Vx] = em.registers_[Vy];
-    break;
-  case 0x1u:
-    em.registers_[Vx] |= em.registers_[Vy];
-    em.registers_[0xFu] = 0u;
-    break;
-  case 0x2u:
-    em.registers_[Vx] &= em.registers_[Vy];
-    em.registers_[0xFu] = 0u;
-    break;
-  case 0x3u:
-    em.registers_[Vx] ^= em.registers_[Vy];
-    em.registers_[0xFu] = 0u;
-    break;
-  case 0x4u: {
-    uint16_t sum = em.registers_[Vx] + em.registers_[Vy];
-    em.registers_[Vx] = (sum & 0xFFu);
-    em.registers_[0xFu] = (sum > 255u) ? 1u : 0u;
-    break;
+uint64_t Chip8State::display_row(int y) const {
+  if (display_mode_ == DisplayMode::Packed) {
+    return static_cast<const PackedDisplay &>(*this).packed_display_[y];
   }
-  case 0x5u: {
-    int diff = em.registers_[Vx] - em.registers_[Vy];
-    em.registers_[Vx] -= em.registers_[Vy];
-    em.registers_[0xFu] = (diff >= 0) ? 1u : 0u;
-    break;
+  const auto &bytes = static_cast<const ByteDisplay &>(*this);
+  uint64_t row = 0u;
+  for (int x = 0; x < 64; x++) {
+    row = (row << 1u) | (bytes.display_[y * 64 + x] & 0x1u);
   }
-  case 0x6u: {
-    em.registers_[Vx] = em.registers_[Vy];
-    bool last_bit_set = em.registers_[Vx] & 0x1u;
-    em.registers_[Vx] >>= 1;
-    em.registers_[0xFu] = last_bit_set ? 1 : 0;
-    break;
-  }
-  case 0x7u: {
-    int diff = em.registers_[Vy] - em.registers_[Vx];
-    em.registers_[Vx] = em.registers_[Vy] - em.registers_[Vx];
-    em.registers_[0xFu] = (diff >= 0) ? 1u : 0u;
-    break;
-  }
-  case 0xEu: {
-    em.registers_[Vx] = em.registers_[Vy];
-    bool last_bit_set = em.registers_[Vx] >> 7u;
-    em.registers_[Vx] <<= 1;
-    em.registers_[0xFu] = last_bit_set ? 1 : 0;
-    break;
+  return row;
+}
+
+void Chip8State::set_display_row(int y, uint64_t row) {
+  if (display_mode_ == DisplayMode::Packed) {
+    static_cast<PackedDisplay &>(*this).packed_display_[y] = row;
+    return;
   }
-  default:
-    return std::unexpected(common::AppError{common::ErrorCode::InternalError,
-                                            "Register op is invalid"});
+  auto &bytes = static_cast<ByteDisplay &>(*this);
+  for (int x = 0; x < 64; x++) {
+    bytes.display_[y * 64 + x] = (row >> (63 - x)) & 0x1u;
   }
-  return {};
 }
 
-common::Status jp_offset(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  em.program_counter_ = em.registers_[0] + (((b1 & 0x0Fu) << 8u) | b2);
-  return {};
+common::AppError Chip8State::describe_fault() const {
+  std::ostringstream message;
+  message << fault_name(fault_.kind);
+  if (!fault_.detailed) {
+    message << " (unchecked core; rerun with Checked for details)";
+  } else {
+    message << std::hex << std::uppercase << std::setfill('0') << " at PC 0x"
+            << std::setw(3) << fault_.program_counter << " (opcode 0x"
+            << std::setw(4) << fault_.opcode << "), I=0x" << std::setw(3)
+            << fault_.index_register << " SP=" << std::dec
+            << static_cast<int>(fault_.stack_pointer) << std::hex;
+    for (size_t i = 0; i < fault_.registers.size(); i++) {
+      message << " V" << i << "=0x" << std::setw(2)
+              << static_cast<int>(fault_.registers[i]);
+    }
+  }
+  return common::AppError{common::ErrorCode::InternalError, message.str()};
 }
 
-common::Status reg_random_plus_offset(chip8::Chip8 &em, uint8_t b1,
-                                      uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  em.registers_[Vx] = em.rand_byte_(em.rand_gen_) & b2;
-  return {};
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+void BasicChip8<Quirks, Checking, Display>::step(Profiler &profiler) {
+  const Instruction instruction = fetch<Checking>(*this);
+  // print_instructions(static_cast<uint8_t>(memory_[program_counter_]),
+  //                    static_cast<uint8_t>(memory_[program_counter_ + 1]),
+  //                    program_counter_);
+  const uint16_t address = this->program_counter_;
+  const uint64_t start_ticks = profiler.start();
+  this->program_counter_ += 2;
+  this->instructions_executed_++;
+  k_handlers<Quirks, Checking, Display>[static_cast<size_t>(instruction.op)](
+      *this, instruction);
+  profiler.record(address, instruction.op, start_ticks);
+  if constexpr (Checking::k_checked) {
+    if (this->faulted_) {
+      capture_fault(*this, address);
+    }
+  }
 }
 
-common::Status skip_key(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  uint8_t key = em.registers_[Vx];
-  switch (b2) {
-  case 0x9Eu:
-    if (em.keypad_[key] == 1u)
-      em.program_counter_ += 2;
-    break;
-  case 0xA1u:
-    if (em.keypad_[key] != 1u)
-      em.program_counter_ += 2;
-    break;
-  default:
-    return std::unexpected(common::AppError{
-        common::ErrorCode::InternalError, "keypad skip operation is invalid"});
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+common::Status
+BasicChip8<Quirks, Checking, Display>::execute_cycle(Profiler &profiler) {
+  if (!this->faulted_ && !stalled<Quirks>(*this)) {
+    step(profiler);
   }
-  return {};
+  return this->fault_status();
 }
 
-common::Status finstr(chip8::Chip8 &em, uint8_t b1, uint8_t b2) {
-  uint8_t Vx = b1 & 0x0Fu;
-  switch (b2) {
-  case 0x07u:
-    em.registers_[Vx] = em.delay_timer_;
-    break;
-  case 0x0Au: {
-    em.waiting_for_key_press_ = true;
-    for (uint8_t i = 0; i < 16u; i++) {
-      if (em.keypad_[i] == 1u) {
-        em.waiting_for_key_press_ = false;
-        em.waiting_for_key_release_ = true;
-        em.registers_[Vx] = i;
+template <typename Quirks, typename Checking, typename Display>
+common::Status BasicChip8<Quirks, Checking, Display>::execute_cycle() {
+  NoProfiler profiler;
+  return execute_cycle(profiler);
+}
+
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+common::Status BasicChip8<Quirks, Checking, Display>::run_cycles_table(
+    int cycles, Profiler &profiler) {
+  if (this->faulted_) {
+    return this->fault_status();
+  }
+  for (int i = 0; i < cycles && !stalled<Quirks>(*this); i++) {
+    step(profiler);
+    if constexpr (Checking::k_checked) {
+      if (this->faulted_) {
         break;
       }
     }
-    if (em.waiting_for_key_press_) {
-      em.program_counter_ -= 2;
-    }
-    break;
   }
-  case 0x15:
-    em.delay_timer_ = em.registers_[Vx];
-    break;
-  case 0x18:
-    em.sound_timer_ = em.registers_[Vx];
-    break;
-  case 0x1E:
-    em.index_register_ += em.registers_[Vx];
-    break;
-  case 0x29:
-    em.index_register_ = k_font_address + (5 * em.registers_[Vx]);
-    break;
-  case 0x33: {
-    uint16_t value = em.registers_[Vx];
-    em.memory_[em.index_register_ + 2] = static_cast<std::byte>(value % 10);
-    value /= 10;
-    em.memory_[em.index_register_ + 1] = static_cast<std::byte>(value % 10);
-    value /= 10;
-    em.memory_[em.index_register_] = static_cast<std::byte>(value % 10);
-    break;
+  return this->fault_status();
+}
+
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+common::Status BasicChip8<Quirks, Checking, Display>::run_machine_cycles(
+    int64_t &budget, Profiler &profiler) {
+  if (this->faulted_) {
+    return this->fault_status();
   }
-  case 0x55:
-    for (uint8_t i = 0; i <= Vx; i++) {
-      em.memory_[em.index_register_ + i] =
-          static_cast<std::byte>(em.registers_[i]);
+  while (budget > 0) {
+    if (stalled<Quirks>(*this)) {
+      budget = 0;
+      break;
     }
-    em.index_register_ += (Vx + 1);
-    break;
-  case 0x65:
-    for (uint8_t i = 0; i <= Vx; i++) {
-      em.registers_[i] =
-          static_cast<uint8_t>(em.memory_[em.index_register_ + i]);
+    // Costed before it runs: Dxyn and the skips read registers it may change.
+    budget -= vip_cycles(fetch<Checking>(*this), this->registers_);
+    step(profiler);
+    if constexpr (Checking::k_checked) {
+      if (this->faulted_) {
+        break;
+      }
     }
-    em.index_register_ += (Vx + 1);
-    break;
-  default:
-    return std::unexpected(common::AppError{common::ErrorCode::InternalError,
-                                            "Invalid finstruction"});
   }
-  return {};
+  return this->fault_status();
 }
 
-} // namespace
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+BasicChip8<Quirks, Checking, Display>::run_machine_cycles(int64_t &budget) {
+  NoProfiler profiler;
+  return run_machine_cycles(budget, profiler);
+}
 
-Chip8::Chip8()
-    : rand_gen_(std::chrono::system_clock::now().time_since_epoch().count()),
-      rand_byte_(std::uniform_int_distribution<uint8_t>(0, 255U)),
-      program_counter_(k_program_start) {
-  execute_[0x0u] = &zero;
-  execute_[0x1u] = &jp;
-  execute_[0x2u] = &call;
-  execute_[0x3u] = &skip_instr_equal;
-  execute_[0x4u] = &skip_instr_not_equal;
-  execute_[0x5u] = &skip_reg_equal;
-  execute_[0x6u] = &ldv;
-  execute_[0x7u] = &addv;
-  execute_[0x8u] = &register_ops;
-  execute_[0x9u] = &skip_reg_not_equal;
-  execute_[0xAu] = &ldi;
-  execute_[0xBu] = &jp_offset;
-  execute_[0xCu] = &reg_random_plus_offset;
-  execute_[0xDu] = &draw;
-  execute_[0xEu] = &skip_key;
-  execute_[0xFu] = &finstr;
+// GCC otherwise cross-jumps the copies of CHIP8_DISPATCH() back into one
+// shared indirect jump, which is exactly what threading is meant to avoid.
+#if defined(__GNUC__) && !defined(__clang__)
+#define CHIP8_KEEP_DISPATCH_COPIES __attribute__((optimize("no-crossjumping")))
+#else
+#define CHIP8_KEEP_DISPATCH_COPIES
+#endif
 
-  for (size_t i = 0; i < k_font_space; i++) {
-    memory_[k_font_address + i] = static_cast<std::byte>(k_fontset[i]);
-  }
-  for (size_t i = 0; i < 256; i++) {
-    for (size_t j = 0; j < 8; j++) {
-      sprite_table_[i][j] = (i & (0x80u >> j)) ? 1u : 0u;
-    }
-  }
-}
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+CHIP8_KEEP_DISPATCH_COPIES common::Status
+BasicChip8<Quirks, Checking, Display>::run_cycles_threaded(
+    int cycles, Profiler &profiler) {
+#if defined(__GNUC__)
+  // Indexed by Op, in declaration order.
+  static constexpr void *k_labels[] = {
+#define CHIP8_OP_LABEL(name, pattern) &&op_##name,
+      CHIP8_OPS(CHIP8_OP_LABEL)
+#undef CHIP8_OP_LABEL
+  };
+  static_assert(std::size(k_labels) == k_num_ops);
 
-common::Status Chip8::load_rom(const std::filesystem::path &path) {
-  std::ifstream file(path, std::ios::binary | std::ios::ate);
-  if (!file) {
-    return std::unexpected(
-        common::AppError{common::ErrorCode::IOError, "Unable to open file"});
-  }
-  std::streampos file_size = file.tellg();
-  file.seekg(0, std::ios::beg);
-  file.read(reinterpret_cast<char *>(&memory_[program_counter_]), file_size);
-  if (!file) {
-    return std::unexpected(common::AppError{
-        common::ErrorCode::IOError, "Failed to read ROM bytes from file"});
+  Instruction instruction;
+  uint16_t address = 0u;
+  uint64_t start_ticks = 0u;
+
+  if (this->faulted_) {
+    return this->fault_status();
   }
-  file.close();
-  return {};
+
+// Fetches the next instruction and jumps to its label. Expanded at the end of
+// every handler so each one gets its own indirect branch.
+#define CHIP8_DISPATCH()                                                       \
+  do {                                                                         \
+    if (cycles-- <= 0 || stalled<Quirks>(*this)) {                             \
+      return this->fault_status();                                             \
+    }                                                                          \
+    instruction = fetch<Checking>(*this);                                      \
+    address = this->program_counter_;                                          \
+    start_ticks = profiler.start();                                            \
+    this->program_counter_ += 2;                                               \
+    this->instructions_executed_++;                                            \
+    goto *k_labels[static_cast<size_t>(instruction.op)];                       \
+  } while (0)
+
+// The handler index is a constant, so the table lookup folds into a direct
+// call the compiler can inline.
+#define CHIP8_OP(name)                                                         \
+  op_##name:                                                                   \
+  k_handlers<Quirks, Checking, Display>[static_cast<size_t>(Op::name)](       \
+      *this, instruction);                                                     \
+  profiler.record(address, Op::name, start_ticks);                             \
+  if constexpr (Checking::k_checked) {                                         \
+    if (this->faulted_) {                                                      \
+      capture_fault(*this, address);                                           \
+      return this->fault_status();                                             \
+    }                                                                          \
+  }                                                                            \
+  CHIP8_DISPATCH();
+
+  CHIP8_DISPATCH();
+
+op_Undecoded:
+  return std::unexpected(common::AppError{common::ErrorCode::InternalError,
+                                          "Dispatched an undecoded slot"});
+  CHIP8_OP(Sys)
+  CHIP8_OP(Cls)
+  CHIP8_OP(Ret)
+  CHIP8_OP(Jp)
+  CHIP8_OP(Call)
+  CHIP8_OP(SeVxKk)
+  CHIP8_OP(SneVxKk)
+  CHIP8_OP(SeVxVy)
+  CHIP8_OP(LdVxKk)
+  CHIP8_OP(AddVxKk)
+  CHIP8_OP(LdVxVy)
+  CHIP8_OP(Or)
+  CHIP8_OP(And)
+  CHIP8_OP(Xor)
+  CHIP8_OP(AddVxVy)
+  CHIP8_OP(Sub)
+  CHIP8_OP(Shr)
+  CHIP8_OP(Subn)
+  CHIP8_OP(Shl)
+  CHIP8_OP(SneVxVy)
+  CHIP8_OP(LdI)
+  CHIP8_OP(JpV0)
+  CHIP8_OP(Rnd)
+  CHIP8_OP(Drw)
+  CHIP8_OP(Skp)
+  CHIP8_OP(Sknp)
+  CHIP8_OP(LdVxDt)
+  CHIP8_OP(LdVxK)
+  CHIP8_OP(LdDtVx)
+  CHIP8_OP(LdStVx)
+  CHIP8_OP(AddIVx)
+  CHIP8_OP(LdFVx)
+  CHIP8_OP(LdBVx)
+  CHIP8_OP(LdIVx)
+  CHIP8_OP(LdVxI)
+  CHIP8_OP(InvalidRegisterOp)
+  CHIP8_OP(InvalidKeyOp)
+  CHIP8_OP(InvalidFOp)
+
+#undef CHIP8_OP
+#undef CHIP8_DISPATCH
+#else
+  return run_cycles_table(cycles, profiler);
+#endif
 }
 
-void Chip8::decrement_timers() {
-  if (delay_timer_ > 0) {
-    --delay_timer_;
-  }
-  if (sound_timer_ > 0) {
-    should_beep_ = true;
-    --sound_timer_;
-  }
-  if (sound_timer_ == 0) {
-    should_beep_ = false;
-  }
+template <typename Quirks, typename Checking, typename Display>
+template <typename Profiler>
+common::Status
+BasicChip8<Quirks, Checking, Display>::run_cycles(int cycles,
+                                                  Profiler &profiler) {
+#if defined(CHIP8_THREADED_DISPATCH)
+  return run_cycles_threaded(cycles, profiler);
+#else
+  return run_cycles_table(cycles, profiler);
+#endif
 }
 
-common::Status Chip8::execute_cycle() {
-  if (waiting_for_key_press_ || waiting_for_key_release_ || redraw_) {
-    return {};
-  }
-  uint8_t b1 = static_cast<uint8_t>(memory_[program_counter_]);
-  uint8_t b2 = static_cast<uint8_t>(memory_[program_counter_ + 1]);
-  // print_instructions(b1, b2, program_counter_);
-  program_counter_ += 2;
-  uint8_t opcode = b1 >> 4u;
-  common::Status status = execute_[opcode](*this, b1, b2);
-  return status;
+template <typename Quirks, typename Checking, typename Display>
+common::Status BasicChip8<Quirks, Checking, Display>::run_cycles(int cycles) {
+  NoProfiler profiler;
+  return run_cycles(cycles, profiler);
 }
 
+#define CHIP8_INSTANTIATE(Quirks, Checking, Display, Profiler)                 \
+  template common::Status                                                      \
+  BasicChip8<Quirks, Checking, Display>::execute_cycle(Profiler &);            \
+  template common::Status                                                      \
+  BasicChip8<Quirks, Checking, Display>::run_cycles(int, Profiler &);          \
+  template common::Status                                                      \
+  BasicChip8<Quirks, Checking, Display>::run_cycles_table(int, Profiler &);    \
+  template common::Status                                                      \
+  BasicChip8<Quirks, Checking, Display>::run_cycles_threaded(int,              \
+                                                             Profiler &);      \
+  template common::Status                                                      \
+  BasicChip8<Quirks, Checking, Display>::run_machine_cycles(int64_t &,         \
+                                                            Profiler &);
+
+#define CHIP8_INSTANTIATE_MACHINE(Quirks, Checking, Display)                   \
+  template class BasicChip8<Quirks, Checking, Display>;                        \
+  CHIP8_INSTANTIATE(Quirks, Checking, Display, NoProfiler)                     \
+  CHIP8_INSTANTIATE(Quirks, Checking, Display, OpcodeProfiler)
+
+CHIP8_INSTANTIATE_MACHINE(CosmacVipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(CosmacVipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(Chip48Quirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(Chip48Quirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(SuperChipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(SuperChipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE_MACHINE(CosmacVipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE_MACHINE(CosmacVipQuirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE_MACHINE(Chip48Quirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE_MACHINE(Chip48Quirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE_MACHINE(SuperChipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE_MACHINE(SuperChipQuirks, Unchecked, PackedDisplay)
+
+#undef CHIP8_INSTANTIATE_MACHINE
+#undef CHIP8_INSTANTIATE
+
 } // namespace chip8
@@ -2,23 +2,98 @@
 #define SRC_CHIP8_H
 
 #include "app_error.h"
+#include "checking.h"
+#include "instruction.h"
+#include "quirks.h"
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <random>
+#include <span>
+#include <vector>
 
 namespace chip8 {
 
-class Chip8 {
+// How the 64x32 framebuffer is stored; see ByteDisplay and PackedDisplay.
+// Read pixels through pixel()/display_row() to stay independent of it.
+enum class DisplayMode : uint8_t { Bytes, Packed };
+
+// Chip8State::dirty_rows_ with every row of the 64x32 display marked.
+constexpr uint32_t k_all_rows = 0xFFFFFFFFu;
+
+// Where every core keeps the 4x5 hex digit font Fx29 points into.
+constexpr uint16_t k_font_address = 0x50;
+// Copies that font into `memory` at k_font_address.
+void load_font(std::span<std::byte> memory);
+
+// The MINSTD generator behind Cxkk, shared by every core: the state, in
+// [1, 2^31 - 2], a seed starts it at, and one step returning the next byte.
+uint32_t random_state_for(uint64_t seed);
+uint8_t next_random_byte(uint32_t &state);
+
+constexpr uint8_t k_num_keys = 16u;
+// A host key with no keypad mapping; see Chip8State::set_key().
+constexpr uint8_t k_unmapped_key = k_num_keys;
+
+// The hex keypad and the Fx0A waits on it, shared by every core so the key
+// plumbing (KeyInjector, the frontends) works with each of them.
+class KeypadState {
+public:
+  // Applies a key transition the way the frontends deliver it. Any key, even
+  // k_unmapped_key, ends a pending Fx0A press or release wait.
+  void set_key(uint8_t key, bool pressed);
+
+public:
+  std::array<uint8_t, 16> keypad_ = {};
+  bool waiting_for_key_press_ = false;
+  bool waiting_for_key_release_ = false;
+};
+
+// Machine state plus the operations no quirk affects. Frontends that only
+// read the display, keypad and timers take a Chip8State so they work with
+// every quirk profile and framebuffer layout.
+//
+// The framebuffer itself lives in the layout deriving from this class,
+// ByteDisplay or PackedDisplay, which are the only ones that can construct
+// it. display_mode() says which one a Chip8State is part of.
+class Chip8State : public KeypadState {
 public:
-  Chip8();
+  // Maps the ROM at `path` (see RomImage) and loads it at program_counter_.
   common::Status load_rom(const std::filesystem::path &path);
+  // Copies `program` to program_counter_ and sizes the decode cache to it;
+  // InvalidArgument, with memory untouched, if it would run past the end of
+  // memory_.
+  common::Status load_program(std::span<const std::byte> program);
   void decrement_timers();
-  common::Status execute_cycle();
+  // Restarts the Cxkk random sequence from `seed`.
+  void seed_random(uint64_t seed);
+  // Writes a byte into memory_ and drops any cached decode that read it.
+  void write_memory(uint16_t address, std::byte value);
+  // Drops cached decodes overlapping [address, address + length).
+  void invalidate_decoded(uint16_t address, size_t length);
+
+  DisplayMode display_mode() const { return display_mode_; }
+  // 1 if the pixel at (x, y) is lit, 0 otherwise.
+  uint8_t pixel(int x, int y) const;
+  // Row `y` as 64 bits, x = 0 in bit 63.
+  uint64_t display_row(int y) const;
+  // Replaces row `y` with `row`, laid out as display_row() returns it.
+  void set_display_row(int y, uint64_t row);
+
+  // fault_ as an error status; OK if the machine has not faulted.
+  common::Status fault_status() const {
+    if (!faulted_) [[likely]] {
+      return {};
+    }
+    return std::unexpected(describe_fault());
+  }
+  // fault_ as an error, with the PC/opcode/register dump when recorded.
+  common::AppError describe_fault() const;
 
 public:
-  std::default_random_engine rand_gen_;
-  std::uniform_int_distribution<uint8_t> rand_byte_;
+  // Park-Miller (MINSTD) generator state for Cxkk, in [1, 2^31 - 2]. One
+  // word, so snapshots can carry it.
+  uint32_t rng_state_ = 1u;
 
   std::array<std::byte, 4096> memory_ = {};
   uint16_t program_counter_ = 0u;
@@ -27,21 +102,133 @@ public:
   std::array<std::uint16_t, 16> stack_ = {};
   std::uint8_t stack_pointer_ = 0u;
 
-  std::array<uint8_t, 64 * 32> display_ = {};
-  std::array<std::array<uint8_t, 8>, 256> sprite_table_;
   bool redraw_ = false;
+  // Bit y set when Dxyn or 00E0 touched row y. Frontends clear it once they
+  // have looked at those rows; the pixels may still be unchanged, e.g. when
+  // a sprite was drawn twice.
+  uint32_t dirty_rows_ = 0u;
 
   uint8_t delay_timer_ = 0u;
   uint8_t sound_timer_ = 0u;
   bool should_beep_ = false;
 
-  std::array<uint8_t, 16> keypad_ = {};
-  bool waiting_for_key_press_ = false;
-  bool waiting_for_key_release_ = false;
+  uint64_t instructions_executed_ = 0u;
+
+  // Set by the first fault and never cleared; every later run returns it.
+  bool faulted_ = false;
+  Fault fault_ = {};
+
+  // Decodes cached for [decoded_base_, decoded_base_ + decoded_.size()),
+  // the range load_program() last filled. Instructions fetched from anywhere
+  // else are decoded every time. Sized to the program rather than to
+  // memory_: 8 bytes per program byte instead of 32 KB in every machine.
+  uint16_t decoded_base_ = 0u;
+  std::vector<Instruction> decoded_;
 
-  std::array<common::Status (*)(Chip8 &, uint8_t, uint8_t), 16> execute_;
+private:
+  friend class ByteDisplay;
+  friend class PackedDisplay;
+
+  explicit Chip8State(DisplayMode display_mode);
+  // Copies only through a layout, so one never takes another's state.
+  Chip8State(const Chip8State &) = default;
+  Chip8State(Chip8State &&) = default;
+  Chip8State &operator=(const Chip8State &) = default;
+  Chip8State &operator=(Chip8State &&) = default;
+
+  DisplayMode display_mode_;
+};
+
+// Framebuffer layouts for BasicChip8. Like the quirk profile and execution
+// policy they are fixed at compile time, so a machine carries only its own
+// framebuffer and Dxyn/00E0 pick their code without testing the layout.
+
+// One byte per pixel, 0 or 1, row-major in display_.
+class ByteDisplay : public Chip8State {
+public:
+  static constexpr DisplayMode k_display_mode = DisplayMode::Bytes;
+
+  ByteDisplay() : Chip8State(k_display_mode) {}
+
+  std::array<uint8_t, 64 * 32> display_ = {};
+};
+
+// Each row as a uint64_t in packed_display_, x = 0 in bit 63: a sprite row
+// draws with one shift and XOR, and 00E0 clears 256 bytes.
+class PackedDisplay : public Chip8State {
+public:
+  static constexpr DisplayMode k_display_mode = DisplayMode::Packed;
+
+  PackedDisplay() : Chip8State(k_display_mode) {}
+
+  std::array<uint64_t, 32> packed_display_ = {};
 };
 
+// The interpreter for one quirk profile (see quirks.h), execution policy
+// (see checking.h) and framebuffer layout. Instantiated in chip8.cc for
+// CosmacVipQuirks, Chip48Quirks and SuperChipQuirks, each Checked and
+// Unchecked, over ByteDisplay and PackedDisplay.
+template <typename Quirks, typename Checking = Checked,
+          typename Display = ByteDisplay>
+class BasicChip8 : public Display {
+public:
+  using quirks = Quirks;
+  using checking = Checking;
+  using display = Display;
+
+  common::Status execute_cycle();
+  // execute_cycle() reporting each instruction to `profiler`; instantiated
+  // for the policies in profiler.h.
+  template <typename Profiler>
+  common::Status execute_cycle(Profiler &profiler);
+  // Same as calling execute_cycle(profiler) `cycles` times. Built with
+  // CHIP8_THREADED_DISPATCH this runs run_cycles_threaded(), otherwise
+  // run_cycles_table().
+  template <typename Profiler>
+  common::Status run_cycles(int cycles, Profiler &profiler);
+  common::Status run_cycles(int cycles);
+  // Loops over execute_cycle(), one indirect call through the handler table
+  // per instruction.
+  template <typename Profiler>
+  common::Status run_cycles_table(int cycles, Profiler &profiler);
+  // Threaded code: every handler is inlined behind its own label and ends
+  // with its own indirect jump to the next one (computed goto), so the branch
+  // predictor sees per-opcode history instead of one shared call site. Falls
+  // back to run_cycles_table() on compilers without labels-as-values.
+  template <typename Profiler>
+  common::Status run_cycles_threaded(int cycles, Profiler &profiler);
+  // The VIP timing model (see vip_timing.h): runs instructions while
+  // `budget` machine cycles remain, charging each its vip_cycles() cost, and
+  // leaves the overrun (<= 0) in `budget` for the caller to carry into the
+  // next call. A stall ends the run and forfeits the rest of the budget, as
+  // the VIP idles until the interrupt. Uses table dispatch.
+  template <typename Profiler>
+  common::Status run_machine_cycles(int64_t &budget, Profiler &profiler);
+  common::Status run_machine_cycles(int64_t &budget);
+
+private:
+  // Fetches and runs one instruction; faults are left in fault_.
+  template <typename Profiler> void step(Profiler &profiler);
+};
+
+extern template class BasicChip8<CosmacVipQuirks, Checked>;
+extern template class BasicChip8<CosmacVipQuirks, Unchecked>;
+extern template class BasicChip8<Chip48Quirks, Checked>;
+extern template class BasicChip8<Chip48Quirks, Unchecked>;
+extern template class BasicChip8<SuperChipQuirks, Checked>;
+extern template class BasicChip8<SuperChipQuirks, Unchecked>;
+extern template class BasicChip8<CosmacVipQuirks, Checked, PackedDisplay>;
+extern template class BasicChip8<CosmacVipQuirks, Unchecked, PackedDisplay>;
+extern template class BasicChip8<Chip48Quirks, Checked, PackedDisplay>;
+extern template class BasicChip8<Chip48Quirks, Unchecked, PackedDisplay>;
+extern template class BasicChip8<SuperChipQuirks, Checked, PackedDisplay>;
+extern template class BasicChip8<SuperChipQuirks, Unchecked, PackedDisplay>;
+
+// The COSMAC VIP behaviour this emulator has always had.
+using Chip8 = BasicChip8<CosmacVipQuirks>;
+// The same on the packed framebuffer.
+using PackedChip8 = BasicChip8<CosmacVipQuirks, Checked, PackedDisplay>;
+
 } // namespace chip8
 
 #endif
@@ -0,0 +1,47 @@
+"""chip8_aot_library: a CHIP-8 ROM compiled ahead of time into C++."""
+
+def chip8_aot_library(name, rom, quirks = "vip", checked = True, **kwargs):
+    """Runs //src:chip8_aot over `rom` and builds the result.
+
+    The cc_library `name` defines chip8::aot::<name>, an AotProgram (see
+    src/aot_program.h) for BasicChip8 with the `quirks` profile, Checked or
+    Unchecked. It registers itself when linked, so find_aot_program() picks
+    it up from the ROM's bytes; `name` must be a C++ identifier.
+
+    Args:
+      name: the cc_library, and the generated <name>.h and <name>.cc.
+      rom: label of the .ch8 image.
+      quirks: "vip", "chip48" or "schip".
+      checked: compile for Checked rather than Unchecked.
+      **kwargs: passed on to the cc_library, e.g. visibility.
+    """
+    header = name + ".h"
+    source = name + ".cc"
+    package = native.package_name()
+    native.genrule(
+        name = name + "_cpp",
+        srcs = [rom],
+        outs = [header, source],
+        cmd = " ".join([
+            "$(location //src:chip8_aot)",
+            "--quirks=" + quirks,
+            "--name=" + name,
+            "--header_include=" + (package + "/" if package else "") + header,
+        ] + ([] if checked else ["--unchecked"]) + [
+            "$(location %s)" % rom,
+            "$(location %s)" % header,
+            "$(location %s)" % source,
+        ]),
+        tools = ["//src:chip8_aot"],
+    )
+    native.cc_library(
+        name = name,
+        srcs = [source],
+        hdrs = [header],
+        deps = [
+            "//src:aot_program",
+            "//src:chip8",
+        ],
+        alwayslink = True,
+        **kwargs
+    )
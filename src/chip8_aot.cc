@@ -0,0 +1,78 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aot_compiler.h"
+#include "app_error.h"
+#include "rom_image.h"
+
+namespace {
+
+common::Status write_file(const std::filesystem::path &path,
+                          const std::string &contents) {
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError, "Unable to write " + path.string()});
+  }
+  return {};
+}
+
+} // namespace
+
+// Compiles a ROM into C++ for AotProgram; see chip8_aot.bzl for the Bazel
+// rule that wraps it into a cc_library.
+int main(int argc, char *argv[]) {
+  chip8::AotOptions options;
+  std::vector<std::string_view> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (arg.starts_with("--quirks=")) {
+      options.quirks = arg.substr(std::string_view("--quirks=").size());
+    } else if (arg.starts_with("--name=")) {
+      options.name = arg.substr(std::string_view("--name=").size());
+    } else if (arg.starts_with("--header_include=")) {
+      options.header_include =
+          arg.substr(std::string_view("--header_include=").size());
+    } else if (arg == "--unchecked") {
+      options.checked = false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 3 || options.name.empty() ||
+      options.header_include.empty()) {
+    std::cerr << "Usage: chip8_aot [--quirks=vip|chip48|schip] [--unchecked] "
+                 "--name=<identifier> --header_include=<path> <rom> <out.h> "
+                 "<out.cc>"
+              << std::endl;
+    return -1;
+  }
+  const std::filesystem::path rom(positional[0]);
+  options.rom_name = rom.filename().string();
+  common::StatusOr<chip8::RomImage> image = chip8::RomImage::open(rom);
+  if (!image) {
+    std::cerr << "Error when loading rom: " << image.error() << std::endl;
+    return -1;
+  }
+  common::StatusOr<chip8::AotTranslation> translation =
+      chip8::compile_rom_to_cpp(image->bytes(), options);
+  if (!translation) {
+    std::cerr << "Error when compiling " << rom << ": " << translation.error()
+              << std::endl;
+    return -1;
+  }
+  for (common::Status status :
+       {write_file(positional[1], translation->header),
+        write_file(positional[2], translation->source)}) {
+    if (!status) {
+      std::cerr << status.error() << std::endl;
+      return -1;
+    }
+  }
+  return 0;
+}
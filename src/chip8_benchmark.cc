@@ -0,0 +1,562 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "aot_program.h"
+#include "app_error.h"
+#include "chip8.h"
+#include "extended_chip8.h"
+#include "headless.h"
+#include "profiler.h"
+#include "recompiler.h"
+#include "rom_image.h"
+#include "simd_kernels.h"
+#include "snapshot.h"
+#include "test_program.h"
+#include "vip_timing.h"
+
+namespace {
+
+constexpr uint16_t k_program_start = 0x200;
+constexpr uint16_t k_data_address = 0x300;
+
+// Puts the machine back into a state where the benchmarked instruction can
+// run again. Every opcode pays the same reset so results stay comparable.
+void reset_for_opcode(chip8::Chip8State &chip8) {
+  chip8.program_counter_ = k_program_start;
+  chip8.index_register_ = k_data_address;
+  chip8.stack_[0] = k_program_start;
+  chip8.stack_pointer_ = 1;
+  chip8.redraw_ = false;
+  chip8.waiting_for_key_press_ = false;
+  chip8.waiting_for_key_release_ = false;
+}
+
+struct OpcodeCase {
+  const char *name;
+  uint16_t word;
+};
+
+constexpr std::array<OpcodeCase, 35> k_opcode_cases = {{
+    {"00E0", 0x00E0}, {"00EE", 0x00EE}, {"1nnn", 0x1200}, {"2nnn", 0x2200},
+    {"3xkk", 0x3100}, {"4xkk", 0x4100}, {"5xy0", 0x5120}, {"6xkk", 0x6142},
+    {"7xkk", 0x7142}, {"8xy0", 0x8120}, {"8xy1", 0x8121}, {"8xy2", 0x8122},
+    {"8xy3", 0x8123}, {"8xy4", 0x8124}, {"8xy5", 0x8125}, {"8xy6", 0x8126},
+    {"8xy7", 0x8127}, {"8xyE", 0x812E}, {"9xy0", 0x9120}, {"Annn", 0xA300},
+    {"Bnnn", 0xB200}, {"Cxkk", 0xC1FF}, {"Dxyn", 0xD12F}, {"Ex9E", 0xE19E},
+    {"ExA1", 0xE1A1}, {"Fx07", 0xF107}, {"Fx0A", 0xF10A}, {"Fx15", 0xF115},
+    {"Fx18", 0xF118}, {"Fx1E", 0xF11E}, {"Fx29", 0xF129}, {"Fx33", 0xF133},
+    {"Fx55", 0xFF55}, {"Fx65", 0xFF65}, {"0nnn", 0x0123},
+}};
+
+template <typename Machine> Machine make_opcode_machine(uint16_t word) {
+  Machine chip8;
+  chip8::load_words(chip8, {word});
+  for (int i = 0; i < 15; i++) {
+    chip8.memory_[k_data_address + i] = std::byte(0xA5u ^ (i * 17));
+  }
+  chip8.registers_[1] = 12;
+  chip8.registers_[2] = 7;
+  chip8.keypad_[3] = 1; // Lets Fx0A complete instead of stalling.
+  reset_for_opcode(chip8);
+  return chip8;
+}
+
+template <typename Machine>
+void BM_Opcode(benchmark::State &state, uint16_t word) {
+  Machine chip8 = make_opcode_machine<Machine>(word);
+  for (auto _ : state) {
+    reset_for_opcode(chip8);
+    common::Status status = chip8.execute_cycle();
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Synthetic instruction mixes, each an endless loop.
+enum class Mix { Alu, Branchy, Memory, Mixed };
+
+void load_mix(chip8::Chip8State &chip8, Mix mix) {
+  switch (mix) {
+  case Mix::Alu:
+    chip8::load_words(chip8, {0x6005, 0x6103, 0x8014, 0x8115, 0x8206,
+                              0x830E, 0x8417, 0x8511, 0x8622, 0x8733,
+                              0x7001, 0x1204});
+    break;
+  case Mix::Branchy:
+    chip8::load_words(chip8, {0x7001, 0x3000, 0x4080, 0x5010, 0x9010,
+                              0x7101, 0x3103, 0x1200, 0x6100, 0x1200});
+    break;
+  case Mix::Memory:
+    chip8::load_words(chip8, {0xA300, 0x7001, 0xF033, 0xF265, 0xA310,
+                              0xF555, 0xF01E, 0x1200});
+    break;
+  case Mix::Mixed:
+    chip8::load_words(chip8, {0x7001, 0x8014, 0xA300, 0xF033, 0xF265,
+                              0x3000, 0x2210, 0x1200, 0x8126, 0x00EE});
+    break;
+  }
+}
+
+void BM_ExecuteCycleMix(benchmark::State &state, Mix mix) {
+  chip8::Chip8 chip8;
+  load_mix(chip8, mix);
+  const int cycles = 1000;
+  for (auto _ : state) {
+    for (int i = 0; i < cycles; i++) {
+      common::Status status = chip8.execute_cycle();
+      benchmark::DoNotOptimize(status);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * cycles);
+}
+
+// Table vs threaded dispatch over the same mix, for the Checked or Unchecked
+// core. Run with --benchmark_perf_counters=BRANCH-MISSES,INSTRUCTIONS
+// (libpfm builds) or under `perf stat` to compare branch misses.
+template <typename Machine>
+void BM_DispatchMix(benchmark::State &state, Mix mix, bool threaded) {
+  Machine chip8;
+  chip8::NoProfiler profiler;
+  load_mix(chip8, mix);
+  const int cycles = 1000;
+  for (auto _ : state) {
+    common::Status status = threaded
+                                ? chip8.run_cycles_threaded(cycles, profiler)
+                                : chip8.run_cycles_table(cycles, profiler);
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(state.iterations() * cycles);
+}
+
+void BM_RecompilerMix(benchmark::State &state, Mix mix) {
+  chip8::Chip8 chip8;
+  chip8::Recompiler recompiler;
+  load_mix(chip8, mix);
+  const int cycles = 1000;
+  for (auto _ : state) {
+    common::Status status = recompiler.run(chip8, cycles);
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(state.iterations() * cycles);
+}
+
+// A full-height sprite drawn at an unaligned x through the draw opcode.
+template <typename Machine>
+void BM_Draw(benchmark::State &state, const chip8::PixelKernels *kernels) {
+  if (kernels != nullptr) {
+    chip8::set_pixel_kernels(*kernels);
+  }
+  Machine chip8 = make_opcode_machine<Machine>(0xD12F);
+  chip8.registers_[1] = 13;
+  chip8.registers_[2] = 9;
+  for (auto _ : state) {
+    reset_for_opcode(chip8);
+    common::Status status = chip8.execute_cycle();
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(chip8::pixel_kernels().name);
+}
+
+// The per-frame pixel conversion SDLSystem::draw does before uploading.
+void BM_ExpandArgb(benchmark::State &state,
+                   const chip8::PixelKernels *kernels) {
+  std::array<uint8_t, 64 * 32> pixels = {};
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = (i * 7 + i / 5) & 0x1u;
+  }
+  std::array<uint32_t, 64 * 32> screen = {};
+  for (auto _ : state) {
+    kernels->expand_argb(pixels.data(), screen.data(), pixels.size(),
+                         0xFFFFFFFF, 0xFF000000);
+    benchmark::DoNotOptimize(screen.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(screen));
+}
+
+void BM_ExpandRowsArgb(benchmark::State &state,
+                       const chip8::PixelKernels *kernels) {
+  std::array<uint64_t, 32> rows = {};
+  for (size_t y = 0; y < rows.size(); y++) {
+    rows[y] = 0x9E3779B97F4A7C15ull * (y + 1);
+  }
+  std::array<uint32_t, 64 * 32> screen = {};
+  for (auto _ : state) {
+    kernels->expand_rows_argb(rows.data(), rows.size(), screen.data(),
+                              0xFFFFFFFF, 0xFF000000);
+    benchmark::DoNotOptimize(screen.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(screen));
+}
+
+// A full-screen 00FB/00FC on one 128x64 bitplane.
+void BM_ShiftWideRows(benchmark::State &state,
+                      const chip8::PixelKernels *kernels) {
+  std::array<uint64_t, 64 * chip8::k_wide_row_words> rows = {};
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+  }
+  for (auto _ : state) {
+    kernels->shift_wide_rows(rows.data(), 64u, 4);
+    benchmark::DoNotOptimize(rows.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(rows));
+}
+
+// SDLSystem::present's conversion of both XO-CHIP planes for a full frame.
+void BM_CompositePlanesArgb(benchmark::State &state,
+                            const chip8::PixelKernels *kernels) {
+  std::array<uint64_t, 64 * chip8::k_wide_row_words> plane0 = {};
+  std::array<uint64_t, 64 * chip8::k_wide_row_words> plane1 = {};
+  for (size_t i = 0; i < plane0.size(); i++) {
+    plane0[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+    plane1[i] = 0xC2B2AE3D27D4EB4Full * (i + 1);
+  }
+  const std::array<uint32_t, 4> palette = {0xFF000000, 0xFFFFFFFF,
+                                           0xFFAAAAAA, 0xFF555555};
+  std::array<uint32_t, 128 * 64> screen = {};
+  for (auto _ : state) {
+    kernels->composite_planes_argb(plane0.data(), plane1.data(), 64u,
+                                   screen.data(), palette);
+    benchmark::DoNotOptimize(screen.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(screen));
+}
+
+// One extended-core instruction, hires with both XO-CHIP planes selected.
+void BM_ExtendedOpcode(benchmark::State &state, uint16_t word) {
+  auto chip8 = std::make_unique<chip8::ExtendedChip8<chip8::XoChipQuirks>>();
+  chip8->hires_ = true;
+  chip8->plane_mask_ = 0x3u;
+  chip8->index_register_ = k_data_address;
+  chip8->registers_[1] = 61;
+  chip8->registers_[2] = 9;
+  for (uint16_t i = 0; i < 64; i++) {
+    chip8->memory_[k_data_address + i] = static_cast<std::byte>(i * 37u);
+  }
+  chip8::load_words(*chip8, {word});
+  for (auto _ : state) {
+    chip8->program_counter_ = k_program_start;
+    common::Status status = chip8->execute_cycle();
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(chip8::pixel_kernels().name);
+}
+
+enum class PresentPath { Staged, Streaming };
+
+// The host side of SDLSystem::present for a full frame into a texture whose
+// rows are state.range(0) bytes apart. The static-texture path converts into
+// a staging array that SDL_UpdateTexture then copies row by row; the
+// streaming path converts straight into the locked texture memory.
+void BM_Present(benchmark::State &state, PresentPath path) {
+  const size_t pitch = static_cast<size_t>(state.range(0));
+  std::array<uint64_t, 32> rows = {};
+  for (size_t y = 0; y < rows.size(); y++) {
+    rows[y] = 0x9E3779B97F4A7C15ull * (y + 1);
+  }
+  std::array<uint32_t, 64 * 32> screen = {};
+  std::vector<std::byte> texture(pitch * rows.size());
+  const chip8::PixelKernels &kernels = chip8::pixel_kernels();
+  for (auto _ : state) {
+    if (path == PresentPath::Streaming) {
+      chip8::expand_rows_argb_pitched(kernels, rows.data(), rows.size(),
+                                      texture.data(), pitch, 0xFFFFFFFF,
+                                      0xFF000000);
+    } else {
+      kernels.expand_rows_argb(rows.data(), rows.size(), screen.data(),
+                               0xFFFFFFFF, 0xFF000000);
+      benchmark::DoNotOptimize(screen.data());
+      for (size_t y = 0; y < rows.size(); y++) {
+        std::memcpy(texture.data() + y * pitch, screen.data() + y * 64,
+                    64 * sizeof(uint32_t));
+      }
+    }
+    benchmark::DoNotOptimize(texture.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["copied_bytes_per_present"] =
+      path == PresentPath::Staged ? static_cast<double>(sizeof(screen)) : 0.0;
+  state.SetBytesProcessed(state.iterations() * sizeof(screen));
+  state.SetLabel(kernels.name);
+}
+
+enum class Backend { Interpreter, Recompiler, Packed, Aot };
+
+// The AotProgram linked in for `rom`, or nullptr.
+const chip8::AotProgram<chip8::Chip8> *
+aot_program_for(const std::filesystem::path &rom) {
+  common::StatusOr<chip8::RomImage> image = chip8::RomImage::open(rom);
+  return image ? chip8::find_aot_program<chip8::Chip8>(image->bytes())
+               : nullptr;
+}
+
+// End-to-end frames/sec for one ROM with no SDL and no frame pacing. Only
+// Chip8 runs on the recompiler and AOT backends.
+template <typename Machine>
+void BM_Rom(benchmark::State &state, std::filesystem::path rom,
+            Backend backend) {
+  Machine chip8;
+  common::Status load_status = chip8.load_rom(rom);
+  if (!load_status) {
+    state.SkipWithError(load_status.error().message.c_str());
+    return;
+  }
+  chip8::Recompiler recompiler;
+  const chip8::AotProgram<chip8::Chip8> *aot =
+      backend == Backend::Aot ? aot_program_for(rom) : nullptr;
+  for (auto _ : state) {
+    common::Status status;
+    if constexpr (std::is_same_v<Machine, chip8::Chip8>) {
+      if (backend == Backend::Recompiler) {
+        status = chip8::run_headless_frame(chip8, recompiler);
+      } else if (aot != nullptr) {
+        status = chip8::run_headless_frame(chip8, *aot);
+      } else {
+        status = chip8::run_headless_frame(chip8);
+      }
+    } else {
+      status = chip8::run_headless_frame(chip8);
+    }
+    if (!status) {
+      state.SkipWithError(status.error().message.c_str());
+      return;
+    }
+  }
+  state.counters["frames_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["instructions_per_second"] = benchmark::Counter(
+      static_cast<double>(chip8.instructions_executed_),
+      benchmark::Counter::kIsRate);
+}
+
+// Headless frames on the VIP timing model at the VIP's own clock.
+// emulated_hz counts the clock pulses of the machine cycles run, so divided
+// by k_vip_clock_hz it is exactly the speed-up over a real VIP.
+void BM_RomTimed(benchmark::State &state, std::filesystem::path rom) {
+  chip8::Chip8 chip8;
+  common::Status load_status = chip8.load_rom(rom);
+  if (!load_status) {
+    state.SkipWithError(load_status.error().message.c_str());
+    return;
+  }
+  chip8::CycleScheduler scheduler;
+  for (auto _ : state) {
+    common::Status status = chip8::run_headless_frame(chip8, scheduler);
+    if (!status) {
+      state.SkipWithError(status.error().message.c_str());
+      return;
+    }
+  }
+  state.counters["frames_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["emulated_hz"] = benchmark::Counter(
+      static_cast<double>(scheduler.machine_cycles()) *
+          chip8::k_clocks_per_machine_cycle,
+      benchmark::Counter::kIsRate);
+  state.counters["instructions_per_frame"] =
+      static_cast<double>(chip8.instructions_executed_) / state.iterations();
+}
+
+void BM_SnapshotSave(benchmark::State &state) {
+  chip8::Chip8 chip8;
+  load_mix(chip8, Mix::Mixed);
+  chip8::Snapshot snapshot;
+  for (auto _ : state) {
+    chip8::save_snapshot(chip8, snapshot);
+    benchmark::DoNotOptimize(&snapshot);
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(snapshot));
+}
+
+void BM_SnapshotRestore(benchmark::State &state) {
+  chip8::Chip8 chip8;
+  load_mix(chip8, Mix::Mixed);
+  chip8::Snapshot snapshot;
+  chip8::save_snapshot(chip8, snapshot);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(chip8::restore_snapshot(chip8, snapshot));
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(snapshot));
+}
+
+// Cost of recording one frame of rewind history while running `rom`, and
+// how many bytes of ring each frame takes on average.
+void BM_RewindPush(benchmark::State &state, std::filesystem::path rom) {
+  chip8::Chip8 chip8;
+  common::Status load_status = chip8.load_rom(rom);
+  if (!load_status) {
+    state.SkipWithError(load_status.error().message.c_str());
+    return;
+  }
+  // Large enough that nothing is evicted, so bytes_used() is the history.
+  chip8::RewindBuffer rewind(size_t{256} << 20u);
+  for (auto _ : state) {
+    state.PauseTiming();
+    common::Status status = chip8::run_headless_frame(chip8);
+    state.ResumeTiming();
+    if (!status) {
+      state.SkipWithError(status.error().message.c_str());
+      return;
+    }
+    rewind.push(chip8);
+  }
+  state.counters["bytes_per_frame"] =
+      static_cast<double>(rewind.bytes_used()) /
+      static_cast<double>(std::max<size_t>(rewind.frames(), 1u));
+}
+
+// CHIP8_ROM_DIR wins, then the workspace's roms/ under `bazel run`, then
+// ./roms.
+std::filesystem::path rom_directory() {
+  if (const char *dir = std::getenv("CHIP8_ROM_DIR")) {
+    return dir;
+  }
+  if (const char *workspace = std::getenv("BUILD_WORKSPACE_DIRECTORY")) {
+    return std::filesystem::path(workspace) / "roms";
+  }
+  return "roms";
+}
+
+void register_benchmarks() {
+  for (const OpcodeCase &opcode : k_opcode_cases) {
+    benchmark::RegisterBenchmark(
+        (std::string("BM_Opcode/") + opcode.name).c_str(),
+        BM_Opcode<chip8::Chip8>, opcode.word);
+  }
+  benchmark::RegisterBenchmark("BM_Opcode/00E0/packed",
+                               BM_Opcode<chip8::PackedChip8>, 0x00E0);
+  benchmark::RegisterBenchmark("BM_Opcode/Dxyn/packed",
+                               BM_Opcode<chip8::PackedChip8>, 0xD12F);
+
+  const std::array<std::pair<const char *, Mix>, 4> mixes = {{
+      {"alu", Mix::Alu},
+      {"branchy", Mix::Branchy},
+      {"memory", Mix::Memory},
+      {"mixed", Mix::Mixed},
+  }};
+  for (auto [name, mix] : mixes) {
+    benchmark::RegisterBenchmark(
+        (std::string("BM_ExecuteCycleMix/") + name).c_str(),
+        BM_ExecuteCycleMix, mix);
+    for (bool threaded : {false, true}) {
+      std::string prefix = std::string("BM_DispatchMix/") + name +
+                           (threaded ? "/threaded" : "/table");
+      benchmark::RegisterBenchmark(prefix.c_str(),
+                                   BM_DispatchMix<chip8::Chip8>, mix,
+                                   threaded);
+      benchmark::RegisterBenchmark(
+          (prefix + "/unchecked").c_str(),
+          BM_DispatchMix<
+              chip8::BasicChip8<chip8::CosmacVipQuirks, chip8::Unchecked>>,
+          mix, threaded);
+    }
+    benchmark::RegisterBenchmark(
+        (std::string("BM_RecompilerMix/") + name).c_str(), BM_RecompilerMix,
+        mix);
+  }
+
+  for (const chip8::PixelKernels &kernels :
+       chip8::supported_pixel_kernels()) {
+    std::string suffix = std::string("/") + kernels.name;
+    benchmark::RegisterBenchmark(("BM_Draw" + suffix).c_str(),
+                                 BM_Draw<chip8::Chip8>, &kernels);
+    benchmark::RegisterBenchmark(("BM_ExpandArgb" + suffix).c_str(),
+                                 BM_ExpandArgb, &kernels);
+    benchmark::RegisterBenchmark(("BM_ExpandRowsArgb" + suffix).c_str(),
+                                 BM_ExpandRowsArgb, &kernels);
+    benchmark::RegisterBenchmark(("BM_ShiftWideRows" + suffix).c_str(),
+                                 BM_ShiftWideRows, &kernels);
+    benchmark::RegisterBenchmark(("BM_CompositePlanesArgb" + suffix).c_str(),
+                                 BM_CompositePlanesArgb, &kernels);
+  }
+  benchmark::RegisterBenchmark("BM_ExtendedOpcode/00FB", BM_ExtendedOpcode,
+                               0x00FB);
+  benchmark::RegisterBenchmark("BM_ExtendedOpcode/00C4", BM_ExtendedOpcode,
+                               0x00C4);
+  benchmark::RegisterBenchmark("BM_ExtendedOpcode/D120", BM_ExtendedOpcode,
+                               0xD120);
+  benchmark::RegisterBenchmark("BM_Draw/packed", BM_Draw<chip8::PackedChip8>,
+                               nullptr);
+  // 256 bytes is a tight 64-pixel row; drivers often pad pitches further.
+  benchmark::RegisterBenchmark("BM_Present/staged", BM_Present,
+                               PresentPath::Staged)
+      ->Arg(256)
+      ->Arg(512)
+      ->Arg(1024);
+  benchmark::RegisterBenchmark("BM_Present/streaming", BM_Present,
+                               PresentPath::Streaming)
+      ->Arg(256)
+      ->Arg(512)
+      ->Arg(1024);
+
+  benchmark::RegisterBenchmark("BM_SnapshotSave", BM_SnapshotSave);
+  benchmark::RegisterBenchmark("BM_SnapshotRestore", BM_SnapshotRestore);
+
+  std::filesystem::path dir = rom_directory();
+  std::error_code error;
+  std::vector<std::filesystem::path> roms;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+    if (entry.path().extension() == ".ch8") {
+      roms.push_back(entry.path());
+    }
+  }
+  if (roms.empty()) {
+    std::cerr << "No ROMs found in " << dir
+              << "; set CHIP8_ROM_DIR to benchmark ROMs." << std::endl;
+  }
+  std::sort(roms.begin(), roms.end());
+  const std::array<std::pair<const char *, Backend>, 4> backends = {{
+      {"interpreter", Backend::Interpreter},
+      {"recompiler", Backend::Recompiler},
+      {"packed", Backend::Packed},
+      {"aot", Backend::Aot},
+  }};
+  for (const std::filesystem::path &rom : roms) {
+    for (auto [name, backend] : backends) {
+      // Only the ROMs built into the binary (AOT_TEST_SUITE) have an aot run.
+      if (backend == Backend::Aot && aot_program_for(rom) == nullptr) {
+        continue;
+      }
+      benchmark::RegisterBenchmark(
+          ("BM_Rom/" + rom.stem().string() + "/" + name).c_str(),
+          backend == Backend::Packed ? BM_Rom<chip8::PackedChip8>
+                                     : BM_Rom<chip8::Chip8>,
+          rom, backend);
+    }
+    benchmark::RegisterBenchmark(
+        ("BM_RomTimed/" + rom.stem().string()).c_str(), BM_RomTimed, rom);
+    benchmark::RegisterBenchmark(
+        ("BM_RewindPush/" + rom.stem().string()).c_str(), BM_RewindPush, rom);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  register_benchmarks();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -1,6 +1,11 @@
 #include "src/chip8.h"
+#include "src/profiler.h"
+#include "src/test_program.h"
 #include "gtest/gtest.h"
+#include <array>
 #include <cstddef>
+#include <span>
+#include <vector>
 
 namespace chip8 {
 
@@ -342,6 +347,64 @@ TEST_F(Chip8Test, OpcodeDxyn_DRW) {
   EXPECT_TRUE(chip8.redraw_);
 }
 
+TEST_F(Chip8Test, OpcodeDxyn_DRW_NoCollisionWithUnrelatedPixels) {
+  chip8.registers_[0] = 8;
+  chip8.registers_[1] = 0;
+  chip8.index_register_ = 0x300;
+  chip8.memory_[0x300] = std::byte{0x0F}; // 00001111
+  // Lit pixels in the sprite's row that the sprite does not cover.
+  chip8.display_[8] = 1;
+  chip8.display_[9] = 1;
+  chip8.memory_[chip8.program_counter_] = std::byte{0xD0};
+  chip8.memory_[chip8.program_counter_ + 1] = std::byte{0x11};
+
+  chip8.execute_cycle();
+
+  EXPECT_EQ(chip8.registers_[0xF], 0);
+  EXPECT_EQ(chip8.display_[8], 1);
+  EXPECT_EQ(chip8.display_[9], 1);
+  EXPECT_EQ(chip8.display_[10], 0);
+  EXPECT_EQ(chip8.display_[12], 1);
+  EXPECT_EQ(chip8.display_[15], 1);
+}
+
+TEST_F(Chip8Test, OpcodeDxyn_DRW_ClipsAtRightEdge) {
+  chip8.registers_[0] = 60;
+  chip8.registers_[1] = 0;
+  chip8.index_register_ = 0x300;
+  chip8.memory_[0x300] = std::byte{0xFF};
+  chip8.memory_[chip8.program_counter_] = std::byte{0xD0};
+  chip8.memory_[chip8.program_counter_ + 1] = std::byte{0x11};
+
+  chip8.execute_cycle();
+
+  for (int x = 60; x < 64; x++) {
+    EXPECT_EQ(chip8.display_[x], 1);
+  }
+  EXPECT_EQ(chip8.display_[64], 0);
+}
+
+TEST_F(Chip8Test, OpcodeDxyn_DRW_MarksDirtyRows) {
+  chip8.registers_[0] = 10;
+  chip8.registers_[1] = 29;
+  chip8.index_register_ = 0x300;
+  chip8.memory_[chip8.program_counter_] = std::byte{0xD0};
+  chip8.memory_[chip8.program_counter_ + 1] = std::byte{0x15};
+
+  chip8.execute_cycle();
+
+  // Rows 29-31; the two rows below the bottom edge are clipped.
+  EXPECT_EQ(chip8.dirty_rows_, 0xE0000000u);
+
+  // Presented: lets the VIP's display wait move on to the CLS.
+  chip8.redraw_ = false;
+  chip8.dirty_rows_ = 0u;
+  chip8.memory_[0x202] = std::byte{0x00};
+  chip8.memory_[0x203] = std::byte{0xE0};
+  chip8.execute_cycle();
+  EXPECT_EQ(chip8.dirty_rows_, k_all_rows);
+}
+
 TEST_F(Chip8Test, OpcodeEx9E_SKP_True) {
   uint16_t initial_pc = chip8.program_counter_;
   chip8.registers_[5] = 0xA;
@@ -491,4 +554,339 @@ TEST_F(Chip8Test, OpcodeFx65_LD_Vx_I) {
   EXPECT_EQ(chip8.program_counter_, 0x202);
 }
 
+template <typename Machine>
+constexpr bool k_has_byte_framebuffer = requires(Machine m) { m.display_; };
+
+// The layout is part of the type: a packed machine has no byte framebuffer.
+static_assert(k_has_byte_framebuffer<Chip8>);
+static_assert(!k_has_byte_framebuffer<PackedChip8>);
+
+TEST(Chip8PackedDisplayTest, OpcodeDxyn_DRW) {
+  PackedChip8 chip8;
+  chip8.registers_[0] = 62;
+  chip8.registers_[1] = 31;
+  chip8.index_register_ = 0x300;
+  chip8.memory_[0x300] = std::byte{0xC1}; // 11000001
+  chip8.memory_[0x301] = std::byte{0xFF};
+  chip8.memory_[chip8.program_counter_] = std::byte{0xD0};
+  chip8.memory_[chip8.program_counter_ + 1] = std::byte{0x12};
+
+  chip8.execute_cycle();
+
+  // Clipped at the right and bottom edges.
+  EXPECT_EQ(chip8.packed_display_[31], 0x3ull);
+  EXPECT_EQ(chip8.pixel(62, 31), 1);
+  EXPECT_EQ(chip8.pixel(63, 31), 1);
+  EXPECT_EQ(chip8.pixel(0, 0), 0);
+  EXPECT_EQ(chip8.registers_[0xF], 0);
+  EXPECT_TRUE(chip8.redraw_);
+
+  chip8.redraw_ = false;
+  chip8.program_counter_ = 0x200;
+  chip8.execute_cycle();
+  EXPECT_EQ(chip8.packed_display_[31], 0u);
+  EXPECT_EQ(chip8.registers_[0xF], 1);
+}
+
+TEST(Chip8PackedDisplayTest, Opcode00E0_CLS) {
+  PackedChip8 chip8;
+  chip8.packed_display_.fill(~0ull);
+  chip8.memory_[chip8.program_counter_] = std::byte{0x00};
+  chip8.memory_[chip8.program_counter_ + 1] = std::byte{0xE0};
+  chip8.execute_cycle();
+  for (int y = 0; y < 32; y++) {
+    EXPECT_EQ(chip8.display_row(y), 0u);
+  }
+  EXPECT_TRUE(chip8.redraw_);
+}
+
+TEST(Chip8PackedDisplayTest, MatchesByteDisplay) {
+  Chip8 bytes;
+  PackedChip8 packed;
+  const std::array<uint8_t, 18> program = {
+      0x60, 0x00, // 200: LD V0, 00
+      0x61, 0x00, // 202: LD V1, 00
+      0x62, 0x00, // 204: LD V2, 00
+      0xF2, 0x29, // 206: LD F, V2
+      0xD0, 0x15, // 208: DRW V0, V1, 5
+      0x70, 0x09, // 20A: ADD V0, 09
+      0x71, 0x03, // 20C: ADD V1, 03
+      0x72, 0x01, // 20E: ADD V2, 01
+      0x12, 0x06, // 210: JP 206
+  };
+  ASSERT_TRUE(bytes.load_program(std::as_bytes(std::span(program))));
+  ASSERT_TRUE(packed.load_program(std::as_bytes(std::span(program))));
+  for (int cycle = 0; cycle < 600; cycle++) {
+    bytes.execute_cycle();
+    packed.execute_cycle();
+    bytes.redraw_ = false;
+    packed.redraw_ = false;
+    ASSERT_EQ(bytes.registers_, packed.registers_);
+  }
+  for (int y = 0; y < 32; y++) {
+    EXPECT_EQ(bytes.display_row(y), packed.display_row(y));
+    for (int x = 0; x < 64; x++) {
+      EXPECT_EQ(bytes.pixel(x, y), packed.pixel(x, y));
+    }
+  }
+}
+
+TEST_F(Chip8Test, SelfModifyingCodeInvalidatesDecodedInstruction) {
+  // LD V0, 0x01 is decoded and cached at 0x200.
+  const std::array<std::byte, 4> program = {std::byte{0x60}, std::byte{0x01},
+                                            std::byte{0xF1}, std::byte{0x55}};
+  ASSERT_TRUE(chip8.load_program(program));
+  chip8.execute_cycle();
+  EXPECT_EQ(chip8.registers_[0], 0x01);
+
+  // F155 at 0x202 overwrites 0x200 with LD V1, 0x07.
+  chip8.registers_[0] = 0x61;
+  chip8.registers_[1] = 0x07;
+  chip8.index_register_ = 0x200;
+  chip8.execute_cycle();
+  EXPECT_EQ(chip8.memory_[0x200], std::byte{0x61});
+  EXPECT_EQ(chip8.memory_[0x201], std::byte{0x07});
+
+  chip8.registers_[1] = 0x00;
+  chip8.program_counter_ = 0x200;
+  chip8.execute_cycle();
+  EXPECT_EQ(chip8.registers_[0], 0x61);
+  EXPECT_EQ(chip8.registers_[1], 0x07);
+}
+
+TEST_F(Chip8Test, RunsCodeWrittenPastTheLoadedProgram) {
+  const std::array<std::byte, 8> program = {
+      std::byte{0x60}, std::byte{0x62}, // 200: LD V0, 62
+      std::byte{0x61}, std::byte{0x09}, // 202: LD V1, 09
+      std::byte{0xA2}, std::byte{0x08}, // 204: LD I, 208
+      std::byte{0xF1}, std::byte{0x55}, // 206: LD [I], V1
+  };
+  ASSERT_TRUE(chip8.load_program(program));
+  EXPECT_EQ(chip8.decoded_.size(), program.size());
+  // 208: LD V2, 09, outside the decode cache.
+  for (int cycle = 0; cycle < 5; cycle++) {
+    ASSERT_TRUE(chip8.execute_cycle());
+  }
+  EXPECT_EQ(chip8.registers_[2], 0x09);
+
+  chip8.write_memory(0x209, std::byte{0x0A});
+  chip8.program_counter_ = 0x208;
+  ASSERT_TRUE(chip8.execute_cycle());
+  EXPECT_EQ(chip8.registers_[2], 0x0A);
+}
+
+TEST(Chip8DispatchTest, ThreadedMatchesTable) {
+  Chip8 table;
+  Chip8 threaded;
+  const std::array<uint8_t, 32> program = {
+      0x60, 0x00, // 200: LD V0, 00
+      0xA2, 0x40, // 202: LD I, 240
+      0x22, 0x16, // 204: CALL 216
+      0x70, 0x03, // 206: ADD V0, 03
+      0x80, 0x1E, // 208: SHL V0, V1
+      0xF0, 0x33, // 20A: LD B, V0
+      0xF2, 0x65, // 20C: LD V2, [I]
+      0xD0, 0x23, // 20E: DRW V0, V2, 3
+      0x30, 0x40, // 210: SE V0, 40
+      0x12, 0x04, // 212: JP 204
+      0x00, 0xE0, // 214: CLS
+      0x81, 0x04, // 216: ADD V1, V0
+      0x00, 0xEE, // 218: RET
+      0x12, 0x14, // 21A: JP 214
+      0x00, 0x00, // 21C
+      0x00, 0x00, // 21E
+  };
+  for (Chip8 *chip8 : {&table, &threaded}) {
+    for (size_t i = 0; i < program.size(); i++) {
+      chip8->memory_[0x200 + i] = std::byte{program[i]};
+    }
+  }
+  NoProfiler profiler;
+  for (int frame = 0; frame < 200; frame++) {
+    ASSERT_TRUE(table.run_cycles_table(7, profiler));
+    ASSERT_TRUE(threaded.run_cycles_threaded(7, profiler));
+    ASSERT_EQ(table.instructions_executed_, threaded.instructions_executed_);
+    ASSERT_EQ(table.program_counter_, threaded.program_counter_);
+    ASSERT_EQ(table.registers_, threaded.registers_);
+    ASSERT_EQ(table.memory_, threaded.memory_);
+    ASSERT_EQ(table.display_, threaded.display_);
+    ASSERT_EQ(table.redraw_, threaded.redraw_);
+    table.redraw_ = false;
+    threaded.redraw_ = false;
+  }
+}
+
+TEST(Chip8DispatchTest, ThreadedStopsOnError) {
+  Chip8 chip8;
+  chip8.memory_[0x200] = std::byte{0x60};
+  chip8.memory_[0x201] = std::byte{0x01};
+  chip8.memory_[0x202] = std::byte{0x80};
+  chip8.memory_[0x203] = std::byte{0x0F};
+  NoProfiler profiler;
+  EXPECT_FALSE(chip8.run_cycles_threaded(10, profiler));
+  EXPECT_EQ(chip8.registers_[0], 0x01);
+  EXPECT_EQ(chip8.instructions_executed_, 2u);
+}
+
+// Runs 8xy1 with VF preloaded, 8xy6 with Vx != Vy, Fx55 with x = 2 and
+// Bnnn/Bxnn, returning the machine for inspection.
+template <typename Quirks> BasicChip8<Quirks> run_quirk_program() {
+  BasicChip8<Quirks> chip8;
+  load_words(chip8, {
+                        0x6F07, // 200: LD VF, 07
+                        0x8121, // 202: OR V1, V2
+                        0x6308, // 204: LD V3, 08
+                        0x6405, // 206: LD V4, 05
+                        0x8346, // 208: SHR V3, V4
+                        0xA300, // 20A: LD I, 300
+                        0xF255, // 20C: LD [I], V2
+                        0x6002, // 20E: LD V0, 02
+                        0x6210, // 210: LD V2, 10
+                        0xB220, // 212: JP V0/V2, 220
+                    });
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(chip8.execute_cycle());
+  }
+  return chip8;
+}
+
+TEST(Chip8QuirksTest, CosmacVip) {
+  auto chip8 = run_quirk_program<CosmacVipQuirks>();
+  EXPECT_EQ(chip8.registers_[0x3], 0x02); // V4 >> 1
+  EXPECT_EQ(chip8.registers_[0xF], 0x01); // Carry out of V4.
+  EXPECT_EQ(chip8.index_register_, 0x303);
+  EXPECT_EQ(chip8.program_counter_, 0x222); // V0 + 220
+}
+
+TEST(Chip8QuirksTest, Chip48) {
+  auto chip8 = run_quirk_program<Chip48Quirks>();
+  EXPECT_EQ(chip8.registers_[0x3], 0x04); // V3 >> 1
+  EXPECT_EQ(chip8.registers_[0xF], 0x00);
+  EXPECT_EQ(chip8.index_register_, 0x302);
+  EXPECT_EQ(chip8.program_counter_, 0x230); // V2 + 220
+}
+
+TEST(Chip8QuirksTest, SuperChip) {
+  auto chip8 = run_quirk_program<SuperChipQuirks>();
+  EXPECT_EQ(chip8.registers_[0x3], 0x04);
+  EXPECT_EQ(chip8.index_register_, 0x300);
+  EXPECT_EQ(chip8.program_counter_, 0x230);
+}
+
+TEST(Chip8QuirksTest, LogicResetsVfOnlyOnVip) {
+  Chip8 vip;
+  BasicChip8<SuperChipQuirks> schip;
+  load_words(vip, {0x6F07, 0x8122});
+  load_words(schip, {0x6F07, 0x8122});
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(vip.execute_cycle());
+    ASSERT_TRUE(schip.execute_cycle());
+  }
+  EXPECT_EQ(vip.registers_[0xF], 0x00);
+  EXPECT_EQ(schip.registers_[0xF], 0x07);
+}
+
+TEST(Chip8QuirksTest, DisplayWaitOnlyOnVip) {
+  Chip8 vip;
+  BasicChip8<Chip48Quirks> chip48;
+  load_words(vip, {0x00E0, 0x7001, 0x7001});
+  load_words(chip48, {0x00E0, 0x7001, 0x7001});
+  ASSERT_TRUE(vip.run_cycles(3));
+  ASSERT_TRUE(chip48.run_cycles(3));
+  EXPECT_EQ(vip.registers_[0], 0x00);
+  EXPECT_EQ(vip.program_counter_, 0x202);
+  EXPECT_EQ(chip48.registers_[0], 0x02);
+  EXPECT_TRUE(chip48.redraw_);
+}
+
+TEST(Chip8CheckingTest, CheckedFaultReportsDetail) {
+  Chip8 chip8;
+  load_words(chip8, {
+                        0xAFFE, // 200: LD I, FFE
+                        0xF255, // 202: LD [I], V2
+                        0x7001, // 204: ADD V0, 01
+                    });
+  chip8.registers_[1] = 0xAB;
+  ASSERT_TRUE(chip8.run_cycles(1));
+  common::Status status = chip8.run_cycles(3);
+  ASSERT_FALSE(status);
+  EXPECT_NE(status.error().message.find(
+                "memory access out of bounds at PC 0x202 (opcode 0xF255)"),
+            std::string::npos);
+  EXPECT_NE(status.error().message.find("V1=0xAB"), std::string::npos);
+  EXPECT_TRUE(chip8.fault_.detailed);
+  EXPECT_EQ(chip8.memory_[0xFFE], std::byte{0x00});
+  EXPECT_EQ(chip8.registers_[0], 0x00);
+
+  // The fault is sticky.
+  EXPECT_FALSE(chip8.execute_cycle());
+  EXPECT_EQ(chip8.program_counter_, 0x204);
+}
+
+TEST(Chip8CheckingTest, CheckedKeyAndProgramCounterFaults) {
+  Chip8 key;
+  load_words(key, {0x6020, 0xE09E});
+  ASSERT_TRUE(key.execute_cycle());
+  EXPECT_FALSE(key.execute_cycle());
+  EXPECT_EQ(key.fault_.kind, FaultKind::KeyOutOfRange);
+
+  Chip8 jump;
+  load_words(jump, {0x1FFF});
+  ASSERT_TRUE(jump.execute_cycle());
+  EXPECT_FALSE(jump.execute_cycle());
+  EXPECT_EQ(jump.fault_.kind, FaultKind::MemoryOutOfBounds);
+  EXPECT_EQ(jump.fault_.program_counter, 0xFFF);
+}
+
+TEST(Chip8CheckingTest, UncheckedWrapsAndKeepsStickyFlag) {
+  BasicChip8<CosmacVipQuirks, Unchecked> chip8;
+  load_words(chip8, {
+                        0xAFFE, // 200: LD I, FFE
+                        0x6107, // 202: LD V1, 07
+                        0xF255, // 204: LD [I], V2
+                        0x00EE, // 206: RET (empty stack)
+                        0x7001, // 208: ADD V0, 01
+                    });
+  ASSERT_TRUE(chip8.run_cycles(3));
+  EXPECT_EQ(chip8.memory_[0xFFF], std::byte{0x07});
+  EXPECT_EQ(chip8.memory_[0x000], std::byte{0x00});
+
+  common::Status status = chip8.run_cycles(2);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(chip8.fault_.kind, FaultKind::StackUnderflow);
+  EXPECT_FALSE(chip8.fault_.detailed);
+  // The frame ran to completion before the flag was looked at.
+  EXPECT_EQ(chip8.registers_[0], 0x01);
+  EXPECT_FALSE(chip8.run_cycles(1));
+  EXPECT_EQ(chip8.instructions_executed_, 5u);
+}
+
+TEST(Chip8CheckingTest, UncheckedDrawsSpritesThatWrapPastMemory) {
+  BasicChip8<CosmacVipQuirks, Unchecked> chip8;
+  load_words(chip8, {
+                        0xAFFE, // 200: LD I, FFE
+                        0xD003, // 202: DRW V0, V0, 3
+                    });
+  chip8.memory_[0xFFE] = std::byte{0x80};
+  chip8.memory_[0xFFF] = std::byte{0x40};
+  chip8.memory_[0x000] = std::byte{0x20};
+  ASSERT_TRUE(chip8.run_cycles(2));
+  EXPECT_EQ(chip8.pixel(0, 0), 1u);
+  EXPECT_EQ(chip8.pixel(1, 1), 1u);
+  EXPECT_EQ(chip8.pixel(2, 2), 1u);
+  EXPECT_EQ(chip8.registers_[0xF], 0u);
+}
+
+TEST_F(Chip8Test, LoadProgramRejectsWhatDoesNotFitInMemory) {
+  std::vector<std::byte> program(4096 - 0x200 + 1, std::byte{0xAA});
+  common::Status status = chip8.load_program(program);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(status.error().code, common::ErrorCode::InvalidArgument);
+  EXPECT_EQ(chip8.memory_[0x200], std::byte{0});
+  program.pop_back();
+  ASSERT_TRUE(chip8.load_program(program));
+  EXPECT_EQ(chip8.memory_[0x200], std::byte{0xAA});
+  EXPECT_EQ(chip8.memory_[0xFFF], std::byte{0xAA});
+}
+
 } // namespace chip8
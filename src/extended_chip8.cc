@@ -0,0 +1,544 @@
+#include "extended_chip8.h"
+#include "app_error.h"
+#include "rom_image.h"
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+constexpr uint16_t k_program_start = 0x200;
+
+// SUPER-CHIP's 8x10 digits, with Octo's A-F added for XO-CHIP programs.
+constexpr std::array<uint8_t, 160> k_big_font = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// Each of the low `width` bits of `bits` twice, for lores pixels.
+uint32_t double_bits(uint32_t bits, int width) {
+  uint32_t doubled = 0u;
+  for (int b = width - 1; b >= 0; b--) {
+    doubled = (doubled << 2u) | (((bits >> b) & 0x1u) * 0x3u);
+  }
+  return doubled;
+}
+
+// Sprite row `bits`, `width` <= 32 pixels with the leftmost in bit
+// width - 1, placed at column x of a 128-pixel row. Pixels past the right
+// edge wrap to column 0 or are clipped.
+template <bool Wrap>
+std::array<uint64_t, k_wide_row_words> place_row(uint32_t bits, int width,
+                                                 int x) {
+  const uint64_t sprite = uint64_t{bits} << (64 - width);
+  std::array<uint64_t, k_wide_row_words> row = {};
+  if (x < 64) {
+    row[0] = sprite >> x;
+    row[1] = x == 0 ? 0u : sprite << (64 - x);
+  } else {
+    row[1] = sprite >> (x - 64);
+  }
+  if constexpr (Wrap) {
+    if (x + width > 128) {
+      row[0] |= sprite << (128 - x);
+    }
+  }
+  return row;
+}
+
+} // namespace
+
+template <typename Quirks>
+ExtendedChip8<Quirks>::ExtendedChip8() : program_counter_(k_program_start) {
+  seed_random(std::chrono::system_clock::now().time_since_epoch().count());
+  load_font(memory_);
+  for (size_t i = 0; i < k_big_font.size(); i++) {
+    memory_[k_big_font_address + i] = static_cast<std::byte>(k_big_font[i]);
+  }
+}
+
+template <typename Quirks>
+common::Status
+ExtendedChip8<Quirks>::load_rom(const std::filesystem::path &path) {
+  common::StatusOr<RomImage> image =
+      RomImage::open(path, k_memory_size - k_program_start);
+  if (!image) {
+    return std::unexpected(image.error());
+  }
+  return load_program(image->bytes());
+}
+
+template <typename Quirks>
+common::Status
+ExtendedChip8<Quirks>::load_program(std::span<const std::byte> program) {
+  if (program.size() > k_memory_size - k_program_start) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "ROM of " + std::to_string(program.size()) +
+            " bytes does not fit in memory"});
+  }
+  std::copy(program.begin(), program.end(),
+            memory_.begin() + k_program_start);
+  return {};
+}
+
+template <typename Quirks> void ExtendedChip8<Quirks>::decrement_timers() {
+  if (delay_timer_ > 0) {
+    --delay_timer_;
+  }
+  if (sound_timer_ > 0) {
+    should_beep_ = true;
+    --sound_timer_;
+  }
+  if (sound_timer_ == 0) {
+    should_beep_ = false;
+  }
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::seed_random(uint64_t seed) {
+  rng_state_ = random_state_for(seed);
+}
+
+template <typename Quirks>
+uint8_t ExtendedChip8<Quirks>::pixel(int x, int y, int plane) const {
+  const uint64_t word = planes_[plane][y * k_wide_row_words + x / 64];
+  return (word >> (63 - x % 64)) & 0x1u;
+}
+
+template <typename Quirks>
+common::AppError ExtendedChip8<Quirks>::describe_fault() const {
+  std::ostringstream message;
+  message << fault_name(fault_.kind) << std::hex << std::uppercase
+          << std::setfill('0') << " at PC 0x" << std::setw(4)
+          << fault_.program_counter << " (opcode 0x" << std::setw(4)
+          << fault_.opcode << "), I=0x" << std::setw(4)
+          << fault_.index_register << " SP=" << std::dec
+          << static_cast<int>(fault_.stack_pointer) << std::hex;
+  for (size_t i = 0; i < fault_.registers.size(); i++) {
+    message << " V" << i << "=0x" << std::setw(2)
+            << static_cast<int>(fault_.registers[i]);
+  }
+  return common::AppError{common::ErrorCode::InternalError, message.str()};
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::raise_fault(FaultKind kind) {
+  if (!faulted_) {
+    faulted_ = true;
+    fault_.kind = kind;
+  }
+}
+
+template <typename Quirks> void ExtendedChip8<Quirks>::skip() {
+  if constexpr (Quirks::k_xo_chip) {
+    if (read(program_counter_) == std::byte{0xF0} &&
+        read(program_counter_ + 1u) == std::byte{0x00}) {
+      program_counter_ += 2;
+    }
+  }
+  program_counter_ += 2;
+}
+
+template <typename Quirks> void ExtendedChip8<Quirks>::clear_planes() {
+  for (int p = 0; p < k_num_planes; p++) {
+    if (plane_mask_ & (1u << p)) {
+      planes_[p] = {};
+    }
+  }
+  redraw_ = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::scroll_vertical(int rows) {
+  const size_t words = static_cast<size_t>(std::abs(rows)) * k_wide_row_words;
+  for (int p = 0; p < k_num_planes; p++) {
+    if (!(plane_mask_ & (1u << p))) {
+      continue;
+    }
+    auto &plane = planes_[p];
+    if (rows > 0) {
+      std::copy_backward(plane.begin(), plane.end() - words, plane.end());
+      std::fill(plane.begin(), plane.begin() + words, 0u);
+    } else {
+      std::copy(plane.begin() + words, plane.end(), plane.begin());
+      std::fill(plane.end() - words, plane.end(), 0u);
+    }
+  }
+  redraw_ = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::scroll_horizontal(int pixels) {
+  const PixelKernels &kernels = pixel_kernels();
+  for (int p = 0; p < k_num_planes; p++) {
+    if (plane_mask_ & (1u << p)) {
+      kernels.shift_wide_rows(planes_[p].data(), k_height, pixels);
+    }
+  }
+  redraw_ = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::draw(uint8_t x, uint8_t y, uint8_t n) {
+  const int scale = hires_ ? 1 : 2;
+  // Dxy0 draws 16x16 from two bytes a row.
+  const int rows = n == 0u ? 16 : n;
+  const int width = n == 0u ? 16 : 8;
+  const int x_coord = x % (k_width / scale) * scale;
+  const int y_coord = y % (k_height / scale) * scale;
+  uint32_t address = index_register_;
+  uint64_t collision = 0u;
+  for (int p = 0; p < k_num_planes; p++) {
+    if (!(plane_mask_ & (1u << p))) {
+      continue;
+    }
+    // With both planes selected, plane 1's sprite follows plane 0's.
+    for (int i = 0; i < rows; i++) {
+      uint32_t bits = static_cast<uint8_t>(read(address++));
+      if (width == 16) {
+        bits = (bits << 8u) | static_cast<uint8_t>(read(address++));
+      }
+      const std::array<uint64_t, k_wide_row_words> sprite =
+          place_row<Quirks::k_wrap_sprites>(
+              scale == 1 ? bits : double_bits(bits, width), width * scale,
+              x_coord);
+      for (int r = 0; r < scale; r++) {
+        int row_y = y_coord + i * scale + r;
+        if (row_y >= k_height) {
+          if constexpr (!Quirks::k_wrap_sprites) {
+            break;
+          }
+          row_y -= k_height;
+        }
+        uint64_t *row = planes_[p].data() + row_y * k_wide_row_words;
+        for (size_t w = 0; w < k_wide_row_words; w++) {
+          collision |= row[w] & sprite[w];
+          row[w] ^= sprite[w];
+        }
+      }
+    }
+  }
+  registers_[0xFu] = collision != 0u ? 1u : 0u;
+  redraw_ = true;
+}
+
+template <typename Quirks> void ExtendedChip8<Quirks>::step() {
+  const uint16_t address = program_counter_;
+  const uint8_t high = static_cast<uint8_t>(read(address));
+  const uint8_t low = static_cast<uint8_t>(read(address + 1u));
+  const uint8_t x = high & 0xFu;
+  const uint8_t y = low >> 4u;
+  const uint8_t n = low & 0xFu;
+  const uint16_t nnn = static_cast<uint16_t>(((high & 0xFu) << 8u) | low);
+  uint8_t &vx = registers_[x];
+  const uint8_t vy = registers_[y];
+  const int scale = hires_ ? 1 : 2;
+  program_counter_ += 2;
+  instructions_executed_++;
+
+  switch (high >> 4u) {
+  case 0x0:
+    if (high != 0u) {
+      break; // 0nnn: machine code, ignored as by the base cores.
+    }
+    if (y == 0xCu) {
+      scroll_vertical(n * scale);
+    } else if (Quirks::k_xo_chip && y == 0xDu) {
+      scroll_vertical(-n * scale);
+    } else if (low == 0xE0u) {
+      clear_planes();
+    } else if (low == 0xEEu) {
+      if (stack_pointer_ == 0u) {
+        raise_fault(FaultKind::StackUnderflow);
+        break;
+      }
+      program_counter_ = stack_[--stack_pointer_];
+    } else if (low == 0xFBu) {
+      scroll_horizontal(4 * scale);
+    } else if (low == 0xFCu) {
+      scroll_horizontal(-4 * scale);
+    } else if (low == 0xFDu) {
+      exited_ = true;
+    } else if (low == 0xFEu || low == 0xFFu) {
+      hires_ = low == 0xFFu;
+      clear_planes();
+    }
+    break;
+  case 0x1:
+    program_counter_ = nnn;
+    break;
+  case 0x2:
+    if (stack_pointer_ >= stack_.size()) {
+      raise_fault(FaultKind::StackOverflow);
+      break;
+    }
+    stack_[stack_pointer_++] = program_counter_;
+    program_counter_ = nnn;
+    break;
+  case 0x3:
+    if (vx == low) {
+      skip();
+    }
+    break;
+  case 0x4:
+    if (vx != low) {
+      skip();
+    }
+    break;
+  case 0x5:
+    if (n == 0x0u) {
+      if (vx == vy) {
+        skip();
+      }
+    } else if (Quirks::k_xo_chip && (n == 0x2u || n == 0x3u)) {
+      // 5xy2/5xy3: save or load Vx..Vy, in either direction; I stays.
+      const int step = x <= y ? 1 : -1;
+      for (int i = 0, r = x; i <= std::abs(y - x); i++, r += step) {
+        if (n == 0x2u) {
+          write(index_register_ + i, static_cast<std::byte>(registers_[r]));
+        } else {
+          registers_[r] = static_cast<uint8_t>(read(index_register_ + i));
+        }
+      }
+    } else {
+      raise_fault(FaultKind::InvalidOpcode);
+    }
+    break;
+  case 0x6:
+    vx = low;
+    break;
+  case 0x7:
+    vx += low;
+    break;
+  case 0x8: {
+    // VF is written last, so 8xFy leaves the flag rather than the result.
+    // -1 leaves it alone.
+    int flag = -1;
+    switch (n) {
+    case 0x0:
+      vx = vy;
+      break;
+    case 0x1:
+    case 0x2:
+    case 0x3:
+      vx = n == 0x1u ? vx | vy : n == 0x2u ? vx & vy : vx ^ vy;
+      if constexpr (Quirks::k_logic_resets_vf) {
+        flag = 0u;
+      }
+      break;
+    case 0x4:
+      flag = vx + vy > 0xFF ? 1u : 0u;
+      vx += vy;
+      break;
+    case 0x5:
+      flag = vx >= vy ? 1u : 0u;
+      vx -= vy;
+      break;
+    case 0x6: {
+      const uint8_t source = Quirks::k_shift_uses_vy ? vy : vx;
+      flag = source & 0x1u;
+      vx = source >> 1u;
+      break;
+    }
+    case 0x7:
+      flag = vy >= vx ? 1u : 0u;
+      vx = vy - vx;
+      break;
+    case 0xE: {
+      const uint8_t source = Quirks::k_shift_uses_vy ? vy : vx;
+      flag = source >> 7u;
+      vx = static_cast<uint8_t>(source << 1u);
+      break;
+    }
+    default:
+      raise_fault(FaultKind::InvalidOpcode);
+      break;
+    }
+    if (flag >= 0) {
+      registers_[0xFu] = static_cast<uint8_t>(flag);
+    }
+    break;
+  }
+  case 0x9:
+    if (n != 0x0u) {
+      raise_fault(FaultKind::InvalidOpcode);
+    } else if (vx != vy) {
+      skip();
+    }
+    break;
+  case 0xA:
+    index_register_ = nnn;
+    break;
+  case 0xB:
+    program_counter_ = nnn + registers_[Quirks::k_jump_uses_vx ? x : 0u];
+    break;
+  case 0xC:
+    vx = next_random_byte(rng_state_) & low;
+    break;
+  case 0xD:
+    draw(vx, vy, n);
+    break;
+  case 0xE:
+    if (low == 0x9Eu) {
+      if (keypad_[vx & 0xFu] == 1u) {
+        skip();
+      }
+    } else if (low == 0xA1u) {
+      if (keypad_[vx & 0xFu] != 1u) {
+        skip();
+      }
+    } else {
+      raise_fault(FaultKind::InvalidOpcode);
+    }
+    break;
+  case 0xF:
+    if (Quirks::k_xo_chip && high == 0xF0u && low == 0x00u) {
+      // F000 nnnn: I = the 16-bit word after it.
+      index_register_ = static_cast<uint16_t>(
+          (static_cast<uint8_t>(read(program_counter_)) << 8u) |
+          static_cast<uint8_t>(read(program_counter_ + 1u)));
+      program_counter_ += 2;
+      break;
+    }
+    switch (low) {
+    case 0x01:
+      if (!Quirks::k_xo_chip) {
+        raise_fault(FaultKind::InvalidOpcode);
+        break;
+      }
+      plane_mask_ = x & 0x3u;
+      break;
+    case 0x02:
+      if (!Quirks::k_xo_chip || x != 0u) {
+        raise_fault(FaultKind::InvalidOpcode);
+        break;
+      }
+      for (size_t i = 0; i < audio_pattern_.size(); i++) {
+        audio_pattern_[i] = static_cast<uint8_t>(read(index_register_ + i));
+      }
+      break;
+    case 0x07:
+      vx = delay_timer_;
+      break;
+    case 0x0A:
+      waiting_for_key_press_ = true;
+      for (uint8_t key = 0; key < k_num_keys; key++) {
+        if (keypad_[key] == 1u) {
+          waiting_for_key_press_ = false;
+          waiting_for_key_release_ = true;
+          vx = key;
+          break;
+        }
+      }
+      if (waiting_for_key_press_) {
+        program_counter_ -= 2;
+      }
+      break;
+    case 0x15:
+      delay_timer_ = vx;
+      break;
+    case 0x18:
+      sound_timer_ = vx;
+      break;
+    case 0x1E:
+      index_register_ += vx;
+      break;
+    case 0x29:
+      index_register_ = k_font_address + 5 * (vx & 0xFu);
+      break;
+    case 0x30:
+      index_register_ = k_big_font_address + 10 * (vx & 0xFu);
+      break;
+    case 0x33:
+      write(index_register_, static_cast<std::byte>(vx / 100));
+      write(index_register_ + 1u, static_cast<std::byte>(vx / 10 % 10));
+      write(index_register_ + 2u, static_cast<std::byte>(vx % 10));
+      break;
+    case 0x3A:
+      if (!Quirks::k_xo_chip) {
+        raise_fault(FaultKind::InvalidOpcode);
+        break;
+      }
+      pitch_ = vx;
+      break;
+    case 0x55:
+    case 0x65:
+      for (uint8_t i = 0; i <= x; i++) {
+        if (low == 0x55u) {
+          write(index_register_ + i, static_cast<std::byte>(registers_[i]));
+        } else {
+          registers_[i] = static_cast<uint8_t>(read(index_register_ + i));
+        }
+      }
+      if constexpr (Quirks::k_index_increment == IndexIncrement::XPlusOne) {
+        index_register_ += x + 1;
+      } else if constexpr (Quirks::k_index_increment == IndexIncrement::X) {
+        index_register_ += x;
+      }
+      break;
+    case 0x75:
+      std::copy_n(registers_.begin(), x + 1, flags_.begin());
+      break;
+    case 0x85:
+      std::copy_n(flags_.begin(), x + 1, registers_.begin());
+      break;
+    default:
+      raise_fault(FaultKind::InvalidOpcode);
+      break;
+    }
+    break;
+  }
+
+  if (faulted_ && !fault_.detailed) {
+    fault_.detailed = true;
+    fault_.program_counter = address;
+    fault_.opcode = static_cast<uint16_t>((high << 8u) | low);
+    fault_.index_register = index_register_;
+    fault_.stack_pointer = stack_pointer_;
+    fault_.registers = registers_;
+  }
+}
+
+template <typename Quirks>
+common::Status ExtendedChip8<Quirks>::execute_cycle() {
+  if (!faulted_ && !stalled()) {
+    step();
+  }
+  return fault_status();
+}
+
+template <typename Quirks>
+common::Status ExtendedChip8<Quirks>::run_cycles(int cycles) {
+  for (int i = 0; i < cycles && !faulted_ && !stalled(); i++) {
+    step();
+  }
+  return fault_status();
+}
+
+template class ExtendedChip8<SuperChipQuirks>;
+template class ExtendedChip8<XoChipQuirks>;
+
+} // namespace chip8
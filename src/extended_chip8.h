@@ -0,0 +1,136 @@
+#ifndef SRC_EXTENDED_CHIP8_H
+#define SRC_EXTENDED_CHIP8_H
+
+#include "app_error.h"
+#include "checking.h"
+#include "chip8.h"
+#include "quirks.h"
+#include "simd_kernels.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace chip8 {
+
+// The SUPER-CHIP 1.1 and XO-CHIP machine, next to BasicChip8 rather than
+// inside it so the 64x32 core keeps its fixed-size state and decode cache.
+// Instantiated in extended_chip8.cc for SuperChipQuirks and XoChipQuirks.
+//
+// The display is always 128x64: lores (64x32) mode draws every pixel as a
+// 2x2 block and doubles scroll distances, as Octo does, so frontends see one
+// resolution and a mode switch never rescales the window. Each bitplane keeps
+// a row as k_wide_row_words words, x = 0 in bit 63 of the first, so draws
+// are two shifts and XORs per row and scrolls run on the PixelKernels.
+// SUPER-CHIP only ever selects plane 0.
+//
+// Addresses wrap to 12 bits (SUPER-CHIP) or 16 bits (XO-CHIP) like an
+// Unchecked BasicChip8; stack over/underflow and invalid opcodes fault.
+template <typename Quirks> class ExtendedChip8 : public KeypadState {
+public:
+  using quirks = Quirks;
+
+  static constexpr int k_width = 128;
+  static constexpr int k_height = 64;
+  static constexpr int k_num_planes = 2;
+  static constexpr size_t k_memory_size = Quirks::k_xo_chip ? 0x10000 : 0x1000;
+  // The 8x10 hex digits Fx30 points into, after the 4x5 font.
+  static constexpr uint16_t k_big_font_address = 0xA0;
+
+  ExtendedChip8();
+  // Loads at 0x200; see Chip8State::load_rom() and load_program().
+  common::Status load_rom(const std::filesystem::path &path);
+  common::Status load_program(std::span<const std::byte> program);
+  void decrement_timers();
+  // Restarts the Cxkk random sequence from `seed`.
+  void seed_random(uint64_t seed);
+
+  common::Status execute_cycle();
+  // Same as calling execute_cycle() `cycles` times; stops early on a stall,
+  // a fault or 00FD.
+  common::Status run_cycles(int cycles);
+  // For KeyInjector. The extended opcodes have no Op, so the profiler sees
+  // nothing.
+  template <typename Profiler>
+  common::Status run_cycles(int cycles, Profiler &profiler) {
+    return run_cycles(cycles);
+  }
+
+  // 1 if the pixel at (x, y) of 128x64 is lit in `plane`, 0 otherwise.
+  uint8_t pixel(int x, int y, int plane = 0) const;
+
+  common::Status fault_status() const {
+    if (!faulted_) [[likely]] {
+      return {};
+    }
+    return std::unexpected(describe_fault());
+  }
+  common::AppError describe_fault() const;
+
+public:
+  uint32_t rng_state_ = 1u;
+
+  std::array<std::byte, k_memory_size> memory_ = {};
+  uint16_t program_counter_ = 0u;
+  uint16_t index_register_ = 0u;
+  std::array<std::uint8_t, 16> registers_ = {};
+  std::array<std::uint16_t, 16> stack_ = {};
+  std::uint8_t stack_pointer_ = 0u;
+  // Fx75/Fx85's persistent flag registers (the HP-48's RPL user flags).
+  std::array<std::uint8_t, 16> flags_ = {};
+
+  // Row y of plane p is planes_[p][y * k_wide_row_words ...].
+  alignas(32)
+      std::array<std::array<uint64_t, k_height * k_wide_row_words>,
+                 k_num_planes> planes_ = {};
+  bool hires_ = false;
+  // Bit p selects plane p for drawing, clearing and scrolling (Fn01).
+  uint8_t plane_mask_ = 0x1u;
+  bool redraw_ = false;
+
+  uint8_t delay_timer_ = 0u;
+  uint8_t sound_timer_ = 0u;
+  bool should_beep_ = false;
+  // XO-CHIP's 1-bit, 128-sample audio pattern (F002) and its playback pitch
+  // (Fx3A); 64 is 4000 Hz.
+  std::array<uint8_t, 16> audio_pattern_ = {};
+  uint8_t pitch_ = 64u;
+
+  // Set by 00FD; nothing runs afterwards.
+  bool exited_ = false;
+  uint64_t instructions_executed_ = 0u;
+
+  bool faulted_ = false;
+  Fault fault_ = {};
+
+private:
+  // Fetches and runs one instruction; faults are left in fault_.
+  void step();
+  bool stalled() const {
+    return waiting_for_key_press_ || waiting_for_key_release_ || exited_;
+  }
+  void raise_fault(FaultKind kind);
+  std::byte read(uint32_t address) const {
+    return memory_[address & (k_memory_size - 1u)];
+  }
+  void write(uint32_t address, std::byte value) {
+    memory_[address & (k_memory_size - 1u)] = value;
+  }
+  // Skips the next instruction, which for XO-CHIP may be the 4-byte F000.
+  void skip();
+  void clear_planes();
+  // Moves the selected planes down `rows` pixels, up when negative.
+  void scroll_vertical(int rows);
+  // Moves the selected planes right `pixels` pixels, left when negative.
+  void scroll_horizontal(int pixels);
+  // Dxyn (Dxy0 for a 16x16 sprite) on every selected plane.
+  void draw(uint8_t x, uint8_t y, uint8_t n);
+};
+
+extern template class ExtendedChip8<SuperChipQuirks>;
+extern template class ExtendedChip8<XoChipQuirks>;
+
+} // namespace chip8
+
+#endif
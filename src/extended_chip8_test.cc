@@ -0,0 +1,195 @@
+#include "src/extended_chip8.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <initializer_list>
+
+namespace chip8 {
+namespace {
+
+template <typename Machine>
+void load_bytes(Machine &chip8, uint16_t address,
+                std::initializer_list<uint8_t> bytes) {
+  for (uint8_t byte : bytes) {
+    chip8.memory_[address++] = static_cast<std::byte>(byte);
+  }
+}
+
+// Lit pixels of row y in [x_begin, x_end) of `plane`.
+template <typename Machine>
+int lit_in_row(const Machine &chip8, int y, int x_begin, int x_end,
+               int plane = 0) {
+  int lit = 0;
+  for (int x = x_begin; x < x_end; x++) {
+    lit += chip8.pixel(x, y, plane);
+  }
+  return lit;
+}
+
+using SuperChip = ExtendedChip8<SuperChipQuirks>;
+using XoChip = ExtendedChip8<XoChipQuirks>;
+
+} // namespace
+
+TEST(ExtendedChip8Test, HiresDrawsSixteenBySixteenAcrossTheWordBoundary) {
+  SuperChip chip8;
+  // 00FF; V0 = 56; I = 0x300; D010; D010
+  load_words(chip8, {0x00FF, 0x6038, 0xA300, 0xD010, 0xD010});
+  for (uint16_t i = 0; i < 32; i++) {
+    chip8.memory_[0x300 + i] = std::byte{0xFF};
+  }
+  ASSERT_TRUE(chip8.run_cycles(4));
+  EXPECT_TRUE(chip8.hires_);
+  EXPECT_EQ(chip8.registers_[0xF], 0u);
+  for (int y = 0; y < 16; y++) {
+    EXPECT_EQ(lit_in_row(chip8, y, 0, 128), 16) << y;
+    EXPECT_EQ(lit_in_row(chip8, y, 56, 72), 16) << y;
+  }
+  EXPECT_EQ(lit_in_row(chip8, 16, 0, 128), 0);
+  ASSERT_TRUE(chip8.run_cycles(1));
+  EXPECT_EQ(chip8.registers_[0xF], 1u);
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 128), 0);
+}
+
+TEST(ExtendedChip8Test, LoresDrawsTwoByTwoPixels) {
+  SuperChip chip8;
+  // V0 = 1; V1 = 2; I = 0x300; D011
+  load_words(chip8, {0x6001, 0x6102, 0xA300, 0xD011});
+  load_bytes(chip8, 0x300, {0x80});
+  ASSERT_TRUE(chip8.run_cycles(4));
+  EXPECT_FALSE(chip8.hires_);
+  EXPECT_EQ(chip8.pixel(2, 4), 1u);
+  EXPECT_EQ(chip8.pixel(3, 4), 1u);
+  EXPECT_EQ(chip8.pixel(2, 5), 1u);
+  EXPECT_EQ(chip8.pixel(3, 5), 1u);
+  EXPECT_EQ(lit_in_row(chip8, 4, 0, 128), 2);
+  EXPECT_EQ(lit_in_row(chip8, 6, 0, 128), 0);
+}
+
+TEST(ExtendedChip8Test, ScrollsHorizontallyByFourHiresPixels) {
+  SuperChip chip8;
+  // 00FF; V0 = 62; I = 0x300; D011; 00FB; 00FC; 00FC
+  load_words(chip8,
+             {0x00FF, 0x603E, 0xA300, 0xD011, 0x00FB, 0x00FC, 0x00FC});
+  load_bytes(chip8, 0x300, {0xC0});
+  ASSERT_TRUE(chip8.run_cycles(5));
+  EXPECT_EQ(chip8.pixel(66, 0), 1u);
+  EXPECT_EQ(chip8.pixel(67, 0), 1u);
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 128), 2);
+  ASSERT_TRUE(chip8.run_cycles(2));
+  EXPECT_EQ(chip8.pixel(58, 0), 1u);
+  EXPECT_EQ(chip8.pixel(59, 0), 1u);
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 128), 2);
+}
+
+TEST(ExtendedChip8Test, LoresScrollsTwiceAsFar) {
+  SuperChip chip8;
+  // I = 0x300; D001; 00FB; 00C1
+  load_words(chip8, {0xA300, 0xD001, 0x00FB, 0x00C1});
+  load_bytes(chip8, 0x300, {0x80});
+  ASSERT_TRUE(chip8.run_cycles(4));
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 128), 0);
+  EXPECT_EQ(lit_in_row(chip8, 2, 0, 128), 2);
+  EXPECT_EQ(chip8.pixel(8, 2), 1u);
+  EXPECT_EQ(chip8.pixel(9, 3), 1u);
+}
+
+TEST(ExtendedChip8Test, ScrollsVerticallyAndDropsRowsOffTheEdge) {
+  XoChip chip8;
+  // 00FF; V1 = 62; I = 0x300; D012; 00C1; 00D4
+  load_words(chip8, {0x00FF, 0x613E, 0xA300, 0xD012, 0x00C1, 0x00D4});
+  load_bytes(chip8, 0x300, {0xFF, 0x0F});
+  ASSERT_TRUE(chip8.run_cycles(5));
+  EXPECT_EQ(lit_in_row(chip8, 63, 0, 128), 8);
+  EXPECT_EQ(lit_in_row(chip8, 62, 0, 128), 0);
+  ASSERT_TRUE(chip8.run_cycles(1));
+  EXPECT_EQ(lit_in_row(chip8, 59, 0, 128), 8);
+  EXPECT_EQ(lit_in_row(chip8, 63, 0, 128), 0);
+}
+
+TEST(ExtendedChip8Test, XoChipWrapsSpritesAndSuperChipClipsThem) {
+  // 00FF; V0 = 124; V1 = 63; I = 0x300; D012
+  const std::initializer_list<uint16_t> program = {0x00FF, 0x607C, 0x613F,
+                                                   0xA300, 0xD012};
+  SuperChip schip;
+  load_words(schip, program);
+  load_bytes(schip, 0x300, {0xFF, 0xFF});
+  ASSERT_TRUE(schip.run_cycles(5));
+  EXPECT_EQ(lit_in_row(schip, 63, 0, 128), 4);
+  EXPECT_EQ(lit_in_row(schip, 0, 0, 128), 0);
+
+  XoChip xochip;
+  load_words(xochip, program);
+  load_bytes(xochip, 0x300, {0xFF, 0xFF});
+  ASSERT_TRUE(xochip.run_cycles(5));
+  EXPECT_EQ(lit_in_row(xochip, 63, 0, 128), 8);
+  EXPECT_EQ(lit_in_row(xochip, 63, 0, 4), 4);
+  EXPECT_EQ(lit_in_row(xochip, 0, 0, 128), 8);
+}
+
+TEST(ExtendedChip8Test, PlaneMaskDrawsConsecutiveSpritesOnEachPlane) {
+  XoChip chip8;
+  // 00FF; F301; I = 0x300; D001; F201; 00E0
+  load_words(chip8, {0x00FF, 0xF301, 0xA300, 0xD001, 0xF201, 0x00E0});
+  load_bytes(chip8, 0x300, {0xF0, 0x0F});
+  ASSERT_TRUE(chip8.run_cycles(4));
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 8, 0), 4);
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 8, 1), 4);
+  EXPECT_EQ(chip8.pixel(0, 0, 0), 1u);
+  EXPECT_EQ(chip8.pixel(0, 0, 1), 0u);
+  EXPECT_EQ(chip8.pixel(7, 0, 1), 1u);
+  // Clearing only touches the selected plane.
+  ASSERT_TRUE(chip8.run_cycles(2));
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 8, 0), 4);
+  EXPECT_EQ(lit_in_row(chip8, 0, 0, 8, 1), 0);
+}
+
+TEST(ExtendedChip8Test, LongIndexLoadIsSkippedWhole) {
+  XoChip chip8;
+  // 3000 (skip, V0 is 0); F000 1234; F000 ABCD
+  load_words(chip8, {0x3000, 0xF000, 0x1234, 0xF000, 0xABCD});
+  ASSERT_TRUE(chip8.run_cycles(2));
+  EXPECT_EQ(chip8.index_register_, 0xABCDu);
+  EXPECT_EQ(chip8.program_counter_, 0x20Au);
+}
+
+TEST(ExtendedChip8Test, SavesAndLoadsRegisterRangesAndFlags) {
+  XoChip chip8;
+  // V1 = 1; V2 = 2; V3 = 3; I = 0x400; 5312; V3 = 0; 5133; F375; V1 = 0;
+  // F185
+  load_words(chip8, {0x6101, 0x6202, 0x6303, 0xA400, 0x5312, 0x6300,
+                     0x5133, 0xF375, 0x6100, 0xF185});
+  ASSERT_TRUE(chip8.run_cycles(5));
+  // Saved from V3 down to V1.
+  EXPECT_EQ(chip8.memory_[0x400], std::byte{3});
+  EXPECT_EQ(chip8.memory_[0x402], std::byte{1});
+  EXPECT_EQ(chip8.index_register_, 0x400u);
+  ASSERT_TRUE(chip8.run_cycles(2));
+  EXPECT_EQ(chip8.registers_[3], 1u);
+  EXPECT_EQ(chip8.registers_[1], 3u);
+  ASSERT_TRUE(chip8.run_cycles(3));
+  EXPECT_EQ(chip8.flags_[3], 1u);
+  EXPECT_EQ(chip8.registers_[1], 3u);
+}
+
+TEST(ExtendedChip8Test, BigFontAndExit) {
+  SuperChip chip8;
+  // V0 = 7; F030; 00FD; V0 = 1
+  load_words(chip8, {0x6007, 0xF030, 0x00FD, 0x6001});
+  ASSERT_TRUE(chip8.run_cycles(10));
+  EXPECT_EQ(chip8.index_register_, SuperChip::k_big_font_address + 70u);
+  EXPECT_TRUE(chip8.exited_);
+  EXPECT_EQ(chip8.registers_[0], 7u);
+  EXPECT_EQ(chip8.instructions_executed_, 3u);
+}
+
+TEST(ExtendedChip8Test, SuperChipRejectsXoChipOpcodes) {
+  SuperChip chip8;
+  load_words(chip8, {0xF301});
+  common::Status status = chip8.run_cycles(1);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(chip8.fault_.kind, FaultKind::InvalidOpcode);
+  EXPECT_EQ(chip8.fault_.opcode, 0xF301u);
+}
+
+} // namespace chip8
@@ -0,0 +1,125 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#endif
+
+namespace chip8 {
+namespace {
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+void sleep_until(FramePacer::clock::time_point deadline) {
+#if defined(__linux__)
+  // libstdc++ and libc++ both build steady_clock on CLOCK_MONOTONIC, so its
+  // epoch is the one clock_nanosleep expects.
+  auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      deadline.time_since_epoch());
+  timespec ts;
+  ts.tv_sec = static_cast<time_t>(since_epoch.count() / 1'000'000'000);
+  ts.tv_nsec = static_cast<long>(since_epoch.count() % 1'000'000'000);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+         EINTR) {
+  }
+#else
+  std::this_thread::sleep_until(deadline);
+#endif
+}
+
+} // namespace
+
+void JitterHistogram::record(std::chrono::nanoseconds lateness) {
+  lateness = std::max(lateness, std::chrono::nanoseconds(0));
+  auto bucket = std::chrono::duration_cast<std::chrono::microseconds>(lateness)
+                    .count();
+  buckets_[std::min<int64_t>(bucket, k_buckets - 1)]++;
+  count_++;
+  max_ = std::max(max_, lateness);
+}
+
+int JitterHistogram::percentile_us(double fraction) const {
+  if (count_ == 0u) {
+    return 0;
+  }
+  uint64_t target = std::max<uint64_t>(
+      1u, static_cast<uint64_t>(std::ceil(fraction * count_)));
+  uint64_t seen = 0u;
+  for (int bucket = 0; bucket < k_buckets; bucket++) {
+    seen += buckets_[bucket];
+    if (seen >= target) {
+      return bucket;
+    }
+  }
+  return k_buckets - 1;
+}
+
+void JitterHistogram::write_csv(std::ostream &os) const {
+  os << "lateness_us,frames\n";
+  for (int bucket = 0; bucket < k_buckets; bucket++) {
+    if (buckets_[bucket] != 0u) {
+      os << bucket << ',' << buckets_[bucket] << '\n';
+    }
+  }
+}
+
+common::Status JitterHistogram::write(const std::filesystem::path &path) const {
+  std::ofstream file(path);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError, "Unable to open " + path.string()});
+  }
+  write_csv(file);
+  return {};
+}
+
+FramePacer::FramePacer(clock::duration period, clock::duration spin)
+    : period_(period), spin_(spin), deadline_(clock::now()) {}
+
+void FramePacer::wait() {
+  deadline_ += period_;
+  clock::time_point now = clock::now();
+  if (now - deadline_ > k_max_frames_behind * period_) {
+    skipped_frames_ += (now - deadline_) / period_;
+    deadline_ = now;
+    return;
+  }
+  if (deadline_ - now > spin_) {
+    sleep_until(deadline_ - spin_);
+  }
+  while ((now = clock::now()) < deadline_) {
+    cpu_relax();
+  }
+  jitter_.record(now - deadline_);
+}
+
+void FramePacer::reset() { deadline_ = clock::now(); }
+
+bool SpeedMeter::add(uint64_t cycles, clock::time_point now) {
+  if (!window_start_) {
+    window_start_ = now;
+  }
+  cycles_ += cycles;
+  const clock::duration elapsed = now - *window_start_;
+  if (elapsed < window_) {
+    return false;
+  }
+  cycles_per_second_ =
+      cycles_ / std::chrono::duration<double>(elapsed).count();
+  window_start_ = now;
+  cycles_ = 0u;
+  return true;
+}
+
+} // namespace chip8
@@ -0,0 +1,97 @@
+#ifndef SRC_FRAME_PACER_H
+#define SRC_FRAME_PACER_H
+
+#include "app_error.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+
+namespace chip8 {
+
+// How late each frame woke up relative to its deadline, in 1 µs buckets.
+// The last bucket also holds everything later than that.
+class JitterHistogram {
+public:
+  static constexpr int k_buckets = 1000;
+
+  void record(std::chrono::nanoseconds lateness);
+  uint64_t count() const { return count_; }
+  std::chrono::nanoseconds max() const { return max_; }
+  // The smallest bucket (in µs) at or below which `fraction` of the samples
+  // fall, e.g. percentile_us(0.99) for p99.
+  int percentile_us(double fraction) const;
+
+  // One "lateness_us,frames" line per non-empty bucket.
+  void write_csv(std::ostream &os) const;
+  common::Status write(const std::filesystem::path &path) const;
+
+private:
+  std::array<uint64_t, k_buckets> buckets_ = {};
+  uint64_t count_ = 0u;
+  std::chrono::nanoseconds max_{0};
+};
+
+// Holds a loop to a fixed period on steady_clock. Deadlines are absolute
+// (each is the previous one plus the period), so a late frame is made up on
+// the next ones instead of drifting. wait() sleeps until `spin` before the
+// deadline (clock_nanosleep with TIMER_ABSTIME on Linux) and busy-waits the
+// rest, which absorbs the scheduler's wake-up overshoot.
+class FramePacer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::microseconds k_default_spin{500};
+  // Falling further behind than this (a debugger stop, a suspended laptop)
+  // skips the missed frames instead of running them back to back.
+  static constexpr int k_max_frames_behind = 4;
+
+  explicit FramePacer(clock::duration period,
+                      clock::duration spin = k_default_spin);
+
+  // Blocks until the next deadline and records how late it returned.
+  void wait();
+  // Starts a fresh schedule one period from now.
+  void reset();
+
+  // The deadline wait() last returned at: when the current frame started.
+  clock::time_point deadline() const { return deadline_; }
+  const JitterHistogram &jitter() const { return jitter_; }
+  uint64_t skipped_frames() const { return skipped_frames_; }
+
+private:
+  clock::duration period_;
+  clock::duration spin_;
+  clock::time_point deadline_;
+  JitterHistogram jitter_;
+  uint64_t skipped_frames_ = 0u;
+};
+
+// Emulated cycles per host second, averaged over a fixed window of host
+// time, for the turbo readout.
+class SpeedMeter {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds k_default_window{500};
+
+  explicit SpeedMeter(clock::duration window = k_default_window)
+      : window_(window) {}
+
+  // Counts `cycles` run up to `now`. Returns true when a window closed and
+  // cycles_per_second() has a new value.
+  bool add(uint64_t cycles, clock::time_point now);
+  double cycles_per_second() const { return cycles_per_second_; }
+
+private:
+  clock::duration window_;
+  std::optional<clock::time_point> window_start_;
+  uint64_t cycles_ = 0u;
+  double cycles_per_second_ = 0.0;
+};
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,67 @@
+#include "src/frame_pacer.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+namespace chip8 {
+
+using namespace std::chrono_literals;
+
+TEST(JitterHistogramTest, PercentilesAndOverflowBucket) {
+  JitterHistogram histogram;
+  for (int i = 0; i < 98; i++) {
+    histogram.record(std::chrono::nanoseconds(3'400));
+  }
+  histogram.record(50us);
+  histogram.record(5ms);
+  EXPECT_EQ(histogram.count(), 100u);
+  EXPECT_EQ(histogram.percentile_us(0.5), 3);
+  EXPECT_EQ(histogram.percentile_us(0.99), 50);
+  EXPECT_EQ(histogram.percentile_us(1.0), JitterHistogram::k_buckets - 1);
+  EXPECT_EQ(histogram.max(), 5ms);
+
+  std::ostringstream csv;
+  histogram.write_csv(csv);
+  EXPECT_EQ(csv.str(), "lateness_us,frames\n3,98\n50,1\n999,1\n");
+}
+
+TEST(FramePacerTest, HoldsThePeriodWithoutDrift) {
+  constexpr int k_frames = 50;
+  FramePacer pacer(2ms);
+  auto start = FramePacer::clock::now();
+  for (int i = 0; i < k_frames; i++) {
+    pacer.wait();
+  }
+  auto elapsed = FramePacer::clock::now() - start;
+  EXPECT_GE(elapsed, k_frames * 2ms);
+  EXPECT_LT(elapsed, k_frames * 2ms + 5ms);
+  EXPECT_EQ(pacer.jitter().count(), static_cast<uint64_t>(k_frames));
+}
+
+TEST(FramePacerTest, SkipsFramesAfterALongStall) {
+  FramePacer pacer(1ms);
+  pacer.wait();
+  std::this_thread::sleep_for(20ms);
+  pacer.wait();
+  EXPECT_GE(pacer.skipped_frames(), 15u);
+  // Back on schedule: the next wait is a full period, not a burst.
+  auto before = FramePacer::clock::now();
+  pacer.wait();
+  EXPECT_GE(FramePacer::clock::now() - before, 900us);
+}
+
+TEST(SpeedMeterTest, AveragesOverTheWindow) {
+  SpeedMeter meter(100ms);
+  const SpeedMeter::clock::time_point start{};
+  EXPECT_FALSE(meter.add(0u, start));
+  EXPECT_FALSE(meter.add(50'000u, start + 60ms));
+  EXPECT_TRUE(meter.add(50'000u, start + 100ms));
+  EXPECT_DOUBLE_EQ(meter.cycles_per_second(), 1'000'000.0);
+  // A new window starts where the last one closed.
+  EXPECT_FALSE(meter.add(600u, start + 150ms));
+  EXPECT_TRUE(meter.add(600u, start + 300ms));
+  EXPECT_DOUBLE_EQ(meter.cycles_per_second(), 6'000.0);
+}
+
+} // namespace chip8
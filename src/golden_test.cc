@@ -0,0 +1,207 @@
+#include "src/aot_program.h"
+#include "src/chip8.h"
+#include "src/headless.h"
+#include "src/profiler.h"
+#include "src/recompiler.h"
+#include "src/rom_image.h"
+#include "src/work_stealing_pool.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the Timendus test-suite ROMs headless on every backend and compares
+// hashes of the display at fixed frames against
+// src/testdata/golden_frames.txt.
+//
+// After an intended behaviour change, regenerate the goldens from the table
+// interpreter with
+//   CHIP8_UPDATE_GOLDENS=$PWD/src/testdata/golden_frames.txt bazel run src:golden_test
+namespace chip8 {
+namespace {
+
+constexpr std::array<const char *, 7> k_roms = {
+    "1-chip8-logo", "2-ibm-logo", "3-corax+", "4-flags",
+    "5-quirks",     "6-keypad",   "7-beep",
+};
+constexpr std::array<int, 5> k_checkpoints = {30, 60, 120, 240, 480};
+constexpr uint64_t k_seed = 1u;
+
+using Hashes = std::vector<uint64_t>;
+
+std::filesystem::path rom_directory() {
+  if (const char *dir = std::getenv("CHIP8_ROM_DIR")) {
+    return dir;
+  }
+  return "roms";
+}
+
+// Loads `rom` into a fresh Machine and returns hash_display() at each
+// checkpoint, running every frame through `run_frame`.
+template <typename Machine, typename RunFrame>
+common::StatusOr<Hashes> run_rom(const std::string &rom, RunFrame run_frame) {
+  Machine chip8;
+  common::Status status = chip8.load_rom(rom_directory() / (rom + ".ch8"));
+  if (!status)
+    return std::unexpected(status.error());
+  chip8.seed_random(k_seed);
+  Hashes hashes;
+  int frame = 0;
+  for (int checkpoint : k_checkpoints) {
+    for (; frame < checkpoint; frame++) {
+      status = run_frame(chip8);
+      if (!status)
+        return std::unexpected(status.error());
+    }
+    hashes.push_back(hash_display(chip8));
+  }
+  return hashes;
+}
+
+struct Backend {
+  const char *name;
+  std::function<common::StatusOr<Hashes>(const std::string &)> run;
+};
+
+const std::array<Backend, 6> k_backends = {{
+    {"table",
+     [](const std::string &rom) {
+       return run_rom<Chip8>(
+           rom, [](Chip8 &chip8) { return run_headless_frame(chip8); });
+     }},
+    {"threaded",
+     [](const std::string &rom) {
+       return run_rom<Chip8>(rom, [](Chip8 &chip8) -> common::Status {
+         NoProfiler profiler;
+         common::Status status =
+             chip8.run_cycles_threaded(k_default_cycles_per_frame, profiler);
+         if (!status)
+           return status;
+         chip8.decrement_timers();
+         chip8.redraw_ = false;
+         return {};
+       });
+     }},
+    {"packed",
+     [](const std::string &rom) {
+       return run_rom<PackedChip8>(rom, [](PackedChip8 &chip8) {
+         return run_headless_frame(chip8);
+       });
+     }},
+    {"unchecked",
+     [](const std::string &rom) {
+       using Machine = BasicChip8<CosmacVipQuirks, Unchecked>;
+       return run_rom<Machine>(
+           rom, [](Machine &chip8) { return run_headless_frame(chip8); });
+     }},
+    {"recompiler",
+     [](const std::string &rom) {
+       Recompiler recompiler;
+       return run_rom<Chip8>(rom, [&recompiler](Chip8 &chip8) {
+         return run_headless_frame(chip8, recompiler);
+       });
+     }},
+    {"aot",
+     [](const std::string &rom) -> common::StatusOr<Hashes> {
+       common::StatusOr<RomImage> image =
+           RomImage::open(rom_directory() / (rom + ".ch8"));
+       if (!image)
+         return std::unexpected(image.error());
+       const AotProgram<Chip8> *program =
+           find_aot_program<Chip8>(image->bytes());
+       if (program == nullptr)
+         return std::unexpected(common::AppError{
+             common::ErrorCode::NotFound,
+             rom + " has no chip8_aot_library in AOT_TEST_SUITE"});
+       return run_rom<Chip8>(rom, [program](Chip8 &chip8) {
+         return run_headless_frame(chip8, *program);
+       });
+     }},
+}};
+
+// One "<rom> <frame> <hash>" line per checkpoint; '#' starts a comment.
+std::map<std::string, Hashes> read_goldens(const std::filesystem::path &path) {
+  std::map<std::string, Hashes> goldens;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string rom;
+    int frame = 0;
+    uint64_t hash = 0u;
+    if (fields >> rom >> frame >> std::hex >> hash) {
+      goldens[rom].push_back(hash);
+    }
+  }
+  return goldens;
+}
+
+void write_goldens(const std::filesystem::path &path,
+                   const std::vector<Hashes> &hashes) {
+  std::ofstream file(path);
+  file << "# hash_display() of each Timendus ROM at fixed frames on the table\n"
+          "# interpreter (COSMAC VIP quirks, RNG seed "
+       << k_seed << "). Regenerate as described in\n# src/golden_test.cc.\n";
+  for (size_t rom = 0; rom < k_roms.size(); rom++) {
+    for (size_t i = 0; i < k_checkpoints.size(); i++) {
+      file << k_roms[rom] << ' ' << k_checkpoints[i] << ' ' << std::hex
+           << std::setw(16) << std::setfill('0') << hashes[rom][i] << std::dec
+           << '\n';
+    }
+  }
+}
+
+TEST(GoldenFrameTest, EveryBackendMatchesGoldens) {
+  // Every (ROM, backend) pair is independent, so run them all at once.
+  const size_t num_tasks = k_roms.size() * k_backends.size();
+  std::vector<common::StatusOr<Hashes>> results(num_tasks);
+  common::WorkStealingPool pool(
+      std::max(1u, std::thread::hardware_concurrency()));
+  pool.run(num_tasks, [&](size_t task) {
+    results[task] = k_backends[task % k_backends.size()].run(
+        k_roms[task / k_backends.size()]);
+  });
+
+  std::map<std::string, Hashes> goldens =
+      read_goldens("src/testdata/golden_frames.txt");
+  if (const char *update = std::getenv("CHIP8_UPDATE_GOLDENS")) {
+    std::vector<Hashes> reference;
+    for (size_t rom = 0; rom < k_roms.size(); rom++) {
+      const common::StatusOr<Hashes> &result =
+          results[rom * k_backends.size()];
+      ASSERT_TRUE(result.has_value()) << k_roms[rom] << ": " << result.error();
+      reference.push_back(*result);
+      goldens[k_roms[rom]] = *result;
+    }
+    write_goldens(update, reference);
+  }
+
+  for (size_t task = 0; task < num_tasks; task++) {
+    const std::string rom = k_roms[task / k_backends.size()];
+    const char *backend = k_backends[task % k_backends.size()].name;
+    const common::StatusOr<Hashes> &result = results[task];
+    ASSERT_TRUE(result.has_value())
+        << rom << " on " << backend << ": " << result.error();
+    ASSERT_EQ(goldens[rom].size(), k_checkpoints.size())
+        << "no goldens for " << rom;
+    for (size_t i = 0; i < k_checkpoints.size(); i++) {
+      EXPECT_EQ((*result)[i], goldens[rom][i])
+          << rom << " on " << backend << " at frame " << k_checkpoints[i];
+    }
+  }
+}
+
+} // namespace
+} // namespace chip8
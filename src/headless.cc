@@ -0,0 +1,74 @@
+#include "headless.h"
+#include "app_error.h"
+#include "recompiler.h"
+
+namespace chip8 {
+
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+run_headless_frame(BasicChip8<Quirks, Checking, Display> &chip8,
+                   int cycles_per_frame) {
+  common::Status status = chip8.run_cycles(cycles_per_frame);
+  if (!status)
+    return status;
+  chip8.decrement_timers();
+  chip8.redraw_ = false;
+  return {};
+}
+
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+run_headless_frame(BasicChip8<Quirks, Checking, Display> &chip8,
+                   CycleScheduler &scheduler) {
+  common::Status status = chip8.run_machine_cycles(scheduler.begin_frame());
+  if (!status)
+    return status;
+  chip8.decrement_timers();
+  chip8.redraw_ = false;
+  return {};
+}
+
+#define CHIP8_INSTANTIATE(Quirks, Checking, Display)                           \
+  template common::Status run_headless_frame(                                  \
+      BasicChip8<Quirks, Checking, Display> &, int);                           \
+  template common::Status run_headless_frame(                                  \
+      BasicChip8<Quirks, Checking, Display> &, CycleScheduler &);
+
+CHIP8_INSTANTIATE(CosmacVipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Unchecked, PackedDisplay)
+
+#undef CHIP8_INSTANTIATE
+
+common::Status run_headless_frame(Chip8 &chip8, Recompiler &recompiler,
+                                  int cycles_per_frame) {
+  common::Status status = recompiler.run(chip8, cycles_per_frame);
+  if (!status)
+    return status;
+  chip8.decrement_timers();
+  chip8.redraw_ = false;
+  return {};
+}
+
+uint64_t hash_display(const Chip8State &chip8) {
+  uint64_t hash = 0xCBF29CE484222325u;
+  for (int y = 0; y < 32; y++) {
+    uint64_t row = chip8.display_row(y);
+    for (int byte = 0; byte < 8; byte++) {
+      hash ^= (row >> (56 - 8 * byte)) & 0xFFu;
+      hash *= 0x100000001B3u;
+    }
+  }
+  return hash;
+}
+
+} // namespace chip8
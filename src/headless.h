@@ -0,0 +1,41 @@
+#ifndef SRC_HEADLESS_H
+#define SRC_HEADLESS_H
+
+#include "app_error.h"
+#include "chip8.h"
+#include "recompiler.h"
+#include "vip_timing.h"
+#include <cstdint>
+
+namespace chip8 {
+
+constexpr int k_default_cycles_per_frame = 10;
+
+// Emulates one 60 Hz frame with no audio, video or frame pacing: runs
+// `cycles_per_frame` cycles, ticks the timers and treats any pending redraw
+// as presented so the next frame is not stalled on it.
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+run_headless_frame(BasicChip8<Quirks, Checking, Display> &chip8,
+                   int cycles_per_frame = k_default_cycles_per_frame);
+
+// Same as above on the VIP timing model: runs the machine cycles `scheduler`
+// grants the frame, carrying any overrun into the next one.
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+run_headless_frame(BasicChip8<Quirks, Checking, Display> &chip8,
+                   CycleScheduler &scheduler);
+
+// Same as the first, but runs the cycles through `recompiler` (COSMAC VIP
+// quirks only).
+common::Status run_headless_frame(Chip8 &chip8, Recompiler &recompiler,
+                                  int cycles_per_frame =
+                                      k_default_cycles_per_frame);
+
+// 64-bit FNV-1a over display_row() for every row, so a picture hashes the
+// same on both framebuffer layouts.
+uint64_t hash_display(const Chip8State &chip8);
+
+} // namespace chip8
+
+#endif
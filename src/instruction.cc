@@ -0,0 +1,132 @@
+#include "instruction.h"
+
+#include <array>
+
+namespace chip8 {
+namespace {
+
+// Indexed by Op.
+constexpr std::array<std::string_view, k_num_ops> k_op_names = {
+#define CHIP8_OP_PATTERN(name, pattern) pattern,
+    CHIP8_OPS(CHIP8_OP_PATTERN)
+#undef CHIP8_OP_PATTERN
+};
+
+constexpr std::array<std::string_view, k_num_ops> k_op_enumerators = {
+#define CHIP8_OP_NAME(name, pattern) #name,
+    CHIP8_OPS(CHIP8_OP_NAME)
+#undef CHIP8_OP_NAME
+};
+
+Op decode_op(uint8_t b1, uint8_t b2) {
+  switch (b1 >> 4u) {
+  case 0x0u:
+    if (b1 == 0x00u && b2 == 0xE0u)
+      return Op::Cls;
+    if (b1 == 0x00u && b2 == 0xEEu)
+      return Op::Ret;
+    return Op::Sys;
+  case 0x1u:
+    return Op::Jp;
+  case 0x2u:
+    return Op::Call;
+  case 0x3u:
+    return Op::SeVxKk;
+  case 0x4u:
+    return Op::SneVxKk;
+  case 0x5u:
+    return Op::SeVxVy;
+  case 0x6u:
+    return Op::LdVxKk;
+  case 0x7u:
+    return Op::AddVxKk;
+  case 0x8u:
+    switch (b2 & 0x0Fu) {
+    case 0x0u:
+      return Op::LdVxVy;
+    case 0x1u:
+      return Op::Or;
+    case 0x2u:
+      return Op::And;
+    case 0x3u:
+      return Op::Xor;
+    case 0x4u:
+      return Op::AddVxVy;
+    case 0x5u:
+      return Op::Sub;
+    case 0x6u:
+      return Op::Shr;
+    case 0x7u:
+      return Op::Subn;
+    case 0xEu:
+      return Op::Shl;
+    default:
+      return Op::InvalidRegisterOp;
+    }
+  case 0x9u:
+    return Op::SneVxVy;
+  case 0xAu:
+    return Op::LdI;
+  case 0xBu:
+    return Op::JpV0;
+  case 0xCu:
+    return Op::Rnd;
+  case 0xDu:
+    return Op::Drw;
+  case 0xEu:
+    switch (b2) {
+    case 0x9Eu:
+      return Op::Skp;
+    case 0xA1u:
+      return Op::Sknp;
+    default:
+      return Op::InvalidKeyOp;
+    }
+  default:
+    switch (b2) {
+    case 0x07u:
+      return Op::LdVxDt;
+    case 0x0Au:
+      return Op::LdVxK;
+    case 0x15u:
+      return Op::LdDtVx;
+    case 0x18u:
+      return Op::LdStVx;
+    case 0x1Eu:
+      return Op::AddIVx;
+    case 0x29u:
+      return Op::LdFVx;
+    case 0x33u:
+      return Op::LdBVx;
+    case 0x55u:
+      return Op::LdIVx;
+    case 0x65u:
+      return Op::LdVxI;
+    default:
+      return Op::InvalidFOp;
+    }
+  }
+}
+
+} // namespace
+
+Instruction decode(uint8_t b1, uint8_t b2) {
+  return Instruction{
+      .op = decode_op(b1, b2),
+      .x = static_cast<uint8_t>(b1 & 0x0Fu),
+      .y = static_cast<uint8_t>((b2 & 0xF0u) >> 4u),
+      .n = static_cast<uint8_t>(b2 & 0x0Fu),
+      .kk = b2,
+      .nnn = static_cast<uint16_t>(((b1 & 0x0Fu) << 8u) | b2),
+  };
+}
+
+std::string_view op_name(Op op) {
+  return k_op_names[static_cast<size_t>(op)];
+}
+
+std::string_view op_enumerator(Op op) {
+  return k_op_enumerators[static_cast<size_t>(op)];
+}
+
+} // namespace chip8
@@ -0,0 +1,86 @@
+#ifndef SRC_INSTRUCTION_H
+#define SRC_INSTRUCTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace chip8 {
+
+// Every distinct instruction form, with sub-opcodes (8xy4 vs 8xyE, Fx33 vs
+// Fx55, ...) resolved, as X(enumerator, opcode pattern) in declaration
+// order. Everything indexed by Op (the enum, op_name(), op_enumerator(),
+// the threaded core's label table) is generated from this one list.
+// `Undecoded` marks an empty decode cache slot.
+#define CHIP8_OPS(X)           \
+  X(Undecoded, "undecoded")    \
+  X(Sys, "0nnn")               \
+  X(Cls, "00E0")               \
+  X(Ret, "00EE")               \
+  X(Jp, "1nnn")                \
+  X(Call, "2nnn")              \
+  X(SeVxKk, "3xkk")            \
+  X(SneVxKk, "4xkk")           \
+  X(SeVxVy, "5xy0")            \
+  X(LdVxKk, "6xkk")            \
+  X(AddVxKk, "7xkk")           \
+  X(LdVxVy, "8xy0")            \
+  X(Or, "8xy1")                \
+  X(And, "8xy2")               \
+  X(Xor, "8xy3")               \
+  X(AddVxVy, "8xy4")           \
+  X(Sub, "8xy5")               \
+  X(Shr, "8xy6")               \
+  X(Subn, "8xy7")              \
+  X(Shl, "8xyE")               \
+  X(SneVxVy, "9xy0")           \
+  X(LdI, "Annn")               \
+  X(JpV0, "Bnnn")              \
+  X(Rnd, "Cxkk")               \
+  X(Drw, "Dxyn")               \
+  X(Skp, "Ex9E")               \
+  X(Sknp, "ExA1")              \
+  X(LdVxDt, "Fx07")            \
+  X(LdVxK, "Fx0A")             \
+  X(LdDtVx, "Fx15")            \
+  X(LdStVx, "Fx18")            \
+  X(AddIVx, "Fx1E")            \
+  X(LdFVx, "Fx29")             \
+  X(LdBVx, "Fx33")             \
+  X(LdIVx, "Fx55")             \
+  X(LdVxI, "Fx65")             \
+  X(InvalidRegisterOp, "8xy?") \
+  X(InvalidKeyOp, "Ex??")      \
+  X(InvalidFOp, "Fx??")
+
+enum class Op : uint8_t {
+#define CHIP8_OP_ENUMERATOR(name, pattern) name,
+  CHIP8_OPS(CHIP8_OP_ENUMERATOR)
+#undef CHIP8_OP_ENUMERATOR
+  Count
+};
+
+constexpr size_t k_num_ops = static_cast<size_t>(Op::Count);
+
+// An instruction with its operands pre-extracted, cached per address so the
+// hot loop never re-decodes.
+struct Instruction {
+  Op op = Op::Undecoded;
+  uint8_t x = 0u;
+  uint8_t y = 0u;
+  uint8_t n = 0u;
+  uint8_t kk = 0u;
+  uint16_t nnn = 0u;
+};
+
+Instruction decode(uint8_t b1, uint8_t b2);
+
+// The opcode pattern for `op`, e.g. "8xy4". Invalid forms use '?' for the
+// unmatched nibbles ("Fx??").
+std::string_view op_name(Op op);
+// The enumerator spelling of `op`, e.g. "AddVxVy", for generated code.
+std::string_view op_enumerator(Op op);
+
+} // namespace chip8
+
+#endif
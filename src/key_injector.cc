@@ -0,0 +1,73 @@
+#include "key_injector.h"
+
+namespace chip8 {
+
+KeyInjector::KeyInjector(clock::duration frame_period, int cycles_per_frame)
+    : frame_period_(frame_period), cycles_per_frame_(cycles_per_frame) {
+  release_at_.fill(k_no_release);
+}
+
+KeyInjector::KeyInjector(clock::duration frame_period,
+                         CycleScheduler &scheduler)
+    : KeyInjector(frame_period, 0) {
+  scheduler_ = &scheduler;
+}
+
+int KeyInjector::cycle_for(clock::time_point time, clock::time_point start,
+                           clock::time_point end) const {
+  if (time <= start || end <= start) {
+    return 0;
+  }
+  const int64_t cycle = (time - start) * cycles_per_frame_ / (end - start);
+  return static_cast<int>(std::min<int64_t>(cycle, cycles_per_frame_ - 1));
+}
+
+void KeyInjector::skip_frame(KeypadState &chip8, KeyQueue &keys,
+                             clock::time_point window_end) {
+  window_start_ = window_end;
+  for (uint8_t key = 0; key < k_num_keys; key++) {
+    if (release_at_[key] != k_no_release) {
+      release(chip8, key, 0, nullptr);
+    }
+  }
+  const KeyEvent *event;
+  while ((event = keys.front()) != nullptr && event->time < window_end) {
+    // Nothing runs to observe a tap, so releases are not held back here.
+    if (event->key < k_num_keys) {
+      release_at_[event->key] = k_no_release;
+    }
+    chip8.set_key(event->key, event->pressed);
+    keys.pop();
+  }
+}
+
+void KeyInjector::apply(KeypadState &chip8, const KeyEvent &event,
+                        int frame_cycle, InputRecorder *recorder) {
+  if (event.key < k_num_keys) {
+    if (event.pressed) {
+      // A press cancels any held-back release; the key just stays down.
+      release_at_[event.key] = k_no_release;
+      pressed_at_[event.key] = cycles_run_;
+    } else if (chip8.keypad_[event.key] == 1u &&
+               cycles_run_ < pressed_at_[event.key] + cycles_per_frame_) {
+      release_at_[event.key] = pressed_at_[event.key] + cycles_per_frame_;
+      return;
+    }
+  }
+  chip8.set_key(event.key, event.pressed);
+  if (recorder != nullptr) {
+    recorder->record(event.key, event.pressed,
+                     static_cast<uint16_t>(frame_cycle));
+  }
+}
+
+void KeyInjector::release(KeypadState &chip8, uint8_t key, int frame_cycle,
+                          InputRecorder *recorder) {
+  release_at_[key] = k_no_release;
+  chip8.set_key(key, false);
+  if (recorder != nullptr) {
+    recorder->record(key, false, static_cast<uint16_t>(frame_cycle));
+  }
+}
+
+} // namespace chip8
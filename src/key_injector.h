@@ -0,0 +1,168 @@
+#ifndef SRC_KEY_INJECTOR_H
+#define SRC_KEY_INJECTOR_H
+
+#include "app_error.h"
+#include "chip8.h"
+#include "recording.h"
+#include "spsc_queue.h"
+#include "vip_timing.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace chip8 {
+
+// A key transition from the frontend, stamped with the host time it
+// happened at so the emulation thread can apply it at the matching cycle.
+struct KeyEvent {
+  uint8_t key = k_unmapped_key;
+  bool pressed = false;
+  std::chrono::steady_clock::time_point time = {};
+};
+
+// Frontend thread to emulation thread.
+using KeyQueue = common::SpscQueue<KeyEvent, 256>;
+
+// Replays timestamped key events inside emulated frames. Each frame stands
+// for the host time since the previous one (its window): an event stamped
+// 35% of the way through the window is applied before 35% of the frame's
+// cycles have run, so input lags by one frame but keeps its spacing. Events
+// stamped after the window stay queued for the next frame.
+//
+// A release is held back until the key has been down for a whole frame of
+// cycles, so a tap shorter than a frame is still seen by games that poll the
+// keypad once per frame with Ex9E/ExA1, and by Fx0A.
+class KeyInjector {
+public:
+  using clock = std::chrono::steady_clock;
+
+  KeyInjector(clock::duration frame_period, int cycles_per_frame);
+  // Runs frames on the VIP timing model instead: each frame takes its
+  // machine-cycle budget from `scheduler`, and cycles below count machine
+  // cycles rather than instructions.
+  KeyInjector(clock::duration frame_period, CycleScheduler &scheduler);
+
+  // Runs one frame's cycles on `chip8` (without ticking the timers), applying
+  // the events in `keys` stamped before `window_end` and logging each applied
+  // transition to `recorder` if set. Recordings count instructions, so an
+  // injector with a scheduler refuses a recorder with InvalidArgument.
+  template <typename Machine, typename Profiler>
+  common::Status run_frame(Machine &chip8, KeyQueue &keys,
+                           clock::time_point window_end, Profiler &profiler,
+                           InputRecorder *recorder = nullptr);
+
+  // For a frame that does not emulate (e.g. rewind): applies the events
+  // stamped before `window_end` and any held-back release at once.
+  void skip_frame(KeypadState &chip8, KeyQueue &keys,
+                  clock::time_point window_end);
+
+  // The cycle of a frame spanning [start, end) an event at `time` is applied
+  // before, clamped to the frame.
+  int cycle_for(clock::time_point time, clock::time_point start,
+                clock::time_point end) const;
+
+private:
+  static constexpr uint64_t k_no_release = std::numeric_limits<uint64_t>::max();
+
+  // Applies `event` before cycle `frame_cycle` of the frame (cycles_run_
+  // overall), or holds back its release.
+  void apply(KeypadState &chip8, const KeyEvent &event, int frame_cycle,
+             InputRecorder *recorder);
+  void release(KeypadState &chip8, uint8_t key, int frame_cycle,
+               InputRecorder *recorder);
+  // Runs `cycles` instructions, or machine cycles with a scheduler.
+  template <typename Machine, typename Profiler>
+  common::Status run_cycles(Machine &chip8, int cycles, Profiler &profiler);
+
+  clock::duration frame_period_;
+  int cycles_per_frame_;
+  CycleScheduler *scheduler_ = nullptr;
+  std::optional<clock::time_point> window_start_;
+  // Cycles run by every frame so far.
+  uint64_t cycles_run_ = 0u;
+  std::array<uint64_t, k_num_keys> pressed_at_ = {};
+  // Cycle a held-back release is due before, or k_no_release.
+  std::array<uint64_t, k_num_keys> release_at_;
+};
+
+template <typename Machine, typename Profiler>
+common::Status KeyInjector::run_frame(Machine &chip8, KeyQueue &keys,
+                                      clock::time_point window_end,
+                                      Profiler &profiler,
+                                      InputRecorder *recorder) {
+  if (scheduler_ != nullptr && recorder != nullptr) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Input cannot be recorded on the VIP timing model"});
+  }
+  const clock::time_point window_start =
+      window_start_.value_or(window_end - frame_period_);
+  window_start_ = window_end;
+  if (scheduler_ != nullptr) {
+    cycles_per_frame_ = scheduler_->next_frame_cycles();
+  }
+  const uint64_t frame_base = cycles_run_;
+  int cycle = 0;
+  while (true) {
+    // The earliest of the next queued event and the next held-back release.
+    int event_cycle = cycles_per_frame_;
+    const KeyEvent *event = keys.front();
+    if (event != nullptr && event->time < window_end) {
+      event_cycle = cycle_for(event->time, window_start, window_end);
+    }
+    int release_cycle = cycles_per_frame_;
+    uint8_t release_key = 0u;
+    for (uint8_t key = 0; key < k_num_keys; key++) {
+      if (release_at_[key] == k_no_release) {
+        continue;
+      }
+      const uint64_t due = release_at_[key] - std::min(release_at_[key],
+                                                       frame_base);
+      if (due < static_cast<uint64_t>(release_cycle)) {
+        release_cycle = static_cast<int>(due);
+        release_key = key;
+      }
+    }
+    const int next = std::max(cycle, std::min(event_cycle, release_cycle));
+    if (next >= cycles_per_frame_) {
+      break;
+    }
+    if (next > cycle) {
+      common::Status status = run_cycles(chip8, next - cycle, profiler);
+      if (!status)
+        return status;
+      cycle = next;
+      cycles_run_ = frame_base + cycle;
+    }
+    if (release_cycle <= event_cycle) {
+      release(chip8, release_key, cycle, recorder);
+    } else {
+      apply(chip8, *event, cycle, recorder);
+      keys.pop();
+    }
+  }
+  common::Status status =
+      run_cycles(chip8, cycles_per_frame_ - cycle, profiler);
+  cycles_run_ = frame_base + cycles_per_frame_;
+  return status;
+}
+
+template <typename Machine, typename Profiler>
+common::Status KeyInjector::run_cycles(Machine &chip8, int cycles,
+                                       Profiler &profiler) {
+  // Only the base cores have a timing model; see ExtendedChip8.
+  if constexpr (requires { chip8.run_machine_cycles(scheduler_->budget()); }) {
+    if (scheduler_ != nullptr) {
+      scheduler_->budget() += cycles;
+      return chip8.run_machine_cycles(scheduler_->budget(), profiler);
+    }
+  }
+  return chip8.run_cycles(cycles, profiler);
+}
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,161 @@
+#include "src/key_injector.h"
+#include "src/chip8.h"
+#include "src/profiler.h"
+#include "src/recording.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <vector>
+
+namespace chip8 {
+
+using namespace std::chrono_literals;
+
+constexpr int k_cycles = 10;
+constexpr auto k_period = 10ms;
+
+class KeyInjectorTest : public ::testing::Test {
+protected:
+  void push(uint8_t key, bool pressed, KeyInjector::clock::duration at) {
+    ASSERT_TRUE(keys.try_push({key, pressed, start + at}));
+  }
+
+  // Runs frame `frame`, whose window is [start + frame * k_period,
+  // start + (frame + 1) * k_period).
+  void run_frame(int frame) {
+    ASSERT_TRUE(injector.run_frame(chip8, keys, start + (frame + 1) * k_period,
+                                   profiler, &recorder));
+    chip8.decrement_timers();
+    recorder.end_frame();
+  }
+
+  Chip8 chip8;
+  KeyQueue keys;
+  NoProfiler profiler;
+  KeyInjector injector{k_period, k_cycles};
+  InputRecorder recorder{CosmacVipQuirks::k_name, 1u, k_cycles};
+  KeyInjector::clock::time_point start = KeyInjector::clock::now();
+};
+
+TEST_F(KeyInjectorTest, MapsTimestampsOntoCycles) {
+  EXPECT_EQ(injector.cycle_for(start, start, start + k_period), 0);
+  EXPECT_EQ(injector.cycle_for(start + 3500us, start, start + k_period), 3);
+  EXPECT_EQ(injector.cycle_for(start + 9999us, start, start + k_period), 9);
+  // Stamped before the window (a late poll) or after it: clamped.
+  EXPECT_EQ(injector.cycle_for(start - 1ms, start, start + k_period), 0);
+  EXPECT_EQ(injector.cycle_for(start + 20ms, start, start + k_period), 9);
+}
+
+TEST_F(KeyInjectorTest, AppliesEventsAtTheirCycleAndKeepsLaterOnesQueued) {
+  load_words(chip8, {0x1200}); // 200: JP 200
+  push(4, true, 3500us);
+  push(5, true, 7200us);
+  push(6, true, 12ms);
+  run_frame(0);
+  EXPECT_EQ(chip8.keypad_[4], 1u);
+  EXPECT_EQ(chip8.keypad_[5], 1u);
+  EXPECT_EQ(chip8.keypad_[6], 0u);
+  run_frame(1);
+  EXPECT_EQ(chip8.keypad_[6], 1u);
+
+  Recording recording = recorder.finish(chip8);
+  EXPECT_EQ(recording.events,
+            (std::vector<InputEvent>{{0u, 3u, 4u, true},
+                                     {0u, 7u, 5u, true},
+                                     {1u, 2u, 6u, true}}));
+}
+
+TEST_F(KeyInjectorTest, TapShorterThanACycleIsSeenByEx9E) {
+  // Sets V1 once key 5 is seen down.
+  std::initializer_list<uint16_t> program = {
+      0x6005, // 200: LD V0, 05
+      0xE09E, // 202: SKP V0
+      0x1202, // 204: JP 202
+      0x6101, // 206: LD V1, 01
+      0x1208, // 208: JP 208
+  };
+  load_words(chip8, program);
+  // Press and release both land before cycle 3; without the hold the key
+  // would be up again before any SKP ran.
+  push(5, true, 3100us);
+  push(5, false, 3300us);
+  run_frame(0);
+  run_frame(1);
+  EXPECT_EQ(chip8.registers_[1], 1u);
+  EXPECT_EQ(chip8.keypad_[5], 0u);
+
+  // The held-back release is recorded where it was applied, so the session
+  // replays to the same display.
+  Recording recording = recorder.finish(chip8);
+  EXPECT_EQ(recording.events, (std::vector<InputEvent>{{0u, 3u, 5u, true},
+                                                       {1u, 3u, 5u, false}}));
+  Chip8 replayed;
+  load_words(replayed, program);
+  EXPECT_TRUE(replay(replayed, recording));
+  EXPECT_EQ(replayed.registers_[1], 1u);
+}
+
+TEST_F(KeyInjectorTest, TapInsideOneFrameCompletesFx0A) {
+  load_words(chip8, {
+                        0xF00A, // 200: LD V0, K
+                        0x1202, // 202: JP 202
+                    });
+  push(9, true, 1ms);
+  push(9, false, 2ms);
+  run_frame(0);
+  EXPECT_EQ(chip8.registers_[0], 9u);
+  EXPECT_TRUE(chip8.waiting_for_key_release_);
+  run_frame(1);
+  EXPECT_FALSE(chip8.waiting_for_key_release_);
+  EXPECT_EQ(chip8.program_counter_, 0x202u);
+}
+
+TEST_F(KeyInjectorTest, PressCancelsAHeldBackRelease) {
+  load_words(chip8, {0x1200}); // 200: JP 200
+  push(2, true, 1ms);
+  push(2, false, 2ms);
+  push(2, true, 3ms);
+  run_frame(0);
+  run_frame(1);
+  EXPECT_EQ(chip8.keypad_[2], 1u);
+}
+
+TEST_F(KeyInjectorTest, SkipFrameAppliesEverythingAtOnce) {
+  load_words(chip8, {0x1200}); // 200: JP 200
+  push(7, true, 1ms);
+  push(7, false, 2ms);
+  run_frame(0);
+  EXPECT_EQ(chip8.keypad_[7], 1u);
+  push(8, true, 11ms);
+  push(8, false, 12ms);
+  injector.skip_frame(chip8, keys, start + 2 * k_period);
+  EXPECT_EQ(chip8.keypad_[7], 0u);
+  EXPECT_EQ(chip8.keypad_[8], 0u);
+  EXPECT_EQ(keys.front(), nullptr);
+}
+
+TEST_F(KeyInjectorTest, SchedulerFramesCountMachineCycles) {
+  load_words(chip8, {0x1200}); // 200: JP 200
+  CycleScheduler scheduler;
+  KeyInjector timed(k_period, scheduler);
+  const int frame_cycles = 3668 - k_vip_interrupt_cycles_per_frame;
+  EXPECT_TRUE(keys.try_push({4, true, start + 5ms}));
+  // Recordings count instructions, not machine cycles.
+  common::Status refused =
+      timed.run_frame(chip8, keys, start + k_period, profiler, &recorder);
+  ASSERT_FALSE(refused);
+  EXPECT_EQ(refused.error().code, common::ErrorCode::InvalidArgument);
+  EXPECT_EQ(chip8.instructions_executed_, 0u);
+
+  ASSERT_TRUE(timed.run_frame(chip8, keys, start + k_period, profiler));
+  EXPECT_EQ(chip8.keypad_[4], 1u);
+  // Halfway through the window is halfway through the machine cycles.
+  EXPECT_EQ(timed.cycle_for(start + 5ms, start, start + k_period),
+            frame_cycles / 2);
+  const int jump = vip_cycles(decode(0x12, 0x00), chip8.registers_);
+  EXPECT_EQ(chip8.instructions_executed_,
+            static_cast<uint64_t>((frame_cycles + jump - 1) / jump));
+  EXPECT_LE(scheduler.budget(), 0);
+}
+
+} // namespace chip8
@@ -1,12 +1,32 @@
 #include <SDL3/SDL.h>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string_view>
 #include <thread>
+#include <vector>
 
+#include "AV_system.h"
 #include "SDL_system.h"
 #include "app_error.h"
+#include "capture.h"
 #include "chip8.h"
+#include "extended_chip8.h"
+#include "frame_pacer.h"
+#include "key_injector.h"
+#include "profiler.h"
+#include "quirks.h"
+#include "recording.h"
 #include "signal.h"
+#include "snapshot.h"
+#include "triple_buffer.h"
+#include "vip_timing.h"
 
 namespace {
 
@@ -18,62 +38,346 @@ constexpr int k_cycles_per_second = 600;
 constexpr int k_timer_frequency = 60;
 constexpr int k_cycles_per_frame = k_cycles_per_second / k_timer_frequency;
 
-constexpr auto k_time_per_frame_ms =
-    std::chrono::duration<double, std::milli>(1000.0 / k_timer_frequency);
-
-common::Status run(chip8::Chip8 &chip8, chip8::SDLSystem &system) {
-  bool quit = false;
-  uint32_t running_sample_index = 0;
-  while (true) {
-    std::chrono::time_point frame_start = std::chrono::system_clock::now();
-    system.poll_events(quit, chip8);
-    if (quit)
-      return {};
-    for (int i = 0; i < k_cycles_per_frame; i++) {
-      common::Status status = chip8.execute_cycle();
-      if (!status)
-        return status;
+// The extended core's 128x64 display in the same size window.
+constexpr int k_extended_scale = k_scale / 2;
+// Instructions per frame on the extended core: SUPER-CHIP games were written
+// for the HP-48's faster interpreter, and XO-CHIP ones for Octo's 1000.
+template <typename Quirks>
+constexpr int k_extended_cycles_per_frame = Quirks::k_xo_chip ? 1000 : 30;
+
+// Build with --copt=-DCHIP8_PROFILE to record the instruction mix; the
+// profile is written when the emulator exits.
+#if defined(CHIP8_PROFILE)
+using Profiler = chip8::OpcodeProfiler;
+#else
+using Profiler = chip8::NoProfiler;
+#endif
+
+constexpr auto k_frame_period =
+    std::chrono::nanoseconds(1'000'000'000 / k_timer_frequency);
+// How long the SDL thread sleeps when no new frame has been published.
+constexpr auto k_render_poll_interval = std::chrono::milliseconds(1);
+// In turbo, frames run back to back until this long before the next tick,
+// leaving time to publish and for the pacer's spin.
+constexpr auto k_turbo_margin = std::chrono::milliseconds(1);
+
+// Command-line options beyond the ROM and quirk profile.
+struct Options {
+  std::optional<std::filesystem::path> record_path;
+  std::optional<std::filesystem::path> capture_path;
+  chip8::TextureMode texture_mode = chip8::TextureMode::Streaming;
+  // Runs on the VIP timing model at this CPU clock instead of a fixed
+  // k_cycles_per_frame instructions per frame.
+  std::optional<uint32_t> clock_hz;
+  // Runs schip on ExtendedChip8 (hires, scrolling) rather than BasicChip8;
+  // xochip always does.
+  bool extended = false;
+};
+
+// The picture a machine publishes to the SDL thread.
+template <typename Machine> struct PictureOf {
+  using type = chip8::Frame;
+};
+template <typename Quirks> struct PictureOf<chip8::ExtendedChip8<Quirks>> {
+  using type = chip8::PlaneFrame;
+};
+
+// State shared by the emulation thread and the SDL thread.
+template <typename Picture> struct Session {
+  common::TripleBuffer<Picture> frames;
+  chip8::KeyQueue keys;
+  std::atomic<bool> rewind_held = false;
+  std::atomic<bool> turbo_held = false;
+  // Emulated instructions (or, on the timing model, clock pulses) per second
+  // while in turbo, 0 otherwise.
+  std::atomic<double> turbo_speed = 0.0;
+  // Set once the emulation thread has returned, e.g. after a fault.
+  std::atomic<bool> emulation_done = false;
+};
+
+// The emulation thread: runs 60 Hz frames until `stop` is requested,
+// applying queued keys at the cycles matching their timestamps and
+// publishing every display that changed to session.frames, so a slow present
+// never delays the CPU or the timers. While Backspace is held each frame
+// steps one frame back through `rewind` instead of running, unless the
+// session is being recorded to `recorder`. While Tab is held (turbo), each
+// 60 Hz tick runs as many whole frames, timers included, as fit before the
+// next one, with the beeper muted, and only the last is published. Every
+// published tick is also pushed to `capture`, if set. With a `scheduler`,
+// frames run its machine-cycle budgets instead of k_cycles_per_frame
+// instructions.
+template <typename Machine>
+common::Status emulate_frames(std::stop_token stop, Machine &chip8,
+                              Session<chip8::Frame> &session,
+                              chip8::SDLSystem &system,
+                              Profiler &profiler, chip8::FramePacer &pacer,
+                              chip8::InputRecorder *recorder,
+                              chip8::FrameCapture *capture,
+                              chip8::CycleScheduler *scheduler) {
+  uint64_t frame_number = 0;
+  chip8::RewindBuffer rewind;
+  // The display as last published.
+  chip8::Frame latest;
+  chip8::KeyInjector injector =
+      scheduler != nullptr
+          ? chip8::KeyInjector(k_frame_period, *scheduler)
+          : chip8::KeyInjector(k_frame_period, k_cycles_per_frame);
+  chip8::SpeedMeter speed;
+  pacer.reset();
+  while (!stop.stop_requested()) {
+    const bool turbo = session.turbo_held.load(std::memory_order_relaxed);
+    const chip8::FramePacer::clock::time_point turbo_end =
+        pacer.deadline() + k_frame_period - k_turbo_margin;
+    uint64_t cycles = 0u;
+    const uint64_t machine_cycles_before =
+        scheduler != nullptr ? scheduler->machine_cycles() : 0u;
+    uint32_t changed = 0u;
+    // Later frames of a turbo tick share its key window, so keys pressed
+    // during the tick wait for the next one; held-back releases still land
+    // at their cycle.
+    do {
+      if (recorder == nullptr &&
+          session.rewind_held.load(std::memory_order_relaxed) &&
+          rewind.frames() > 0u) {
+        injector.skip_frame(chip8, session.keys, pacer.deadline());
+        std::array<uint8_t, 16> keypad = chip8.keypad_;
+        rewind.rewind(chip8);
+        // Keep the keys the player is holding now, not the recorded ones.
+        chip8.keypad_ = keypad;
+        chip8.redraw_ = true;
+      } else {
+        // What actually ran: with the VIP display wait most frames stop
+        // short of k_cycles_per_frame at their first Dxyn.
+        const uint64_t executed_before = chip8.instructions_executed_;
+        common::Status status = injector.run_frame(
+            chip8, session.keys, pacer.deadline(), profiler, recorder);
+        if (!status)
+          return status;
+        chip8.decrement_timers();
+        cycles += chip8.instructions_executed_ - executed_before;
+        if (recorder != nullptr) {
+          recorder->end_frame();
+        } else {
+          rewind.push(chip8);
+        }
+      }
+      frame_number++;
+      // Cleared every frame, published or not: the VIP display wait stalls
+      // the CPU until redraw_ is.
+      if (chip8.redraw_) {
+        changed |= chip8::update_frame(chip8, latest);
+        chip8.redraw_ = false;
+        chip8.dirty_rows_ = 0u;
+      }
+    } while (turbo && !stop.stop_requested() &&
+             chip8::FramePacer::clock::now() < turbo_end);
+    if (scheduler != nullptr) {
+      cycles = (scheduler->machine_cycles() - machine_cycles_before) *
+               chip8::k_clocks_per_machine_cycle;
+    }
+    system.publish_audio_state(chip8, turbo);
+    if (changed != 0u) {
+      latest.number = frame_number;
+      session.frames.back() = latest;
+      session.frames.publish();
+    }
+    if (speed.add(cycles, chip8::FramePacer::clock::now())) {
+      session.turbo_speed.store(turbo ? speed.cycles_per_second() : 0.0,
+                                std::memory_order_relaxed);
     }
+    if (capture != nullptr) {
+      latest.number = frame_number;
+      capture->push(latest);
+    }
+    pacer.wait();
+  }
+  return {};
+}
+
+// emulate_frames() for the extended core: runs and publishes its frames
+// until `stop` is requested or the program exits with 00FD. Rewind, turbo,
+// recording, capture and the timing model are base-core only, so the last
+// three are always null here.
+template <typename Quirks>
+common::Status emulate_frames(std::stop_token stop,
+                              chip8::ExtendedChip8<Quirks> &chip8,
+                              Session<chip8::PlaneFrame> &session,
+                              chip8::SDLSystem &system, Profiler &profiler,
+                              chip8::FramePacer &pacer,
+                              chip8::InputRecorder *recorder,
+                              chip8::FrameCapture *capture,
+                              chip8::CycleScheduler *scheduler) {
+  uint64_t frame_number = 0;
+  chip8::KeyInjector injector(k_frame_period,
+                              k_extended_cycles_per_frame<Quirks>);
+  pacer.reset();
+  while (!stop.stop_requested() && !chip8.exited_) {
+    common::Status status =
+        injector.run_frame(chip8, session.keys, pacer.deadline(), profiler);
+    if (!status)
+      return status;
     chip8.decrement_timers();
-    system.publish_audio_stream(chip8, running_sample_index);
+    frame_number++;
+    system.publish_audio_state(chip8.should_beep_);
     if (chip8.redraw_) {
-      system.draw(chip8);
       chip8.redraw_ = false;
+      chip8::PlaneFrame &frame = session.frames.back();
+      frame.planes = chip8.planes_;
+      frame.number = frame_number;
+      session.frames.publish();
     }
-    std::chrono::time_point frame_end = std::chrono::system_clock::now();
-    std::chrono::duration<double, std::milli> d = frame_end - frame_start;
-    std::chrono::duration<double, std::milli> sleep_time_ms =
-        k_time_per_frame_ms - d;
-    if (sleep_time_ms.count() > 0) {
-      std::this_thread::sleep_for(sleep_time_ms);
-    }
+    pacer.wait();
   }
   return {};
 }
 
-} // namespace
+// Runs emulation on its own thread while this (SDL) thread polls input and
+// presents the latest published frame, until the window is closed or
+// emulation fails.
+template <typename Machine>
+common::Status run(Machine &chip8, chip8::SDLSystem &system,
+                   Profiler &profiler, chip8::InputRecorder *recorder,
+                   chip8::FrameCapture *capture,
+                   chip8::CycleScheduler *scheduler) {
+  Session<typename PictureOf<Machine>::type> session;
+  chip8::FramePacer pacer(k_frame_period);
+  // What turbo_speed is without turbo.
+  const double real_time_speed = scheduler != nullptr
+                                     ? scheduler->clock_hz()
+                                     : k_cycles_per_second;
+  common::Status status;
+  {
+    std::jthread emulation([&](std::stop_token stop) {
+      status = emulate_frames(stop, chip8, session, system, profiler, pacer,
+                              recorder, capture, scheduler);
+      session.emulation_done.store(true, std::memory_order_release);
+    });
+    bool quit = false;
+    double shown_speed = 0.0;
+    while (!quit && !session.emulation_done.load(std::memory_order_acquire)) {
+      system.poll_events(quit, session.keys);
+      session.rewind_held.store(system.rewind_held(),
+                                std::memory_order_relaxed);
+      session.turbo_held.store(system.turbo_held(), std::memory_order_relaxed);
+      const double speed = system.turbo_held()
+                               ? session.turbo_speed.load(
+                                     std::memory_order_relaxed)
+                               : 0.0;
+      if (speed != shown_speed) {
+        shown_speed = speed;
+        system.show_speed(speed != 0.0 ? std::optional<double>(speed)
+                                       : std::nullopt,
+                          real_time_speed);
+      }
+      if (session.frames.acquire() || system.needs_full_redraw()) {
+        system.present(session.frames.front());
+      } else {
+        std::this_thread::sleep_for(k_render_poll_interval);
+      }
+    }
+    // Leaving the scope requests stop and joins the emulation thread.
+  }
+  if (const char *pacing_path = std::getenv("CHIP8_PACING_OUT")) {
+    common::Status pacing_status = pacer.jitter().write(pacing_path);
+    if (!pacing_status) {
+      std::cerr << "Error when writing the pacing histogram: "
+                << pacing_status.error() << std::endl;
+    }
+  }
+  if (std::getenv("CHIP8_AUDIO_STATS") != nullptr) {
+    chip8::AudioStats audio = system.audio_stats();
+    std::cerr << "Audio: " << audio.callbacks << " callbacks, "
+              << audio.samples << " samples, largest request "
+              << audio.max_request_samples << " samples, "
+              << system.buffered_audio_samples() << " samples buffered"
+              << std::endl;
+  }
+  return status;
+}
 
-int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    std::cerr << "No ROM passed into emulator." << std::endl;
+// Loads `rom` into a machine with the given quirks and runs it until the
+// window is closed, recording the session and capturing the video as
+// `options` ask.
+template <typename Quirks>
+int emulate(const std::filesystem::path &rom, const Options &options) {
+  const std::optional<std::filesystem::path> &record_path =
+      options.record_path;
+  const std::optional<std::filesystem::path> &capture_path =
+      options.capture_path;
+  if (record_path && options.clock_hz) {
+    // Recordings count instructions per frame; the timing model's varying
+    // count would not replay.
+    std::cerr << "--record and --clock cannot be combined." << std::endl;
     return -1;
   }
-
-  chip8::Chip8 chip8;
-  common::Status load_status = chip8.load_rom(std::filesystem::path(argv[1]));
+  using Machine = chip8::BasicChip8<Quirks>;
+  Machine chip8;
+  common::Status load_status = chip8.load_rom(rom);
   if (!load_status) {
     std::cerr << "Error when loading rom: " << load_status.error() << std::endl;
     return -1;
   }
 
   common::StatusOr<chip8::SDLSystem> system =
-      chip8::create_sdl_system(k_width, k_height, k_scale);
+      chip8::create_sdl_system(k_width, k_height, k_scale,
+                               options.texture_mode);
   if (!system.has_value()) {
     std::cerr << "Error when setting up sdl system: " << system.error()
               << std::endl;
   }
 
-  common::Status run_status = run(chip8, system.value());
+  std::optional<chip8::InputRecorder> recorder;
+  if (record_path) {
+    uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    recorder.emplace(Quirks::k_name, seed, k_cycles_per_frame);
+    chip8.seed_random(recorder->seed());
+  }
+
+  std::unique_ptr<chip8::FrameCapture> capture;
+  if (capture_path) {
+    auto opened = chip8::FrameCapture::open(
+        *capture_path, chip8::capture_format_for(*capture_path));
+    if (!opened) {
+      std::cerr << "Error when opening the capture: " << opened.error()
+                << std::endl;
+      return -1;
+    }
+    capture = std::move(*opened);
+  }
+
+  std::optional<chip8::CycleScheduler> scheduler;
+  if (options.clock_hz) {
+    scheduler.emplace(*options.clock_hz);
+  }
+
+  Profiler profiler;
+  common::Status run_status =
+      run(chip8, system.value(), profiler, recorder ? &*recorder : nullptr,
+          capture.get(), scheduler ? &*scheduler : nullptr);
+  if (capture) {
+    common::Status capture_status = capture->finish();
+    if (!capture_status) {
+      std::cerr << "Error when writing the capture: " << capture_status.error()
+                << std::endl;
+    }
+  }
+  if (recorder) {
+    common::Status record_status =
+        chip8::write_recording(recorder->finish(chip8), *record_path);
+    if (!record_status) {
+      std::cerr << "Error when writing the recording: "
+                << record_status.error() << std::endl;
+    }
+  }
+#if defined(CHIP8_PROFILE)
+  const char *profile_path = std::getenv("CHIP8_PROFILE_OUT");
+  common::Status profile_status = profiler.write(
+      profile_path != nullptr ? profile_path : "chip8_profile.json");
+  if (!profile_status) {
+    std::cerr << "Error when writing the profile: " << profile_status.error()
+              << std::endl;
+  }
+#endif
   if (!run_status) {
     std::cerr << "Error when running the rom: " << run_status.error()
               << std::endl;
@@ -81,3 +385,103 @@ int main(int argc, char *argv[]) {
   }
   return 0;
 }
+
+// Loads `rom` into the extended core with the given quirks and runs it until
+// the window is closed or the program exits.
+template <typename Quirks>
+int emulate_extended(const std::filesystem::path &rom,
+                     const Options &options) {
+  if (options.record_path || options.capture_path || options.clock_hz) {
+    std::cerr << "--record, --capture and --clock need the base core."
+              << std::endl;
+    return -1;
+  }
+  // 64 KB of memory for XO-CHIP: too much for the stack.
+  auto chip8 = std::make_unique<chip8::ExtendedChip8<Quirks>>();
+  common::Status load_status = chip8->load_rom(rom);
+  if (!load_status) {
+    std::cerr << "Error when loading rom: " << load_status.error() << std::endl;
+    return -1;
+  }
+  common::StatusOr<chip8::SDLSystem> system = chip8::create_sdl_system(
+      chip8::ExtendedChip8<Quirks>::k_width,
+      chip8::ExtendedChip8<Quirks>::k_height, k_extended_scale,
+      options.texture_mode);
+  if (!system.has_value()) {
+    std::cerr << "Error when setting up sdl system: " << system.error()
+              << std::endl;
+    return -1;
+  }
+  Profiler profiler;
+  common::Status run_status =
+      run(*chip8, system.value(), profiler, nullptr, nullptr, nullptr);
+  if (!run_status) {
+    std::cerr << "Error when running the rom: " << run_status.error()
+              << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string_view> positional;
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (arg.starts_with("--record=")) {
+      options.record_path = arg.substr(std::string_view("--record=").size());
+    } else if (arg.starts_with("--capture=")) {
+      options.capture_path = arg.substr(std::string_view("--capture=").size());
+    } else if (arg == "--extended") {
+      options.extended = true;
+    } else if (arg == "--static-texture") {
+      options.texture_mode = chip8::TextureMode::Static;
+    } else if (arg.starts_with("--clock=")) {
+      std::string_view value = arg.substr(std::string_view("--clock=").size());
+      uint32_t clock_hz = chip8::k_vip_clock_hz;
+      if (value != "vip") {
+        const char *value_end = value.data() + value.size();
+        auto [end, error] = std::from_chars(value.data(), value_end, clock_hz);
+        if (error != std::errc() || end != value_end || clock_hz == 0u) {
+          std::cerr << "Invalid clock " << value
+                    << " (expected vip or a rate in Hz)." << std::endl;
+          return -1;
+        }
+      }
+      options.clock_hz = clock_hz;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.empty()) {
+    std::cerr << "No ROM passed into emulator." << std::endl;
+    return -1;
+  }
+  std::filesystem::path rom(positional[0]);
+  std::string_view quirks =
+      positional.size() > 1 ? positional[1] : chip8::CosmacVipQuirks::k_name;
+  if (quirks == chip8::XoChipQuirks::k_name) {
+    return emulate_extended<chip8::XoChipQuirks>(rom, options);
+  }
+  if (quirks == chip8::SuperChipQuirks::k_name && options.extended) {
+    return emulate_extended<chip8::SuperChipQuirks>(rom, options);
+  }
+  if (options.extended) {
+    std::cerr << "--extended needs the schip or xochip profile." << std::endl;
+    return -1;
+  }
+  if (quirks == chip8::CosmacVipQuirks::k_name) {
+    return emulate<chip8::CosmacVipQuirks>(rom, options);
+  }
+  if (quirks == chip8::Chip48Quirks::k_name) {
+    return emulate<chip8::Chip48Quirks>(rom, options);
+  }
+  if (quirks == chip8::SuperChipQuirks::k_name) {
+    return emulate<chip8::SuperChipQuirks>(rom, options);
+  }
+  std::cerr << "Unknown quirk profile " << quirks
+            << " (expected vip, chip48, schip or xochip)." << std::endl;
+  return -1;
+}
@@ -0,0 +1,538 @@
+#ifndef SRC_OPCODE_HANDLERS_H
+#define SRC_OPCODE_HANDLERS_H
+
+#include "checking.h"
+#include "chip8.h"
+#include "instruction.h"
+#include "quirks.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// The semantics of every CHIP-8 opcode, one handler per Op, shared by the
+// interpreter loops in chip8.cc and the code chip8_aot generates (see
+// aot_program.h). Handlers run with program_counter_ already past the
+// instruction and leave faults in Chip8State::fault_. Not part of the
+// machine's interface; include chip8.h instead.
+namespace chip8::handlers {
+
+// Addresses wrap to the VIP's 12-bit bus when they are not checked.
+inline constexpr uint16_t k_address_mask = 0xFFFu;
+
+// Records `kind` as the machine's fault unless one is already recorded.
+inline void raise_fault(Chip8State &em, FaultKind kind) {
+  if (!em.faulted_) {
+    em.faulted_ = true;
+    em.fault_.kind = kind;
+  }
+}
+
+// Adds the detail Checked cores report for the fault just raised by the
+// instruction at `address`.
+inline void capture_fault(Chip8State &em, uint16_t address) {
+  Fault &fault = em.fault_;
+  if (fault.detailed) {
+    return;
+  }
+  fault.detailed = true;
+  fault.program_counter = address;
+  fault.opcode = static_cast<uint16_t>(
+      (static_cast<uint8_t>(em.memory_[address & k_address_mask]) << 8u) |
+      static_cast<uint8_t>(em.memory_[(address + 1) & k_address_mask]));
+  fault.index_register = em.index_register_;
+  fault.stack_pointer = em.stack_pointer_;
+  fault.registers = em.registers_;
+}
+
+// True if [address, address + length) lies in memory. Checked cores raise a
+// fault otherwise; Unchecked ones skip the test and mask addresses instead.
+template <typename Checking>
+bool memory_in_bounds(Chip8State &em, uint32_t address, size_t length) {
+  if constexpr (Checking::k_checked) {
+    if (address + length > em.memory_.size()) {
+      raise_fault(em, FaultKind::MemoryOutOfBounds);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Keypad index for register value `value`.
+template <typename Checking> uint8_t key_index(Chip8State &em, uint8_t value) {
+  if constexpr (Checking::k_checked) {
+    if (value > 0xFu) {
+      raise_fault(em, FaultKind::KeyOutOfRange);
+    }
+  }
+  return value & 0xFu;
+}
+
+inline void sys(Chip8State &em, const Instruction &in) {}
+
+template <typename Display> void cls(Chip8State &em, const Instruction &in) {
+  Display &screen = static_cast<Display &>(em);
+  if constexpr (Display::k_display_mode == DisplayMode::Packed) {
+    screen.packed_display_ = {};
+  } else {
+    screen.display_ = {};
+  }
+  em.redraw_ = true;
+  em.dirty_rows_ = k_all_rows;
+}
+
+inline void ret(Chip8State &em, const Instruction &in) {
+  if (em.stack_pointer_ == 0u) {
+    raise_fault(em, FaultKind::StackUnderflow);
+    return;
+  }
+  em.stack_pointer_ -= 1;
+  em.program_counter_ = em.stack_[em.stack_pointer_];
+}
+
+inline void jp(Chip8State &em, const Instruction &in) {
+  em.program_counter_ = in.nnn;
+}
+
+inline void ldi(Chip8State &em, const Instruction &in) {
+  em.index_register_ = in.nnn;
+}
+
+inline void ldv(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] = in.kk;
+}
+
+inline void addv(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] += in.kk;
+}
+
+inline void scalar_draw(ByteDisplay &em, const Instruction &in) {
+  int x_coord = em.registers_[in.x] % 64;
+  int y_coord = em.registers_[in.y] % 32;
+  em.registers_[0xFu] = 0u;
+  for (uint8_t i = 0u; i < in.n; i++) {
+    int y = (y_coord + i);
+    if (y >= 32)
+      break;
+    uint8_t sprite_byte = static_cast<uint8_t>(
+        em.memory_[(em.index_register_ + i) & k_address_mask]);
+    for (uint8_t j = 0u; j < 8u; j++) {
+      if ((sprite_byte & (0x80u >> j))) {
+        int x = (x_coord + j);
+        if (x >= 64)
+          break;
+        uint16_t pix = (y * 64) + x;
+        if (em.display_[pix] == 1u) {
+          em.registers_[0xFu] = 1u;
+        }
+        em.display_[pix] ^= 1u;
+      }
+    }
+  }
+}
+
+inline void vector_draw(ByteDisplay &em, const Instruction &in) {
+  int x_coord = em.registers_[in.x] % 64;
+  // Sprites clipped by the right edge take the scalar path.
+  if (x_coord + 8 > 64) {
+    return scalar_draw(em, in);
+  }
+  int y_coord = em.registers_[in.y] % 32;
+  const size_t rows = std::min<int>(in.n, 32 - y_coord);
+  const uint16_t address = em.index_register_ & k_address_mask;
+  const uint8_t *sprite =
+      reinterpret_cast<const uint8_t *>(em.memory_.data() + address);
+  // An Unchecked core reads a sprite past the end of memory from the start.
+  std::array<uint8_t, 15> wrapped;
+  if (address + rows > em.memory_.size()) [[unlikely]] {
+    for (size_t i = 0; i < rows; i++) {
+      wrapped[i] =
+          static_cast<uint8_t>(em.memory_[(address + i) & k_address_mask]);
+    }
+    sprite = wrapped.data();
+  }
+  const bool collision = pixel_kernels().xor_sprite(
+      &em.display_[y_coord * 64 + x_coord], sprite, rows);
+  em.registers_[0xFu] = collision ? 1u : 0u;
+}
+
+inline void packed_draw(PackedDisplay &em, const Instruction &in) {
+  int x_coord = em.registers_[in.x] % 64;
+  int y_coord = em.registers_[in.y] % 32;
+  int rows = std::min<int>(in.n, 32 - y_coord);
+  uint64_t collision = 0u;
+  for (int i = 0; i < rows; i++) {
+    // Bits shifted past x = 63 fall off, which clips at the right edge.
+    uint64_t sprite =
+        (static_cast<uint64_t>(
+             em.memory_[(em.index_register_ + i) & k_address_mask])
+         << 56u) >>
+        x_coord;
+    collision |= em.packed_display_[y_coord + i] & sprite;
+    em.packed_display_[y_coord + i] ^= sprite;
+  }
+  em.registers_[0xFu] = collision != 0u ? 1u : 0u;
+}
+
+template <typename Display>
+void wrapped_draw(Display &em, const Instruction &in) {
+  int x_coord = em.registers_[in.x] % 64;
+  int y_coord = em.registers_[in.y] % 32;
+  uint64_t collision = 0u;
+  for (int i = 0; i < in.n; i++) {
+    int y = (y_coord + i) % 32;
+    uint64_t sprite = std::rotr(
+        static_cast<uint64_t>(
+            em.memory_[(em.index_register_ + i) & k_address_mask])
+            << 56u,
+        x_coord);
+    if constexpr (Display::k_display_mode == DisplayMode::Packed) {
+      collision |= em.packed_display_[y] & sprite;
+      em.packed_display_[y] ^= sprite;
+    } else {
+      for (int x = 0; x < 64; x++) {
+        uint8_t bit = (sprite >> (63 - x)) & 0x1u;
+        collision |= em.display_[y * 64 + x] & bit;
+        em.display_[y * 64 + x] ^= bit;
+      }
+    }
+  }
+  em.registers_[0xFu] = collision != 0u ? 1u : 0u;
+}
+
+template <typename Quirks, typename Checking, typename Display>
+void draw(Chip8State &em, const Instruction &in) {
+  if (!memory_in_bounds<Checking>(em, em.index_register_, in.n)) {
+    return;
+  }
+  em.redraw_ = true;
+  // n <= 15 rows from y_coord, clipped at the bottom or wrapped to the top.
+  uint64_t rows = ((uint64_t{1} << in.n) - 1u) << (em.registers_[in.y] % 32);
+  em.dirty_rows_ |= static_cast<uint32_t>(rows);
+  Display &screen = static_cast<Display &>(em);
+  if constexpr (Quirks::k_wrap_sprites) {
+    em.dirty_rows_ |= static_cast<uint32_t>(rows >> 32u);
+    return wrapped_draw(screen, in);
+  } else if constexpr (Display::k_display_mode == DisplayMode::Packed) {
+    return packed_draw(screen, in);
+  } else {
+    return vector_draw(screen, in);
+  }
+}
+
+inline void call(Chip8State &em, const Instruction &in) {
+  if (em.stack_pointer_ > 15) {
+    raise_fault(em, FaultKind::StackOverflow);
+    return;
+  }
+  em.stack_[em.stack_pointer_] = em.program_counter_;
+  em.stack_pointer_ += 1;
+  em.program_counter_ = in.nnn;
+}
+
+inline void skip_instr_equal(Chip8State &em, const Instruction &in) {
+  if (em.registers_[in.x] == in.kk) {
+    em.program_counter_ += 2;
+  }
+}
+
+inline void skip_instr_not_equal(Chip8State &em, const Instruction &in) {
+  if (em.registers_[in.x] != in.kk) {
+    em.program_counter_ += 2;
+  }
+}
+
+inline void skip_reg_equal(Chip8State &em, const Instruction &in) {
+  if (em.registers_[in.x] == em.registers_[in.y]) {
+    em.program_counter_ += 2;
+  }
+}
+
+inline void skip_reg_not_equal(Chip8State &em, const Instruction &in) {
+  if (em.registers_[in.x] != em.registers_[in.y]) {
+    em.program_counter_ += 2;
+  }
+}
+
+inline void ld_reg(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] = em.registers_[in.y];
+}
+
+template <typename Quirks>
+void or_reg(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] |= em.registers_[in.y];
+  if constexpr (Quirks::k_logic_resets_vf) {
+    em.registers_[0xFu] = 0u;
+  }
+}
+
+template <typename Quirks>
+void and_reg(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] &= em.registers_[in.y];
+  if constexpr (Quirks::k_logic_resets_vf) {
+    em.registers_[0xFu] = 0u;
+  }
+}
+
+template <typename Quirks>
+void xor_reg(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] ^= em.registers_[in.y];
+  if constexpr (Quirks::k_logic_resets_vf) {
+    em.registers_[0xFu] = 0u;
+  }
+}
+
+inline void add_reg(Chip8State &em, const Instruction &in) {
+  uint16_t sum = em.registers_[in.x] + em.registers_[in.y];
+  em.registers_[in.x] = (sum & 0xFFu);
+  em.registers_[0xFu] = (sum > 255u) ? 1u : 0u;
+}
+
+inline void sub_reg(Chip8State &em, const Instruction &in) {
+  int diff = em.registers_[in.x] - em.registers_[in.y];
+  em.registers_[in.x] -= em.registers_[in.y];
+  em.registers_[0xFu] = (diff >= 0) ? 1u : 0u;
+}
+
+template <typename Quirks>
+void shr_reg(Chip8State &em, const Instruction &in) {
+  if constexpr (Quirks::k_shift_uses_vy) {
+    em.registers_[in.x] = em.registers_[in.y];
+  }
+  bool last_bit_set = em.registers_[in.x] & 0x1u;
+  em.registers_[in.x] >>= 1;
+  em.registers_[0xFu] = last_bit_set ? 1 : 0;
+}
+
+inline void subn_reg(Chip8State &em, const Instruction &in) {
+  int diff = em.registers_[in.y] - em.registers_[in.x];
+  em.registers_[in.x] = em.registers_[in.y] - em.registers_[in.x];
+  em.registers_[0xFu] = (diff >= 0) ? 1u : 0u;
+}
+
+template <typename Quirks>
+void shl_reg(Chip8State &em, const Instruction &in) {
+  if constexpr (Quirks::k_shift_uses_vy) {
+    em.registers_[in.x] = em.registers_[in.y];
+  }
+  bool last_bit_set = em.registers_[in.x] >> 7u;
+  em.registers_[in.x] <<= 1;
+  em.registers_[0xFu] = last_bit_set ? 1 : 0;
+}
+
+inline void invalid_register_op(Chip8State &em, const Instruction &in) {
+  raise_fault(em, FaultKind::InvalidOpcode);
+}
+
+template <typename Quirks>
+void jp_offset(Chip8State &em, const Instruction &in) {
+  uint8_t offset_register = Quirks::k_jump_uses_vx ? in.x : 0u;
+  em.program_counter_ = em.registers_[offset_register] + in.nnn;
+}
+
+inline void reg_random_plus_offset(Chip8State &em,
+                                      const Instruction &in) {
+  em.registers_[in.x] = next_random_byte(em.rng_state_) & in.kk;
+}
+
+template <typename Checking>
+void skip_key_pressed(Chip8State &em, const Instruction &in) {
+  if (em.keypad_[key_index<Checking>(em, em.registers_[in.x])] == 1u)
+    em.program_counter_ += 2;
+}
+
+template <typename Checking>
+void skip_key_not_pressed(Chip8State &em, const Instruction &in) {
+  if (em.keypad_[key_index<Checking>(em, em.registers_[in.x])] != 1u)
+    em.program_counter_ += 2;
+}
+
+inline void invalid_key_op(Chip8State &em, const Instruction &in) {
+  raise_fault(em, FaultKind::InvalidOpcode);
+}
+
+inline void ld_delay(Chip8State &em, const Instruction &in) {
+  em.registers_[in.x] = em.delay_timer_;
+}
+
+inline void wait_key(Chip8State &em, const Instruction &in) {
+  em.waiting_for_key_press_ = true;
+  for (uint8_t i = 0; i < 16u; i++) {
+    if (em.keypad_[i] == 1u) {
+      em.waiting_for_key_press_ = false;
+      em.waiting_for_key_release_ = true;
+      em.registers_[in.x] = i;
+      break;
+    }
+  }
+  if (em.waiting_for_key_press_) {
+    em.program_counter_ -= 2;
+  }
+}
+
+inline void set_delay(Chip8State &em, const Instruction &in) {
+  em.delay_timer_ = em.registers_[in.x];
+}
+
+inline void set_sound(Chip8State &em, const Instruction &in) {
+  em.sound_timer_ = em.registers_[in.x];
+}
+
+inline void add_index(Chip8State &em, const Instruction &in) {
+  em.index_register_ += em.registers_[in.x];
+}
+
+inline void ld_font(Chip8State &em, const Instruction &in) {
+  em.index_register_ = k_font_address + (5 * em.registers_[in.x]);
+}
+
+template <typename Checking>
+void store_bcd(Chip8State &em, const Instruction &in) {
+  if (!memory_in_bounds<Checking>(em, em.index_register_, 3)) {
+    return;
+  }
+  uint16_t value = em.registers_[in.x];
+  for (int i = 2; i >= 0; i--) {
+    em.write_memory((em.index_register_ + i) & k_address_mask,
+                    static_cast<std::byte>(value % 10));
+    value /= 10;
+  }
+}
+
+// I after Fx55/Fx65 copied V0..Vx.
+template <typename Quirks> void advance_index(Chip8State &em, uint8_t x) {
+  if constexpr (Quirks::k_index_increment == IndexIncrement::XPlusOne) {
+    em.index_register_ += x + 1;
+  } else if constexpr (Quirks::k_index_increment == IndexIncrement::X) {
+    em.index_register_ += x;
+  }
+}
+
+template <typename Quirks, typename Checking>
+void store_registers(Chip8State &em, const Instruction &in) {
+  if (!memory_in_bounds<Checking>(em, em.index_register_, in.x + 1u)) {
+    return;
+  }
+  for (uint8_t i = 0; i <= in.x; i++) {
+    em.write_memory((em.index_register_ + i) & k_address_mask,
+                    static_cast<std::byte>(em.registers_[i]));
+  }
+  advance_index<Quirks>(em, in.x);
+}
+
+template <typename Quirks, typename Checking>
+void load_registers(Chip8State &em, const Instruction &in) {
+  if (!memory_in_bounds<Checking>(em, em.index_register_, in.x + 1u)) {
+    return;
+  }
+  for (uint8_t i = 0; i <= in.x; i++) {
+    em.registers_[i] = static_cast<uint8_t>(
+        em.memory_[(em.index_register_ + i) & k_address_mask]);
+  }
+  advance_index<Quirks>(em, in.x);
+}
+
+inline void invalid_finstr(Chip8State &em, const Instruction &in) {
+  raise_fault(em, FaultKind::InvalidOpcode);
+}
+
+using Handler = void (*)(Chip8State &, const Instruction &);
+
+// Indexed by Op; the Undecoded slot is never dispatched. Each handler is
+// handed the BasicChip8<Quirks, Checking, Display> it runs on.
+template <typename Quirks, typename Checking, typename Display>
+inline constexpr std::array<Handler, k_num_ops> k_handlers = [] {
+  std::array<Handler, k_num_ops> handlers = {};
+  auto set = [&handlers](Op op, Handler handler) {
+    handlers[static_cast<size_t>(op)] = handler;
+  };
+  set(Op::Sys, &sys);
+  set(Op::Cls, &cls<Display>);
+  set(Op::Ret, &ret);
+  set(Op::Jp, &jp);
+  set(Op::Call, &call);
+  set(Op::SeVxKk, &skip_instr_equal);
+  set(Op::SneVxKk, &skip_instr_not_equal);
+  set(Op::SeVxVy, &skip_reg_equal);
+  set(Op::LdVxKk, &ldv);
+  set(Op::AddVxKk, &addv);
+  set(Op::LdVxVy, &ld_reg);
+  set(Op::Or, &or_reg<Quirks>);
+  set(Op::And, &and_reg<Quirks>);
+  set(Op::Xor, &xor_reg<Quirks>);
+  set(Op::AddVxVy, &add_reg);
+  set(Op::Sub, &sub_reg);
+  set(Op::Shr, &shr_reg<Quirks>);
+  set(Op::Subn, &subn_reg);
+  set(Op::Shl, &shl_reg<Quirks>);
+  set(Op::SneVxVy, &skip_reg_not_equal);
+  set(Op::LdI, &ldi);
+  set(Op::JpV0, &jp_offset<Quirks>);
+  set(Op::Rnd, &reg_random_plus_offset);
+  set(Op::Drw, &draw<Quirks, Checking, Display>);
+  set(Op::Skp, &skip_key_pressed<Checking>);
+  set(Op::Sknp, &skip_key_not_pressed<Checking>);
+  set(Op::LdVxDt, &ld_delay);
+  set(Op::LdVxK, &wait_key);
+  set(Op::LdDtVx, &set_delay);
+  set(Op::LdStVx, &set_sound);
+  set(Op::AddIVx, &add_index);
+  set(Op::LdFVx, &ld_font);
+  set(Op::LdBVx, &store_bcd<Checking>);
+  set(Op::LdIVx, &store_registers<Quirks, Checking>);
+  set(Op::LdVxI, &load_registers<Quirks, Checking>);
+  set(Op::InvalidRegisterOp, &invalid_register_op);
+  set(Op::InvalidKeyOp, &invalid_key_op);
+  set(Op::InvalidFOp, &invalid_finstr);
+  return handlers;
+}();
+
+// Decodes the instruction at `address`, bypassing the cache.
+inline Instruction decode_at(const Chip8State &chip8, uint16_t address) {
+  return decode(static_cast<uint8_t>(chip8.memory_[address]),
+                static_cast<uint8_t>(
+                    chip8.memory_[(address + 1) & k_address_mask]));
+}
+
+// Returns the instruction at the program counter, decoding it into the cache
+// on first use if it lies in the loaded program. Returned by value so a
+// handler that overwrites its own code (Fx55 onto itself) keeps its
+// operands. A Checked core turns a program counter past the last
+// instruction slot into a fault (and runs a no-op); an Unchecked one wraps
+// it.
+template <typename Checking> Instruction fetch(Chip8State &chip8) {
+  uint16_t pc = chip8.program_counter_;
+  if constexpr (Checking::k_checked) {
+    if (pc > chip8.memory_.size() - 2) {
+      raise_fault(chip8, FaultKind::MemoryOutOfBounds);
+      return Instruction{.op = Op::Sys};
+    }
+  } else {
+    pc &= k_address_mask;
+  }
+  // Wraps below decoded_base_, so one compare covers both ends.
+  const size_t slot = size_t{pc} - chip8.decoded_base_;
+  if (slot < chip8.decoded_.size()) [[likely]] {
+    Instruction &cached = chip8.decoded_[slot];
+    if (cached.op != Op::Undecoded) [[likely]] {
+      return cached;
+    }
+    cached = decode_at(chip8, pc);
+    return cached;
+  }
+  return decode_at(chip8, pc);
+}
+
+// True while execute_cycle() would do nothing: Fx0A is waiting on the
+// keypad, or, with the display wait quirk, a drawn frame has not been
+// presented yet. Nothing inside the core clears these.
+template <typename Quirks> bool stalled(const Chip8State &chip8) {
+  return chip8.waiting_for_key_press_ || chip8.waiting_for_key_release_ ||
+         (Quirks::k_display_wait && chip8.redraw_);
+}
+
+} // namespace chip8::handlers
+
+#endif
@@ -0,0 +1,92 @@
+#include "profiler.h"
+#include "app_error.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace chip8 {
+namespace {
+
+// Undecoded is never dispatched, so the table starts at the first real form.
+constexpr size_t k_first_op = static_cast<size_t>(Op::Sys);
+
+} // namespace
+
+std::string_view OpcodeProfiler::tick_unit() {
+#if defined(__x86_64__)
+  return "tsc";
+#else
+  return "ns";
+#endif
+}
+
+void OpcodeProfiler::merge(const OpcodeProfiler &other) {
+  for (size_t i = 0; i < k_num_ops; i++) {
+    counts_[i] += other.counts_[i];
+    ticks_[i] += other.ticks_[i];
+  }
+  for (size_t i = 0; i < pc_hits_.size(); i++) {
+    pc_hits_[i] += other.pc_hits_[i];
+  }
+}
+
+void OpcodeProfiler::write_json(std::ostream &out) const {
+  out << "{\n  \"tick_unit\": \"" << tick_unit() << "\",\n  \"ops\": [";
+  bool first = true;
+  for (size_t i = k_first_op; i < k_num_ops; i++) {
+    if (counts_[i] == 0u) {
+      continue;
+    }
+    out << (first ? "\n" : ",\n") << "    {\"op\": \""
+        << op_name(static_cast<Op>(i)) << "\", \"count\": " << counts_[i]
+        << ", \"ticks\": " << ticks_[i] << "}";
+    first = false;
+  }
+  out << "\n  ],\n  \"hotspots\": [";
+  first = true;
+  for (size_t pc = 0; pc < pc_hits_.size(); pc++) {
+    if (pc_hits_[pc] == 0u) {
+      continue;
+    }
+    out << (first ? "\n" : ",\n") << "    {\"pc\": " << pc
+        << ", \"count\": " << pc_hits_[pc] << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
+
+void OpcodeProfiler::write_csv(std::ostream &out) const {
+  out << "kind,key,count,ticks\n";
+  for (size_t i = k_first_op; i < k_num_ops; i++) {
+    if (counts_[i] != 0u) {
+      out << "op," << op_name(static_cast<Op>(i)) << "," << counts_[i] << ","
+          << ticks_[i] << "\n";
+    }
+  }
+  for (size_t pc = 0; pc < pc_hits_.size(); pc++) {
+    if (pc_hits_[pc] != 0u) {
+      out << "pc,0x" << std::hex << std::uppercase << std::setfill('0')
+          << std::setw(3) << pc << std::dec << "," << pc_hits_[pc] << ",\n";
+    }
+  }
+}
+
+common::Status OpcodeProfiler::write(const std::filesystem::path &path) const {
+  std::ofstream file(path);
+  if (!file) {
+    return std::unexpected(common::AppError{common::ErrorCode::IOError,
+                                            "Unable to open profile output"});
+  }
+  if (path.extension() == ".csv") {
+    write_csv(file);
+  } else {
+    write_json(file);
+  }
+  if (!file) {
+    return std::unexpected(common::AppError{common::ErrorCode::IOError,
+                                            "Failed to write profile"});
+  }
+  return {};
+}
+
+} // namespace chip8
@@ -0,0 +1,72 @@
+#ifndef SRC_PROFILER_H
+#define SRC_PROFILER_H
+
+#include "app_error.h"
+#include "instruction.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace chip8 {
+
+// Profiling policies for Chip8::execute_cycle. The interpreter calls start()
+// before dispatching an instruction and record() once it returns. NoProfiler
+// does nothing, so the default execute_cycle() compiles to the same code as
+// it would without the hooks.
+struct NoProfiler {
+  static constexpr bool k_enabled = false;
+
+  uint64_t start() const { return 0u; }
+  void record(uint16_t program_counter, Op op, uint64_t start_ticks) {}
+};
+
+// Counts executions and host ticks per Op and executions per address.
+// Reading the clock costs tens of cycles per instruction, so ticks are only
+// meaningful relative to each other.
+class OpcodeProfiler {
+public:
+  static constexpr bool k_enabled = true;
+
+  // TSC cycles on x86-64, steady_clock nanoseconds elsewhere.
+  static uint64_t now() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+  static std::string_view tick_unit();
+
+  uint64_t start() const { return now(); }
+  void record(uint16_t program_counter, Op op, uint64_t start_ticks) {
+    size_t index = static_cast<size_t>(op);
+    counts_[index]++;
+    ticks_[index] += now() - start_ticks;
+    pc_hits_[program_counter & 0xFFFu]++;
+  }
+
+  void merge(const OpcodeProfiler &other);
+
+  void write_json(std::ostream &out) const;
+  void write_csv(std::ostream &out) const;
+  // CSV if `path` ends in .csv, JSON otherwise.
+  common::Status write(const std::filesystem::path &path) const;
+
+public:
+  std::array<uint64_t, k_num_ops> counts_ = {};
+  std::array<uint64_t, k_num_ops> ticks_ = {};
+  std::array<uint64_t, 4096> pc_hits_ = {};
+};
+
+} // namespace chip8
+
+#endif
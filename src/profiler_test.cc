@@ -0,0 +1,70 @@
+#include "src/profiler.h"
+#include "src/chip8.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <sstream>
+
+namespace chip8 {
+
+class ProfilerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    const uint16_t program[] = {
+        0x6005, // 200: LD V0, 05
+        0x8014, // 202: ADD V0, V1
+        0x810E, // 204: SHL V1, V0
+        0x1202, // 206: JP 202
+    };
+    ASSERT_TRUE(chip8.load_program(program_bytes(program)));
+  }
+
+  uint64_t count(Op op) const {
+    return profiler.counts_[static_cast<size_t>(op)];
+  }
+
+  Chip8 chip8;
+  OpcodeProfiler profiler;
+};
+
+TEST_F(ProfilerTest, CountsSubOpcodesSeparately) {
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(chip8.execute_cycle(profiler));
+  }
+  EXPECT_EQ(count(Op::LdVxKk), 1u);
+  EXPECT_EQ(count(Op::AddVxVy), 3u);
+  EXPECT_EQ(count(Op::Shl), 3u);
+  EXPECT_EQ(count(Op::Jp), 3u);
+  EXPECT_EQ(profiler.pc_hits_[0x200], 1u);
+  EXPECT_EQ(profiler.pc_hits_[0x202], 3u);
+  EXPECT_EQ(profiler.pc_hits_[0x208], 0u);
+  EXPECT_EQ(chip8.instructions_executed_, 10u);
+}
+
+TEST_F(ProfilerTest, WritesOnlyExecutedOps) {
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(chip8.execute_cycle(profiler));
+  }
+  std::ostringstream json;
+  profiler.write_json(json);
+  EXPECT_NE(json.str().find("\"op\": \"8xyE\", \"count\": 1"),
+            std::string::npos);
+  EXPECT_EQ(json.str().find("Dxyn"), std::string::npos);
+  EXPECT_NE(json.str().find("{\"pc\": 518, \"count\": 1}"),
+            std::string::npos);
+
+  std::ostringstream csv;
+  profiler.write_csv(csv);
+  EXPECT_NE(csv.str().find("op,8xy4,1,"), std::string::npos);
+  EXPECT_NE(csv.str().find("pc,0x206,1,\n"), std::string::npos);
+}
+
+TEST_F(ProfilerTest, MergeAddsCounts) {
+  ASSERT_TRUE(chip8.execute_cycle(profiler));
+  OpcodeProfiler total;
+  total.merge(profiler);
+  total.merge(profiler);
+  EXPECT_EQ(total.counts_[static_cast<size_t>(Op::LdVxKk)], 2u);
+  EXPECT_EQ(total.pc_hits_[0x200], 2u);
+}
+
+} // namespace chip8
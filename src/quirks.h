@@ -0,0 +1,82 @@
+#ifndef SRC_QUIRKS_H
+#define SRC_QUIRKS_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace chip8 {
+
+// How Fx55/Fx65 leave I once they have copied V0..Vx.
+enum class IndexIncrement : uint8_t {
+  XPlusOne, // I += x + 1
+  X,        // I += x
+  None,     // I unchanged
+};
+
+// Quirk profiles: the behaviours CHIP-8 implementations disagree on. The core
+// is a template over one of these (see BasicChip8), so every quirk is a
+// compile-time constant and the untaken branch is folded away.
+//
+// k_logic_resets_vf    8xy1/8xy2/8xy3 set VF to 0.
+// k_shift_uses_vy      8xy6/8xyE shift Vy into Vx; otherwise shift Vx.
+// k_index_increment    I after Fx55/Fx65.
+// k_jump_uses_vx       Bxnn jumps to xnn + Vx; otherwise Bnnn uses V0.
+// k_wrap_sprites       Dxyn wraps pixels past the edge; otherwise clips them.
+// k_display_wait       Dxyn and 00E0 stall the CPU until the frame is
+//                      presented (redraw_ cleared), like the VIP's vblank
+//                      interrupt.
+// k_xo_chip            XO-CHIP's extensions: 64 KB of memory, a second
+//                      bitplane, 00Dn, 5xy2/5xy3, F000 nnnn, Fn01, F002 and
+//                      Fx3A. Only ExtendedChip8 looks at it.
+
+// The original COSMAC VIP interpreter.
+struct CosmacVipQuirks {
+  static constexpr std::string_view k_name = "vip";
+  static constexpr bool k_logic_resets_vf = true;
+  static constexpr bool k_shift_uses_vy = true;
+  static constexpr IndexIncrement k_index_increment = IndexIncrement::XPlusOne;
+  static constexpr bool k_jump_uses_vx = false;
+  static constexpr bool k_wrap_sprites = false;
+  static constexpr bool k_display_wait = true;
+  static constexpr bool k_xo_chip = false;
+};
+
+// CHIP-48 on the HP-48.
+struct Chip48Quirks {
+  static constexpr std::string_view k_name = "chip48";
+  static constexpr bool k_logic_resets_vf = false;
+  static constexpr bool k_shift_uses_vy = false;
+  static constexpr IndexIncrement k_index_increment = IndexIncrement::X;
+  static constexpr bool k_jump_uses_vx = true;
+  static constexpr bool k_wrap_sprites = false;
+  static constexpr bool k_display_wait = false;
+  static constexpr bool k_xo_chip = false;
+};
+
+// SUPER-CHIP 1.1.
+struct SuperChipQuirks {
+  static constexpr std::string_view k_name = "schip";
+  static constexpr bool k_logic_resets_vf = false;
+  static constexpr bool k_shift_uses_vy = false;
+  static constexpr IndexIncrement k_index_increment = IndexIncrement::None;
+  static constexpr bool k_jump_uses_vx = true;
+  static constexpr bool k_wrap_sprites = false;
+  static constexpr bool k_display_wait = false;
+  static constexpr bool k_xo_chip = false;
+};
+
+// XO-CHIP, as Octo runs it.
+struct XoChipQuirks {
+  static constexpr std::string_view k_name = "xochip";
+  static constexpr bool k_logic_resets_vf = false;
+  static constexpr bool k_shift_uses_vy = true;
+  static constexpr IndexIncrement k_index_increment = IndexIncrement::XPlusOne;
+  static constexpr bool k_jump_uses_vx = false;
+  static constexpr bool k_wrap_sprites = true;
+  static constexpr bool k_display_wait = false;
+  static constexpr bool k_xo_chip = true;
+};
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,555 @@
+#include "recompiler.h"
+#include "app_error.h"
+#include "chip8.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CHIP8_RECOMPILER_X86_64 1
+#include <cerrno>
+#include <sys/mman.h>
+#include <system_error>
+#endif
+
+namespace chip8 {
+namespace {
+
+constexpr size_t k_code_size = 256 * 1024;
+// Worst case for one block is well under this; the buffer is flushed when
+// less than this much space is left.
+constexpr size_t k_max_block_bytes = 4096;
+constexpr uint8_t k_max_block_length = 64;
+
+// Guest memory range written by a store instruction that is about to run.
+struct StoreRange {
+  uint16_t address;
+  size_t length;
+};
+
+std::optional<StoreRange> pending_store(const Chip8 &em) {
+  uint16_t pc = em.program_counter_;
+  if (pc + 1u >= em.memory_.size()) {
+    return std::nullopt;
+  }
+  Instruction in = decode(static_cast<uint8_t>(em.memory_[pc]),
+                          static_cast<uint8_t>(em.memory_[pc + 1]));
+  if (in.op == Op::LdBVx) {
+    return StoreRange{em.index_register_, 3u};
+  }
+  if (in.op == Op::LdIVx) {
+    return StoreRange{em.index_register_, in.x + 1u};
+  }
+  return std::nullopt;
+}
+
+bool is_terminator(Op op) {
+  switch (op) {
+  case Op::Jp:
+  case Op::SeVxKk:
+  case Op::SneVxKk:
+  case Op::SeVxVy:
+  case Op::SneVxVy:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool is_straight_line(Op op) {
+  switch (op) {
+  case Op::Sys:
+  case Op::LdVxKk:
+  case Op::AddVxKk:
+  case Op::LdVxVy:
+  case Op::Or:
+  case Op::And:
+  case Op::Xor:
+  case Op::AddVxVy:
+  case Op::Sub:
+  case Op::Shr:
+  case Op::Subn:
+  case Op::Shl:
+  case Op::LdI:
+  case Op::LdVxDt:
+  case Op::LdDtVx:
+  case Op::LdStVx:
+  case Op::AddIVx:
+  case Op::LdFVx:
+    return true;
+  default:
+    return false;
+  }
+}
+
+#if defined(CHIP8_RECOMPILER_X86_64)
+
+// Register conventions inside compiled code:
+//   rbx - Chip8 *
+//   r13 - remaining cycle budget
+//   al, cl, eax - scratch
+class Emitter {
+public:
+  explicit Emitter(uint8_t *cursor) : cursor_(cursor) {}
+
+  uint8_t *cursor() const { return cursor_; }
+
+  void bytes(std::initializer_list<uint8_t> values) {
+    for (uint8_t value : values) {
+      *cursor_++ = value;
+    }
+  }
+
+  void imm16(uint16_t value) {
+    std::memcpy(cursor_, &value, sizeof(value));
+    cursor_ += sizeof(value);
+  }
+
+  void imm32(int32_t value) {
+    std::memcpy(cursor_, &value, sizeof(value));
+    cursor_ += sizeof(value);
+  }
+
+  // <opcode...> modrm [rbx + disp32] with `reg` in the modrm reg field.
+  void rbx_mem(std::initializer_list<uint8_t> opcode, uint8_t reg,
+               int32_t disp) {
+    bytes(opcode);
+    bytes({static_cast<uint8_t>(0x80u | (reg << 3u) | 0x3u)});
+    imm32(disp);
+  }
+
+  // Emits a rel32 jump (or a Jcc when `condition` is set) and returns the
+  // address of its displacement for later patching.
+  uint8_t *jump(std::optional<uint8_t> condition = std::nullopt) {
+    if (condition) {
+      bytes({0x0Fu, static_cast<uint8_t>(0x80u | *condition)});
+    } else {
+      bytes({0xE9u});
+    }
+    uint8_t *rel32 = cursor_;
+    imm32(0);
+    return rel32;
+  }
+
+private:
+  uint8_t *cursor_;
+};
+
+// x86 condition codes for Jcc.
+constexpr uint8_t k_cc_equal = 0x4u;
+constexpr uint8_t k_cc_not_equal = 0x5u;
+constexpr uint8_t k_cc_less = 0xCu;
+
+constexpr uint8_t k_reg_al = 0u;
+constexpr uint8_t k_reg_cl = 1u;
+
+void patch_rel32(uint8_t *rel32, const uint8_t *target) {
+  int32_t displacement = static_cast<int32_t>(target - (rel32 + 4));
+  std::memcpy(rel32, &displacement, sizeof(displacement));
+}
+
+// `verb` ("map", "protect") failed on the code buffer with errno `error`.
+common::AppError code_error(const char *verb, int error) {
+  const common::ErrorCode code = error == EACCES || error == EPERM
+                                     ? common::ErrorCode::PermissionDenied
+                                     : common::ErrorCode::InternalError;
+  return common::AppError{code, std::string("Unable to ") + verb +
+                                    " the recompiler's code buffer: " +
+                                    std::generic_category().message(error)};
+}
+
+#endif
+
+} // namespace
+
+Recompiler::Recompiler() {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  void *code = mmap(nullptr, k_code_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) {
+    native_status_ = std::unexpected(code_error("map", errno));
+    return;
+  }
+  code_ = static_cast<uint8_t *>(code);
+  code_size_ = k_code_size;
+  writable_ = true;
+  emit_trampolines();
+#else
+  native_status_ = std::unexpected(
+      common::AppError{common::ErrorCode::InternalError,
+                       "The recompiler only targets x86-64"});
+#endif
+}
+
+Recompiler::Recompiler(Recompiler &&rhs) noexcept
+    : code_(std::exchange(rhs.code_, nullptr)),
+      code_size_(std::exchange(rhs.code_size_, 0u)), writable_(rhs.writable_),
+      native_status_(std::move(rhs.native_status_)), cursor_(rhs.cursor_),
+      blocks_begin_(rhs.blocks_begin_), epilogue_(rhs.epilogue_),
+      enter_(rhs.enter_), offsets_ready_(rhs.offsets_ready_),
+      registers_offset_(rhs.registers_offset_),
+      index_offset_(rhs.index_offset_),
+      program_counter_offset_(rhs.program_counter_offset_),
+      delay_timer_offset_(rhs.delay_timer_offset_),
+      sound_timer_offset_(rhs.sound_timer_offset_),
+      blocks_(std::move(rhs.blocks_)), block_at_(rhs.block_at_),
+      coverage_(rhs.coverage_), links_(std::move(rhs.links_)) {}
+
+Recompiler::~Recompiler() {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  if (code_ != nullptr) {
+    munmap(code_, code_size_);
+  }
+#endif
+}
+
+bool Recompiler::set_writable(bool writable) {
+  if (code_ == nullptr) {
+    return false;
+  }
+  if (writable_ == writable) {
+    return true;
+  }
+#if defined(CHIP8_RECOMPILER_X86_64)
+  const int protection =
+      writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+  if (mprotect(code_, code_size_, protection) != 0) {
+    drop_code(code_error("protect", errno));
+    return false;
+  }
+#endif
+  writable_ = writable;
+  return true;
+}
+
+void Recompiler::drop_code(common::AppError error) {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  munmap(code_, code_size_);
+#endif
+  code_ = nullptr;
+  code_size_ = 0u;
+  native_status_ = std::unexpected(std::move(error));
+  invalidate_all();
+}
+
+bool Recompiler::supported() {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Recompiler::emit_trampolines() {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  Emitter e(code_);
+  // int64_t enter(Chip8 *rdi, int64_t budget rsi, const uint8_t *entry rdx)
+  enter_ = reinterpret_cast<int64_t (*)(Chip8 *, int64_t, const uint8_t *)>(
+      e.cursor());
+  e.bytes({0x53u});              // push rbx
+  e.bytes({0x41u, 0x55u});       // push r13
+  e.bytes({0x48u, 0x89u, 0xFBu}); // mov rbx, rdi
+  e.bytes({0x49u, 0x89u, 0xF5u}); // mov r13, rsi
+  e.bytes({0xFFu, 0xE2u});       // jmp rdx
+
+  epilogue_ = e.cursor();
+  e.bytes({0x4Cu, 0x89u, 0xE8u}); // mov rax, r13
+  e.bytes({0x41u, 0x5Du});       // pop r13
+  e.bytes({0x5Bu});              // pop rbx
+  e.bytes({0xC3u});              // ret
+  blocks_begin_ = e.cursor();
+  cursor_ = blocks_begin_;
+#endif
+}
+
+void Recompiler::compute_offsets(const Chip8 &chip8) {
+  auto offset = [&chip8](const void *member) {
+    return static_cast<int32_t>(static_cast<const char *>(member) -
+                                reinterpret_cast<const char *>(&chip8));
+  };
+  registers_offset_ = offset(chip8.registers_.data());
+  index_offset_ = offset(&chip8.index_register_);
+  program_counter_offset_ = offset(&chip8.program_counter_);
+  delay_timer_offset_ = offset(&chip8.delay_timer_);
+  sound_timer_offset_ = offset(&chip8.sound_timer_);
+  offsets_ready_ = true;
+}
+
+void Recompiler::invalidate_all() {
+  blocks_.clear();
+  block_at_ = {};
+  coverage_ = {};
+  links_.clear();
+  cursor_ = blocks_begin_;
+}
+
+void Recompiler::invalidate(uint16_t address, size_t length) {
+  size_t end = std::min<size_t>(address + length, coverage_.size());
+  bool covered = false;
+  for (size_t i = address; i < end; i++) {
+    covered |= coverage_[i] != 0u;
+  }
+  if (!covered) {
+    return;
+  }
+  // Dropping a block repoints the exits chained into it.
+  if (!set_writable(true)) {
+    return;
+  }
+  for (Block &block : blocks_) {
+    if (!block.live || block.end <= address || block.start >= end) {
+      continue;
+    }
+    block.live = false;
+    block_at_[block.start] = 0u;
+    for (size_t i = block.start; i < block.end; i++) {
+      coverage_[i]--;
+    }
+#if defined(CHIP8_RECOMPILER_X86_64)
+    auto links = links_.find(block.start);
+    if (links != links_.end()) {
+      for (const Link &link : links->second) {
+        patch_rel32(link.rel32, link.stub);
+      }
+    }
+#endif
+  }
+}
+
+const Recompiler::Block *Recompiler::lookup_or_compile(Chip8 &chip8,
+                                                       uint16_t address) {
+  if (address + 1u >= chip8.memory_.size()) {
+    return nullptr;
+  }
+  if (block_at_[address] != 0u) {
+    return &blocks_[block_at_[address] - 1u];
+  }
+  if (!set_writable(true)) {
+    return nullptr;
+  }
+  if (static_cast<size_t>(code_ + code_size_ - cursor_) < k_max_block_bytes) {
+    invalidate_all();
+  }
+  return compile(chip8, address);
+}
+
+const Recompiler::Block *Recompiler::compile(Chip8 &chip8, uint16_t address) {
+#if defined(CHIP8_RECOMPILER_X86_64)
+  // Pass 1: find the extent of the block.
+  std::vector<Instruction> body;
+  uint16_t pc = address;
+  bool terminated = false;
+  while (body.size() < k_max_block_length && pc + 1u < chip8.memory_.size()) {
+    Instruction in = decode(static_cast<uint8_t>(chip8.memory_[pc]),
+                            static_cast<uint8_t>(chip8.memory_[pc + 1]));
+    if (!is_straight_line(in.op) && !is_terminator(in.op)) {
+      break;
+    }
+    body.push_back(in);
+    pc += 2;
+    if (is_terminator(in.op)) {
+      terminated = true;
+      break;
+    }
+  }
+
+  Block block;
+  block.start = address;
+  block.end = body.empty() ? address + 2u : pc;
+  block.length = static_cast<uint8_t>(body.size());
+  block.live = true;
+
+  if (!body.empty()) {
+    Emitter e(cursor_);
+    const int32_t r = registers_offset_;
+    const int32_t vf = r + 0xF;
+    std::vector<std::pair<uint8_t *, uint16_t>> exits;
+
+    block.entry = e.cursor();
+    e.bytes({0x49u, 0x83u, 0xFDu, block.length}); // cmp r13, length
+    uint8_t *out_of_budget = e.jump(k_cc_less);
+    e.bytes({0x49u, 0x83u, 0xEDu, block.length}); // sub r13, length
+
+    for (size_t i = 0; i < body.size(); i++) {
+      const Instruction &in = body[i];
+      uint16_t next = address + 2u * (i + 1u);
+      switch (in.op) {
+      case Op::Sys:
+        break;
+      case Op::LdVxKk:
+        e.rbx_mem({0xC6u}, 0u, r + in.x); // mov byte [Vx], kk
+        e.bytes({in.kk});
+        break;
+      case Op::AddVxKk:
+        e.rbx_mem({0x80u}, 0u, r + in.x); // add byte [Vx], kk
+        e.bytes({in.kk});
+        break;
+      case Op::LdVxVy:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y); // mov al, [Vy]
+        e.rbx_mem({0x88u}, k_reg_al, r + in.x); // mov [Vx], al
+        break;
+      case Op::Or:
+      case Op::And:
+      case Op::Xor: {
+        uint8_t opcode =
+            in.op == Op::Or ? 0x08u : (in.op == Op::And ? 0x20u : 0x30u);
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y);  // mov al, [Vy]
+        e.rbx_mem({opcode}, k_reg_al, r + in.x); // op [Vx], al
+        e.rbx_mem({0xC6u}, 0u, vf);              // mov byte [VF], 0
+        e.bytes({0x00u});
+        break;
+      }
+      case Op::AddVxVy:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y); // mov al, [Vy]
+        e.rbx_mem({0x00u}, k_reg_al, r + in.x); // add [Vx], al
+        e.bytes({0x0Fu, 0x92u, 0xC1u});         // setc cl
+        e.rbx_mem({0x88u}, k_reg_cl, vf);       // mov [VF], cl
+        break;
+      case Op::Sub:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y); // mov al, [Vy]
+        e.rbx_mem({0x28u}, k_reg_al, r + in.x); // sub [Vx], al
+        e.bytes({0x0Fu, 0x93u, 0xC1u});         // setnc cl
+        e.rbx_mem({0x88u}, k_reg_cl, vf);       // mov [VF], cl
+        break;
+      case Op::Subn:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y); // mov al, [Vy]
+        e.rbx_mem({0x2Au}, k_reg_al, r + in.x); // sub al, [Vx]
+        e.bytes({0x0Fu, 0x93u, 0xC1u});         // setnc cl
+        e.rbx_mem({0x88u}, k_reg_al, r + in.x); // mov [Vx], al
+        e.rbx_mem({0x88u}, k_reg_cl, vf);       // mov [VF], cl
+        break;
+      case Op::Shr:
+      case Op::Shl:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.y); // mov al, [Vy]
+        e.bytes({0xD0u, in.op == Op::Shr ? uint8_t{0xE8u}
+                                         : uint8_t{0xE0u}}); // shr/shl al, 1
+        e.bytes({0x0Fu, 0x92u, 0xC1u});                      // setc cl
+        e.rbx_mem({0x88u}, k_reg_al, r + in.x);              // mov [Vx], al
+        e.rbx_mem({0x88u}, k_reg_cl, vf);                    // mov [VF], cl
+        break;
+      case Op::LdI:
+        e.rbx_mem({0x66u, 0xC7u}, 0u, index_offset_); // mov word [I], nnn
+        e.imm16(in.nnn);
+        break;
+      case Op::LdVxDt:
+      case Op::LdDtVx:
+      case Op::LdStVx: {
+        int32_t timer = in.op == Op::LdStVx ? sound_timer_offset_
+                                            : delay_timer_offset_;
+        bool to_register = in.op == Op::LdVxDt;
+        e.rbx_mem({0x8Au}, k_reg_al, to_register ? timer : r + in.x);
+        e.rbx_mem({0x88u}, k_reg_al, to_register ? r + in.x : timer);
+        break;
+      }
+      case Op::AddIVx:
+        e.rbx_mem({0x0Fu, 0xB6u}, 0u, r + in.x);    // movzx eax, byte [Vx]
+        e.rbx_mem({0x66u, 0x01u}, 0u, index_offset_); // add word [I], ax
+        break;
+      case Op::LdFVx:
+        e.rbx_mem({0x0Fu, 0xB6u}, 0u, r + in.x); // movzx eax, byte [Vx]
+        e.bytes({0x8Du, 0x44u, 0x80u, 0x50u});   // lea eax, [rax*5 + 0x50]
+        e.rbx_mem({0x66u, 0x89u}, 0u, index_offset_); // mov word [I], ax
+        break;
+      case Op::Jp:
+        exits.emplace_back(e.jump(), in.nnn);
+        break;
+      case Op::SeVxKk:
+      case Op::SneVxKk:
+        e.rbx_mem({0x80u}, 7u, r + in.x); // cmp byte [Vx], kk
+        e.bytes({in.kk});
+        exits.emplace_back(e.jump(in.op == Op::SeVxKk ? k_cc_equal
+                                                      : k_cc_not_equal),
+                           next + 2u);
+        exits.emplace_back(e.jump(), next);
+        break;
+      case Op::SeVxVy:
+      case Op::SneVxVy:
+        e.rbx_mem({0x8Au}, k_reg_al, r + in.x); // mov al, [Vx]
+        e.rbx_mem({0x3Au}, k_reg_al, r + in.y); // cmp al, [Vy]
+        exits.emplace_back(e.jump(in.op == Op::SeVxVy ? k_cc_equal
+                                                      : k_cc_not_equal),
+                           next + 2u);
+        exits.emplace_back(e.jump(), next);
+        break;
+      default:
+        break;
+      }
+    }
+    if (!terminated) {
+      exits.emplace_back(e.jump(), pc);
+    }
+
+    // Exit stubs: publish the guest pc and return to the dispatcher.
+    auto emit_stub = [&](uint16_t target) {
+      const uint8_t *stub = e.cursor();
+      e.rbx_mem({0x66u, 0xC7u}, 0u, program_counter_offset_);
+      e.imm16(target);
+      patch_rel32(e.jump(), epilogue_);
+      return stub;
+    };
+    patch_rel32(out_of_budget, emit_stub(address));
+    for (auto [rel32, target] : exits) {
+      const uint8_t *stub = emit_stub(target);
+      links_[target].push_back(Link{rel32, stub});
+      bool chained = block_at_[target] != 0u &&
+                     blocks_[block_at_[target] - 1u].entry != nullptr;
+      patch_rel32(rel32,
+                  chained ? blocks_[block_at_[target] - 1u].entry : stub);
+    }
+    cursor_ = e.cursor();
+
+    // Chain every existing exit that was waiting for this address.
+    for (const Link &link : links_[address]) {
+      patch_rel32(link.rel32, block.entry);
+    }
+  }
+
+  blocks_.push_back(block);
+  block_at_[address] = static_cast<uint32_t>(blocks_.size());
+  for (size_t i = block.start; i < block.end; i++) {
+    coverage_[i]++;
+  }
+  return &blocks_.back();
+#else
+  return nullptr;
+#endif
+}
+
+common::Status Recompiler::run(Chip8 &chip8, int cycles) {
+  if (code_ != nullptr && !offsets_ready_) {
+    compute_offsets(chip8);
+  }
+  int64_t budget = cycles;
+  while (budget > 0) {
+    if (chip8.waiting_for_key_press_ || chip8.waiting_for_key_release_ ||
+        chip8.redraw_) {
+      // Every remaining cycle would be a no-op in the interpreter.
+      return {};
+    }
+    const Block *block = code_ != nullptr
+                             ? lookup_or_compile(chip8, chip8.program_counter_)
+                             : nullptr;
+    if (block != nullptr && block->entry != nullptr &&
+        block->length <= budget && set_writable(false)) {
+      int64_t remaining = enter_(&chip8, budget, block->entry);
+      chip8.instructions_executed_ += budget - remaining;
+      budget = remaining;
+      continue;
+    }
+
+    std::optional<StoreRange> store = pending_store(chip8);
+    common::Status status = chip8.execute_cycle();
+    budget--;
+    if (!status) {
+      return status;
+    }
+    if (store) {
+      invalidate(store->address, store->length);
+    }
+  }
+  return {};
+}
+
+} // namespace chip8
@@ -0,0 +1,105 @@
+#ifndef SRC_RECOMPILER_H
+#define SRC_RECOMPILER_H
+
+#include "app_error.h"
+#include "chip8.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace chip8 {
+
+// Dynamic recompiler that translates basic blocks of CHIP-8 code starting at
+// program_counter_ into native x86-64 and chains them with direct jumps.
+// Anything it does not translate (Dxyn, Fx0A, calls, memory stores, ...) is
+// executed one instruction at a time through Chip8::execute_cycle, so the
+// observable behaviour matches the interpreter cycle for cycle.
+//
+// A Recompiler owns code compiled from one machine's memory and must only
+// ever be run against that machine. On hosts other than x86-64 every cycle
+// falls back to the interpreter.
+//
+// The code buffer is never writable and executable at once (W^X): it is
+// mapped read-write, and flipped with mprotect to read-execute before
+// run() enters it and back before anything is compiled or a link patched.
+// If a flip fails, e.g. under SELinux deny_execmem, the buffer is dropped
+// and run() interprets from then on; native_status() says why.
+class Recompiler {
+public:
+  Recompiler();
+  Recompiler(const Recompiler &rhs) = delete;
+  Recompiler(Recompiler &&rhs) noexcept;
+  ~Recompiler();
+
+  // Same semantics as calling chip8.execute_cycle() `cycles` times.
+  common::Status run(Chip8 &chip8, int cycles);
+
+  // Drops compiled code overlapping [address, address + length). Stores made
+  // by instructions run through run() are tracked automatically; call this
+  // after writing memory_ directly.
+  void invalidate(uint16_t address, size_t length);
+  void invalidate_all();
+
+  static bool supported();
+  // OK while run() can use compiled code; otherwise why every cycle is
+  // interpreted (unsupported host, or the buffer could not be mapped or
+  // protected).
+  common::Status native_status() const { return native_status_; }
+
+private:
+  struct Block {
+    uint16_t start = 0u;
+    uint16_t end = 0u;
+    uint8_t length = 0u;
+    const uint8_t *entry = nullptr;
+    bool live = false;
+  };
+
+  // A rel32 jump that leaves a block for guest address `target`. It points
+  // at `stub` (store pc, return to the dispatcher) until a block for
+  // `target` is compiled, and back at `stub` once that block is dropped.
+  struct Link {
+    uint8_t *rel32 = nullptr;
+    const uint8_t *stub = nullptr;
+  };
+
+  const Block *lookup_or_compile(Chip8 &chip8, uint16_t address);
+  const Block *compile(Chip8 &chip8, uint16_t address);
+  void emit_trampolines();
+  void compute_offsets(const Chip8 &chip8);
+  // Makes the code buffer writable (or executable); false, with the buffer
+  // dropped, if that failed or there is no buffer.
+  bool set_writable(bool writable);
+  // Unmaps the code buffer after `error`, falling back to the interpreter.
+  void drop_code(common::AppError error);
+
+  uint8_t *code_ = nullptr;
+  size_t code_size_ = 0u;
+  bool writable_ = false;
+  common::Status native_status_;
+  uint8_t *cursor_ = nullptr;
+  uint8_t *blocks_begin_ = nullptr;
+  const uint8_t *epilogue_ = nullptr;
+  int64_t (*enter_)(Chip8 *, int64_t, const uint8_t *) = nullptr;
+
+  bool offsets_ready_ = false;
+  int32_t registers_offset_ = 0;
+  int32_t index_offset_ = 0;
+  int32_t program_counter_offset_ = 0;
+  int32_t delay_timer_offset_ = 0;
+  int32_t sound_timer_offset_ = 0;
+
+  std::vector<Block> blocks_;
+  // 1-based index into blocks_ of the live block starting at each address.
+  std::array<uint32_t, 4096> block_at_ = {};
+  // Number of live blocks whose code was translated from each byte.
+  std::array<uint16_t, 4096> coverage_ = {};
+  std::unordered_map<uint16_t, std::vector<Link>> links_;
+};
+
+} // namespace chip8
+
+#endif
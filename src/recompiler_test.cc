@@ -0,0 +1,151 @@
+#include "src/recompiler.h"
+#include "src/chip8.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+// True if any mapping in this process is both writable and executable.
+bool has_writable_code() {
+  std::ifstream maps("/proc/self/maps");
+  std::string line;
+  while (std::getline(maps, line)) {
+    // "start-end perms offset ...", perms like "r-xp".
+    std::istringstream fields(line);
+    std::string range;
+    std::string perms;
+    fields >> range >> perms;
+    if (perms.size() >= 3u && perms[1] == 'w' && perms[2] == 'x') {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+class RecompilerTest : public ::testing::Test {
+protected:
+  void load_program(std::initializer_list<uint16_t> program) {
+    for (Chip8 *machine : {&interpreted, &recompiled}) {
+      load_words(*machine, program);
+    }
+  }
+
+  // Runs both machines in frame-sized chunks and checks they never diverge.
+  void run_and_compare(int frames, int cycles_per_frame) {
+    for (int frame = 0; frame < frames; frame++) {
+      for (int i = 0; i < cycles_per_frame; i++) {
+        ASSERT_TRUE(interpreted.execute_cycle());
+      }
+      ASSERT_TRUE(recompiler.run(recompiled, cycles_per_frame));
+      ASSERT_EQ(interpreted.registers_, recompiled.registers_);
+      ASSERT_EQ(interpreted.index_register_, recompiled.index_register_);
+      ASSERT_EQ(interpreted.program_counter_, recompiled.program_counter_);
+      ASSERT_EQ(interpreted.memory_, recompiled.memory_);
+      ASSERT_EQ(interpreted.instructions_executed_,
+                recompiled.instructions_executed_);
+    }
+  }
+
+  Chip8 interpreted;
+  Chip8 recompiled;
+  Recompiler recompiler;
+};
+
+TEST_F(RecompilerTest, ArithmeticLoopMatchesInterpreter) {
+  load_program({
+      0x6005, // 200: LD V0, 05
+      0x6103, // 202: LD V1, 03
+      0x8014, // 204: ADD V0, V1
+      0x8115, // 206: SUB V1, V0
+      0x8206, // 208: SHR V2, V0
+      0x830E, // 20A: SHL V3, V0
+      0x8417, // 20C: SUBN V4, V1
+      0x8511, // 20E: OR V5, V1
+      0x8622, // 210: AND V6, V2
+      0x8733, // 212: XOR V7, V3
+      0x8F14, // 214: ADD VF, V1
+      0xA123, // 216: LD I, 123
+      0xF01E, // 218: ADD I, V0
+      0xF129, // 21A: LD F, V1
+      0x7001, // 21C: ADD V0, 01
+      0x30F0, // 21E: SE V0, F0
+      0x1204, // 220: JP 204
+      0x1222, // 222: JP 222
+  });
+  run_and_compare(200, 10);
+  run_and_compare(20, 7);
+  run_and_compare(5, 250);
+}
+
+TEST_F(RecompilerTest, BudgetIsExact) {
+  load_program({0x7001, 0x7001, 0x7001, 0x7001, 0x7001, 0x7001, 0x7001,
+                0x7001, 0x1200});
+  ASSERT_TRUE(recompiler.run(recompiled, 7));
+  EXPECT_EQ(recompiled.registers_[0], 7);
+  EXPECT_EQ(recompiled.program_counter_, 0x200 + 7 * 2);
+  EXPECT_EQ(recompiled.instructions_executed_, 7u);
+}
+
+TEST_F(RecompilerTest, StoreInvalidatesCompiledBlock) {
+  load_program({
+      0x7001, // 200: ADD V0, 01  (rewritten to ADD V1, 02)
+      0x3003, // 202: SE V0, 03
+      0x1200, // 204: JP 200
+      0x6071, // 206: LD V0, 71
+      0x6102, // 208: LD V1, 02
+      0xA200, // 20A: LD I, 200
+      0xF155, // 20C: LD [I], V1
+      0x1200, // 20E: JP 200
+  });
+  run_and_compare(30, 10);
+  EXPECT_EQ(recompiled.memory_[0x200], std::byte{0x71});
+  EXPECT_GT(recompiled.registers_[1], 0x02);
+}
+
+TEST_F(RecompilerTest, NeverMapsCodeWritableAndExecutable) {
+  if (!Recompiler::supported()) {
+    GTEST_SKIP() << "No recompiler on this host";
+  }
+  // Compiles, chains, then patches and recompiles after the store.
+  load_program({
+      0x7001, // 200: ADD V0, 01  (rewritten to ADD V1, 02)
+      0x3003, // 202: SE V0, 03
+      0x1200, // 204: JP 200
+      0xA200, // 206: LD I, 200
+      0x6171, // 208: LD V1, 71
+      0x6202, // 20A: LD V2, 02
+      0xF255, // 20C: LD [I], V2
+      0x1200, // 20E: JP 200
+  });
+  for (int frame = 0; frame < 10; frame++) {
+    run_and_compare(1, 10);
+    ASSERT_FALSE(has_writable_code()) << "frame " << frame;
+  }
+  EXPECT_TRUE(recompiler.native_status());
+}
+
+TEST_F(RecompilerTest, FallsBackForDraw) {
+  load_program({
+      0x6000, // 200: LD V0, 00
+      0xA050, // 202: LD I, 050
+      0xD005, // 204: DRW V0, V0, 5
+      0x7001, // 206: ADD V0, 01
+      0x1204, // 208: JP 204
+  });
+  for (int frame = 0; frame < 10; frame++) {
+    run_and_compare(1, 10);
+    ASSERT_EQ(interpreted.display_, recompiled.display_);
+    interpreted.redraw_ = false;
+    recompiled.redraw_ = false;
+  }
+}
+
+} // namespace chip8
@@ -0,0 +1,216 @@
+#include "recording.h"
+#include "app_error.h"
+#include "byte_stream.h"
+#include "headless.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+constexpr char k_magic[4] = {'C', '8', 'R', 'C'};
+constexpr uint8_t k_pressed_bit = 0x80u;
+
+common::AppError malformed(const std::string &what) {
+  return common::AppError{common::ErrorCode::InvalidArgument,
+                          "Malformed recording: " + what};
+}
+
+} // namespace
+
+std::vector<std::byte> encode_recording(const Recording &recording) {
+  std::vector<std::byte> out;
+  out.reserve(40u + recording.quirks.size() + 3u * recording.events.size());
+  common::ByteWriter writer(out);
+  writer.bytes(std::string_view(k_magic, sizeof(k_magic)));
+  writer.integer(Recording::k_version);
+  writer.integer(static_cast<uint8_t>(recording.quirks.size()));
+  writer.bytes(recording.quirks);
+  writer.integer(recording.cycles_per_frame);
+  writer.integer(recording.seed);
+  writer.integer(recording.frames);
+  writer.integer(recording.display_hash);
+  writer.integer(static_cast<uint32_t>(recording.events.size()));
+  uint32_t frame = 0u;
+  for (const InputEvent &event : recording.events) {
+    writer.varint(event.frame - frame);
+    writer.varint(event.cycle);
+    writer.integer(static_cast<uint8_t>(event.key |
+                                        (event.pressed ? k_pressed_bit : 0u)));
+    frame = event.frame;
+  }
+  return out;
+}
+
+common::StatusOr<Recording> decode_recording(std::span<const std::byte> bytes) {
+  common::ByteReader reader(bytes);
+  if (reader.string(sizeof(k_magic)) !=
+      std::string_view(k_magic, sizeof(k_magic))) {
+    return std::unexpected(malformed("not a CHIP-8 recording"));
+  }
+  uint8_t version = reader.integer<uint8_t>();
+  if (reader.ok() && version != Recording::k_version) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Unsupported recording version " + std::to_string(version)});
+  }
+  Recording recording;
+  recording.quirks = reader.string(reader.integer<uint8_t>());
+  recording.cycles_per_frame = reader.integer<uint16_t>();
+  recording.seed = reader.integer<uint64_t>();
+  recording.frames = reader.integer<uint32_t>();
+  recording.display_hash = reader.integer<uint64_t>();
+  uint32_t event_count = reader.integer<uint32_t>();
+  if (!reader.ok()) {
+    return std::unexpected(malformed("truncated header"));
+  }
+  // Every event takes at least 3 bytes; don't trust the count further.
+  recording.events.reserve(std::min<size_t>(event_count, bytes.size() / 3u));
+  uint32_t frame = 0u;
+  uint32_t previous_cycle = 0u;
+  for (uint32_t i = 0; i < event_count; i++) {
+    InputEvent event;
+    event.frame = frame + reader.varint();
+    uint32_t cycle = reader.varint();
+    uint8_t key = reader.integer<uint8_t>();
+    if (!reader.ok()) {
+      return std::unexpected(malformed("truncated events"));
+    }
+    if (event.frame < frame || event.frame >= recording.frames ||
+        cycle > recording.cycles_per_frame ||
+        (event.frame == frame && i > 0 && cycle < previous_cycle) ||
+        (key & ~k_pressed_bit) > k_unmapped_key) {
+      return std::unexpected(
+          malformed("event " + std::to_string(i) + " is out of range"));
+    }
+    event.cycle = static_cast<uint16_t>(cycle);
+    event.key = key & ~k_pressed_bit;
+    event.pressed = (key & k_pressed_bit) != 0u;
+    recording.events.push_back(event);
+    frame = event.frame;
+    previous_cycle = cycle;
+  }
+  if (!reader.at_end()) {
+    return std::unexpected(malformed("trailing bytes"));
+  }
+  return recording;
+}
+
+common::Status write_recording(const Recording &recording,
+                               const std::filesystem::path &path) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError,
+        "Unable to open recording output " + path.string()});
+  }
+  std::vector<std::byte> bytes = encode_recording(recording);
+  file.write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError, "Unable to write " + path.string()});
+  }
+  return {};
+}
+
+common::StatusOr<Recording> read_recording(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::NotFound, "Unable to open " + path.string()});
+  }
+  std::vector<char> contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return decode_recording(std::as_bytes(std::span(contents)));
+}
+
+InputRecorder::InputRecorder(std::string_view quirks, uint64_t seed,
+                             int cycles_per_frame) {
+  recording_.quirks = std::string(quirks);
+  recording_.seed = seed;
+  recording_.cycles_per_frame = static_cast<uint16_t>(cycles_per_frame);
+}
+
+void InputRecorder::record(uint8_t key, bool pressed, uint16_t cycle) {
+  recording_.events.push_back({recording_.frames, cycle, key, pressed});
+}
+
+Recording InputRecorder::finish(const Chip8State &chip8) const {
+  Recording recording = recording_;
+  // Keys polled for a frame that never ran (e.g. on quit) did nothing.
+  std::erase_if(recording.events, [&](const InputEvent &event) {
+    return event.frame >= recording.frames;
+  });
+  recording.display_hash = hash_display(chip8);
+  return recording;
+}
+
+template <typename Quirks, typename Checking, typename Display>
+common::Status replay(BasicChip8<Quirks, Checking, Display> &chip8,
+                      const Recording &recording,
+                      const std::function<void(const Chip8State &)> &on_frame) {
+  if (recording.quirks != Quirks::k_name) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Recording was made with " + recording.quirks + " quirks, not " +
+            std::string(Quirks::k_name)});
+  }
+  chip8.seed_random(recording.seed);
+  const int cycles_per_frame = recording.cycles_per_frame;
+  auto event = recording.events.begin();
+  for (uint32_t frame = 0; frame < recording.frames; frame++) {
+    int cycle = 0;
+    for (; event != recording.events.end() && event->frame == frame;
+         ++event) {
+      if (event->cycle > cycle) {
+        common::Status status = chip8.run_cycles(event->cycle - cycle);
+        if (!status)
+          return status;
+        cycle = event->cycle;
+      }
+      chip8.set_key(event->key, event->pressed);
+    }
+    common::Status status =
+        run_headless_frame(chip8, cycles_per_frame - cycle);
+    if (!status)
+      return status;
+    if (on_frame) {
+      on_frame(chip8);
+    }
+  }
+  if (hash_display(chip8) != recording.display_hash) {
+    std::ostringstream message;
+    message << "Replay diverged: final display hash " << std::hex
+            << hash_display(chip8) << ", recorded " << recording.display_hash;
+    return std::unexpected(
+        common::AppError{common::ErrorCode::InternalError, message.str()});
+  }
+  return {};
+}
+
+#define CHIP8_INSTANTIATE(Quirks, Checking, Display)                           \
+  template common::Status replay(                                              \
+      BasicChip8<Quirks, Checking, Display> &, const Recording &,              \
+      const std::function<void(const Chip8State &)> &);
+
+CHIP8_INSTANTIATE(CosmacVipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Checked, ByteDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Unchecked, ByteDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(CosmacVipQuirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(Chip48Quirks, Unchecked, PackedDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Checked, PackedDisplay)
+CHIP8_INSTANTIATE(SuperChipQuirks, Unchecked, PackedDisplay)
+
+#undef CHIP8_INSTANTIATE
+
+} // namespace chip8
@@ -0,0 +1,86 @@
+#ifndef SRC_RECORDING_H
+#define SRC_RECORDING_H
+
+#include "app_error.h"
+#include "chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace chip8 {
+
+// One key transition, applied with Chip8State::set_key() before cycle
+// `cycle` of frame `frame` (both counted from 0).
+struct InputEvent {
+  uint32_t frame = 0u;
+  uint16_t cycle = 0u;
+  uint8_t key = 0u;
+  bool pressed = false;
+
+  bool operator==(const InputEvent &) const = default;
+};
+
+// Everything beyond the ROM that a session depends on: quirk profile, frame
+// length, RNG seed and the key transitions, plus the hash of the final
+// display so a replay can prove it matched.
+//
+// On disk (all integers little-endian):
+//   "C8RC", u8 version, u8 quirks length, quirks name, u16 cycles per frame,
+//   u64 seed, u32 frames, u64 final display hash, u32 event count, then per
+//   event varint(frame - previous event's frame), varint(cycle) and
+//   u8 (key | pressed << 7).
+// Typical events take 3 bytes, so a 10-minute session is a few KB.
+struct Recording {
+  static constexpr uint8_t k_version = 1u;
+
+  std::string quirks;
+  uint16_t cycles_per_frame = 0u;
+  uint64_t seed = 0u;
+  uint32_t frames = 0u;
+  uint64_t display_hash = 0u;
+  std::vector<InputEvent> events;
+};
+
+std::vector<std::byte> encode_recording(const Recording &recording);
+common::StatusOr<Recording> decode_recording(std::span<const std::byte> bytes);
+common::Status write_recording(const Recording &recording,
+                               const std::filesystem::path &path);
+common::StatusOr<Recording> read_recording(const std::filesystem::path &path);
+
+// Builds a Recording while a frontend runs. Seed the machine with seed()
+// before its first cycle, log transitions as they are applied and call
+// end_frame() once per emulated frame.
+class InputRecorder {
+public:
+  InputRecorder(std::string_view quirks, uint64_t seed, int cycles_per_frame);
+
+  uint64_t seed() const { return recording_.seed; }
+  // Logs a transition applied before cycle `cycle` of the current frame.
+  void record(uint8_t key, bool pressed, uint16_t cycle = 0u);
+  void end_frame() { recording_.frames++; }
+  // The recording so far, stamped with the display `chip8` ends on.
+  Recording finish(const Chip8State &chip8) const;
+
+private:
+  Recording recording_;
+};
+
+// Re-runs `recording` on `chip8`, which must hold the same ROM in its
+// power-on state: seeds the RNG, then runs every frame as
+// run_headless_frame() does with each event injected at its cycle, calling
+// `on_frame` (if set) after each. Fails if the final display differs from
+// the recorded one. Instantiated for every machine in chip8.h.
+template <typename Quirks, typename Checking, typename Display>
+common::Status
+replay(BasicChip8<Quirks, Checking, Display> &chip8,
+       const Recording &recording,
+       const std::function<void(const Chip8State &)> &on_frame = {});
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,119 @@
+#include "src/recording.h"
+#include "src/chip8.h"
+#include "src/headless.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <vector>
+
+namespace chip8 {
+
+// Waits for a key, then keeps drawing the pressed key's digit at a random
+// column while the key is held.
+constexpr uint16_t k_program[] = {
+    0xF00A, // 200: LD V0, K
+    0xF029, // 202: LD F, V0
+    0xC13F, // 204: RND V1, 3F
+    0xD125, // 206: DRW V1, V2, 5
+    0x7201, // 208: ADD V2, 01
+    0xE09E, // 20A: SKP V0
+    0x1200, // 20C: JP 200
+    0x1202, // 20E: JP 202
+};
+
+class RecordingTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    load(chip8);
+    load(replayed);
+  }
+
+  static void load(Chip8 &machine) {
+    ASSERT_TRUE(machine.load_program(program_bytes(k_program)));
+  }
+
+  // Runs a session the way main.cc does: keys arrive before the frame's
+  // first cycle and the recorder sees every transition.
+  Recording record(int frames) {
+    InputRecorder recorder(CosmacVipQuirks::k_name, 42u,
+                           k_default_cycles_per_frame);
+    chip8.seed_random(recorder.seed());
+    for (int frame = 0; frame < frames; frame++) {
+      if (frame % 30 == 5) {
+        uint8_t key = static_cast<uint8_t>(frame % k_num_keys);
+        chip8.set_key(key, true);
+        recorder.record(key, true);
+      } else if (frame % 30 == 20) {
+        uint8_t key = static_cast<uint8_t>((frame - 15) % k_num_keys);
+        chip8.set_key(key, false);
+        recorder.record(key, false);
+        chip8.set_key(k_unmapped_key, true);
+        recorder.record(k_unmapped_key, true);
+      }
+      EXPECT_TRUE(run_headless_frame(chip8));
+      recorder.end_frame();
+    }
+    return recorder.finish(chip8);
+  }
+
+  Chip8 chip8;
+  Chip8 replayed;
+};
+
+TEST_F(RecordingTest, ReplayReproducesDisplay) {
+  Recording recording = record(600);
+  ASSERT_FALSE(recording.events.empty());
+
+  ASSERT_TRUE(replay(replayed, recording));
+  EXPECT_EQ(replayed.display_, chip8.display_);
+  EXPECT_EQ(replayed.registers_, chip8.registers_);
+}
+
+TEST_F(RecordingTest, EncodeDecodeRoundTrip) {
+  Recording recording = record(300);
+  recording.events.push_back({299u, 7u, 3u, true});
+  std::vector<std::byte> bytes = encode_recording(recording);
+  EXPECT_LT(bytes.size(), 48u + 3u * recording.events.size());
+
+  common::StatusOr<Recording> decoded = decode_recording(bytes);
+  ASSERT_TRUE(decoded.has_value()) << decoded.error();
+  EXPECT_EQ(decoded->quirks, recording.quirks);
+  EXPECT_EQ(decoded->cycles_per_frame, recording.cycles_per_frame);
+  EXPECT_EQ(decoded->seed, recording.seed);
+  EXPECT_EQ(decoded->frames, recording.frames);
+  EXPECT_EQ(decoded->display_hash, recording.display_hash);
+  EXPECT_EQ(decoded->events, recording.events);
+
+  bytes.pop_back();
+  EXPECT_FALSE(decode_recording(bytes).has_value());
+}
+
+TEST_F(RecordingTest, ReplayDetectsDivergence) {
+  Recording recording = record(120);
+  recording.seed++;
+  common::Status status = replay(replayed, recording);
+  ASSERT_FALSE(status);
+  EXPECT_NE(status.error().message.find("diverged"), std::string::npos);
+}
+
+TEST_F(RecordingTest, SubFrameEventsApplyAtTheirCycle) {
+  Recording recording;
+  recording.quirks = CosmacVipQuirks::k_name;
+  recording.cycles_per_frame = k_default_cycles_per_frame;
+  recording.frames = 1u;
+  recording.events = {{0u, 4u, 7u, true}};
+
+  // Fx0A stalls the first 4 cycles, then the press lands mid-frame.
+  replayed.seed_random(recording.seed);
+  ASSERT_TRUE(replayed.run_cycles(4));
+  replayed.set_key(7u, true);
+  ASSERT_TRUE(run_headless_frame(replayed, k_default_cycles_per_frame - 4));
+  recording.display_hash = hash_display(replayed);
+  uint64_t executed = replayed.instructions_executed_;
+
+  ASSERT_TRUE(replay(chip8, recording));
+  EXPECT_EQ(chip8.registers_[0], 7u);
+  EXPECT_EQ(chip8.instructions_executed_, executed);
+}
+
+} // namespace chip8
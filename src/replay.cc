@@ -0,0 +1,116 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "AV_system.h"
+#include "app_error.h"
+#include "capture.h"
+#include "chip8.h"
+#include "quirks.h"
+#include "recording.h"
+
+namespace {
+
+// Replays `recording` against `rom` as fast as the core runs and reports
+// how long it took compared to the session's wall-clock length. With
+// `capture_path` every frame is also written there as video.
+template <typename Quirks>
+int replay(const std::filesystem::path &rom,
+           const chip8::Recording &recording,
+           const std::optional<std::filesystem::path> &capture_path) {
+  chip8::BasicChip8<Quirks> chip8;
+  common::Status load_status = chip8.load_rom(rom);
+  if (!load_status) {
+    std::cerr << "Error when loading rom: " << load_status.error() << std::endl;
+    return -1;
+  }
+  std::unique_ptr<chip8::FrameCapture> capture;
+  if (capture_path) {
+    auto opened = chip8::FrameCapture::open(
+        *capture_path, chip8::capture_format_for(*capture_path));
+    if (!opened) {
+      std::cerr << "Error when opening the capture: " << opened.error()
+                << std::endl;
+      return -1;
+    }
+    capture = std::move(*opened);
+  }
+  chip8::CaptureSystem system(64, 32);
+  system.attach(capture.get());
+  chip8::Frame frame;
+  auto present = [&](const chip8::Chip8State &state) {
+    chip8::update_frame(state, frame);
+    chip8.dirty_rows_ = 0u;
+    system.present(frame);
+    frame.number++;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  common::Status status = chip8::replay(
+      chip8, recording,
+      capture ? std::function<void(const chip8::Chip8State &)>(present)
+              : nullptr);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (capture) {
+    common::Status capture_status = capture->finish();
+    if (!capture_status) {
+      std::cerr << "Error when writing the capture: " << capture_status.error()
+                << std::endl;
+      return -1;
+    }
+  }
+  if (!status) {
+    std::cerr << status.error() << std::endl;
+    return -1;
+  }
+  std::cout << "Replayed " << recording.frames << " frames ("
+            << recording.frames / 60.0 << " s at 60 Hz) and "
+            << recording.events.size() << " key events in " << elapsed.count()
+            << " ms; the final display matches." << std::endl;
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string_view> positional;
+  std::optional<std::filesystem::path> capture_path;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (arg.starts_with("--capture=")) {
+      capture_path = arg.substr(std::string_view("--capture=").size());
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() < 2) {
+    std::cerr << "Usage: replay <rom> <recording> [--capture=<out.y4m|out.c8v>]"
+              << std::endl;
+    return -1;
+  }
+  std::filesystem::path rom(positional[0]);
+  common::StatusOr<chip8::Recording> recording =
+      chip8::read_recording(positional[1]);
+  if (!recording) {
+    std::cerr << "Error when reading the recording: " << recording.error()
+              << std::endl;
+    return -1;
+  }
+  std::string_view quirks = recording->quirks;
+  if (quirks == chip8::CosmacVipQuirks::k_name) {
+    return replay<chip8::CosmacVipQuirks>(rom, *recording, capture_path);
+  }
+  if (quirks == chip8::Chip48Quirks::k_name) {
+    return replay<chip8::Chip48Quirks>(rom, *recording, capture_path);
+  }
+  if (quirks == chip8::SuperChipQuirks::k_name) {
+    return replay<chip8::SuperChipQuirks>(rom, *recording, capture_path);
+  }
+  std::cerr << "Recording uses unknown quirk profile " << quirks << std::endl;
+  return -1;
+}
@@ -0,0 +1,261 @@
+#include "rom_analysis.h"
+#include "instruction.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace chip8 {
+namespace {
+
+constexpr size_t k_address_space = 0x10000;
+
+// The machine an opcode decode() has no Op for first appeared on; Vip when
+// it is plain CHIP-8 or defined nowhere.
+RomProfile extension_of(uint16_t opcode) {
+  const uint8_t kk = opcode & 0xFFu;
+  const uint8_t n = opcode & 0xFu;
+  switch (opcode >> 12u) {
+  case 0x0u:
+    if ((opcode & 0xFFF0u) == 0x00D0u) {
+      return RomProfile::XoChip;
+    }
+    if (((opcode & 0xFFF0u) == 0x00C0u && n != 0u) ||
+        (opcode >= 0x00FBu && opcode <= 0x00FFu)) {
+      return RomProfile::SuperChip;
+    }
+    return RomProfile::Vip;
+  case 0x5u:
+    return n == 0x2u || n == 0x3u ? RomProfile::XoChip : RomProfile::Vip;
+  case 0xDu:
+    return n == 0u ? RomProfile::SuperChip : RomProfile::Vip;
+  case 0xFu:
+    if (opcode == 0xF000u || opcode == 0xF002u || kk == 0x01u ||
+        kk == 0x3Au) {
+      return RomProfile::XoChip;
+    }
+    if (kk == 0x30u || kk == 0x75u || kk == 0x85u) {
+      return RomProfile::SuperChip;
+    }
+    return RomProfile::Vip;
+  default:
+    return RomProfile::Vip;
+  }
+}
+
+// Reads the program as the cores see it once loaded at `origin`.
+class Image {
+public:
+  Image(std::span<const std::byte> program, uint16_t origin,
+        RomProfile machine)
+      : program_(program), origin_(origin), machine_(machine) {}
+
+  RomProfile machine() const { return machine_; }
+  // Bytes taken by the instruction at `address`.
+  uint16_t size_at(uint32_t address) const {
+    return instruction_size(opcode(address), machine_);
+  }
+
+  // True if a whole opcode starts at `address`.
+  bool contains(uint32_t address) const {
+    return address >= origin_ && address - origin_ + 2u <= program_.size();
+  }
+  uint16_t opcode(uint32_t address) const {
+    const size_t offset = address - origin_;
+    return static_cast<uint16_t>(std::to_integer<uint16_t>(program_[offset])
+                                     << 8u |
+                                 std::to_integer<uint16_t>(
+                                     program_[offset + 1u]));
+  }
+  // Where a skip at `address` lands when taken.
+  uint32_t skip_target(uint32_t address) const {
+    const uint32_t next = address + 2u;
+    return next + (contains(next) ? size_at(next) : 2u);
+  }
+
+private:
+  std::span<const std::byte> program_;
+  uint16_t origin_;
+  RomProfile machine_;
+};
+
+// How the instruction at `address` leaves it, with `target` set for Jump,
+// Call and Skip. FallThrough for everything that runs on to the next one.
+BlockExit exit_of(const Image &image, uint32_t address, uint32_t &target) {
+  const uint16_t opcode = image.opcode(address);
+  const RomProfile extension = extension_of(opcode);
+  if (extension != RomProfile::Vip && extension <= image.machine()) {
+    return opcode == 0x00FDu ? BlockExit::Stop : BlockExit::FallThrough;
+  }
+  const Instruction instruction = decode(opcode >> 8u, opcode & 0xFFu);
+  switch (instruction.op) {
+  case Op::Jp:
+    target = instruction.nnn;
+    return BlockExit::Jump;
+  case Op::Call:
+    target = instruction.nnn;
+    return BlockExit::Call;
+  case Op::Ret:
+    return BlockExit::Return;
+  case Op::JpV0:
+    return BlockExit::Computed;
+  case Op::SeVxKk:
+  case Op::SneVxKk:
+  case Op::SeVxVy:
+  case Op::SneVxVy:
+  case Op::Skp:
+  case Op::Sknp:
+    target = image.skip_target(address);
+    return BlockExit::Skip;
+  case Op::InvalidRegisterOp:
+  case Op::InvalidKeyOp:
+  case Op::InvalidFOp:
+    return BlockExit::Stop;
+  default:
+    return BlockExit::FallThrough;
+  }
+}
+
+} // namespace
+
+std::string_view profile_name(RomProfile profile) {
+  switch (profile) {
+  case RomProfile::Vip:
+    return "vip";
+  case RomProfile::SuperChip:
+    return "schip";
+  case RomProfile::XoChip:
+    return "xochip";
+  }
+  return "vip";
+}
+
+const BasicBlock *ControlFlowGraph::find(uint16_t address) const {
+  auto it = std::lower_bound(
+      blocks.begin(), blocks.end(), address,
+      [](const BasicBlock &block, uint16_t a) { return block.start < a; });
+  return it != blocks.end() && it->start == address ? &*it : nullptr;
+}
+
+ControlFlowGraph recover_cfg(std::span<const std::byte> program,
+                             uint16_t origin, RomProfile machine) {
+  const Image image(program, origin, machine);
+  ControlFlowGraph cfg;
+  cfg.origin = origin;
+
+  // Walk every path once, marking each instruction reached and each address
+  // control can arrive at other than from the instruction before it.
+  std::vector<bool> visited(k_address_space, false);
+  std::vector<bool> leader(k_address_space, false);
+  std::vector<uint32_t> worklist = {origin};
+  leader[origin] = true;
+  auto branch_to = [&](uint32_t address) {
+    if (image.contains(address)) {
+      leader[address] = true;
+      worklist.push_back(address);
+    }
+  };
+  while (!worklist.empty()) {
+    uint32_t address = worklist.back();
+    worklist.pop_back();
+    while (image.contains(address) && !visited[address]) {
+      visited[address] = true;
+      const uint32_t next = address + image.size_at(address);
+      uint32_t target = 0u;
+      const BlockExit exit = exit_of(image, address, target);
+      if (exit == BlockExit::FallThrough) {
+        address = next;
+        continue;
+      }
+      if (exit == BlockExit::Jump || exit == BlockExit::Call ||
+          exit == BlockExit::Skip) {
+        branch_to(target);
+      }
+      if (exit == BlockExit::Call || exit == BlockExit::Skip) {
+        branch_to(next);
+      }
+      break;
+    }
+  }
+
+  // Cut the visited instructions into blocks at the leaders.
+  for (uint32_t start = origin; start < k_address_space; start++) {
+    if (!visited[start] || !leader[start]) {
+      continue;
+    }
+    BasicBlock block{.start = static_cast<uint16_t>(start)};
+    uint32_t address = start;
+    while (true) {
+      const uint32_t next = address + image.size_at(address);
+      uint32_t target = 0u;
+      block.exit = exit_of(image, address, target);
+      block.end = next;
+      block.target = target;
+      block.next = next;
+      if (block.exit != BlockExit::FallThrough || next >= k_address_space ||
+          !visited[next] || leader[next]) {
+        break;
+      }
+      address = next;
+    }
+    cfg.blocks.push_back(block);
+  }
+  return cfg;
+}
+
+RomAnalysis analyse_rom(std::span<const std::byte> program, uint16_t origin) {
+  const Image image(program, origin, RomProfile::XoChip);
+  const ControlFlowGraph cfg = recover_cfg(program, origin);
+  RomAnalysis analysis;
+  analysis.blocks = static_cast<uint32_t>(cfg.blocks.size());
+  for (const BasicBlock &block : cfg.blocks) {
+    for (uint32_t address = block.start; address < block.end;) {
+      const uint16_t opcode = image.opcode(address);
+      address += instruction_size(opcode);
+      analysis.reachable_instructions++;
+      analysis.profile = std::max(analysis.profile, extension_of(opcode));
+      switch (decode(opcode >> 8u, opcode & 0xFFu).op) {
+      case Op::Call:
+        analysis.features |= k_feature_subroutines;
+        break;
+      case Op::JpV0:
+        analysis.features |= k_feature_computed_jump;
+        break;
+      case Op::Or:
+      case Op::And:
+      case Op::Xor:
+        analysis.features |= k_feature_logic_ops;
+        break;
+      case Op::Shr:
+      case Op::Shl:
+        analysis.features |= k_feature_shifts;
+        break;
+      case Op::LdIVx:
+        analysis.features |= k_feature_load_store | k_feature_memory_writes;
+        break;
+      case Op::LdVxI:
+        analysis.features |= k_feature_load_store;
+        break;
+      case Op::LdBVx:
+        analysis.features |= k_feature_memory_writes;
+        break;
+      case Op::LdVxK:
+        analysis.features |= k_feature_key_wait;
+        break;
+      case Op::Rnd:
+        analysis.features |= k_feature_random;
+        break;
+      case Op::LdStVx:
+        analysis.features |= k_feature_sound;
+        break;
+      case Op::Drw:
+        analysis.features |= k_feature_draws;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return analysis;
+}
+
+} // namespace chip8
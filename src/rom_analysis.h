@@ -0,0 +1,104 @@
+#ifndef SRC_ROM_ANALYSIS_H
+#define SRC_ROM_ANALYSIS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace chip8 {
+
+// Where every core loads a program.
+constexpr uint16_t k_rom_origin = 0x200;
+
+// The oldest machine a ROM's reachable code needs. SUPER-CHIP and XO-CHIP
+// are recognised by their opcodes (00Cn, 00FB-00FF, Dxy0, Fx30/75/85;
+// 00Dn, 5xy2/5xy3, F000 nnnn, Fn01, F002, Fx3A). A plain CHIP-8 ROM is
+// Vip; nothing in the code tells it apart from one written for CHIP-48.
+enum class RomProfile : uint8_t { Vip, SuperChip, XoChip };
+
+// The quirk profile name main.cc takes for `profile` ("vip", "schip",
+// "xochip").
+std::string_view profile_name(RomProfile profile);
+
+// What the reachable code uses, as bits of RomAnalysis::features. Most
+// map onto the quirk (see quirks.h) whose setting changes the result.
+constexpr uint32_t k_feature_subroutines = 1u << 0u;   // 2nnn
+constexpr uint32_t k_feature_computed_jump = 1u << 1u; // Bnnn, jump quirk
+constexpr uint32_t k_feature_logic_ops = 1u << 2u;     // 8xy1-3, VF reset
+constexpr uint32_t k_feature_shifts = 1u << 3u;        // 8xy6/8xyE
+constexpr uint32_t k_feature_load_store = 1u << 4u;    // Fx55/Fx65, I
+constexpr uint32_t k_feature_memory_writes = 1u << 5u; // Fx33/Fx55
+constexpr uint32_t k_feature_key_wait = 1u << 6u;      // Fx0A
+constexpr uint32_t k_feature_random = 1u << 7u;        // Cxkk
+constexpr uint32_t k_feature_sound = 1u << 8u;         // Fx18
+constexpr uint32_t k_feature_draws = 1u << 9u;         // Dxyn
+
+// Bytes taken by the instruction starting with `opcode` on `machine`: 4 for
+// XO-CHIP's F000 nnnn, 2 for everything else.
+inline uint16_t instruction_size(uint16_t opcode,
+                                 RomProfile machine = RomProfile::XoChip) {
+  return opcode == 0xF000u && machine == RomProfile::XoChip ? 4u : 2u;
+}
+
+// How a basic block hands over control.
+enum class BlockExit : uint8_t {
+  FallThrough, // runs into `next`, which starts another block
+  Jump,        // 1nnn to `target`
+  Call,        // 2nnn to `target`; 00EE comes back to `next`
+  Skip,        // a conditional skip: `next` if not taken, `target` if taken
+  Return,      // 00EE; the stack decides
+  Computed,    // Bnnn; a register decides
+  Stop,        // 00FD or an opcode no machine defines
+};
+
+// A run of instructions entered only at `start` and left only by the last
+// one. Covers [start, end). `end`, `next` and a skip's `target` are 32 bits
+// because a block can run to the very end of a full-size image, 0x10000.
+struct BasicBlock {
+  uint16_t start = 0u;
+  uint32_t end = 0u;
+  BlockExit exit = BlockExit::Stop;
+  uint32_t target = 0u;
+  uint32_t next = 0u;
+};
+
+// The code statically reachable from `origin`, following every jump, call,
+// return site and skip whose destination lies inside the image. Bnnn
+// targets and anything built or changed at run time are not found, so a
+// successor that is not itself a block start leaves the recovered code.
+struct ControlFlowGraph {
+  uint16_t origin = k_rom_origin;
+  // Sorted by start. Blocks only overlap when code jumps into the middle of
+  // another instruction.
+  std::vector<BasicBlock> blocks;
+
+  // The block starting at `address`, or nullptr.
+  const BasicBlock *find(uint16_t address) const;
+};
+
+// `program` is the image as loaded at `origin`. `machine` is the instruction
+// set followed: XoChip knows every extension, while Vip decodes everything
+// as BasicChip8 does, e.g. 5xy2 as a skip and F000 as a 2-byte invalid
+// opcode.
+ControlFlowGraph recover_cfg(std::span<const std::byte> program,
+                             uint16_t origin = k_rom_origin,
+                             RomProfile machine = RomProfile::XoChip);
+
+// What the ROM index keeps per ROM.
+struct RomAnalysis {
+  RomProfile profile = RomProfile::Vip;
+  uint32_t features = 0u;
+  uint32_t reachable_instructions = 0u;
+  uint32_t blocks = 0u;
+
+  bool operator==(const RomAnalysis &) const = default;
+};
+
+RomAnalysis analyse_rom(std::span<const std::byte> program,
+                        uint16_t origin = k_rom_origin);
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,158 @@
+#include "src/rom_analysis.h"
+#include "src/rom_image.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <vector>
+
+namespace chip8 {
+
+TEST(RomAnalysisTest, SplitsBlocksAtBranchesAndTheirTargets) {
+  std::vector<std::byte> rom = program_bytes({
+      0x6000, // 200: LD V0, 0
+      0x2208, // 202: CALL 208
+      0x3005, // 204: SE V0, 5
+      0x1202, // 206: JP 202
+      0x7001, // 208: ADD V0, 1
+      0x00EE, // 20A: RET
+      0xFFFF, // 20C: never reached
+  });
+  ControlFlowGraph cfg = recover_cfg(rom);
+  ASSERT_EQ(cfg.blocks.size(), 5u);
+
+  const BasicBlock *entry = cfg.find(0x200);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->end, 0x202u);
+  EXPECT_EQ(entry->exit, BlockExit::FallThrough);
+  EXPECT_EQ(entry->next, 0x202u);
+
+  const BasicBlock *call = cfg.find(0x202);
+  ASSERT_NE(call, nullptr);
+  EXPECT_EQ(call->exit, BlockExit::Call);
+  EXPECT_EQ(call->target, 0x208u);
+  EXPECT_EQ(call->next, 0x204u);
+
+  const BasicBlock *skip = cfg.find(0x204);
+  ASSERT_NE(skip, nullptr);
+  EXPECT_EQ(skip->exit, BlockExit::Skip);
+  EXPECT_EQ(skip->next, 0x206u);
+  EXPECT_EQ(skip->target, 0x208u);
+
+  const BasicBlock *loop = cfg.find(0x206);
+  ASSERT_NE(loop, nullptr);
+  EXPECT_EQ(loop->exit, BlockExit::Jump);
+  EXPECT_EQ(loop->target, 0x202u);
+
+  const BasicBlock *subroutine = cfg.find(0x208);
+  ASSERT_NE(subroutine, nullptr);
+  EXPECT_EQ(subroutine->end, 0x20Cu);
+  EXPECT_EQ(subroutine->exit, BlockExit::Return);
+  EXPECT_EQ(cfg.find(0x20C), nullptr);
+}
+
+TEST(RomAnalysisTest, StopsAtComputedJumpsAndTheImageEdge) {
+  std::vector<std::byte> rom = program_bytes({
+      0x1300, // 200: JP 300, outside the image
+      0xB204, // 202: unreachable
+  });
+  ControlFlowGraph cfg = recover_cfg(rom);
+  ASSERT_EQ(cfg.blocks.size(), 1u);
+  EXPECT_EQ(cfg.blocks[0].exit, BlockExit::Jump);
+  EXPECT_EQ(cfg.find(0x300), nullptr);
+
+  cfg = recover_cfg(program_bytes({0x6000, 0xB204, 0x6100}));
+  ASSERT_EQ(cfg.blocks.size(), 1u);
+  EXPECT_EQ(cfg.blocks[0].exit, BlockExit::Computed);
+  EXPECT_EQ(cfg.blocks[0].end, 0x204u);
+}
+
+TEST(RomAnalysisTest, SkipsOverTheFourByteLongLoad) {
+  std::vector<std::byte> rom = program_bytes({
+      0x3000, // 200: SE V0, 0
+      0xF000, // 202: LD I, long
+      0x1234,
+      0x00FD, // 206: EXIT
+  });
+  ControlFlowGraph cfg = recover_cfg(rom);
+  const BasicBlock *skip = cfg.find(0x200);
+  ASSERT_NE(skip, nullptr);
+  EXPECT_EQ(skip->target, 0x206u);
+  const BasicBlock *long_load = cfg.find(0x202);
+  ASSERT_NE(long_load, nullptr);
+  EXPECT_EQ(long_load->end, 0x206u);
+  const BasicBlock *exit = cfg.find(0x206);
+  ASSERT_NE(exit, nullptr);
+  EXPECT_EQ(exit->exit, BlockExit::Stop);
+}
+
+TEST(RomAnalysisTest, FollowsTheVipDecodingOnVip) {
+  std::vector<std::byte> rom = program_bytes({
+      0x5012, // 200: SE V0, V1 on the VIP, XO-CHIP's save elsewhere
+      0xF000, // 202: invalid on the VIP
+      0x1234, // 204: JP 234, where the skip lands
+  });
+  ControlFlowGraph cfg = recover_cfg(rom, k_rom_origin, RomProfile::Vip);
+  ASSERT_EQ(cfg.blocks.size(), 3u);
+  const BasicBlock *skip = cfg.find(0x200);
+  ASSERT_NE(skip, nullptr);
+  EXPECT_EQ(skip->exit, BlockExit::Skip);
+  EXPECT_EQ(skip->target, 0x204u);
+  const BasicBlock *invalid = cfg.find(0x202);
+  ASSERT_NE(invalid, nullptr);
+  EXPECT_EQ(invalid->end, 0x204u);
+  EXPECT_EQ(invalid->exit, BlockExit::Stop);
+}
+
+TEST(RomAnalysisTest, CoversABlockRunningToTheEndOfAFullSizeImage) {
+  // Straight-line code filling the image, ending in XO-CHIP's F002.
+  std::vector<std::byte> rom;
+  while (rom.size() + 2u < k_max_rom_size) {
+    rom.push_back(std::byte{0x60});
+    rom.push_back(std::byte{0x00});
+  }
+  rom.push_back(std::byte{0xF0});
+  rom.push_back(std::byte{0x02});
+  ControlFlowGraph cfg = recover_cfg(rom);
+  ASSERT_EQ(cfg.blocks.size(), 1u);
+  EXPECT_EQ(cfg.blocks[0].end, 0x10000u);
+  EXPECT_EQ(cfg.blocks[0].next, 0x10000u);
+
+  RomAnalysis analysis = analyse_rom(rom);
+  EXPECT_EQ(analysis.reachable_instructions, k_max_rom_size / 2u);
+  EXPECT_EQ(analysis.profile, RomProfile::XoChip);
+}
+
+TEST(RomAnalysisTest, DetectsTheProfileFromReachableCode) {
+  RomAnalysis vip = analyse_rom(program_bytes({0x6000, 0xD015, 0x1202}));
+  EXPECT_EQ(vip.profile, RomProfile::Vip);
+  EXPECT_EQ(vip.reachable_instructions, 3u);
+  EXPECT_EQ(vip.blocks, 2u);
+
+  // 00FF is only reachable through the jump.
+  RomAnalysis schip = analyse_rom(program_bytes({0x1204, 0xF301, 0x00FF}));
+  EXPECT_EQ(schip.profile, RomProfile::SuperChip);
+  EXPECT_EQ(profile_name(schip.profile), "schip");
+  EXPECT_EQ(schip.reachable_instructions, 2u);
+
+  RomAnalysis xochip = analyse_rom(program_bytes({0x00FF, 0xF201, 0x00FD}));
+  EXPECT_EQ(xochip.profile, RomProfile::XoChip);
+  EXPECT_EQ(profile_name(xochip.profile), "xochip");
+}
+
+TEST(RomAnalysisTest, RecordsQuirkSensitiveFeatures) {
+  RomAnalysis analysis = analyse_rom(program_bytes({
+      0x8016, // SHR V0, V1
+      0x8012, // AND V0, V1
+      0xF255, // LD [I], V2
+      0xF00A, // LD V0, K
+      0x2208, // CALL 208
+      0x00EE, // RET
+  }));
+  EXPECT_EQ(analysis.features,
+            k_feature_shifts | k_feature_logic_ops | k_feature_load_store |
+                k_feature_memory_writes | k_feature_key_wait |
+                k_feature_subroutines);
+  EXPECT_EQ(analysis.features & k_feature_computed_jump, 0u);
+}
+
+} // namespace chip8
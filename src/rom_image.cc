@@ -0,0 +1,149 @@
+#include "rom_image.h"
+#include "app_error.h"
+
+#include <cerrno>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define CHIP8_ROM_IMAGE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace chip8 {
+namespace {
+
+common::AppError too_large(const std::filesystem::path &path, size_t size,
+                           size_t max_size) {
+  return common::AppError{common::ErrorCode::InvalidArgument,
+                          path.string() + " is " + std::to_string(size) +
+                              " bytes; at most " + std::to_string(max_size) +
+                              " fit in memory"};
+}
+
+// `verb` ("open", "map") failed on `path` with errno `error`.
+common::AppError system_error(const char *verb,
+                              const std::filesystem::path &path, int error) {
+  common::ErrorCode code = common::ErrorCode::IOError;
+  if (error == ENOENT) {
+    code = common::ErrorCode::NotFound;
+  } else if (error == EACCES) {
+    code = common::ErrorCode::PermissionDenied;
+  }
+  return common::AppError{code, std::string("Unable to ") + verb + " " +
+                                    path.string() + ": " +
+                                    std::generic_category().message(error)};
+}
+
+} // namespace
+
+uint64_t hash_bytes(std::span<const std::byte> bytes) {
+  uint64_t hash = 0xCBF29CE484222325u;
+  for (std::byte byte : bytes) {
+    hash ^= std::to_integer<uint64_t>(byte);
+    hash *= 0x100000001B3u;
+  }
+  return hash;
+}
+
+#ifdef CHIP8_ROM_IMAGE_MMAP
+
+common::StatusOr<RomImage> RomImage::open(const std::filesystem::path &path,
+                                          size_t max_size) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::unexpected(system_error("open", path, errno));
+  }
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    ::close(fd);
+    return std::unexpected(
+        common::AppError{common::ErrorCode::InvalidArgument,
+                         path.string() + " is not a regular file"});
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  if (size > max_size) {
+    ::close(fd);
+    return std::unexpected(too_large(path, size, max_size));
+  }
+  RomImage image;
+  // mmap rejects an empty length; an empty ROM is just an empty span.
+  if (size > 0u) {
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      int error = errno;
+      ::close(fd);
+      return std::unexpected(system_error("map", path, error));
+    }
+    image.data_ = static_cast<const std::byte *>(data);
+    image.mapped_ = true;
+  }
+  // The mapping outlives the descriptor.
+  ::close(fd);
+  image.size_ = size;
+  image.hash_ = hash_bytes(image.bytes());
+  return image;
+}
+
+void RomImage::release() {
+  if (mapped_) {
+    munmap(const_cast<std::byte *>(data_), size_);
+  }
+}
+
+#else
+
+common::StatusOr<RomImage> RomImage::open(const std::filesystem::path &path,
+                                          size_t max_size) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return std::unexpected(system_error("open", path, errno));
+  }
+  size_t size = static_cast<size_t>(file.tellg());
+  if (size > max_size) {
+    return std::unexpected(too_large(path, size, max_size));
+  }
+  RomImage image;
+  image.copy_.resize(size);
+  file.seekg(0, std::ios::beg);
+  file.read(reinterpret_cast<char *>(image.copy_.data()), size);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError, "Failed to read ROM bytes from file"});
+  }
+  image.data_ = image.copy_.data();
+  image.size_ = size;
+  image.hash_ = hash_bytes(image.bytes());
+  return image;
+}
+
+void RomImage::release() {}
+
+#endif
+
+RomImage::RomImage(RomImage &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0u)),
+      mapped_(std::exchange(other.mapped_, false)),
+      copy_(std::move(other.copy_)), hash_(other.hash_) {}
+
+RomImage &RomImage::operator=(RomImage &&other) noexcept {
+  if (this != &other) {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0u);
+    mapped_ = std::exchange(other.mapped_, false);
+    copy_ = std::move(other.copy_);
+    hash_ = other.hash_;
+  }
+  return *this;
+}
+
+RomImage::~RomImage() { release(); }
+
+} // namespace chip8
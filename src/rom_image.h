@@ -0,0 +1,55 @@
+#ifndef SRC_ROM_IMAGE_H
+#define SRC_ROM_IMAGE_H
+
+#include "app_error.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace chip8 {
+
+// The largest program any core can hold: XO-CHIP's 64 KiB less the
+// interpreter area below 0x200.
+constexpr size_t k_max_rom_size = 0x10000 - 0x200;
+
+// FNV-1a 64 over `bytes`; what RomImage::hash() and the ROM index use to
+// tell ROMs apart.
+uint64_t hash_bytes(std::span<const std::byte> bytes);
+
+// A ROM file mapped read-only (copied where mmap is unavailable), checked
+// against the size the caller can hold before anything reads it, and
+// hashed once. Move-only; bytes() stays valid while the image lives.
+class RomImage {
+public:
+  // NotFound if `path` does not exist, InvalidArgument if it is not a
+  // regular file or is larger than `max_size`, IOError otherwise.
+  static common::StatusOr<RomImage> open(const std::filesystem::path &path,
+                                         size_t max_size = k_max_rom_size);
+
+  RomImage(RomImage &&other) noexcept;
+  RomImage &operator=(RomImage &&other) noexcept;
+  RomImage(const RomImage &) = delete;
+  RomImage &operator=(const RomImage &) = delete;
+  ~RomImage();
+
+  std::span<const std::byte> bytes() const { return {data_, size_}; }
+  size_t size() const { return size_; }
+  uint64_t hash() const { return hash_; }
+
+private:
+  RomImage() = default;
+  void release();
+
+  const std::byte *data_ = nullptr;
+  size_t size_ = 0u;
+  // True when data_ is a mapping to munmap, false when it points at copy_.
+  bool mapped_ = false;
+  std::vector<std::byte> copy_;
+  uint64_t hash_ = 0u;
+};
+
+} // namespace chip8
+
+#endif
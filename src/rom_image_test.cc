@@ -0,0 +1,82 @@
+#include "src/rom_image.h"
+#include "src/chip8.h"
+#include "src/extended_chip8.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+std::filesystem::path write_file(const std::string &name, size_t size) {
+  std::filesystem::path path =
+      std::filesystem::path(::testing::TempDir()) / name;
+  std::ofstream file(path, std::ios::binary);
+  for (size_t i = 0; i < size; i++) {
+    file.put(static_cast<char>(i * 7u));
+  }
+  return path;
+}
+
+} // namespace
+
+TEST(RomImageTest, MapsAndHashesTheFile) {
+  std::filesystem::path path = write_file("rom_image_maps.ch8", 300);
+  common::StatusOr<RomImage> image = RomImage::open(path);
+  ASSERT_TRUE(image) << image.error();
+  ASSERT_EQ(image->size(), 300u);
+  EXPECT_EQ(image->bytes()[0], std::byte{0});
+  EXPECT_EQ(image->bytes()[299], static_cast<std::byte>(299u * 7u));
+  EXPECT_EQ(image->hash(), hash_bytes(image->bytes()));
+  // Moving keeps the bytes valid.
+  RomImage moved = std::move(*image);
+  EXPECT_EQ(moved.size(), 300u);
+  EXPECT_EQ(moved.bytes()[1], std::byte{7});
+}
+
+TEST(RomImageTest, HashesContentNotNames) {
+  EXPECT_EQ(hash_bytes({}), 0xCBF29CE484222325u);
+  common::StatusOr<RomImage> a = RomImage::open(write_file("hash_a.ch8", 64));
+  common::StatusOr<RomImage> b = RomImage::open(write_file("hash_b.ch8", 64));
+  common::StatusOr<RomImage> c = RomImage::open(write_file("hash_c.ch8", 65));
+  ASSERT_TRUE(a && b && c);
+  EXPECT_EQ(a->hash(), b->hash());
+  EXPECT_NE(a->hash(), c->hash());
+}
+
+TEST(RomImageTest, RejectsMissingAndOversizeFilesButAcceptsEmpty) {
+  common::StatusOr<RomImage> missing = RomImage::open(
+      std::filesystem::path(::testing::TempDir()) / "no_such_rom.ch8");
+  ASSERT_FALSE(missing);
+  EXPECT_EQ(missing.error().code, common::ErrorCode::NotFound);
+
+  std::filesystem::path path = write_file("rom_image_big.ch8", 101);
+  common::StatusOr<RomImage> oversize = RomImage::open(path, 100);
+  ASSERT_FALSE(oversize);
+  EXPECT_EQ(oversize.error().code, common::ErrorCode::InvalidArgument);
+  EXPECT_TRUE(RomImage::open(path, 101));
+
+  common::StatusOr<RomImage> empty =
+      RomImage::open(write_file("rom_image_empty.ch8", 0));
+  ASSERT_TRUE(empty);
+  EXPECT_EQ(empty->size(), 0u);
+}
+
+TEST(RomImageTest, LoadRomRejectsWhatDoesNotFitInMemory) {
+  Chip8 chip8;
+  // 4096 - 0x200 bytes fit exactly; one more used to run off memory_.
+  EXPECT_TRUE(chip8.load_rom(write_file("fits.ch8", 3584)));
+  common::Status status = chip8.load_rom(write_file("overruns.ch8", 3585));
+  ASSERT_FALSE(status);
+  EXPECT_EQ(status.error().code, common::ErrorCode::InvalidArgument);
+
+  // XO-CHIP's 64 KB takes what the 4 KB cores cannot.
+  ExtendedChip8<XoChipQuirks> xochip;
+  EXPECT_TRUE(xochip.load_rom(write_file("xo.xo8", 3585)));
+  ExtendedChip8<SuperChipQuirks> schip;
+  EXPECT_FALSE(schip.load_rom(write_file("xo.xo8", 3585)));
+}
+
+} // namespace chip8
@@ -0,0 +1,222 @@
+#include "rom_index.h"
+#include "app_error.h"
+#include "byte_stream.h"
+#include "rom_image.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace chip8 {
+namespace {
+
+constexpr char k_magic[4] = {'C', '8', 'I', 'X'};
+constexpr std::array<std::string_view, 4> k_rom_extensions = {
+    ".ch8", ".c8", ".sc8", ".xo8"};
+
+common::AppError malformed(const std::string &what) {
+  return common::AppError{common::ErrorCode::InvalidArgument,
+                          "Malformed ROM index: " + what};
+}
+
+bool by_path(const RomRecord &a, const RomRecord &b) {
+  return a.path < b.path;
+}
+
+} // namespace
+
+const RomRecord *RomIndex::find(const std::filesystem::path &path) const {
+  const std::string key = path.string();
+  auto it = std::lower_bound(
+      records.begin(), records.end(), key,
+      [](const RomRecord &record, const std::string &k) {
+        return record.path < k;
+      });
+  return it != records.end() && it->path == key ? &*it : nullptr;
+}
+
+bool is_rom_file(const std::filesystem::path &path) {
+  const std::string extension = path.extension().string();
+  return std::any_of(k_rom_extensions.begin(), k_rom_extensions.end(),
+                     [&](std::string_view rom_extension) {
+                       return extension == rom_extension;
+                     });
+}
+
+common::StatusOr<ScanStats> scan_roms(RomIndex &index,
+                                      const std::filesystem::path &directory) {
+  std::error_code error;
+  if (!std::filesystem::is_directory(directory, error)) {
+    return std::unexpected(
+        common::AppError{common::ErrorCode::NotFound,
+                         directory.string() + " is not a directory"});
+  }
+  ScanStats stats;
+  std::vector<RomRecord> scanned;
+  std::filesystem::recursive_directory_iterator it(
+      directory, std::filesystem::directory_options::skip_permission_denied,
+      error);
+  for (; !error && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error)) {
+    const std::filesystem::directory_entry &entry = *it;
+    std::error_code entry_error;
+    if (!entry.is_regular_file(entry_error) || !is_rom_file(entry.path())) {
+      continue;
+    }
+    const uint64_t size = entry.file_size(entry_error);
+    const int64_t modified =
+        entry.last_write_time(entry_error).time_since_epoch().count();
+    if (entry_error) {
+      stats.rejected++;
+      continue;
+    }
+    const RomRecord *known = index.find(entry.path());
+    if (known != nullptr && known->size == size &&
+        known->modified == modified) {
+      scanned.push_back(*known);
+      stats.unchanged++;
+      continue;
+    }
+    common::StatusOr<RomImage> image = RomImage::open(entry.path());
+    if (!image) {
+      stats.rejected++;
+      continue;
+    }
+    RomRecord record{.path = entry.path().string(),
+                     .size = image->size(),
+                     .modified = modified,
+                     .hash = image->hash()};
+    if (known != nullptr && known->hash == record.hash) {
+      record.analysis = known->analysis;
+      stats.unchanged++;
+    } else {
+      record.analysis = analyse_rom(image->bytes());
+      stats.analysed++;
+    }
+    scanned.push_back(std::move(record));
+  }
+  if (error) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError,
+        "Unable to scan " + directory.string() + ": " + error.message()});
+  }
+
+  // Swap in the new records for everything that was under `directory`.
+  std::sort(scanned.begin(), scanned.end(), by_path);
+  const std::string prefix = (directory / "").string();
+  std::vector<RomRecord> merged;
+  merged.reserve(index.records.size() + scanned.size());
+  for (RomRecord &record : index.records) {
+    if (!record.path.starts_with(prefix)) {
+      merged.push_back(std::move(record));
+    } else if (!std::binary_search(scanned.begin(), scanned.end(), record,
+                                   by_path)) {
+      stats.removed++;
+    }
+  }
+  std::move(scanned.begin(), scanned.end(), std::back_inserter(merged));
+  std::sort(merged.begin(), merged.end(), by_path);
+  index.records = std::move(merged);
+  return stats;
+}
+
+std::vector<std::byte> encode_rom_index(const RomIndex &index) {
+  std::vector<std::byte> out;
+  common::ByteWriter writer(out);
+  writer.bytes(std::string_view(k_magic, sizeof(k_magic)));
+  writer.integer(RomIndex::k_version);
+  writer.varint(static_cast<uint32_t>(index.records.size()));
+  for (const RomRecord &record : index.records) {
+    writer.varint(static_cast<uint32_t>(record.path.size()));
+    writer.bytes(record.path);
+    writer.integer(record.size);
+    writer.integer(static_cast<uint64_t>(record.modified));
+    writer.integer(record.hash);
+    writer.integer(static_cast<uint8_t>(record.analysis.profile));
+    writer.integer(record.analysis.features);
+    writer.varint(record.analysis.reachable_instructions);
+    writer.varint(record.analysis.blocks);
+  }
+  return out;
+}
+
+common::StatusOr<RomIndex> decode_rom_index(std::span<const std::byte> bytes) {
+  common::ByteReader reader(bytes);
+  if (reader.string(sizeof(k_magic)) !=
+      std::string_view(k_magic, sizeof(k_magic))) {
+    return std::unexpected(malformed("not a ROM index"));
+  }
+  uint8_t version = reader.integer<uint8_t>();
+  if (reader.ok() && version != RomIndex::k_version) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Unsupported ROM index version " + std::to_string(version)});
+  }
+  uint32_t record_count = reader.varint();
+  if (!reader.ok()) {
+    return std::unexpected(malformed("truncated header"));
+  }
+  RomIndex index;
+  // Every record takes at least 32 bytes; don't trust the count further.
+  index.records.reserve(std::min<size_t>(record_count, bytes.size() / 32u));
+  for (uint32_t i = 0; i < record_count; i++) {
+    RomRecord record;
+    record.path = reader.string(reader.varint());
+    record.size = reader.integer<uint64_t>();
+    record.modified = static_cast<int64_t>(reader.integer<uint64_t>());
+    record.hash = reader.integer<uint64_t>();
+    uint8_t profile = reader.integer<uint8_t>();
+    record.analysis.features = reader.integer<uint32_t>();
+    record.analysis.reachable_instructions = reader.varint();
+    record.analysis.blocks = reader.varint();
+    if (!reader.ok()) {
+      return std::unexpected(malformed("truncated records"));
+    }
+    if (profile > static_cast<uint8_t>(RomProfile::XoChip) ||
+        (i > 0 && record.path <= index.records.back().path)) {
+      return std::unexpected(
+          malformed("record " + std::to_string(i) + " is out of range"));
+    }
+    record.analysis.profile = static_cast<RomProfile>(profile);
+    index.records.push_back(std::move(record));
+  }
+  if (!reader.at_end()) {
+    return std::unexpected(malformed("trailing bytes"));
+  }
+  return index;
+}
+
+common::Status write_rom_index(const RomIndex &index,
+                               const std::filesystem::path &path) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError,
+        "Unable to open ROM index output " + path.string()});
+  }
+  std::vector<std::byte> bytes = encode_rom_index(index);
+  file.write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::IOError, "Unable to write " + path.string()});
+  }
+  return {};
+}
+
+common::StatusOr<RomIndex> read_rom_index(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::NotFound, "Unable to open " + path.string()});
+  }
+  std::vector<char> contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return decode_rom_index(std::as_bytes(std::span(contents)));
+}
+
+} // namespace chip8
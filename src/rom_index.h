@@ -0,0 +1,73 @@
+#ifndef SRC_ROM_INDEX_H
+#define SRC_ROM_INDEX_H
+
+#include "app_error.h"
+#include "rom_analysis.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+
+// What the index knows about one ROM file. `size` and `modified` (the
+// file's last write time, in file_clock ticks) let a rescan skip files
+// that have not changed without opening them; `hash` (hash_bytes()) lets it
+// keep the analysis of a file that was only touched.
+struct RomRecord {
+  std::string path;
+  uint64_t size = 0u;
+  int64_t modified = 0;
+  uint64_t hash = 0u;
+  RomAnalysis analysis;
+
+  bool operator==(const RomRecord &) const = default;
+};
+
+// Every ROM under the scanned directories, so batch runs start from the
+// cached analysis instead of re-reading and re-walking the corpus.
+//
+// On disk (all integers little-endian):
+//   "C8IX", u8 version, varint record count, then per record varint path
+//   length, path, u64 size, u64 modified, u64 hash, u8 profile,
+//   u32 features, varint reachable instructions, varint blocks.
+struct RomIndex {
+  static constexpr uint8_t k_version = 1u;
+
+  // Sorted by path.
+  std::vector<RomRecord> records;
+
+  // The record for `path`, or nullptr.
+  const RomRecord *find(const std::filesystem::path &path) const;
+};
+
+// ROM files scan_roms() picks up.
+bool is_rom_file(const std::filesystem::path &path);
+
+struct ScanStats {
+  size_t unchanged = 0u;
+  size_t analysed = 0u;
+  size_t removed = 0u;
+  // Files with a ROM extension RomImage would not open, e.g. too large.
+  size_t rejected = 0u;
+};
+
+// Brings the records under `directory` up to date with the ROM files
+// (is_rom_file()) below it: new and changed files are hashed and, unless
+// the hash matches, analysed again; records for deleted files are dropped.
+// Records elsewhere are left alone.
+common::StatusOr<ScanStats> scan_roms(RomIndex &index,
+                                      const std::filesystem::path &directory);
+
+std::vector<std::byte> encode_rom_index(const RomIndex &index);
+common::StatusOr<RomIndex> decode_rom_index(std::span<const std::byte> bytes);
+common::Status write_rom_index(const RomIndex &index,
+                               const std::filesystem::path &path);
+// NotFound if there is no index at `path` yet.
+common::StatusOr<RomIndex> read_rom_index(const std::filesystem::path &path);
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,119 @@
+#include "src/rom_index.h"
+#include "src/rom_image.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+namespace {
+
+void write_rom(const std::filesystem::path &path,
+               std::initializer_list<uint16_t> words) {
+  std::vector<std::byte> bytes = program_bytes(words);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+class RomIndexTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    directory = std::filesystem::path(::testing::TempDir()) /
+                ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "schip");
+    write_rom(directory / "loop.ch8", {0x6000, 0x1202});
+    write_rom(directory / "schip" / "hires.sc8", {0x00FF, 0x1202});
+    write_rom(directory / "notes.txt", {0x4142});
+  }
+
+  std::filesystem::path directory;
+};
+
+} // namespace
+
+TEST_F(RomIndexTest, ScansRomsRecursively) {
+  RomIndex index;
+  common::StatusOr<ScanStats> stats = scan_roms(index, directory);
+  ASSERT_TRUE(stats) << stats.error();
+  EXPECT_EQ(stats->analysed, 2u);
+  ASSERT_EQ(index.records.size(), 2u);
+
+  const RomRecord *loop = index.find(directory / "loop.ch8");
+  ASSERT_NE(loop, nullptr);
+  EXPECT_EQ(loop->size, 4u);
+  EXPECT_EQ(loop->analysis.profile, RomProfile::Vip);
+  EXPECT_EQ(loop->analysis.reachable_instructions, 2u);
+  common::StatusOr<RomImage> image = RomImage::open(directory / "loop.ch8");
+  ASSERT_TRUE(image);
+  EXPECT_EQ(loop->hash, image->hash());
+
+  const RomRecord *hires = index.find(directory / "schip" / "hires.sc8");
+  ASSERT_NE(hires, nullptr);
+  EXPECT_EQ(hires->analysis.profile, RomProfile::SuperChip);
+}
+
+TEST_F(RomIndexTest, RescanOnlyAnalysesWhatChanged) {
+  RomIndex index;
+  ASSERT_TRUE(scan_roms(index, directory));
+
+  common::StatusOr<ScanStats> stats = scan_roms(index, directory);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->unchanged, 2u);
+  EXPECT_EQ(stats->analysed, 0u);
+
+  // New content is analysed again; a touched but identical file is not.
+  write_rom(directory / "loop.ch8", {0x6000, 0x00FF, 0x1202});
+  const std::filesystem::path hires = directory / "schip" / "hires.sc8";
+  std::filesystem::last_write_time(
+      hires, std::filesystem::last_write_time(hires) + std::chrono::hours(1));
+  stats = scan_roms(index, directory);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->analysed, 1u);
+  EXPECT_EQ(stats->unchanged, 1u);
+  EXPECT_EQ(index.find(directory / "loop.ch8")->analysis.profile,
+            RomProfile::SuperChip);
+
+  std::filesystem::remove(directory / "loop.ch8");
+  stats = scan_roms(index, directory);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->removed, 1u);
+  EXPECT_EQ(index.records.size(), 1u);
+}
+
+TEST_F(RomIndexTest, RoundTripsThroughTheFile) {
+  RomIndex index;
+  ASSERT_TRUE(scan_roms(index, directory));
+  std::filesystem::path path = directory / "index.c8ix";
+  ASSERT_TRUE(write_rom_index(index, path));
+  common::StatusOr<RomIndex> read = read_rom_index(path);
+  ASSERT_TRUE(read) << read.error();
+  EXPECT_EQ(read->records, index.records);
+
+  common::StatusOr<RomIndex> missing = read_rom_index(directory / "none");
+  ASSERT_FALSE(missing);
+  EXPECT_EQ(missing.error().code, common::ErrorCode::NotFound);
+}
+
+TEST(RomIndexDecodeTest, RejectsMalformedIndexes) {
+  RomIndex index;
+  index.records.push_back(RomRecord{.path = "a.ch8", .size = 2u});
+  std::vector<std::byte> bytes = encode_rom_index(index);
+  EXPECT_TRUE(decode_rom_index(bytes));
+
+  std::vector<std::byte> truncated(bytes.begin(), bytes.end() - 1);
+  EXPECT_FALSE(decode_rom_index(truncated));
+  std::vector<std::byte> trailing = bytes;
+  trailing.push_back(std::byte{0});
+  EXPECT_FALSE(decode_rom_index(trailing));
+  std::vector<std::byte> bad_magic = bytes;
+  bad_magic[0] = std::byte{'X'};
+  EXPECT_FALSE(decode_rom_index(bad_magic));
+}
+
+} // namespace chip8
@@ -0,0 +1,474 @@
+#include "simd_kernels.h"
+
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CHIP8_SIMD_X86_64 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHIP8_SIMD_NEON 1
+#endif
+
+namespace chip8 {
+namespace {
+
+bool scalar_xor_sprite(uint8_t *pixels, const uint8_t *sprite,
+                       size_t num_rows) {
+  uint8_t collision = 0u;
+  for (size_t i = 0; i < num_rows; i++) {
+    for (int j = 0; j < 8; j++) {
+      uint8_t bit = (sprite[i] >> (7 - j)) & 0x1u;
+      collision |= pixels[64 * i + j] & bit;
+      pixels[64 * i + j] ^= bit;
+    }
+  }
+  return collision != 0u;
+}
+
+void scalar_expand_argb(const uint8_t *pixels, uint32_t *out, size_t count,
+                        uint32_t on, uint32_t off) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = (pixels[i] != 0u) ? on : off;
+  }
+}
+
+void scalar_expand_rows_argb(const uint64_t *rows, size_t num_rows,
+                             uint32_t *out, uint32_t on, uint32_t off) {
+  for (size_t y = 0; y < num_rows; y++) {
+    for (int x = 0; x < 64; x++) {
+      *out++ = ((rows[y] >> (63 - x)) & 0x1u) ? on : off;
+    }
+  }
+}
+
+void scalar_shift_wide_rows(uint64_t *rows, size_t num_rows, int shift) {
+  for (size_t y = 0; y < num_rows; y++) {
+    uint64_t &left = rows[y * k_wide_row_words];
+    uint64_t &right = rows[y * k_wide_row_words + 1];
+    if (shift > 0) {
+      right = (right >> shift) | (left << (64 - shift));
+      left >>= shift;
+    } else {
+      left = (left << -shift) | (right >> (64 + shift));
+      right <<= -shift;
+    }
+  }
+}
+
+void scalar_composite_planes_argb(const uint64_t *plane0,
+                                  const uint64_t *plane1, size_t num_rows,
+                                  uint32_t *out,
+                                  const std::array<uint32_t, 4> &palette) {
+  for (size_t i = 0; i < num_rows * k_wide_row_words; i++) {
+    for (int x = 63; x >= 0; x--) {
+      *out++ = palette[((plane0[i] >> x) & 0x1u) |
+                       (((plane1[i] >> x) & 0x1u) << 1u)];
+    }
+  }
+}
+
+#if defined(CHIP8_SIMD_X86_64)
+
+// SSE2 is part of the x86-64 baseline, so these need no feature check.
+bool sse2_xor_sprite(uint8_t *pixels, const uint8_t *sprite,
+                     size_t num_rows) {
+  const __m128i bits = _mm_setr_epi8(
+      static_cast<char>(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0, 0,
+      0, 0, 0, 0, 0, 0);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i overlap = zero;
+  for (size_t i = 0; i < num_rows; i++) {
+    __m128i selected =
+        _mm_and_si128(_mm_set1_epi8(static_cast<char>(sprite[i])), bits);
+    // 1 in every lane whose sprite bit is set; the upper 8 lanes stay 0.
+    __m128i row = _mm_andnot_si128(_mm_cmpeq_epi8(selected, zero), one);
+    auto *target = reinterpret_cast<__m128i *>(pixels + 64 * i);
+    __m128i display = _mm_loadl_epi64(target);
+    overlap = _mm_or_si128(overlap, _mm_and_si128(display, row));
+    _mm_storel_epi64(target, _mm_xor_si128(display, row));
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(overlap, zero)) != 0xFFFF;
+}
+
+void sse2_expand_argb(const uint8_t *pixels, uint32_t *out, size_t count,
+                      uint32_t on, uint32_t off) {
+  const __m128i on_v = _mm_set1_epi32(static_cast<int>(on));
+  const __m128i off_v = _mm_set1_epi32(static_cast<int>(off));
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t i = 0; i < count; i += 16) {
+    __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+    // 0xFF for every pixel that is off, widened to 32 bits per pixel.
+    __m128i dark = _mm_cmpeq_epi8(input, zero);
+    __m128i low = _mm_unpacklo_epi8(dark, dark);
+    __m128i high = _mm_unpackhi_epi8(dark, dark);
+    const __m128i masks[4] = {
+        _mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low),
+        _mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high)};
+    for (int j = 0; j < 4; j++) {
+      __m128i result = _mm_or_si128(_mm_and_si128(masks[j], off_v),
+                                    _mm_andnot_si128(masks[j], on_v));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4 * j), result);
+    }
+  }
+}
+
+void sse2_expand_rows_argb(const uint64_t *rows, size_t num_rows,
+                           uint32_t *out, uint32_t on, uint32_t off) {
+  const __m128i on_v = _mm_set1_epi32(static_cast<int>(on));
+  const __m128i off_v = _mm_set1_epi32(static_cast<int>(off));
+  const __m128i bits[2] = {_mm_setr_epi32(0x80, 0x40, 0x20, 0x10),
+                           _mm_setr_epi32(0x08, 0x04, 0x02, 0x01)};
+  for (size_t y = 0; y < num_rows; y++) {
+    for (int k = 0; k < 8; k++) {
+      __m128i byte = _mm_set1_epi32((rows[y] >> (56 - 8 * k)) & 0xFFu);
+      for (int j = 0; j < 2; j++) {
+        __m128i lit = _mm_cmpeq_epi32(_mm_and_si128(byte, bits[j]), bits[j]);
+        __m128i result = _mm_or_si128(_mm_and_si128(lit, on_v),
+                                      _mm_andnot_si128(lit, off_v));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), result);
+        out += 4;
+      }
+    }
+  }
+}
+
+// Both words of a row in one register: lane 0 is the left word, so a byte
+// shift by 8 moves it into the right word's lane to carry bits across.
+// Inline so the AVX2 kernel's tail is VEX-encoded too; calling legacy SSE
+// code with the upper YMM halves dirty costs a state transition.
+inline void sse2_shift_wide_row(uint64_t *row_words, int shift, __m128i count,
+                                __m128i carry_count) {
+  auto *row = reinterpret_cast<__m128i *>(row_words);
+  __m128i v = _mm_loadu_si128(row);
+  if (shift > 0) {
+    v = _mm_or_si128(_mm_srl_epi64(v, count),
+                     _mm_sll_epi64(_mm_slli_si128(v, 8), carry_count));
+  } else {
+    v = _mm_or_si128(_mm_sll_epi64(v, count),
+                     _mm_srl_epi64(_mm_srli_si128(v, 8), carry_count));
+  }
+  _mm_storeu_si128(row, v);
+}
+
+void sse2_shift_wide_rows(uint64_t *rows, size_t num_rows, int shift) {
+  const int bits = shift > 0 ? shift : -shift;
+  const __m128i count = _mm_cvtsi32_si128(bits);
+  const __m128i carry_count = _mm_cvtsi32_si128(64 - bits);
+  for (size_t y = 0; y < num_rows; y++) {
+    sse2_shift_wide_row(rows + y * k_wide_row_words, shift, count,
+                        carry_count);
+  }
+}
+
+// a where mask is set, b elsewhere.
+inline __m128i sse2_select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+void sse2_composite_planes_argb(const uint64_t *plane0,
+                                const uint64_t *plane1, size_t num_rows,
+                                uint32_t *out,
+                                const std::array<uint32_t, 4> &palette) {
+  __m128i colours[4];
+  for (int i = 0; i < 4; i++) {
+    colours[i] = _mm_set1_epi32(static_cast<int>(palette[i]));
+  }
+  const __m128i bits[2] = {_mm_setr_epi32(0x80, 0x40, 0x20, 0x10),
+                           _mm_setr_epi32(0x08, 0x04, 0x02, 0x01)};
+  for (size_t i = 0; i < num_rows * k_wide_row_words; i++) {
+    for (int k = 0; k < 8; k++) {
+      const int shift = 56 - 8 * k;
+      __m128i byte0 = _mm_set1_epi32((plane0[i] >> shift) & 0xFFu);
+      __m128i byte1 = _mm_set1_epi32((plane1[i] >> shift) & 0xFFu);
+      for (int j = 0; j < 2; j++) {
+        __m128i lit0 = _mm_cmpeq_epi32(_mm_and_si128(byte0, bits[j]), bits[j]);
+        __m128i lit1 = _mm_cmpeq_epi32(_mm_and_si128(byte1, bits[j]), bits[j]);
+        __m128i result =
+            sse2_select(lit1, sse2_select(lit0, colours[3], colours[2]),
+                        sse2_select(lit0, colours[1], colours[0]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), result);
+        out += 4;
+      }
+    }
+  }
+}
+
+__attribute__((target("avx2"))) void avx2_expand_argb(const uint8_t *pixels,
+                                                      uint32_t *out,
+                                                      size_t count,
+                                                      uint32_t on,
+                                                      uint32_t off) {
+  const __m256i on_v = _mm256_set1_epi32(static_cast<int>(on));
+  const __m256i off_v = _mm256_set1_epi32(static_cast<int>(off));
+  const __m256i zero = _mm256_setzero_si256();
+  for (size_t i = 0; i < count; i += 16) {
+    __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+    __m256i low = _mm256_cvtepu8_epi32(input);
+    __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(input, 8));
+    __m256i result_low =
+        _mm256_blendv_epi8(on_v, off_v, _mm256_cmpeq_epi32(low, zero));
+    __m256i result_high =
+        _mm256_blendv_epi8(on_v, off_v, _mm256_cmpeq_epi32(high, zero));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), result_low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 8),
+                        result_high);
+  }
+}
+
+__attribute__((target("avx2"))) void
+avx2_expand_rows_argb(const uint64_t *rows, size_t num_rows, uint32_t *out,
+                      uint32_t on, uint32_t off) {
+  const __m256i on_v = _mm256_set1_epi32(static_cast<int>(on));
+  const __m256i off_v = _mm256_set1_epi32(static_cast<int>(off));
+  const __m256i bits =
+      _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  for (size_t y = 0; y < num_rows; y++) {
+    for (int k = 0; k < 8; k++) {
+      __m256i byte = _mm256_set1_epi32((rows[y] >> (56 - 8 * k)) & 0xFFu);
+      __m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out),
+                          _mm256_blendv_epi8(off_v, on_v, lit));
+      out += 8;
+    }
+  }
+}
+
+// Two rows per register; the byte shifts stay within each row's lane.
+__attribute__((target("avx2"))) void
+avx2_shift_wide_rows(uint64_t *rows, size_t num_rows, int shift) {
+  const int bits = shift > 0 ? shift : -shift;
+  const __m128i count = _mm_cvtsi32_si128(bits);
+  const __m128i carry_count = _mm_cvtsi32_si128(64 - bits);
+  size_t y = 0;
+  for (; y + 2 <= num_rows; y += 2) {
+    auto *pair = reinterpret_cast<__m256i *>(rows + y * k_wide_row_words);
+    __m256i v = _mm256_loadu_si256(pair);
+    if (shift > 0) {
+      v = _mm256_or_si256(
+          _mm256_srl_epi64(v, count),
+          _mm256_sll_epi64(_mm256_slli_si256(v, 8), carry_count));
+    } else {
+      v = _mm256_or_si256(
+          _mm256_sll_epi64(v, count),
+          _mm256_srl_epi64(_mm256_srli_si256(v, 8), carry_count));
+    }
+    _mm256_storeu_si256(pair, v);
+  }
+  if (y < num_rows) {
+    sse2_shift_wide_row(rows + y * k_wide_row_words, shift, count,
+                        carry_count);
+  }
+}
+
+__attribute__((target("avx2"))) void
+avx2_composite_planes_argb(const uint64_t *plane0, const uint64_t *plane1,
+                           size_t num_rows, uint32_t *out,
+                           const std::array<uint32_t, 4> &palette) {
+  __m256i colours[4];
+  for (int i = 0; i < 4; i++) {
+    colours[i] = _mm256_set1_epi32(static_cast<int>(palette[i]));
+  }
+  const __m256i bits =
+      _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  for (size_t i = 0; i < num_rows * k_wide_row_words; i++) {
+    for (int k = 0; k < 8; k++) {
+      const int shift = 56 - 8 * k;
+      __m256i byte0 = _mm256_set1_epi32((plane0[i] >> shift) & 0xFFu);
+      __m256i byte1 = _mm256_set1_epi32((plane1[i] >> shift) & 0xFFu);
+      __m256i lit0 = _mm256_cmpeq_epi32(_mm256_and_si256(byte0, bits), bits);
+      __m256i lit1 = _mm256_cmpeq_epi32(_mm256_and_si256(byte1, bits), bits);
+      __m256i low = _mm256_blendv_epi8(colours[0], colours[1], lit0);
+      __m256i high = _mm256_blendv_epi8(colours[2], colours[3], lit0);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out),
+                          _mm256_blendv_epi8(low, high, lit1));
+      out += 8;
+    }
+  }
+}
+
+#endif
+
+#if defined(CHIP8_SIMD_NEON)
+
+bool neon_xor_sprite(uint8_t *pixels, const uint8_t *sprite,
+                     size_t num_rows) {
+  const uint8x8_t bits = {0x80u, 0x40u, 0x20u, 0x10u, 0x08u, 0x04u, 0x02u,
+                          0x01u};
+  uint8x8_t overlap = vdup_n_u8(0u);
+  for (size_t i = 0; i < num_rows; i++) {
+    uint8x8_t row =
+        vand_u8(vtst_u8(vdup_n_u8(sprite[i]), bits), vdup_n_u8(1u));
+    uint8x8_t display = vld1_u8(pixels + 64 * i);
+    overlap = vorr_u8(overlap, vand_u8(display, row));
+    vst1_u8(pixels + 64 * i, veor_u8(display, row));
+  }
+  return vmaxv_u8(overlap) != 0u;
+}
+
+void neon_expand_argb(const uint8_t *pixels, uint32_t *out, size_t count,
+                      uint32_t on, uint32_t off) {
+  const uint32x4_t on_v = vdupq_n_u32(on);
+  const uint32x4_t off_v = vdupq_n_u32(off);
+  for (size_t i = 0; i < count; i += 16) {
+    uint8x16_t input = vld1q_u8(pixels + i);
+    uint16x8_t low = vmovl_u8(vget_low_u8(input));
+    uint16x8_t high = vmovl_u8(vget_high_u8(input));
+    const uint32x4_t widened[4] = {
+        vmovl_u16(vget_low_u16(low)), vmovl_u16(vget_high_u16(low)),
+        vmovl_u16(vget_low_u16(high)), vmovl_u16(vget_high_u16(high))};
+    for (int j = 0; j < 4; j++) {
+      uint32x4_t mask = vtstq_u32(widened[j], widened[j]);
+      vst1q_u32(out + i + 4 * j, vbslq_u32(mask, on_v, off_v));
+    }
+  }
+}
+
+void neon_expand_rows_argb(const uint64_t *rows, size_t num_rows,
+                           uint32_t *out, uint32_t on, uint32_t off) {
+  const uint32x4_t on_v = vdupq_n_u32(on);
+  const uint32x4_t off_v = vdupq_n_u32(off);
+  const uint32x4_t bits[2] = {{0x80u, 0x40u, 0x20u, 0x10u},
+                              {0x08u, 0x04u, 0x02u, 0x01u}};
+  for (size_t y = 0; y < num_rows; y++) {
+    for (int k = 0; k < 8; k++) {
+      uint32x4_t byte = vdupq_n_u32((rows[y] >> (56 - 8 * k)) & 0xFFu);
+      for (int j = 0; j < 2; j++) {
+        vst1q_u32(out, vbslq_u32(vtstq_u32(byte, bits[j]), on_v, off_v));
+        out += 4;
+      }
+    }
+  }
+}
+
+void neon_shift_wide_rows(uint64_t *rows, size_t num_rows, int shift) {
+  const uint64x2_t zero = vdupq_n_u64(0u);
+  const int bits = shift > 0 ? shift : -shift;
+  // vshlq_u64 shifts right for negative counts.
+  const int64x2_t count = vdupq_n_s64(shift > 0 ? -bits : bits);
+  const int64x2_t carry_count = vdupq_n_s64(shift > 0 ? 64 - bits : bits - 64);
+  for (size_t y = 0; y < num_rows; y++) {
+    uint64_t *row = rows + y * k_wide_row_words;
+    uint64x2_t v = vld1q_u64(row);
+    // The left word moved into the right lane, or the right into the left.
+    uint64x2_t carry =
+        shift > 0 ? vextq_u64(zero, v, 1) : vextq_u64(v, zero, 1);
+    vst1q_u64(row,
+              vorrq_u64(vshlq_u64(v, count), vshlq_u64(carry, carry_count)));
+  }
+}
+
+void neon_composite_planes_argb(const uint64_t *plane0,
+                                const uint64_t *plane1, size_t num_rows,
+                                uint32_t *out,
+                                const std::array<uint32_t, 4> &palette) {
+  uint32x4_t colours[4];
+  for (int i = 0; i < 4; i++) {
+    colours[i] = vdupq_n_u32(palette[i]);
+  }
+  const uint32x4_t bits[2] = {{0x80u, 0x40u, 0x20u, 0x10u},
+                              {0x08u, 0x04u, 0x02u, 0x01u}};
+  for (size_t i = 0; i < num_rows * k_wide_row_words; i++) {
+    for (int k = 0; k < 8; k++) {
+      const int shift = 56 - 8 * k;
+      uint32x4_t byte0 = vdupq_n_u32((plane0[i] >> shift) & 0xFFu);
+      uint32x4_t byte1 = vdupq_n_u32((plane1[i] >> shift) & 0xFFu);
+      for (int j = 0; j < 2; j++) {
+        uint32x4_t lit0 = vtstq_u32(byte0, bits[j]);
+        uint32x4_t lit1 = vtstq_u32(byte1, bits[j]);
+        uint32x4_t low = vbslq_u32(lit0, colours[1], colours[0]);
+        uint32x4_t high = vbslq_u32(lit0, colours[3], colours[2]);
+        vst1q_u32(out, vbslq_u32(lit1, high, low));
+        out += 4;
+      }
+    }
+  }
+}
+
+#endif
+
+constexpr PixelKernels k_scalar_kernels = {
+    "scalar",
+    &scalar_xor_sprite,
+    &scalar_expand_argb,
+    &scalar_expand_rows_argb,
+    &scalar_shift_wide_rows,
+    &scalar_composite_planes_argb};
+#if defined(CHIP8_SIMD_X86_64)
+constexpr PixelKernels k_sse2_kernels = {
+    "sse2",
+    &sse2_xor_sprite,
+    &sse2_expand_argb,
+    &sse2_expand_rows_argb,
+    &sse2_shift_wide_rows,
+    &sse2_composite_planes_argb};
+// A sprite row is 8 pixels, which already fits one SSE register, so AVX2
+// only widens the expansion, shift and composite kernels.
+constexpr PixelKernels k_avx2_kernels = {
+    "avx2",
+    &sse2_xor_sprite,
+    &avx2_expand_argb,
+    &avx2_expand_rows_argb,
+    &avx2_shift_wide_rows,
+    &avx2_composite_planes_argb};
+#endif
+#if defined(CHIP8_SIMD_NEON)
+constexpr PixelKernels k_neon_kernels = {
+    "neon",
+    &neon_xor_sprite,
+    &neon_expand_argb,
+    &neon_expand_rows_argb,
+    &neon_shift_wide_rows,
+    &neon_composite_planes_argb};
+#endif
+
+} // namespace
+
+std::span<const PixelKernels> supported_pixel_kernels() {
+  static const std::vector<PixelKernels> supported = [] {
+    std::vector<PixelKernels> kernels = {k_scalar_kernels};
+#if defined(CHIP8_SIMD_X86_64)
+    kernels.push_back(k_sse2_kernels);
+    if (__builtin_cpu_supports("avx2")) {
+      kernels.push_back(k_avx2_kernels);
+    }
+#endif
+#if defined(CHIP8_SIMD_NEON)
+    kernels.push_back(k_neon_kernels);
+#endif
+    return kernels;
+  }();
+  return supported;
+}
+
+namespace {
+
+const PixelKernels *&selected_pixel_kernels() {
+  static const PixelKernels *selected = []() -> const PixelKernels * {
+    std::span<const PixelKernels> supported = supported_pixel_kernels();
+    if (const char *forced = std::getenv("CHIP8_PIXEL_KERNEL")) {
+      for (const PixelKernels &kernels : supported) {
+        if (std::string_view(kernels.name) == forced) {
+          return &kernels;
+        }
+      }
+    }
+    return &supported.back();
+  }();
+  return selected;
+}
+
+} // namespace
+
+const PixelKernels &pixel_kernels() { return *selected_pixel_kernels(); }
+
+void set_pixel_kernels(const PixelKernels &kernels) {
+  selected_pixel_kernels() = &kernels;
+}
+
+} // namespace chip8
@@ -0,0 +1,101 @@
+#ifndef SRC_SIMD_KERNELS_H
+#define SRC_SIMD_KERNELS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace chip8 {
+
+// The extended core's 128-pixel rows are two words, x = 0 in bit 63 of the
+// first.
+constexpr size_t k_wide_row_words = 2u;
+
+// Pixel kernels shared by the draw opcode and the renderers. Pixels are one
+// byte each, 0 (off) or 1 (on).
+struct PixelKernels {
+  const char *name;
+
+  // XORs the 8 bits of each of `num_rows` sprite bytes (MSB first) into
+  // pixels[64 * i + 0..7], one 64-pixel display row apart, and returns true
+  // if any pixel that was on got turned off. One call per Dxyn.
+  bool (*xor_sprite)(uint8_t *pixels, const uint8_t *sprite,
+                     size_t num_rows);
+
+  // Writes `on` or `off` to out[i] for every pixels[i]. `count` must be a
+  // multiple of 16.
+  void (*expand_argb)(const uint8_t *pixels, uint32_t *out, size_t count,
+                      uint32_t on, uint32_t off);
+
+  // Same as expand_argb for a bit-packed display: 64 pixels per row with
+  // x = 0 in bit 63.
+  void (*expand_rows_argb)(const uint64_t *rows, size_t num_rows,
+                           uint32_t *out, uint32_t on, uint32_t off);
+
+  // Moves every pixel of `num_rows` 128-pixel rows `shift` places right
+  // (left when negative, 0 < |shift| < 64); pixels shifted in are off. The
+  // horizontal scrolls 00FB/00FC.
+  void (*shift_wide_rows)(uint64_t *rows, size_t num_rows, int shift);
+
+  // Writes palette[bit of plane0 | bit of plane1 << 1] for every pixel of
+  // `num_rows` 128-pixel rows: the two XO-CHIP bitplanes composited.
+  void (*composite_planes_argb)(const uint64_t *plane0,
+                                const uint64_t *plane1, size_t num_rows,
+                                uint32_t *out,
+                                const std::array<uint32_t, 4> &palette);
+};
+
+// kernels.expand_rows_argb into a buffer whose rows are `pitch` bytes apart,
+// such as a locked texture, which may pad each row past 64 pixels.
+inline void expand_rows_argb_pitched(const PixelKernels &kernels,
+                                     const uint64_t *rows, size_t num_rows,
+                                     void *out, size_t pitch, uint32_t on,
+                                     uint32_t off) {
+  if (pitch == 64u * sizeof(uint32_t)) {
+    kernels.expand_rows_argb(rows, num_rows, static_cast<uint32_t *>(out), on,
+                             off);
+    return;
+  }
+  auto *bytes = static_cast<std::byte *>(out);
+  for (size_t y = 0; y < num_rows; y++) {
+    kernels.expand_rows_argb(rows + y, 1u,
+                             reinterpret_cast<uint32_t *>(bytes + y * pitch),
+                             on, off);
+  }
+}
+
+// kernels.composite_planes_argb into a buffer whose rows are `pitch` bytes
+// apart.
+inline void composite_planes_argb_pitched(
+    const PixelKernels &kernels, const uint64_t *plane0,
+    const uint64_t *plane1, size_t num_rows, void *out, size_t pitch,
+    const std::array<uint32_t, 4> &palette) {
+  if (pitch == 128u * sizeof(uint32_t)) {
+    kernels.composite_planes_argb(plane0, plane1, num_rows,
+                                  static_cast<uint32_t *>(out), palette);
+    return;
+  }
+  auto *bytes = static_cast<std::byte *>(out);
+  for (size_t y = 0; y < num_rows; y++) {
+    kernels.composite_planes_argb(
+        plane0 + y * k_wide_row_words, plane1 + y * k_wide_row_words, 1u,
+        reinterpret_cast<uint32_t *>(bytes + y * pitch), palette);
+  }
+}
+
+// The fastest kernels this CPU supports, picked once on first use. Setting
+// CHIP8_PIXEL_KERNEL=<name> in the environment forces a specific set (for
+// A/B runs); unknown or unsupported names are ignored.
+const PixelKernels &pixel_kernels();
+
+// Every kernel set usable on this CPU, scalar first.
+std::span<const PixelKernels> supported_pixel_kernels();
+
+// Replaces the set returned by pixel_kernels(), e.g. to compare kernels in
+// one benchmark process. Not synchronised with running emulation.
+void set_pixel_kernels(const PixelKernels &kernels);
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,167 @@
+#include "src/simd_kernels.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace chip8 {
+
+TEST(SimdKernelsTest, XorSpriteMatchesScalar) {
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    for (int display_bits = 0; display_bits < 256; display_bits += 7) {
+      for (int sprite = 0; sprite < 256; sprite++) {
+        std::array<uint8_t, 8> expected = {};
+        for (int j = 0; j < 8; j++) {
+          expected[j] = (display_bits >> (7 - j)) & 0x1;
+        }
+        std::array<uint8_t, 8> actual = expected;
+        const uint8_t byte = static_cast<uint8_t>(sprite);
+        bool expected_collision = scalar.xor_sprite(expected.data(), &byte, 1);
+        bool actual_collision = kernels.xor_sprite(actual.data(), &byte, 1);
+        ASSERT_EQ(actual, expected);
+        ASSERT_EQ(actual_collision, expected_collision);
+        ASSERT_EQ(expected_collision, (display_bits & sprite) != 0);
+      }
+    }
+  }
+}
+
+TEST(SimdKernelsTest, XorSpriteCoversEveryRow) {
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  std::array<uint8_t, 15> sprite;
+  for (size_t i = 0; i < sprite.size(); i++) {
+    sprite[i] = static_cast<uint8_t>(0xA5u ^ (i * 17u));
+  }
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    for (size_t rows = 1; rows <= sprite.size(); rows++) {
+      // Only the last row overlaps a lit pixel.
+      std::array<uint8_t, 64 * 15> expected = {};
+      expected[64 * (rows - 1) + 7 - std::countr_zero(sprite[rows - 1])] = 1u;
+      std::array<uint8_t, 64 * 15> actual = expected;
+      EXPECT_TRUE(scalar.xor_sprite(expected.data(), sprite.data(), rows));
+      EXPECT_TRUE(kernels.xor_sprite(actual.data(), sprite.data(), rows));
+      ASSERT_EQ(actual, expected);
+    }
+  }
+}
+
+TEST(SimdKernelsTest, XorSpriteTouchesOnlyEightPixelsARow) {
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    std::array<uint8_t, 64 * 2> pixels = {};
+    pixels[8] = 1u;
+    pixels[64 + 8] = 1u;
+    const std::array<uint8_t, 2> sprite = {0xFFu, 0xFFu};
+    // Lit neighbours outside the rows must not count as a collision.
+    EXPECT_FALSE(kernels.xor_sprite(pixels.data(), sprite.data(), 2));
+    for (int y = 0; y < 2; y++) {
+      for (int j = 0; j < 8; j++) {
+        EXPECT_EQ(pixels[64 * y + j], 1u);
+      }
+      EXPECT_EQ(pixels[64 * y + 8], 1u);
+      EXPECT_EQ(pixels[64 * y + 9], 0u);
+    }
+  }
+}
+
+TEST(SimdKernelsTest, ExpandArgbMatchesScalar) {
+  std::array<uint8_t, 64 * 32> pixels = {};
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = (i * 7 + i / 3) % 2;
+  }
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  std::array<uint32_t, 64 * 32> expected = {};
+  scalar.expand_argb(pixels.data(), expected.data(), pixels.size(),
+                     0xFFFFFFFF, 0xFF000000);
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    std::array<uint32_t, 64 * 32> actual = {};
+    kernels.expand_argb(pixels.data(), actual.data(), pixels.size(),
+                        0xFFFFFFFF, 0xFF000000);
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST(SimdKernelsTest, ExpandRowsArgbMatchesScalar) {
+  std::array<uint64_t, 32> rows = {};
+  for (size_t y = 0; y < rows.size(); y++) {
+    rows[y] = 0x9E3779B97F4A7C15ull * (y + 1);
+  }
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  std::array<uint32_t, 64 * 32> expected = {};
+  scalar.expand_rows_argb(rows.data(), rows.size(), expected.data(),
+                          0xFFFFFFFF, 0xFF000000);
+  EXPECT_EQ(expected[0], (rows[0] >> 63) ? 0xFFFFFFFF : 0xFF000000);
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    std::array<uint32_t, 64 * 32> actual = {};
+    kernels.expand_rows_argb(rows.data(), rows.size(), actual.data(),
+                             0xFFFFFFFF, 0xFF000000);
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST(SimdKernelsTest, ShiftWideRowsMatchesScalar) {
+  // Odd row counts leave the AVX2 kernel a single-row tail.
+  std::array<uint64_t, 7 * k_wide_row_words> rows = {};
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+  }
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  for (int shift : {-63, -8, -4, -1, 1, 4, 8, 63}) {
+    SCOPED_TRACE(shift);
+    std::array<uint64_t, 7 * k_wide_row_words> expected = rows;
+    scalar.shift_wide_rows(expected.data(), 7u, shift);
+    for (const PixelKernels &kernels : supported_pixel_kernels()) {
+      SCOPED_TRACE(kernels.name);
+      std::array<uint64_t, 7 * k_wide_row_words> actual = rows;
+      kernels.shift_wide_rows(actual.data(), 7u, shift);
+      EXPECT_EQ(actual, expected);
+    }
+  }
+}
+
+TEST(SimdKernelsTest, ShiftWideRowsCarriesAcrossWords) {
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    // Pixel 63 moves to pixel 67, and back.
+    std::array<uint64_t, 2> row = {0x1u, 0x0u};
+    kernels.shift_wide_rows(row.data(), 1u, 4);
+    EXPECT_EQ(row[0], 0x0u);
+    EXPECT_EQ(row[1], 0x1ull << 60);
+    kernels.shift_wide_rows(row.data(), 1u, -4);
+    EXPECT_EQ(row[0], 0x1u);
+    EXPECT_EQ(row[1], 0x0u);
+  }
+}
+
+TEST(SimdKernelsTest, CompositePlanesArgbMatchesScalar) {
+  std::array<uint64_t, 5 * k_wide_row_words> plane0 = {};
+  std::array<uint64_t, 5 * k_wide_row_words> plane1 = {};
+  for (size_t i = 0; i < plane0.size(); i++) {
+    plane0[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+    plane1[i] = 0xC2B2AE3D27D4EB4Full * (i + 3);
+  }
+  const std::array<uint32_t, 4> palette = {0xFF000000, 0xFFFF0000,
+                                           0xFF00FF00, 0xFF0000FF};
+  const PixelKernels &scalar = supported_pixel_kernels().front();
+  std::array<uint32_t, 128 * 5> expected = {};
+  scalar.composite_planes_argb(plane0.data(), plane1.data(), 5u,
+                               expected.data(), palette);
+  EXPECT_EQ(expected[0],
+            palette[(plane0[0] >> 63) | ((plane1[0] >> 63) << 1)]);
+  EXPECT_EQ(expected[64],
+            palette[(plane0[1] >> 63) | ((plane1[1] >> 63) << 1)]);
+  for (const PixelKernels &kernels : supported_pixel_kernels()) {
+    SCOPED_TRACE(kernels.name);
+    std::array<uint32_t, 128 * 5> actual = {};
+    kernels.composite_planes_argb(plane0.data(), plane1.data(), 5u,
+                                  actual.data(), palette);
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+} // namespace chip8
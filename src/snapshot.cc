@@ -0,0 +1,257 @@
+#include "snapshot.h"
+#include "xor_delta.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace chip8 {
+namespace {
+
+constexpr size_t k_snapshot_size = sizeof(Snapshot);
+
+// A literal ends once this many unchanged bytes follow it. Long enough that
+// a token's two varints always cost less than the bytes they skip.
+constexpr size_t k_min_zero_run = 8u;
+// Varints below 2^21 take at most 3 bytes, so an encoded entry is never more
+// than one literal token larger than the snapshot.
+constexpr size_t k_max_encoded_size = k_snapshot_size + 6u;
+
+const std::array<std::byte, k_snapshot_size> k_zero_snapshot = {};
+
+const std::byte *raw_bytes(const Snapshot &snapshot) {
+  return reinterpret_cast<const std::byte *>(&snapshot);
+}
+
+uint64_t load_word(const std::byte *bytes) {
+  uint64_t word;
+  std::memcpy(&word, bytes, sizeof(word));
+  return word;
+}
+
+// Run-length encodes current XOR base (see encode_xor_delta()).
+void encode_delta(const std::byte *current, const std::byte *base,
+                  std::vector<std::byte> &out) {
+  common::encode_xor_delta(std::span(current, k_snapshot_size),
+                           std::span(base, k_snapshot_size), k_min_zero_run,
+                           out);
+}
+
+// Entries only ever come from encode_delta(), so they always apply.
+void decode_delta(const std::byte *in, size_t length, const std::byte *base,
+                  std::byte *out) {
+  std::memcpy(out, base, k_snapshot_size);
+  common::apply_xor_delta(std::span(in, length),
+                          std::span(out, k_snapshot_size));
+}
+
+common::Status check_header(const Snapshot &snapshot) {
+  if (snapshot.magic != Snapshot::k_magic) {
+    return std::unexpected(common::AppError{common::ErrorCode::InvalidArgument,
+                                            "Not a CHIP-8 snapshot"});
+  }
+  if (snapshot.version != Snapshot::k_version) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Unsupported snapshot version " + std::to_string(snapshot.version)});
+  }
+  return {};
+}
+
+} // namespace
+
+void save_snapshot(const Chip8State &chip8, Snapshot &snapshot) {
+  snapshot.magic = Snapshot::k_magic;
+  snapshot.version = Snapshot::k_version;
+  snapshot.memory = chip8.memory_;
+  for (int y = 0; y < 32; y++) {
+    snapshot.display[y] = chip8.display_row(y);
+  }
+  snapshot.stack = chip8.stack_;
+  snapshot.registers = chip8.registers_;
+  snapshot.keypad = chip8.keypad_;
+  snapshot.instructions_executed = chip8.instructions_executed_;
+  snapshot.rng_state = chip8.rng_state_;
+  snapshot.program_counter = chip8.program_counter_;
+  snapshot.index_register = chip8.index_register_;
+  snapshot.stack_pointer = chip8.stack_pointer_;
+  snapshot.delay_timer = chip8.delay_timer_;
+  snapshot.sound_timer = chip8.sound_timer_;
+  snapshot.flags =
+      (chip8.redraw_ ? Snapshot::k_redraw : 0u) |
+      (chip8.should_beep_ ? Snapshot::k_should_beep : 0u) |
+      (chip8.waiting_for_key_press_ ? Snapshot::k_waiting_for_key_press
+                                    : 0u) |
+      (chip8.waiting_for_key_release_ ? Snapshot::k_waiting_for_key_release
+                                      : 0u);
+  snapshot.reserved = {};
+}
+
+common::Status restore_snapshot(Chip8State &chip8, const Snapshot &snapshot) {
+  common::Status valid = check_header(snapshot);
+  if (!valid) {
+    return std::unexpected(valid.error());
+  }
+
+  // Rewinding usually leaves memory untouched; otherwise only drop the
+  // decodes that actually went stale.
+  const std::byte *old_memory = chip8.memory_.data();
+  const std::byte *new_memory = snapshot.memory.data();
+  if (std::memcmp(old_memory, new_memory, chip8.memory_.size()) != 0) {
+    for (size_t address = 0; address < chip8.memory_.size(); address += 8u) {
+      if (load_word(old_memory + address) !=
+          load_word(new_memory + address)) {
+        chip8.invalidate_decoded(static_cast<uint16_t>(address), 8u);
+      }
+    }
+    chip8.memory_ = snapshot.memory;
+  }
+  for (int y = 0; y < 32; y++) {
+    chip8.set_display_row(y, snapshot.display[y]);
+  }
+  chip8.stack_ = snapshot.stack;
+  chip8.registers_ = snapshot.registers;
+  chip8.keypad_ = snapshot.keypad;
+  chip8.instructions_executed_ = snapshot.instructions_executed;
+  chip8.rng_state_ = snapshot.rng_state;
+  chip8.program_counter_ = snapshot.program_counter;
+  chip8.index_register_ = snapshot.index_register;
+  chip8.stack_pointer_ = snapshot.stack_pointer;
+  chip8.delay_timer_ = snapshot.delay_timer;
+  chip8.sound_timer_ = snapshot.sound_timer;
+  chip8.redraw_ = (snapshot.flags & Snapshot::k_redraw) != 0u;
+  chip8.dirty_rows_ = k_all_rows;
+  chip8.should_beep_ = (snapshot.flags & Snapshot::k_should_beep) != 0u;
+  chip8.waiting_for_key_press_ =
+      (snapshot.flags & Snapshot::k_waiting_for_key_press) != 0u;
+  chip8.waiting_for_key_release_ =
+      (snapshot.flags & Snapshot::k_waiting_for_key_release) != 0u;
+  chip8.faulted_ = false;
+  chip8.fault_ = {};
+  return {};
+}
+
+std::span<const std::byte> snapshot_bytes(const Snapshot &snapshot) {
+  return std::as_bytes(std::span(&snapshot, 1));
+}
+
+common::StatusOr<Snapshot> parse_snapshot(std::span<const std::byte> bytes) {
+  if (bytes.size() != k_snapshot_size) {
+    return std::unexpected(common::AppError{
+        common::ErrorCode::InvalidArgument,
+        "Snapshot is " + std::to_string(bytes.size()) + " bytes, expected " +
+            std::to_string(k_snapshot_size)});
+  }
+  Snapshot snapshot;
+  std::memcpy(&snapshot, bytes.data(), k_snapshot_size);
+  common::Status valid = check_header(snapshot);
+  if (!valid) {
+    return std::unexpected(valid.error());
+  }
+  return snapshot;
+}
+
+RewindBuffer::RewindBuffer(size_t max_bytes, int keyframe_interval)
+    : ring_(std::max(max_bytes, 2u * k_max_encoded_size)),
+      keyframe_interval_(std::max(keyframe_interval, 1)) {
+  scratch_.reserve(k_max_encoded_size);
+}
+
+void RewindBuffer::push(const Chip8State &chip8) {
+  save_snapshot(chip8, current_);
+  bool keyframe =
+      entries_.empty() || since_keyframe_ + 1 >= keyframe_interval_;
+  if (!keyframe) {
+    encode_delta(raw_bytes(current_), raw_bytes(keyframe_), scratch_);
+    size_t offset = allocate(scratch_.size());
+    // Eviction took this delta's keyframe with it; start a new group.
+    keyframe = entries_.empty();
+    if (!keyframe) {
+      std::memcpy(ring_.data() + offset, scratch_.data(), scratch_.size());
+      entries_.push_back({offset, scratch_.size(), false});
+      since_keyframe_++;
+      return;
+    }
+  }
+  encode_delta(raw_bytes(current_), k_zero_snapshot.data(), scratch_);
+  size_t offset = allocate(scratch_.size());
+  std::memcpy(ring_.data() + offset, scratch_.data(), scratch_.size());
+  entries_.push_back({offset, scratch_.size(), true});
+  keyframe_ = current_;
+  since_keyframe_ = 0;
+}
+
+bool RewindBuffer::rewind(Chip8State &chip8) {
+  if (entries_.empty()) {
+    return false;
+  }
+  Entry entry = entries_.back();
+  entries_.pop_back();
+  if (entry.keyframe) {
+    current_ = keyframe_;
+    // Deltas pushed from here on need the previous group's keyframe.
+    auto previous = std::find_if(entries_.rbegin(), entries_.rend(),
+                                 [](const Entry &e) { return e.keyframe; });
+    if (previous != entries_.rend()) {
+      decode(*previous, keyframe_);
+      since_keyframe_ = static_cast<int>(previous - entries_.rbegin());
+    } else {
+      since_keyframe_ = 0;
+    }
+  } else {
+    decode(entry, current_);
+    since_keyframe_--;
+  }
+  head_ = entry.offset;
+  restore_snapshot(chip8, current_);
+  return true;
+}
+
+void RewindBuffer::clear() {
+  entries_.clear();
+  head_ = 0u;
+  since_keyframe_ = 0;
+}
+
+size_t RewindBuffer::bytes_used() const {
+  size_t used = 0u;
+  for (const Entry &entry : entries_) {
+    used += entry.length;
+  }
+  return used;
+}
+
+size_t RewindBuffer::allocate(size_t length) {
+  if (head_ + length > ring_.size()) {
+    // Whatever sits past head_ is left over from the previous lap and is the
+    // oldest history; drop it before wrapping.
+    while (!entries_.empty() && entries_.front().offset >= head_) {
+      entries_.pop_front();
+    }
+    while (!entries_.empty() && !entries_.front().keyframe) {
+      entries_.pop_front();
+    }
+    head_ = 0u;
+  }
+  size_t begin = head_;
+  size_t end = head_ + length;
+  while (!entries_.empty() && entries_.front().offset < end &&
+         begin < entries_.front().offset + entries_.front().length) {
+    // Deltas are useless without their keyframe, so drop the whole group.
+    entries_.pop_front();
+    while (!entries_.empty() && !entries_.front().keyframe) {
+      entries_.pop_front();
+    }
+  }
+  head_ = end;
+  return begin;
+}
+
+void RewindBuffer::decode(const Entry &entry, Snapshot &out) const {
+  const std::byte *base =
+      entry.keyframe ? k_zero_snapshot.data() : raw_bytes(keyframe_);
+  decode_delta(ring_.data() + entry.offset, entry.length, base,
+               reinterpret_cast<std::byte *>(&out));
+}
+
+} // namespace chip8
@@ -0,0 +1,120 @@
+#ifndef SRC_SNAPSHOT_H
+#define SRC_SNAPSHOT_H
+
+#include "app_error.h"
+#include "chip8.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace chip8 {
+
+// Everything needed to resume a machine: memory, registers, stack, timers,
+// display, keypad, key-wait flags and RNG state. The decode cache is rebuilt
+// from memory and faults are not carried, so a restored machine is always
+// runnable. The display is kept as display_row() returns it, so a snapshot
+// restores onto either framebuffer layout.
+//
+// The struct is its own wire format: fixed layout, no padding and native
+// byte order, so saving and restoring are plain copies and two snapshots can
+// be diffed bytewise. Bump k_version whenever a field changes.
+struct Snapshot {
+  static constexpr uint32_t k_magic = 0x53533843u; // "C8SS"
+  static constexpr uint32_t k_version = 2u;
+
+  static constexpr uint8_t k_redraw = 1u << 0u;
+  static constexpr uint8_t k_should_beep = 1u << 1u;
+  static constexpr uint8_t k_waiting_for_key_press = 1u << 2u;
+  static constexpr uint8_t k_waiting_for_key_release = 1u << 3u;
+
+  uint32_t magic = k_magic;
+  uint32_t version = k_version;
+  std::array<std::byte, 4096> memory = {};
+  std::array<uint64_t, 32> display = {};
+  std::array<uint16_t, 16> stack = {};
+  std::array<uint8_t, 16> registers = {};
+  std::array<uint8_t, 16> keypad = {};
+  uint64_t instructions_executed = 0u;
+  uint32_t rng_state = 0u;
+  uint16_t program_counter = 0u;
+  uint16_t index_register = 0u;
+  uint8_t stack_pointer = 0u;
+  uint8_t delay_timer = 0u;
+  uint8_t sound_timer = 0u;
+  uint8_t flags = 0u;
+  std::array<uint8_t, 4> reserved = {};
+};
+
+static_assert(std::is_trivially_copyable_v<Snapshot>);
+static_assert(std::has_unique_object_representations_v<Snapshot>,
+              "Snapshot must not contain padding");
+
+void save_snapshot(const Chip8State &chip8, Snapshot &snapshot);
+// Fails without touching `chip8` if `snapshot` has the wrong magic or
+// version. Only decodes whose memory changed are invalidated.
+common::Status restore_snapshot(Chip8State &chip8, const Snapshot &snapshot);
+
+// The bytes of `snapshot` as written to disk.
+std::span<const std::byte> snapshot_bytes(const Snapshot &snapshot);
+// Parses bytes produced by snapshot_bytes() on a machine with the same byte
+// order.
+common::StatusOr<Snapshot> parse_snapshot(std::span<const std::byte> bytes);
+
+// Frames cost 15-250 bytes of history on the bundled ROMs, so 4 MiB holds
+// from about five minutes (Space Invaders) to over half an hour at 60 Hz.
+constexpr size_t k_default_rewind_bytes = 4u << 20u;
+constexpr int k_default_keyframe_interval = 60;
+
+// Per-frame history for stepping a running machine backwards. Every
+// `keyframe_interval`-th push stores a full snapshot; the others store the
+// XOR against that keyframe, run-length encoded, which is usually tens of
+// bytes. Entries live in one byte ring of `max_bytes`; when it fills
+// the oldest keyframe and its deltas are dropped together.
+//
+// push() and rewind() each encode or decode a single entry, except that
+// rewinding past a keyframe also decodes the one before it.
+class RewindBuffer {
+public:
+  explicit RewindBuffer(
+      size_t max_bytes = k_default_rewind_bytes,
+      int keyframe_interval = k_default_keyframe_interval);
+
+  // Records the current state of `chip8` as the newest frame.
+  void push(const Chip8State &chip8);
+  // Restores the newest frame into `chip8` and drops it. Returns false if
+  // there is no history left.
+  bool rewind(Chip8State &chip8);
+  void clear();
+
+  size_t frames() const { return entries_.size(); }
+  size_t bytes_used() const;
+
+private:
+  struct Entry {
+    size_t offset;
+    size_t length;
+    bool keyframe;
+  };
+
+  // Reserves `length` bytes at the ring head, evicting old groups.
+  size_t allocate(size_t length);
+  void decode(const Entry &entry, Snapshot &out) const;
+
+  std::vector<std::byte> ring_;
+  size_t head_ = 0u;
+  int keyframe_interval_;
+  std::deque<Entry> entries_;
+  // The newest keyframe in entries_, decoded; deltas are taken against it.
+  Snapshot keyframe_ = {};
+  int since_keyframe_ = 0;
+  Snapshot current_ = {};
+  std::vector<std::byte> scratch_;
+};
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,174 @@
+#include "src/snapshot.h"
+#include "src/chip8.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace chip8 {
+
+class SnapshotTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    const uint16_t program[] = {
+        0xC0FF, // 200: RND V0, FF
+        0x7101, // 202: ADD V1, 01
+        0xF029, // 204: LD F, V0
+        0xD015, // 206: DRW V0, V1, 5
+        0x1200, // 208: JP 200
+    };
+    ASSERT_TRUE(chip8.load_program(program_bytes(program)));
+    chip8.seed_random(1234u);
+  }
+
+  // One 60 Hz frame as the frontend runs it, including presenting the
+  // display so the VIP display wait releases.
+  void run_frame() {
+    ASSERT_TRUE(chip8.run_cycles(10));
+    chip8.decrement_timers();
+    chip8.redraw_ = false;
+  }
+
+  Chip8 chip8;
+};
+
+TEST_F(SnapshotTest, RestoreResumesIdentically) {
+  for (int frame = 0; frame < 5; frame++) {
+    run_frame();
+  }
+  Snapshot snapshot;
+  save_snapshot(chip8, snapshot);
+  for (int frame = 0; frame < 20; frame++) {
+    run_frame();
+  }
+  std::array<uint8_t, 64 * 32> expected_display = chip8.display_;
+  std::array<uint8_t, 16> expected_registers = chip8.registers_;
+
+  ASSERT_TRUE(restore_snapshot(chip8, snapshot));
+  for (int frame = 0; frame < 20; frame++) {
+    run_frame();
+  }
+  EXPECT_EQ(chip8.display_, expected_display);
+  EXPECT_EQ(chip8.registers_, expected_registers);
+}
+
+TEST_F(SnapshotTest, RestoresOntoTheOtherFramebufferLayout) {
+  for (int frame = 0; frame < 5; frame++) {
+    run_frame();
+  }
+  Snapshot snapshot;
+  save_snapshot(chip8, snapshot);
+  PackedChip8 packed;
+  ASSERT_TRUE(restore_snapshot(packed, snapshot));
+  for (int frame = 0; frame < 20; frame++) {
+    run_frame();
+    ASSERT_TRUE(packed.run_cycles(10));
+    packed.decrement_timers();
+    packed.redraw_ = false;
+  }
+  for (int y = 0; y < 32; y++) {
+    EXPECT_EQ(packed.display_row(y), chip8.display_row(y)) << "row " << y;
+  }
+
+  Snapshot from_packed;
+  save_snapshot(packed, from_packed);
+  save_snapshot(chip8, snapshot);
+  EXPECT_EQ(std::memcmp(&from_packed, &snapshot, sizeof(Snapshot)), 0);
+}
+
+TEST_F(SnapshotTest, RestoreDropsStaleDecodes) {
+  ASSERT_TRUE(chip8.run_cycles(5));
+  Snapshot snapshot;
+  save_snapshot(chip8, snapshot);
+  snapshot.memory[0x202] = std::byte{0x61}; // 202: LD V1, 01
+  snapshot.program_counter = 0x202;
+  snapshot.flags = 0u;
+
+  ASSERT_TRUE(restore_snapshot(chip8, snapshot));
+  chip8.registers_[1] = 7u;
+  ASSERT_TRUE(chip8.execute_cycle());
+  EXPECT_EQ(chip8.registers_[1], 1u);
+}
+
+TEST_F(SnapshotTest, BytesRoundTripAndRejectOtherVersions) {
+  ASSERT_TRUE(chip8.run_cycles(20));
+  Snapshot snapshot;
+  save_snapshot(chip8, snapshot);
+  std::span<const std::byte> bytes = snapshot_bytes(snapshot);
+  std::vector<std::byte> file(bytes.begin(), bytes.end());
+
+  common::StatusOr<Snapshot> parsed = parse_snapshot(file);
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_EQ(parsed->program_counter, chip8.program_counter_);
+  EXPECT_EQ(parsed->rng_state, chip8.rng_state_);
+
+  file[4] = std::byte{Snapshot::k_version + 1u};
+  EXPECT_FALSE(parse_snapshot(file).has_value());
+  EXPECT_FALSE(
+      parse_snapshot(std::span(file).first(file.size() - 1)).has_value());
+}
+
+TEST_F(SnapshotTest, RewindStepsBackOneFrameAtATime) {
+  RewindBuffer rewind(k_default_rewind_bytes, 4);
+  std::vector<Snapshot> frames;
+  for (int frame = 0; frame < 10; frame++) {
+    run_frame();
+    rewind.push(chip8);
+    save_snapshot(chip8, frames.emplace_back());
+  }
+  ASSERT_EQ(rewind.frames(), 10u);
+
+  for (int frame = 9; frame >= 0; frame--) {
+    ASSERT_TRUE(rewind.rewind(chip8));
+    Snapshot restored;
+    save_snapshot(chip8, restored);
+    EXPECT_EQ(std::memcmp(&restored, &frames[frame], sizeof(Snapshot)), 0)
+        << "frame " << frame;
+  }
+  EXPECT_FALSE(rewind.rewind(chip8));
+}
+
+TEST_F(SnapshotTest, RewindContinuesAfterSteppingBack) {
+  RewindBuffer rewind(k_default_rewind_bytes, 4);
+  for (int frame = 0; frame < 6; frame++) {
+    run_frame();
+    rewind.push(chip8);
+  }
+  // Back past the second keyframe, then record a new branch of history.
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(rewind.rewind(chip8));
+  }
+  Snapshot expected;
+  for (int frame = 0; frame < 3; frame++) {
+    run_frame();
+    rewind.push(chip8);
+  }
+  save_snapshot(chip8, expected);
+  run_frame();
+  rewind.push(chip8);
+
+  ASSERT_TRUE(rewind.rewind(chip8));
+  ASSERT_TRUE(rewind.rewind(chip8));
+  Snapshot restored;
+  save_snapshot(chip8, restored);
+  EXPECT_EQ(std::memcmp(&restored, &expected, sizeof(Snapshot)), 0);
+}
+
+TEST_F(SnapshotTest, RewindEvictsOldestGroupsWhenFull) {
+  RewindBuffer rewind(64u * 1024u, 60);
+  for (int frame = 0; frame < 5000; frame++) {
+    run_frame();
+    rewind.push(chip8);
+    ASSERT_LE(rewind.bytes_used(), 64u * 1024u);
+  }
+  ASSERT_GT(rewind.frames(), 60u);
+  ASSERT_LT(rewind.frames(), 5000u);
+  size_t frames = rewind.frames();
+  for (size_t i = 0; i < frames; i++) {
+    ASSERT_TRUE(rewind.rewind(chip8));
+  }
+  EXPECT_FALSE(rewind.rewind(chip8));
+}
+
+} // namespace chip8
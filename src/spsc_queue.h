@@ -0,0 +1,76 @@
+#ifndef SRC_SPSC_QUEUE_H
+#define SRC_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace common {
+
+// Bounded lock-free FIFO for exactly one producer thread and one consumer
+// thread. Each side caches the other's index and only reloads it when the
+// queue looks full (or empty), so the common case touches no shared cache
+// line besides the slot itself.
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(std::has_single_bit(Capacity),
+                "Capacity must be a power of two");
+
+public:
+  // Producer side. Returns false, dropping `value`, if the queue is full.
+  bool try_push(const T &value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ == Capacity) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head - cached_tail_ == Capacity) {
+        return false;
+      }
+    }
+    slots_[head & k_mask] = value;
+    head_.store(head + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. The oldest element, or null if the queue is empty. Stays
+  // valid until pop().
+  const T *front() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == cached_head_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail == cached_head_) {
+        return nullptr;
+      }
+    }
+    return &slots_[tail & k_mask];
+  }
+
+  // Consumer side. Drops the element front() returned.
+  void pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1u,
+                std::memory_order_release);
+  }
+
+  // Consumer side. Moves the oldest element into `value`; false if empty.
+  bool try_pop(T &value) {
+    const T *oldest = front();
+    if (oldest == nullptr) {
+      return false;
+    }
+    value = *oldest;
+    pop();
+    return true;
+  }
+
+private:
+  static constexpr size_t k_mask = Capacity - 1u;
+
+  alignas(64) std::atomic<size_t> head_ = 0u;
+  size_t cached_tail_ = 0u;
+  alignas(64) std::atomic<size_t> tail_ = 0u;
+  size_t cached_head_ = 0u;
+  alignas(64) std::array<T, Capacity> slots_ = {};
+};
+
+} // namespace common
+
+#endif
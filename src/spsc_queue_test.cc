@@ -0,0 +1,44 @@
+#include "src/spsc_queue.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <thread>
+
+namespace common {
+
+TEST(SpscQueueTest, PushFailsWhenFull) {
+  SpscQueue<int, 4> queue;
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.try_push(i));
+  }
+  EXPECT_FALSE(queue.try_push(4));
+  int value = -1;
+  ASSERT_TRUE(queue.try_pop(value));
+  EXPECT_EQ(value, 0);
+  EXPECT_TRUE(queue.try_push(4));
+}
+
+TEST(SpscQueueTest, DeliversEverythingInOrderAcrossThreads) {
+  constexpr uint64_t k_count = 100000u;
+  SpscQueue<uint64_t, 64> queue;
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < k_count; i++) {
+      while (!queue.try_push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (uint64_t expected = 0; expected < k_count;) {
+    const uint64_t *value = queue.front();
+    if (value == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(*value, expected);
+    queue.pop();
+    expected++;
+  }
+  producer.join();
+  EXPECT_EQ(queue.front(), nullptr);
+}
+
+} // namespace common
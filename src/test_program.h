@@ -0,0 +1,41 @@
+#ifndef SRC_TEST_PROGRAM_H
+#define SRC_TEST_PROGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+namespace chip8 {
+
+// `words` as ROM bytes: each instruction big-endian, in order.
+inline std::vector<std::byte> program_bytes(std::span<const uint16_t> words) {
+  std::vector<std::byte> bytes;
+  bytes.reserve(words.size() * 2u);
+  for (uint16_t word : words) {
+    bytes.push_back(static_cast<std::byte>(word >> 8u));
+    bytes.push_back(static_cast<std::byte>(word & 0xFFu));
+  }
+  return bytes;
+}
+
+inline std::vector<std::byte>
+program_bytes(std::initializer_list<uint16_t> words) {
+  return program_bytes(std::span(words.begin(), words.size()));
+}
+
+// Loads `words` at program_counter_ through `machine.load_program()`, so
+// they run out of the decode cache like a ROM does. Aborts if they do not
+// fit, which only a broken test or benchmark asks for.
+template <typename Machine>
+void load_words(Machine &machine, std::initializer_list<uint16_t> words) {
+  if (!machine.load_program(program_bytes(words))) {
+    std::abort();
+  }
+}
+
+} // namespace chip8
+
+#endif
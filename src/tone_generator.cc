@@ -0,0 +1,45 @@
+#include "tone_generator.h"
+
+#include <algorithm>
+
+namespace chip8 {
+
+ToneGenerator::ToneGenerator() {
+  for (int i = 0; i < k_period_samples; i++) {
+    period_[i] = i < k_period_samples / 2 ? k_tone_volume : -k_tone_volume;
+  }
+}
+
+void ToneGenerator::generate(std::span<int16_t> out) {
+  // Only the audio thread writes these, so relaxed read-modify-writes are
+  // enough for other threads to see consistent counts.
+  callbacks_.fetch_add(1u, std::memory_order_relaxed);
+  samples_.fetch_add(out.size(), std::memory_order_relaxed);
+  if (static_cast<int>(out.size()) >
+      max_request_samples_.load(std::memory_order_relaxed)) {
+    max_request_samples_.store(static_cast<int>(out.size()),
+                               std::memory_order_relaxed);
+  }
+
+  if (!beeping_.load(std::memory_order_relaxed)) {
+    std::fill(out.begin(), out.end(), int16_t{0});
+    phase_ = 0;
+    return;
+  }
+  size_t written = 0u;
+  while (written < out.size()) {
+    size_t run = std::min<size_t>(k_period_samples - phase_,
+                                  out.size() - written);
+    std::copy_n(period_.begin() + phase_, run, out.begin() + written);
+    written += run;
+    phase_ = (phase_ + static_cast<int>(run)) % k_period_samples;
+  }
+}
+
+AudioStats ToneGenerator::stats() const {
+  return {callbacks_.load(std::memory_order_relaxed),
+          samples_.load(std::memory_order_relaxed),
+          max_request_samples_.load(std::memory_order_relaxed)};
+}
+
+} // namespace chip8
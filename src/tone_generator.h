@@ -0,0 +1,56 @@
+#ifndef SRC_TONE_GENERATOR_H
+#define SRC_TONE_GENERATOR_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+namespace chip8 {
+
+constexpr int k_samples_per_second = 44100;
+
+// Counters kept by the audio thread, readable from any thread.
+struct AudioStats {
+  uint64_t callbacks = 0u;
+  uint64_t samples = 0u;
+  // The largest single request from the device, a floor on output latency.
+  int max_request_samples = 0;
+};
+
+// Synthesises the beeper's 440 Hz square wave on the audio thread. The
+// emulation thread only flips set_beeping() once per frame; generate() runs
+// from the device callback, copies whole stretches of a precomputed period
+// and never allocates.
+class ToneGenerator {
+public:
+  static constexpr int k_tone_hz = 440;
+  static constexpr int16_t k_tone_volume = 3000;
+  static constexpr int k_period_samples = k_samples_per_second / k_tone_hz;
+
+  ToneGenerator();
+
+  // Emulation thread: whether the sound timer is running.
+  void set_beeping(bool beeping) {
+    beeping_.store(beeping, std::memory_order_relaxed);
+  }
+
+  // Audio thread: fills `out` with the next samples. Silence restarts the
+  // wave, so every beep begins on the same edge.
+  void generate(std::span<int16_t> out);
+
+  AudioStats stats() const;
+
+private:
+  std::array<int16_t, k_period_samples> period_;
+  int phase_ = 0;
+  std::atomic<bool> beeping_ = false;
+
+  std::atomic<uint64_t> callbacks_ = 0u;
+  std::atomic<uint64_t> samples_ = 0u;
+  std::atomic<int> max_request_samples_ = 0;
+};
+
+} // namespace chip8
+
+#endif
@@ -0,0 +1,53 @@
+#include "src/tone_generator.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <vector>
+
+namespace chip8 {
+
+TEST(ToneGeneratorTest, SilentUntilBeeping) {
+  ToneGenerator tone;
+  std::vector<int16_t> samples(735, 1);
+  tone.generate(samples);
+  EXPECT_TRUE(std::all_of(samples.begin(), samples.end(),
+                          [](int16_t sample) { return sample == 0; }));
+}
+
+TEST(ToneGeneratorTest, SquareWaveContinuesAcrossRequests) {
+  ToneGenerator tone;
+  tone.set_beeping(true);
+  // Uneven request sizes, as a device asks for whatever it has room for.
+  std::vector<int16_t> samples;
+  for (int request : {7, 150, 1, 93, 512}) {
+    std::vector<int16_t> chunk(request);
+    tone.generate(chunk);
+    samples.insert(samples.end(), chunk.begin(), chunk.end());
+  }
+  for (size_t i = 0; i < samples.size(); i++) {
+    int16_t expected = i % ToneGenerator::k_period_samples <
+                               ToneGenerator::k_period_samples / 2
+                           ? ToneGenerator::k_tone_volume
+                           : -ToneGenerator::k_tone_volume;
+    ASSERT_EQ(samples[i], expected) << "sample " << i;
+  }
+
+  AudioStats stats = tone.stats();
+  EXPECT_EQ(stats.callbacks, 5u);
+  EXPECT_EQ(stats.samples, samples.size());
+  EXPECT_EQ(stats.max_request_samples, 512);
+}
+
+TEST(ToneGeneratorTest, SilenceRestartsTheWave) {
+  ToneGenerator tone;
+  tone.set_beeping(true);
+  std::vector<int16_t> samples(75);
+  tone.generate(samples);
+  EXPECT_EQ(samples.back(), -ToneGenerator::k_tone_volume);
+  tone.set_beeping(false);
+  tone.generate(samples);
+  tone.set_beeping(true);
+  tone.generate(samples);
+  EXPECT_EQ(samples.front(), ToneGenerator::k_tone_volume);
+}
+
+} // namespace chip8
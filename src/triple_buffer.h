@@ -0,0 +1,61 @@
+#ifndef SRC_TRIPLE_BUFFER_H
+#define SRC_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace common {
+
+// Hands the latest value from one writer thread to one reader thread
+// without locks or blocking. The writer fills back() and publish()es it; the
+// reader calls acquire() and then reads front(). Each side owns one slot and
+// the third sits in the middle, swapped with a single atomic exchange, so
+// neither side ever waits for the other and the reader never sees a torn
+// value. Values the reader was too slow to acquire are skipped.
+template <typename T> class TripleBuffer {
+public:
+  // The slot the writer fills next. Its contents are whatever was published
+  // two or more publishes ago.
+  T &back() { return slots_[back_].value; }
+
+  // Makes back() the newest value and hands the writer another slot.
+  void publish() {
+    uint8_t previous =
+        middle_.exchange(back_ | k_fresh, std::memory_order_acq_rel);
+    back_ = previous & k_index_mask;
+  }
+
+  // Moves the newest published value into front(). Returns false, leaving
+  // front() as it was, if nothing was published since the last acquire().
+  bool acquire() {
+    if ((middle_.load(std::memory_order_relaxed) & k_fresh) == 0u) {
+      return false;
+    }
+    uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & k_index_mask;
+    return true;
+  }
+
+  const T &front() const { return slots_[front_].value; }
+
+private:
+  static constexpr uint8_t k_index_mask = 0x3u;
+  static constexpr uint8_t k_fresh = 0x4u;
+
+  // Slots on separate cache lines so the two threads never false-share.
+  struct alignas(64) Slot {
+    T value = {};
+  };
+
+  std::array<Slot, 3> slots_;
+  // Index of the middle slot, plus k_fresh if the writer published it and
+  // the reader has not taken it yet.
+  alignas(64) std::atomic<uint8_t> middle_ = 1u;
+  alignas(64) uint8_t back_ = 0u;
+  alignas(64) uint8_t front_ = 2u;
+};
+
+} // namespace common
+
+#endif
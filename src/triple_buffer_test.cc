@@ -0,0 +1,50 @@
+#include "src/triple_buffer.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <cstdint>
+#include <thread>
+
+namespace common {
+
+TEST(TripleBufferTest, AcquireSeesOnlyTheNewestPublish) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.acquire());
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+  ASSERT_TRUE(buffer.acquire());
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_FALSE(buffer.acquire());
+  EXPECT_EQ(buffer.front(), 2);
+}
+
+// Every field of a published value is the same number, so a torn read
+// shows up as a mix.
+TEST(TripleBufferTest, ReaderNeverSeesTornOrOlderValues) {
+  using Value = std::array<uint64_t, 32>;
+  constexpr uint64_t k_publishes = 50000u;
+  TripleBuffer<Value> buffer;
+  std::thread writer([&] {
+    for (uint64_t i = 1; i <= k_publishes; i++) {
+      buffer.back().fill(i);
+      buffer.publish();
+    }
+  });
+  uint64_t last = 0u;
+  while (last < k_publishes) {
+    if (!buffer.acquire()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const Value &value = buffer.front();
+    for (uint64_t field : value) {
+      ASSERT_EQ(field, value[0]);
+    }
+    ASSERT_GT(value[0], last);
+    last = value[0];
+  }
+  writer.join();
+}
+
+} // namespace common
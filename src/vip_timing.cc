@@ -0,0 +1,112 @@
+#include "vip_timing.h"
+
+namespace chip8 {
+namespace {
+
+// Fetching both bytes, advancing the PC and jumping through the interpreter's
+// dispatch table.
+constexpr int k_fetch_cycles = 40;
+// Extra cost of the branch a taken skip adds.
+constexpr int k_skip_taken_cycles = 4;
+
+// Dxyn: locating the sprite and the screen byte, then per row copying the
+// byte and XORing it in, plus for a sprite not on a byte boundary a shift of
+// each row per bit of misalignment and a second screen byte.
+constexpr int k_draw_setup_cycles = 68;
+constexpr int k_draw_row_cycles = 20;
+constexpr int k_draw_unaligned_row_cycles = 16;
+constexpr int k_draw_shift_cycles = 4;
+
+// 00E0 stores zero over the 256 display bytes, 4 machine cycles a byte.
+constexpr int k_clear_cycles = 256 * 4;
+constexpr int k_bcd_setup_cycles = 80;
+constexpr int k_bcd_subtract_cycles = 16;
+constexpr int k_copy_setup_cycles = 28;
+constexpr int k_copy_register_cycles = 14;
+
+// Cost beyond the fetch, indexed by Op. vip_cycles() adds the operand-
+// dependent parts: taken skips, Dxyn, Fx33, Fx55 and Fx65.
+constexpr std::array<int, k_num_ops> k_op_cycles = [] {
+  std::array<int, k_num_ops> cycles = {};
+  auto set = [&cycles](Op op, int value) {
+    cycles[static_cast<size_t>(op)] = value;
+  };
+  set(Op::Cls, k_clear_cycles);
+  set(Op::Ret, 10);
+  set(Op::Jp, 12);
+  set(Op::Call, 26);
+  set(Op::SeVxKk, 10);
+  set(Op::SneVxKk, 10);
+  set(Op::SeVxVy, 14);
+  set(Op::LdVxKk, 6);
+  set(Op::AddVxKk, 10);
+  // 8xyN builds and runs a two-byte 1802 routine for the ALU operation.
+  for (Op op : {Op::LdVxVy, Op::Or, Op::And, Op::Xor, Op::AddVxVy, Op::Sub,
+                Op::Shr, Op::Subn, Op::Shl}) {
+    set(op, 44);
+  }
+  set(Op::SneVxVy, 14);
+  set(Op::LdI, 12);
+  set(Op::JpV0, 22);
+  set(Op::Rnd, 36);
+  set(Op::Skp, 14);
+  set(Op::Sknp, 14);
+  set(Op::LdVxDt, 10);
+  set(Op::LdDtVx, 10);
+  set(Op::LdStVx, 10);
+  set(Op::AddIVx, 18);
+  set(Op::LdFVx, 20);
+  return cycles;
+}();
+
+} // namespace
+
+int vip_cycles(const Instruction &instruction,
+               const std::array<uint8_t, 16> &registers) {
+  const uint8_t vx = registers[instruction.x];
+  const uint8_t vy = registers[instruction.y];
+  const int cycles =
+      k_fetch_cycles + k_op_cycles[static_cast<size_t>(instruction.op)];
+  switch (instruction.op) {
+  case Op::SeVxKk:
+    return cycles + (vx == instruction.kk ? k_skip_taken_cycles : 0);
+  case Op::SneVxKk:
+    return cycles + (vx != instruction.kk ? k_skip_taken_cycles : 0);
+  case Op::SeVxVy:
+    return cycles + (vx == vy ? k_skip_taken_cycles : 0);
+  case Op::SneVxVy:
+    return cycles + (vx != vy ? k_skip_taken_cycles : 0);
+  case Op::Drw: {
+    const int shift = vx % 8;
+    int row_cycles = k_draw_row_cycles;
+    if (shift != 0) {
+      row_cycles += k_draw_unaligned_row_cycles + shift * k_draw_shift_cycles;
+    }
+    return cycles + k_draw_setup_cycles + instruction.n * row_cycles;
+  }
+  case Op::LdBVx:
+    return cycles + k_bcd_setup_cycles +
+           (vx / 100 + vx / 10 % 10 + vx % 10) * k_bcd_subtract_cycles;
+  case Op::LdIVx:
+  case Op::LdVxI:
+    return cycles + k_copy_setup_cycles +
+           (instruction.x + 1) * k_copy_register_cycles;
+  default:
+    return cycles;
+  }
+}
+
+int CycleScheduler::next_frame_cycles() {
+  constexpr uint64_t k_clocks_per_frame_unit =
+      uint64_t{k_clocks_per_machine_cycle} * k_vip_frames_per_second;
+  const uint64_t clocks = clock_hz_ + remainder_;
+  const uint64_t frame_cycles = clocks / k_clocks_per_frame_unit;
+  remainder_ = clocks % k_clocks_per_frame_unit;
+  machine_cycles_ += frame_cycles;
+  if (frame_cycles <= static_cast<uint64_t>(k_vip_interrupt_cycles_per_frame)) {
+    return 0;
+  }
+  return static_cast<int>(frame_cycles - k_vip_interrupt_cycles_per_frame);
+}
+
+} // namespace chip8
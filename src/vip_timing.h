@@ -0,0 +1,73 @@
+#ifndef SRC_VIP_TIMING_H
+#define SRC_VIP_TIMING_H
+
+#include "instruction.h"
+#include <array>
+#include <cstdint>
+
+namespace chip8 {
+
+// The COSMAC VIP's CDP1802 clock (the 3.52128 MHz crystal halved), and the
+// clock pulses in each of its machine cycles.
+constexpr uint32_t k_vip_clock_hz = 1'760'640u;
+constexpr int k_clocks_per_machine_cycle = 8;
+constexpr int k_vip_frames_per_second = 60;
+
+// Machine cycles the display takes from the interpreter every frame. The
+// CDP1861 draws each of the 32 rows on 4 of its 128 visible scan lines (14
+// machine cycles each) and the interrupt routine spends all of them
+// re-pointing DMA at the row, then decrements the timers on the way out.
+constexpr int k_vip_interrupt_cycles_per_frame = 128 * 14 + 44;
+
+// What the original interpreter spends on one instruction, in machine
+// cycles, fetch and decode included. `registers` are V0..VF before the
+// instruction runs: skips cost more when taken, Dxyn grows with the sprite's
+// height and with how far Vx is from a byte boundary (each row is shifted
+// into place bit by bit and then spans two bytes), Fx33 with the digits it
+// extracts by repeated subtraction, and Fx55/Fx65 with x.
+//
+// The costs are estimates from the VIP interpreter's routines rather than a
+// cycle-by-cycle CDP1802 trace, so a program's speed comes out right on
+// average even where a single instruction is off by a few cycles.
+int vip_cycles(const Instruction &instruction,
+               const std::array<uint8_t, 16> &registers);
+
+// Turns a clock rate into per-frame budgets of interpreter machine cycles:
+// each 60 Hz frame gets the clock's machine cycles for 1/60 s, less the
+// display interrupt's share. Rates that are not a multiple of 480 Hz carry
+// the remainder into later frames so no cycle is lost. The clock can be
+// changed between frames.
+class CycleScheduler {
+public:
+  explicit CycleScheduler(uint32_t clock_hz = k_vip_clock_hz)
+      : clock_hz_(clock_hz) {}
+
+  uint32_t clock_hz() const { return clock_hz_; }
+  void set_clock_hz(uint32_t clock_hz) { clock_hz_ = clock_hz; }
+
+  // Interpreter machine cycles in the next frame, 0 when the clock is too
+  // slow to leave any after the display.
+  int next_frame_cycles();
+  // Cycles left to run, carried between calls to run_machine_cycles(): a
+  // negative budget is an overrun the next frame pays back.
+  int64_t &budget() { return budget_; }
+  // Adds the next frame's cycles to budget() and returns it.
+  int64_t &begin_frame() {
+    budget_ += next_frame_cycles();
+    return budget_;
+  }
+  // Machine cycles in every frame started so far, display included, for
+  // reporting the emulated clock.
+  uint64_t machine_cycles() const { return machine_cycles_; }
+
+private:
+  uint32_t clock_hz_;
+  // Clock pulses left over from previous frames.
+  uint64_t remainder_ = 0u;
+  int64_t budget_ = 0;
+  uint64_t machine_cycles_ = 0u;
+};
+
+} // namespace chip8
+
+#endif
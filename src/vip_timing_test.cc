@@ -0,0 +1,99 @@
+#include "src/vip_timing.h"
+#include "src/chip8.h"
+#include "src/headless.h"
+#include "src/test_program.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+
+namespace chip8 {
+namespace {
+
+int cycles_for(uint16_t word, const std::array<uint8_t, 16> &registers = {}) {
+  return vip_cycles(decode(word >> 8u, word & 0xFFu), registers);
+}
+
+} // namespace
+
+TEST(VipTimingTest, DrawCostGrowsWithHeightAndMisalignment) {
+  std::array<uint8_t, 16> registers = {};
+  const int aligned_short = cycles_for(0xD011, registers);
+  const int aligned_tall = cycles_for(0xD01F, registers);
+  EXPECT_GT(aligned_tall, aligned_short);
+  registers[0] = 3;
+  const int shifted = cycles_for(0xD01F, registers);
+  registers[0] = 7;
+  const int shifted_more = cycles_for(0xD01F, registers);
+  EXPECT_GT(shifted, aligned_tall);
+  EXPECT_GT(shifted_more, shifted);
+  // Only the position within a byte matters.
+  registers[0] = 8 + 3;
+  EXPECT_EQ(cycles_for(0xD01F, registers), shifted);
+}
+
+TEST(VipTimingTest, OperandDependentCosts) {
+  std::array<uint8_t, 16> registers = {};
+  registers[1] = 0x42;
+  EXPECT_GT(cycles_for(0x3142, registers), cycles_for(0x3143, registers));
+  EXPECT_GT(cycles_for(0x4143, registers), cycles_for(0x4142, registers));
+  EXPECT_GT(cycles_for(0xF555), cycles_for(0xF055));
+  EXPECT_EQ(cycles_for(0xF565), cycles_for(0xF555));
+  registers[1] = 199;
+  const int many_digits = cycles_for(0xF133, registers);
+  registers[1] = 100;
+  EXPECT_GT(many_digits, cycles_for(0xF133, registers));
+  // 00E0 writes the whole display; 6xkk is one register write.
+  EXPECT_GT(cycles_for(0x00E0), 10 * cycles_for(0x6000));
+}
+
+TEST(CycleSchedulerTest, VipClockLeavesTheInterpreterItsShare) {
+  CycleScheduler scheduler;
+  // 1 760 640 Hz / 8 / 60 = 3668 machine cycles a frame.
+  EXPECT_EQ(scheduler.next_frame_cycles(),
+            3668 - k_vip_interrupt_cycles_per_frame);
+  EXPECT_EQ(scheduler.machine_cycles(), 3668u);
+}
+
+TEST(CycleSchedulerTest, CarriesFractionalCyclesAndChangesClock) {
+  // Half a machine cycle a frame beyond 4000.
+  CycleScheduler scheduler(480u * 4000u + 240u);
+  const int first = scheduler.next_frame_cycles();
+  const int second = scheduler.next_frame_cycles();
+  EXPECT_EQ(first + second, 8001 - 2 * k_vip_interrupt_cycles_per_frame);
+  scheduler.set_clock_hz(480u * 100u);
+  // Too slow for the display to leave anything.
+  EXPECT_EQ(scheduler.next_frame_cycles(), 0);
+}
+
+TEST(CycleSchedulerTest, RunsTheBudgetAndCarriesTheOverrun) {
+  Chip8 chip8;
+  // 200: ADD V0, 1; 202: JP 200
+  load_words(chip8, {0x7001, 0x1200});
+  const int add = cycles_for(0x7001);
+  const int jump = cycles_for(0x1200);
+  int64_t budget = 3 * (add + jump) + 1;
+  ASSERT_TRUE(chip8.run_machine_cycles(budget));
+  // The seventh instruction starts with one cycle left and overruns.
+  EXPECT_EQ(chip8.instructions_executed_, 7u);
+  EXPECT_EQ(budget, 1 - add);
+  EXPECT_EQ(chip8.registers_[0], 4u);
+  // Nothing runs until the overrun is paid back.
+  budget += add - 1;
+  ASSERT_TRUE(chip8.run_machine_cycles(budget));
+  EXPECT_EQ(chip8.instructions_executed_, 7u);
+}
+
+TEST(CycleSchedulerTest, DisplayWaitForfeitsTheFrame) {
+  Chip8 chip8;
+  // 200: CLS; 202: ADD V0, 1
+  load_words(chip8, {0x00E0, 0x7001});
+  CycleScheduler scheduler;
+  ASSERT_TRUE(chip8.run_machine_cycles(scheduler.begin_frame()));
+  EXPECT_EQ(chip8.instructions_executed_, 1u);
+  EXPECT_EQ(scheduler.budget(), 0);
+  chip8.redraw_ = false;
+  ASSERT_TRUE(run_headless_frame(chip8, scheduler));
+  EXPECT_EQ(chip8.registers_[0], 1u);
+}
+
+} // namespace chip8
@@ -0,0 +1,67 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+WorkStealingPool::WorkStealingPool(unsigned num_workers)
+    : num_workers_(std::max(num_workers, 1u)),
+      queues_(std::make_unique<Queue[]>(num_workers_)) {}
+
+std::optional<size_t> WorkStealingPool::pop(unsigned worker) {
+  Queue &queue = queues_[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return std::nullopt;
+  }
+  size_t task = queue.tasks.back();
+  queue.tasks.pop_back();
+  return task;
+}
+
+std::optional<size_t> WorkStealingPool::steal(unsigned thief) {
+  for (unsigned i = 1; i < num_workers_; i++) {
+    Queue &victim = queues_[(thief + i) % num_workers_];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      size_t task = victim.tasks.front();
+      victim.tasks.pop_front();
+      return task;
+    }
+  }
+  return std::nullopt;
+}
+
+void WorkStealingPool::run(size_t num_tasks,
+                           const std::function<void(size_t)> &task) {
+  // Tasks are never added once the batch starts, so a worker that finds
+  // every queue empty can simply exit.
+  for (unsigned w = 0; w < num_workers_; w++) {
+    size_t begin = num_tasks * w / num_workers_;
+    size_t end = num_tasks * (w + 1) / num_workers_;
+    for (size_t i = begin; i < end; i++) {
+      queues_[w].tasks.push_back(i);
+    }
+  }
+
+  std::vector<std::jthread> workers;
+  workers.reserve(num_workers_);
+  for (unsigned w = 0; w < num_workers_; w++) {
+    workers.emplace_back([this, w, &task]() {
+      while (true) {
+        std::optional<size_t> next = pop(w);
+        if (!next) {
+          next = steal(w);
+        }
+        if (!next) {
+          return;
+        }
+        task(*next);
+      }
+    });
+  }
+}
+
+} // namespace common
@@ -0,0 +1,45 @@
+#ifndef SRC_WORK_STEALING_POOL_H
+#define SRC_WORK_STEALING_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace common {
+
+// Runs a fixed batch of independent tasks across a set of worker threads.
+// Each worker owns a deque seeded with a contiguous slice of the batch; it
+// pops from the back of its own deque and, once that runs dry, steals from
+// the front of the other workers' deques so long tasks do not leave cores
+// idle at the end of a batch.
+class WorkStealingPool {
+public:
+  explicit WorkStealingPool(unsigned num_workers);
+
+  // Invokes task(i) for every i in [0, num_tasks) and blocks until all of
+  // them have finished.
+  void run(size_t num_tasks, const std::function<void(size_t)> &task);
+
+  unsigned num_workers() const { return num_workers_; }
+
+private:
+  // Padded to a cache line so workers locking their own queue do not
+  // contend with neighbours.
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  std::optional<size_t> pop(unsigned worker);
+  std::optional<size_t> steal(unsigned thief);
+
+  unsigned num_workers_;
+  std::unique_ptr<Queue[]> queues_;
+};
+
+} // namespace common
+
+#endif
@@ -0,0 +1,76 @@
+#include "xor_delta.h"
+#include "byte_stream.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace common {
+namespace {
+
+uint64_t load_word(const std::byte *bytes) {
+  uint64_t word;
+  std::memcpy(&word, bytes, sizeof(word));
+  return word;
+}
+
+} // namespace
+
+void encode_xor_delta(std::span<const std::byte> current,
+                      std::span<const std::byte> base,
+                      size_t min_unchanged_run, std::vector<std::byte> &out) {
+  out.clear();
+  ByteWriter writer(out);
+  const size_t size = current.size();
+  size_t i = 0u;
+  while (i < size) {
+    size_t run_start = i;
+    while (i + 8u <= size &&
+           load_word(&current[i]) == load_word(&base[i])) {
+      i += 8u;
+    }
+    while (i < size && current[i] == base[i]) {
+      i++;
+    }
+    if (i == size) {
+      break;
+    }
+    size_t literal_start = i;
+    size_t unchanged = 0u;
+    for (; i < size && unchanged < min_unchanged_run; i++) {
+      unchanged = current[i] == base[i] ? unchanged + 1u : 0u;
+    }
+    size_t literal_end = i - unchanged;
+    writer.varint(static_cast<uint32_t>(literal_start - run_start));
+    writer.varint(static_cast<uint32_t>(literal_end - literal_start));
+    for (size_t j = literal_start; j < literal_end; j++) {
+      out.push_back(current[j] ^ base[j]);
+    }
+    i = literal_end;
+  }
+}
+
+bool apply_xor_delta(std::span<const std::byte> delta,
+                     std::span<std::byte> out) {
+  ByteReader reader(delta);
+  size_t position = 0u;
+  while (!reader.at_end()) {
+    const size_t unchanged = reader.varint();
+    const size_t literal = reader.varint();
+    // Checked one at a time: their sum could wrap.
+    if (!reader.ok() || unchanged > out.size() - position ||
+        literal > out.size() - position - unchanged) {
+      return false;
+    }
+    position += unchanged;
+    std::span<const std::byte> bytes = reader.bytes(literal);
+    if (!reader.ok()) {
+      return false;
+    }
+    for (std::byte value : bytes) {
+      out[position++] ^= value;
+    }
+  }
+  return true;
+}
+
+} // namespace common
@@ -0,0 +1,26 @@
+#ifndef SRC_XOR_DELTA_H
+#define SRC_XOR_DELTA_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// Run-length encodes `current` XOR `base` (the same size) into `out` as
+// (unchanged run, literal length, literal XOR bytes) tokens, the two
+// lengths as ByteWriter varints. A literal ends once `min_unchanged_run`
+// unchanged bytes follow it; trailing unchanged bytes are left implicit.
+// Shared by rewind snapshots and RLE captures.
+void encode_xor_delta(std::span<const std::byte> current,
+                      std::span<const std::byte> base,
+                      size_t min_unchanged_run, std::vector<std::byte> &out);
+
+// Applies the tokens in `delta` to `out`, which holds the base. False, with
+// `out` partly updated, if a token is truncated or would run past `out`.
+bool apply_xor_delta(std::span<const std::byte> delta,
+                     std::span<std::byte> out);
+
+} // namespace common
+
+#endif